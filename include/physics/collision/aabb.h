@@ -0,0 +1,129 @@
+/**
+ * @file aabb.h
+ *
+ * @brief Axis-aligned bounding box
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __AABB_H
+#define __AABB_H
+
+#include <physics/defs.h>
+#include <limits>
+
+namespace Physics {
+
+/**
+ * @brief Axis-aligned bounding box. Unbounded shapes, such as planes, use
+ * infinite boxes. A box with min greater than max is empty.
+ */
+struct AABB {
+    glm::vec3 min; //!< Minimum corner
+    glm::vec3 max; //!< Maximum corner
+
+    /**
+     * @brief Get an empty box, which can be grown with merge()
+     */
+    static AABB empty();
+
+    /**
+     * @brief Get a box containing everything
+     */
+    static AABB infinite();
+
+    /**
+     * @brief Whether this box has any finite extent
+     */
+    bool isEmpty() const;
+
+    /**
+     * @brief Whether this box extends infinitely along any axis
+     */
+    bool isInfinite() const;
+
+    /**
+     * @brief Whether two boxes overlap
+     */
+    bool overlaps(const AABB & other) const;
+
+    /**
+     * @brief Grow this box to contain another box
+     */
+    void merge(const AABB & other);
+
+    /**
+     * @brief Grow this box to contain a point
+     */
+    void merge(const glm::vec3 & point);
+
+    /**
+     * @brief Grow this box by a distance in every direction
+     */
+    void inflate(float distance);
+
+    /**
+     * @brief Get center of box
+     */
+    glm::vec3 getCenter() const;
+};
+
+inline AABB AABB::empty() {
+    float inf = std::numeric_limits<float>::infinity();
+
+    AABB box;
+    box.min = glm::vec3( inf,  inf,  inf);
+    box.max = glm::vec3(-inf, -inf, -inf);
+
+    return box;
+}
+
+inline AABB AABB::infinite() {
+    float inf = std::numeric_limits<float>::infinity();
+
+    AABB box;
+    box.min = glm::vec3(-inf, -inf, -inf);
+    box.max = glm::vec3( inf,  inf,  inf);
+
+    return box;
+}
+
+inline bool AABB::isEmpty() const {
+    return min.x > max.x || min.y > max.y || min.z > max.z;
+}
+
+inline bool AABB::isInfinite() const {
+    float inf = std::numeric_limits<float>::infinity();
+
+    return min.x == -inf || min.y == -inf || min.z == -inf ||
+           max.x ==  inf || max.y ==  inf || max.z ==  inf;
+}
+
+inline bool AABB::overlaps(const AABB & other) const {
+    return min.x <= other.max.x && max.x >= other.min.x &&
+           min.y <= other.max.y && max.y >= other.min.y &&
+           min.z <= other.max.z && max.z >= other.min.z;
+}
+
+inline void AABB::merge(const AABB & other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+inline void AABB::merge(const glm::vec3 & point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+inline void AABB::inflate(float distance) {
+    min -= glm::vec3(distance);
+    max += glm::vec3(distance);
+}
+
+inline glm::vec3 AABB::getCenter() const {
+    return (min + max) * 0.5f;
+}
+
+}
+
+#endif
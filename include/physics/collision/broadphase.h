@@ -0,0 +1,213 @@
+/**
+ * @file broadphase.h
+ *
+ * @brief Coarse collision detection using a bounding volume hierarchy
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __BROADPHASE_H
+#define __BROADPHASE_H
+
+#include <physics/collision/aabb.h>
+#include <physics/collision/collision.h>
+#include <vector>
+
+namespace Physics {
+
+/**
+ * @brief Bounding volume hierarchy over body bounding boxes, rebuilt from
+ * scratch each step, and refit between steps. Finds candidate pairs for the narrowphase, and is
+ * traversed by scene queries. Boxes are identified by their index in the array
+ * passed to build(). Empty boxes are skipped, and infinite boxes (planes) are
+ * kept in a separate list which overlaps everything.
+ *
+ * Each box may carry collision group and mask bits. Two bodies form a pair
+ * only if each one's group has a bit in the other's mask. Nodes store the union
+ * of the bits below them, so whole subtrees which cannot interact are skipped,
+ * and excluded pairs cost a bitwise AND rather than a box test. An optional
+ * filter function can reject the remaining pairs before they reach the
+ * narrowphase.
+ */
+class PHYSICS_EXPORT Broadphase {
+public:
+
+    /**
+     * @brief Pair filter. Returns false to reject a pair of boxes which passed
+     * the group and mask test.
+     */
+    typedef bool (*PairFilter)(void *ctx, int i1, int i2);
+
+    /**
+     * @brief Tree node. Nodes are stored depth first, so the left child of an
+     * interior node immediately follows it.
+     */
+    struct Node {
+        AABB     box;    //!< Bounds of everything below this node
+        int      start;  //!< First entry in item list, for leaves
+        int      count;  //!< Number of items, or 0 for interior nodes
+        int      right;  //!< Index of right child, for interior nodes
+        unsigned groups; //!< Union of collision groups below this node
+        unsigned masks;  //!< Union of collision masks below this node
+    };
+
+private:
+
+    std::vector<AABB>      boxes;     //!< Box of each body
+    std::vector<int>       items;     //!< Bounded body indices, in leaf order
+    std::vector<int>       unbounded; //!< Body indices with infinite boxes
+    std::vector<Node>      nodes;     //!< Tree nodes, root first
+    std::vector<unsigned>  groups;    //!< Collision group bits of each body
+    std::vector<unsigned>  masks;     //!< Collision mask bits of each body
+    std::vector<glm::vec3> centers;   //!< Box centers, used while building
+    PairFilter             filter;
+    void                  *filterCtx;
+
+    void buildNode(int start, int count);
+
+    bool interacts(int i1, int i2) const;
+
+    void addPair(int i1, int i2, std::vector<Collision::Pair> & pairs) const;
+
+    void findPairsNode(int node, std::vector<Collision::Pair> & pairs) const;
+
+    void findPairsNodes(int a, int b, std::vector<Collision::Pair> & pairs) const;
+
+public:
+
+    Broadphase();
+
+    ~Broadphase();
+
+    /**
+     * @brief Rebuild the tree
+     *
+     * @param[in] boxes  Bounding box of each body
+     * @param[in] count  Number of boxes
+     * @param[in] groups Collision group bits of each body, or null to put every
+     *                   body in every group
+     * @param[in] masks  Collision mask bits of each body, or null to let every
+     *                   body collide with every group
+     */
+    void build(const AABB *boxes, size_t count, const unsigned *groups = nullptr,
+        const unsigned *masks = nullptr);
+
+    /**
+     * @brief Update boxes, groups and masks without changing the shape of the
+     * tree, which is cheaper than a rebuild but grows looser as bodies move.
+     * Returns false, changing nothing, if the count differs or any body
+     * became empty, bounded or unbounded, in which case the tree must be
+     * rebuilt.
+     */
+    bool refit(const AABB *boxes, size_t count, const unsigned *groups = nullptr,
+        const unsigned *masks = nullptr);
+
+    /**
+     * @brief Set a function to reject pairs during findPairs(), or null for
+     * none. It is called with ctx and the indices of the two bodies.
+     */
+    void setPairFilter(PairFilter filter, void *ctx);
+
+    /**
+     * @brief Find all pairs of bodies whose boxes overlap and whose groups and
+     * masks allow them to interact, and which pass the pair filter. Pairs are
+     * appended with the lower index first.
+     */
+    void findPairs(std::vector<Collision::Pair> & pairs) const;
+
+    /**
+     * @brief Call visitor(int index) for each body whose box overlaps the
+     * given box, including unbounded bodies
+     */
+    template<typename Visitor>
+    void query(const AABB & box, Visitor & visitor) const;
+
+    /**
+     * @brief Get number of boxes the tree was built with
+     */
+    size_t getCount() const;
+
+    /**
+     * @brief Get box of a body
+     */
+    const AABB & getBox(int index) const;
+
+    /**
+     * @brief Get tree nodes. Empty if there are no bounded bodies.
+     */
+    const std::vector<Node> & getNodes() const;
+
+    /**
+     * @brief Get body indices referenced by leaves
+     */
+    const std::vector<int> & getItems() const;
+
+    /**
+     * @brief Get indices of unbounded bodies
+     */
+    const std::vector<int> & getUnbounded() const;
+
+};
+
+// Maximum depth of the tree, used to size traversal stacks
+#define BROADPHASE_MAX_DEPTH 64
+
+template<typename Visitor>
+void Broadphase::query(const AABB & box, Visitor & visitor) const {
+    for (int index : unbounded)
+        visitor(index);
+
+    if (nodes.empty())
+        return;
+
+    int stack[BROADPHASE_MAX_DEPTH];
+    int top = 0;
+
+    stack[top++] = 0;
+
+    while (top > 0) {
+        const Node & node = nodes[stack[--top]];
+
+        if (!node.box.overlaps(box))
+            continue;
+
+        if (node.count > 0) {
+            for (int i = node.start; i < node.start + node.count; i++)
+                if (boxes[items[i]].overlaps(box))
+                    visitor(items[i]);
+        }
+        else {
+            int left = (int)(&node - &nodes[0]) + 1;
+            stack[top++] = node.right;
+            stack[top++] = left;
+        }
+    }
+}
+
+inline bool Broadphase::interacts(int i1, int i2) const {
+    return (groups[i1] & masks[i2]) && (groups[i2] & masks[i1]);
+}
+
+inline size_t Broadphase::getCount() const {
+    return boxes.size();
+}
+
+inline const AABB & Broadphase::getBox(int index) const {
+    return boxes[index];
+}
+
+inline const std::vector<Broadphase::Node> & Broadphase::getNodes() const {
+    return nodes;
+}
+
+inline const std::vector<int> & Broadphase::getItems() const {
+    return items;
+}
+
+inline const std::vector<int> & Broadphase::getUnbounded() const {
+    return unbounded;
+}
+
+}
+
+#endif
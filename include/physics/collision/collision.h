@@ -13,6 +13,8 @@
 #include <glm/glm.hpp>
 #include <physics/transform.h>
 #include <physics/collision/shape.h>
+#include <physics/collision/aabb.h>
+#include <vector>
 
 namespace Physics {
 namespace Collision {
@@ -24,37 +26,215 @@ namespace Collision {
 struct Contact {
     glm::vec3  position; //!< Contact location in world space
     glm::vec3  normal;   //!< Contact normal in world space, pointing from first shape to second
-    float      depth;    //!< Contact depth, where positive depth indicated penetration
+    float      depth;    //!< Contact depth, where positive depth indicated penetration,
+                         //!< and negative depth is the gap of a speculative contact
+};
+
+// Maximum number of points in a contact manifold
+#define MAX_MANIFOLD_CONTACTS 4
+
+/**
+ * @brief Contact manifold, which collects the contact points between two
+ * shapes. All points share the same normal. Resting boxes need several points
+ * so that they do not rock about a single corner.
+ */
+struct Manifold {
+    Contact contacts[MAX_MANIFOLD_CONTACTS]; //!< Contact points
+    int     count;                           //!< Number of contact points
+};
+
+/**
+ * @brief Candidate pair for fine-grained collision detection. Indices refer to
+ * the shape and transform arrays passed to checkCollisions().
+ */
+struct Pair {
+    int i1; //!< Index of first shape
+    int i2; //!< Index of second shape
+};
+
+/**
+ * @brief Contact generated for a candidate pair
+ */
+struct PairContact {
+    int     i1;      //!< Index of first shape
+    int     i2;      //!< Index of second shape
+    Contact contact; //!< Contact, with normal pointing from first shape to second
+};
+
+/**
+ * @brief Candidate pairs sorted by shape type. Each bucket is checked with one
+ * collision kernel, rather than dispatching per pair. Pairs are stored with the
+ * lower shape type first, so only the upper triangle of buckets is used.
+ */
+class PHYSICS_EXPORT PairBuckets {
+private:
+
+    std::vector<Pair> buckets[Shape::Count][Shape::Count];
+
+public:
+
+    /**
+     * @brief Remove all pairs, keeping allocated storage
+     */
+    void clear();
+
+    /**
+     * @brief Add a candidate pair. The pair may be swapped to keep the lower
+     * shape type first.
+     *
+     * @param[in] i1    Index of first shape
+     * @param[in] type1 Type of first shape
+     * @param[in] i2    Index of second shape
+     * @param[in] type2 Type of second shape
+     */
+    void add(int i1, Shape::ShapeType type1, int i2, Shape::ShapeType type2);
+
+    /**
+     * @brief Get the pairs of the given types. type1 must not be greater than
+     * type2.
+     */
+    const std::vector<Pair> & getBucket(Shape::ShapeType type1, Shape::ShapeType type2) const;
+
+    /**
+     * @brief Get the total number of pairs in all buckets
+     */
+    size_t size() const;
+
+};
+
+inline void PairBuckets::add(int i1, Shape::ShapeType type1, int i2, Shape::ShapeType type2) {
+    Pair pair;
+
+    if (type1 <= type2) {
+        pair.i1 = i1;
+        pair.i2 = i2;
+        buckets[type1][type2].push_back(pair);
+    }
+    else {
+        pair.i1 = i2;
+        pair.i2 = i1;
+        buckets[type2][type1].push_back(pair);
+    }
+}
+
+inline const std::vector<Pair> & PairBuckets::getBucket(Shape::ShapeType type1,
+    Shape::ShapeType type2) const
+{
+    return buckets[type1][type2];
+}
+
+/**
+ * @brief Structure-of-arrays copy of sphere and plane data, used by the batched
+ * sphere kernels. Arrays are indexed like the shape array passed to
+ * checkCollisions(). Position is valid for every shape, radius only for spheres,
+ * and normal and distance only for planes.
+ */
+class PHYSICS_EXPORT SphereBatch {
+public:
+
+    std::vector<float> x;      //!< Position X
+    std::vector<float> y;      //!< Position Y
+    std::vector<float> z;      //!< Position Z
+    std::vector<float> radius; //!< Sphere radius
+    std::vector<float> nx;     //!< Plane normal X
+    std::vector<float> ny;     //!< Plane normal Y
+    std::vector<float> nz;     //!< Plane normal Z
+    std::vector<float> dist;   //!< Plane distance
+
+    /**
+     * @brief Copy shape data into the arrays, keeping allocated storage
+     *
+     * @param[in] shapes     Shapes, which may be null
+     * @param[in] transforms Transforms
+     * @param[in] count      Number of shapes
+     */
+    void gather(const Shape * const *shapes, const Transform * const *transforms, size_t count);
+
 };
 
 /**
- * @brief Contact manifold, which collects a set of contact points
+ * @brief Check a batch of sphere/sphere pairs. Pairs are rejected by squared
+ * distance eight at a time when built with AVX2, and only surviving pairs pay
+ * for a square root.
+ *
+ * @param[in]  pairs    Candidate pairs
+ * @param[in]  count    Number of pairs
+ * @param[in]  x        Sphere position X, indexed by pair indices
+ * @param[in]  y        Sphere position Y
+ * @param[in]  z        Sphere position Z
+ * @param[in]  radius   Sphere radius
+ * @param[out] contacts Contacts are appended to this list
  */
-/*struct Manifold {
-    Body                 *b1;       //!< First body
-    Body                 *b2;       //!< Second body
-    std::vector<Contact>  contacts; //!< Set of contacts
-};*/
+void PHYSICS_EXPORT checkCollisionSphereSphereBatch(const Pair *pairs, size_t count,
+    const float *x, const float *y, const float *z, const float *radius,
+    std::vector<PairContact> & contacts);
 
 /**
- * @brief Initialize collision system. This can safely be called more than once.
+ * @brief Check a batch of sphere/plane pairs, where the first index of each
+ * pair is the sphere. See checkCollisionSphereSphereBatch().
+ *
+ * @param[in]  pairs    Candidate pairs
+ * @param[in]  count    Number of pairs
+ * @param[in]  x        Sphere position X, indexed by pair indices
+ * @param[in]  y        Sphere position Y
+ * @param[in]  z        Sphere position Z
+ * @param[in]  radius   Sphere radius
+ * @param[in]  nx       Plane normal X
+ * @param[in]  ny       Plane normal Y
+ * @param[in]  nz       Plane normal Z
+ * @param[in]  dist     Plane distance
+ * @param[out] contacts Contacts are appended to this list
  */
-void PHYSICS_EXPORT initialize(); // TODO static?
+void PHYSICS_EXPORT checkCollisionSpherePlaneBatch(const Pair *pairs, size_t count,
+    const float *x, const float *y, const float *z, const float *radius,
+    const float *nx, const float *ny, const float *nz, const float *dist,
+    std::vector<PairContact> & contacts);
 
 /**
- * @brief Check for collision with another shape. This function calls the
- * central fine-collision function as a convenience. TODO inline this.
+ * @brief Compute the world space bounding box of a shape. Planes have infinite
+ * boxes.
+ *
+ * @param[in]  shape Shape
+ * @param[in]  t     Transform of the body corresponding to this shape
+ * @param[out] box   Bounding box
+ */
+void PHYSICS_EXPORT getBoundingBox(const Shape & shape, const Transform & t, AABB & box);
+
+/**
+ * @brief Check for collision with another shape. This is dispatched through a
+ * table built at compile time, and is meant for one-off checks. Batches of pairs
+ * should go through checkCollisions().
  *
  * @param[in]  s1      First shape
  * @param[in]  s2      Second shape
  * @param[in]  t1      Transform of first body, corresponding to this shape
  * @param[in]  t2      Transform of second body, corresponding to other shape
- * @param[out] contact Contact, which should be filled out if there was a collision
+ * @param[out] manifold Contact points, which are filled out if there was a
+ *                      collision
+ * @param[in]  margin   Shapes separated by less than this distance also produce
+ *                      speculative contacts, with negative depth
  *
  * @return True if there was a collision, or false otherwise
  */
 bool PHYSICS_EXPORT checkCollision(const Shape & s1, const Shape & s2, const Transform & t1,
-    const Transform & t2, Contact & contact);
+    const Transform & t2, Manifold & manifold, float margin = 0.0f);
+
+/**
+ * @brief Check every pair in a set of buckets for collision. Each bucket runs
+ * through a single loop with its collision function inlined. Sphere/sphere and
+ * sphere/plane pairs use the batched SoA kernels. Each point of a manifold is
+ * appended as its own contact, and points of the same pair are adjacent.
+ *
+ * @param[in]  buckets    Candidate pairs
+ * @param[in]  shapes     Shapes, indexed by pair indices
+ * @param[in]  transforms Transforms, indexed by pair indices
+ * @param[in]  count      Number of shapes and transforms
+ * @param[in]  batch      Scratch space for the batched sphere kernels
+ * @param[out] contacts   Contacts are appended to this list
+ */
+void PHYSICS_EXPORT checkCollisions(const PairBuckets & buckets, const Shape * const *shapes,
+    const Transform * const *transforms, size_t count, SphereBatch & batch,
+    std::vector<PairContact> & contacts);
 
 }}
 
@@ -0,0 +1,145 @@
+/**
+ * @file contactcache.h
+ *
+ * @brief Cache of narrowphase results, reused while the relative transform
+ * between two bodies stays nearly the same
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __CONTACTCACHE_H
+#define __CONTACTCACHE_H
+
+#include <physics/collision/collision.h>
+#include <unordered_map>
+#include <stdint.h>
+
+namespace Physics {
+namespace Collision {
+
+#define MAX_CACHED_CONTACTS 4
+
+/**
+ * @brief Per-pair cache of generated contacts. Each entry stores the relative
+ * pose of the pair when its contacts were computed, and the contacts in the
+ * first body's local space. While the relative pose stays within a tolerance,
+ * the contacts are projected to the current pose instead of running the
+ * narrowphase again. Pairs which had no contacts are cached too, with an empty
+ * contact list.
+ *
+ * Entries are refreshed when looked up or stored during a step, and entries that
+ * were not touched during a step are evicted by endStep().
+ */
+class PHYSICS_EXPORT ContactCache {
+private:
+
+    struct Entry {
+        int       i1;                            //!< Index of first body
+        int       i2;                            //!< Index of second body
+        glm::vec3 relPosition;                   //!< Second body position in first body space
+        glm::quat relOrientation;                //!< Second body orientation in first body space
+        glm::vec3 position[MAX_CACHED_CONTACTS]; //!< Contact positions in first body space
+        glm::vec3 normal[MAX_CACHED_CONTACTS];   //!< Contact normals in first body space
+        float     depth[MAX_CACHED_CONTACTS];    //!< Contact depths
+        int       count;                         //!< Number of contacts
+        unsigned  stamp;                         //!< Step the entry was last used
+    };
+
+    std::unordered_map<uint64_t, Entry> entries;
+    unsigned  stamp;
+    float     linearTolerance;
+    float     minOrientationDot;
+    long long hits;
+    long long misses;
+
+    static uint64_t key(int i1, int i2);
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] linearTolerance  Maximum change in relative position
+     * @param[in] angularTolerance Maximum change in relative orientation, in radians
+     */
+    ContactCache(float linearTolerance = 0.002f, float angularTolerance = 0.005f);
+
+    ~ContactCache();
+
+    /**
+     * @brief Set tolerances. See constructor.
+     */
+    void setTolerance(float linearTolerance, float angularTolerance);
+
+    /**
+     * @brief Start a new step
+     */
+    void beginStep();
+
+    /**
+     * @brief Evict entries which were not used during the current step
+     */
+    void endStep();
+
+    /**
+     * @brief Remove all entries
+     */
+    void clear();
+
+    /**
+     * @brief Look up a pair. On a hit, the cached contacts are projected to the
+     * current pose and appended to contacts.
+     *
+     * @param[in]  i1       Index of first body
+     * @param[in]  i2       Index of second body
+     * @param[in]  t1       Transform of first body
+     * @param[in]  t2       Transform of second body
+     * @param[out] contacts Contacts are appended to this list on a hit
+     *
+     * @return True on a hit, or false if the narrowphase must be run
+     */
+    bool lookup(int i1, int i2, const Transform & t1, const Transform & t2,
+        std::vector<PairContact> & contacts);
+
+    /**
+     * @brief Store the pose of a pair that went through the narrowphase during
+     * this step, with an empty contact list. Generated contacts are added with
+     * addContact().
+     *
+     * @param[in] i1 Index of first body
+     * @param[in] i2 Index of second body
+     * @param[in] t1 Transform of first body
+     * @param[in] t2 Transform of second body
+     */
+    void store(int i1, int i2, const Transform & t1, const Transform & t2);
+
+    /**
+     * @brief Add a contact generated by the narrowphase to an entry stored
+     * during this step. At most MAX_CACHED_CONTACTS are kept per pair, and an
+     * entry which overflows is dropped so that the pair is recomputed.
+     *
+     * @param[in] contact Contact
+     * @param[in] t1      Transform of first body
+     */
+    void addContact(const PairContact & contact, const Transform & t1);
+
+    /**
+     * @brief Get number of lookups which reused cached contacts
+     */
+    long long getHits() const;
+
+    /**
+     * @brief Get number of lookups which required the narrowphase
+     */
+    long long getMisses() const;
+
+    /**
+     * @brief Reset hit and miss counters
+     */
+    void resetCounters();
+
+};
+
+}}
+
+#endif
@@ -0,0 +1,116 @@
+/**
+ * @file contactevents.h
+ *
+ * @brief Tracking of touching pairs across steps, to report when bodies start
+ * and stop touching
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __CONTACTEVENTS_H
+#define __CONTACTEVENTS_H
+
+#include <physics/collision/collision.h>
+#include <vector>
+#include <stdint.h>
+
+namespace Physics {
+namespace Collision {
+
+/**
+ * @brief Change in the touching state of a pair between two steps
+ */
+struct PairEvent {
+    enum Type {
+        Begin,   //!< Pair started touching this step
+        Persist, //!< Pair is touching, or stopped touching within the end delay
+        End      //!< Pair has not touched for longer than the end delay
+    };
+
+    Type      type;     //!< Event type
+    int       i1;       //!< Index of body with the lower index
+    int       i2;       //!< Index of body with the higher index
+    glm::vec3 position; //!< Deepest contact point. Last known point for End.
+    glm::vec3 normal;   //!< Normal at deepest contact, pointing from i1 to i2
+    float     impulse;  //!< Normal impulse summed over the pair's contacts. 0 if not touching.
+};
+
+/**
+ * @brief Tracks which pairs are touching from one step to the next. Contacts
+ * are collected during a step, then sorted by pair and merged against the
+ * sorted list from the previous step. This needs no hashing, and its cost
+ * only depends on the number of touching pairs.
+ *
+ * Resting contacts often separate for a step or two as the solver settles. A
+ * pair which stops touching is kept for a few steps before it ends, reporting
+ * Persist with no impulse, so that these gaps do not produce Begin/End noise.
+ * Persist therefore means the pair is touching or touched recently, and a
+ * Persist with no impulse may be for a pair which is no longer touching.
+ */
+class PHYSICS_EXPORT ContactTracker {
+private:
+
+    struct Touch {
+        uint64_t  key;      //!< Pair key, lower index in the high bits
+        glm::vec3 position; //!< Deepest contact point
+        glm::vec3 normal;   //!< Normal from lower to higher index
+        float     depth;    //!< Deepest contact depth
+        float     impulse;  //!< Summed normal impulse
+        int       missed;   //!< Consecutive steps without a contact
+    };
+
+    std::vector<Touch> previous;
+    std::vector<Touch> current;
+    std::vector<Touch> next;
+    int                endDelay;
+
+    static void addEvent(PairEvent::Type type, const Touch & touch,
+        std::vector<PairEvent> & events);
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] endDelay Number of steps a pair may go without contacts
+     *                     before it ends
+     */
+    ContactTracker(int endDelay = 8);
+
+    /**
+     * @brief Set end delay. See constructor.
+     */
+    void setEndDelay(int endDelay);
+
+    ~ContactTracker();
+
+    /**
+     * @brief Start collecting the contacts of a new step
+     */
+    void beginStep();
+
+    /**
+     * @brief Add a contact which is touching in this step. A pair may have
+     * several contacts.
+     *
+     * @param[in] contact Contact
+     * @param[in] impulse Normal impulse the solver applied at this contact
+     */
+    void addContact(const PairContact & contact, float impulse);
+
+    /**
+     * @brief Finish a step, appending events for each pair which is touching
+     * in this step or was in the previous one. Events are ordered by pair.
+     */
+    void endStep(std::vector<PairEvent> & events);
+
+    /**
+     * @brief Forget all touching pairs, without generating End events
+     */
+    void clear();
+
+};
+
+}}
+
+#endif
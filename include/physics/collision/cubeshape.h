@@ -34,6 +34,21 @@ public:
 
 };
 
+// Accessors are inline so that collision kernels can be inlined into their
+// batch loops.
+
+inline float CubeShape::getWidth() const {
+    return width;
+}
+
+inline float CubeShape::getHeight() const {
+    return height;
+}
+
+inline float CubeShape::getDepth() const {
+    return depth;
+}
+
 }
 
 #endif
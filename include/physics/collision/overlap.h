@@ -0,0 +1,106 @@
+/**
+ * @file overlap.h
+ *
+ * @brief Overlap, closest point and nearest neighbor queries against shapes, and
+ * batches of them against the broadphase
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __OVERLAP_H
+#define __OVERLAP_H
+
+#include <physics/collision/broadphase.h>
+#include <physics/threadpool.h>
+
+namespace Physics {
+namespace Collision {
+
+/**
+ * @brief Closest point on a shape to a query point
+ */
+struct PointHit {
+    int       index;    //!< Index of shape
+    float     distance; //!< Distance from query point to shape, 0 if inside
+    glm::vec3 point;    //!< Closest point on shape
+};
+
+/**
+ * @brief Check whether a shape overlaps a sphere
+ */
+bool PHYSICS_EXPORT overlapSphere(const Shape & shape, const Transform & t,
+    const glm::vec3 & center, float radius);
+
+/**
+ * @brief Check whether a shape overlaps an axis-aligned box
+ */
+bool PHYSICS_EXPORT overlapBox(const Shape & shape, const Transform & t, const AABB & box);
+
+/**
+ * @brief Find the closest point on a shape to a point
+ *
+ * @param[in]  shape   Shape
+ * @param[in]  t       Transform of the body corresponding to this shape
+ * @param[in]  point   Query point
+ * @param[out] closest Closest point on shape, or the query point if it is inside
+ *
+ * @return Distance to the shape, or 0 if the point is inside
+ */
+float PHYSICS_EXPORT closestPoint(const Shape & shape, const Transform & t,
+    const glm::vec3 & point, glm::vec3 & closest);
+
+// The batched queries below write into caller-provided arrays with a fixed
+// number of slots per query, so they do no allocation. Query q owns slots
+// [q * maxResults, (q + 1) * maxResults). Queries are spread over the pool.
+
+/**
+ * @brief Find shapes overlapping each of a batch of spheres
+ *
+ * @param[in]  broadphase Broadphase built over the shapes
+ * @param[in]  shapes     Shapes, indexed like the broadphase boxes
+ * @param[in]  transforms Transforms, indexed like the broadphase boxes
+ * @param[in]  centers    Sphere centers
+ * @param[in]  radii      Sphere radii
+ * @param[in]  count      Number of queries
+ * @param[in]  maxResults Slots per query
+ * @param[out] results    Shape indices, count * maxResults slots
+ * @param[out] counts     Number of overlapping shapes per query. This may be
+ *                        larger than maxResults, in which case only the first
+ *                        maxResults were stored.
+ * @param[in]  pool       Thread pool
+ */
+void PHYSICS_EXPORT overlapSpheres(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const glm::vec3 *centers, const float *radii,
+    size_t count, int maxResults, int *results, int *counts, ThreadPool & pool);
+
+/**
+ * @brief Find shapes overlapping each of a batch of axis-aligned boxes. See
+ * overlapSpheres().
+ */
+void PHYSICS_EXPORT overlapBoxes(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const AABB *boxes, size_t count, int maxResults,
+    int *results, int *counts, ThreadPool & pool);
+
+/**
+ * @brief Find the k shapes nearest to each of a batch of points, by distance to
+ * the shape's surface. The tree is traversed nearest first and pruned against
+ * the k-th best distance found so far.
+ *
+ * @param[in]  broadphase  Broadphase built over the shapes
+ * @param[in]  shapes      Shapes, indexed like the broadphase boxes
+ * @param[in]  transforms  Transforms, indexed like the broadphase boxes
+ * @param[in]  points      Query points
+ * @param[in]  count       Number of queries
+ * @param[in]  k           Number of neighbors, and slots per query
+ * @param[in]  maxDistance Shapes further than this are ignored
+ * @param[out] results     Neighbors sorted nearest first, count * k slots
+ * @param[out] counts      Number of neighbors found per query, at most k
+ * @param[in]  pool        Thread pool
+ */
+void PHYSICS_EXPORT nearest(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const glm::vec3 *points, size_t count, int k,
+    float maxDistance, PointHit *results, int *counts, ThreadPool & pool);
+
+}}
+
+#endif
@@ -0,0 +1,187 @@
+/**
+ * @file particlecollider.h
+ *
+ * @brief Snapshot of a body for colliding particles against
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __PARTICLECOLLIDER_H
+#define __PARTICLECOLLIDER_H
+
+#include <physics/collision/shape.h>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+
+/**
+ * @brief Shape and motion of a sphere, plane or cube body, copied once per
+ * step so that particles of cloth and soft bodies can be tested against it
+ * from many threads without touching the body.
+ */
+struct PHYSICS_EXPORT ParticleCollider {
+    Body *           body;
+    Shape::ShapeType type;
+    glm::vec3        position;
+    glm::quat        orientation;
+    glm::vec3        linearVelocity;
+    glm::vec3        angularVelocity;
+    glm::vec3        size;     //!< Sphere radius in x, cube half extents, or plane normal
+    float            distance; //!< Plane distance
+
+    /**
+     * @brief Copy a body. Returns false if the body has no shape particles
+     * collide with.
+     */
+    bool set(Body *body);
+
+    /**
+     * @brief Find whether a sphere overlaps the shape, and if so, the
+     * direction and distance to move it out
+     *
+     * @param[in]  point  Center of sphere
+     * @param[in]  radius Radius of sphere
+     * @param[out] normal Direction out of the shape
+     * @param[out] depth  Distance to move along the normal
+     */
+    bool getContact(const glm::vec3 & point, float radius, glm::vec3 & normal,
+        float & depth) const;
+
+    /**
+     * @brief Get velocity of the body at a point in world space
+     */
+    glm::vec3 getVelocityAtPoint(const glm::vec3 & point) const;
+};
+
+/**
+ * @brief Colliders copied from the bodies near a cloth, soft body, fluid or
+ * other particles for one step, with the impulses the particles apply to
+ * them. Each thread sums impulses into its own slots, so threads need not
+ * synchronize, and the sums are applied to the bodies once the step is done.
+ */
+class PHYSICS_EXPORT ParticleColliders {
+private:
+
+    std::vector<ParticleCollider> colliders;
+    std::vector<glm::vec3>        linearImpulses;
+    std::vector<glm::vec3>        angularImpulses;
+    int                           numThreads;
+
+public:
+
+    ParticleColliders();
+
+    ~ParticleColliders();
+
+    /**
+     * @brief Copy the bodies particles collide with, and clear impulses for
+     * the given number of threads
+     */
+    void set(Body *const *bodies, int numBodies, int numThreads);
+
+    int size() const;
+
+    const ParticleCollider & operator[](int k) const;
+
+    /**
+     * @brief Get a thread's impulses on each collider, or null if there are no
+     * colliders
+     */
+    glm::vec3 *getLinearImpulses(int thread);
+
+    glm::vec3 *getAngularImpulses(int thread);
+
+    /**
+     * @brief Apply the impulses of all threads to free bodies
+     */
+    void apply();
+
+};
+
+inline bool ParticleCollider::getContact(const glm::vec3 & point, float radius,
+    glm::vec3 & normal, float & depth) const
+{
+    switch (type) {
+    case Shape::Sphere:
+    {
+        glm::vec3 d = point - position;
+        float r = size.x + radius;
+        float dist2 = glm::dot(d, d);
+
+        if (dist2 >= r * r)
+            return false;
+
+        float dist = sqrtf(dist2);
+        normal = dist > 1e-6f ? d / dist : glm::vec3(0, 1, 0);
+        depth = r - dist;
+        return true;
+    }
+    case Shape::Plane:
+    {
+        // Planes are in world space, as in the narrowphase
+        float dist = glm::dot(point, size) - distance;
+
+        if (dist >= radius)
+            return false;
+
+        normal = size;
+        depth = radius - dist;
+        return true;
+    }
+    case Shape::Cube:
+    {
+        glm::vec3 local = glm::conjugate(orientation) * (point - position);
+        glm::vec3 closest = glm::clamp(local, -size, size);
+        glm::vec3 d = local - closest;
+        float dist2 = glm::dot(d, d);
+
+        if (dist2 >= radius * radius)
+            return false;
+
+        if (dist2 > 0.0f) {
+            float dist = sqrtf(dist2);
+            normal = d / dist;
+            depth = radius - dist;
+        }
+        else {
+            // Inside, so leave through the nearest face
+            glm::vec3 gap = size - glm::abs(local);
+            int axis = gap.x < gap.y ? (gap.x < gap.z ? 0 : 2) : (gap.y < gap.z ? 1 : 2);
+            normal = glm::vec3();
+            normal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+            depth = gap[axis] + radius;
+        }
+
+        normal = orientation * normal;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+inline glm::vec3 ParticleCollider::getVelocityAtPoint(const glm::vec3 & point) const {
+    return linearVelocity + glm::cross(angularVelocity, point - position);
+}
+
+inline int ParticleColliders::size() const {
+    return (int)colliders.size();
+}
+
+inline const ParticleCollider & ParticleColliders::operator[](int k) const {
+    return colliders[k];
+}
+
+inline glm::vec3 *ParticleColliders::getLinearImpulses(int thread) {
+    return colliders.empty() ? nullptr : &linearImpulses[thread * colliders.size()];
+}
+
+inline glm::vec3 *ParticleColliders::getAngularImpulses(int thread) {
+    return colliders.empty() ? nullptr : &angularImpulses[thread * colliders.size()];
+}
+
+}
+
+#endif
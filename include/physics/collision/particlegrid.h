@@ -0,0 +1,142 @@
+/**
+ * @file particlegrid.h
+ *
+ * @brief Uniform grid of cells for finding nearby particles
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __PARTICLEGRID_H
+#define __PARTICLEGRID_H
+
+#include <physics/collision/aabb.h>
+#include <physics/threadpool.h>
+#include <atomic>
+#include <vector>
+
+namespace Physics {
+
+/**
+ * @brief Uniform grid of cells over the box around a set of points, such as
+ * fluid particles or grains. Points are counting sorted by cell in parallel,
+ * with atomic counts, a blocked prefix sum and an atomic scatter, and then by
+ * index within each cell, so that the order does not depend on the number of
+ * threads. Cells are numbered along x first, so that a row of cells is one
+ * range of the sorted order.
+ *
+ * Points outside the grid are sorted into the nearest cell. Clamping moves a
+ * point by no more cells than the point itself moved, so points within a cell
+ * of each other stay within a cell of each other.
+ */
+class PHYSICS_EXPORT ParticleGrid {
+private:
+
+    AABB       bounds;
+    glm::ivec3 size;
+    float      cellSize;
+    float      invCellSize;
+
+    std::vector<int>              keys;
+    std::vector<std::atomic<int>> counts;
+    std::vector<int>              blockSums;
+    std::vector<AABB>             threadBounds;
+
+public:
+
+    ParticleGrid();
+
+    ~ParticleGrid();
+
+    /**
+     * @brief Fit the grid to the box around some points. Cells are at least
+     * minCellSize across, and grow when the grid would have more than maxCells
+     * cells, such as when points are spread thin.
+     */
+    void fit(ThreadPool & pool, const glm::vec3 *points, int count, float minCellSize,
+        int maxCells);
+
+    /**
+     * @brief Fit the grid to given cells, such as blocks of another lattice
+     */
+    void fit(const glm::vec3 & origin, const glm::ivec3 & size, float cellSize);
+
+    /**
+     * @brief Sort points into cells. Cell c holds points order[starts[c]] up to
+     * order[starts[c + 1]], in index order.
+     */
+    void sort(ThreadPool & pool, const glm::vec3 *points, int count, std::vector<int> & starts,
+        std::vector<int> & order);
+
+    /**
+     * @brief Reorder an array of points, or of stride items per point, into
+     * the order found by sort(). The old array is swapped into sorted, so
+     * that it can be reused as scratch.
+     */
+    template<typename T>
+    static void reorder(ThreadPool & pool, const std::vector<int> & order, std::vector<T> & array,
+        std::vector<T> & sorted, int stride = 1);
+
+    /**
+     * @brief Get box the grid was fit to
+     */
+    const AABB & getBounds() const;
+
+    const glm::ivec3 & getSize() const;
+
+    int getNumCells() const;
+
+    float getCellSize() const;
+
+    /**
+     * @brief Get cell of a point, clamped to the grid
+     */
+    glm::ivec3 getCell(const glm::vec3 & point) const;
+
+    int getCellIndex(const glm::ivec3 & cell) const;
+
+};
+
+inline const AABB & ParticleGrid::getBounds() const {
+    return bounds;
+}
+
+inline const glm::ivec3 & ParticleGrid::getSize() const {
+    return size;
+}
+
+inline int ParticleGrid::getNumCells() const {
+    return size.x * size.y * size.z;
+}
+
+inline float ParticleGrid::getCellSize() const {
+    return cellSize;
+}
+
+inline glm::ivec3 ParticleGrid::getCell(const glm::vec3 & point) const {
+    glm::vec3 cell = glm::floor((point - bounds.min) * invCellSize);
+
+    return glm::clamp(glm::ivec3(cell), glm::ivec3(0), size - glm::ivec3(1));
+}
+
+inline int ParticleGrid::getCellIndex(const glm::ivec3 & cell) const {
+    return cell.x + size.x * (cell.y + size.y * cell.z);
+}
+
+template<typename T>
+void ParticleGrid::reorder(ThreadPool & pool, const std::vector<int> & order,
+    std::vector<T> & array, std::vector<T> & sorted, int stride)
+{
+    sorted.resize(array.size());
+
+    pool.parallelFor((int)order.size(), 256, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            for (int k = 0; k < stride; k++)
+                sorted[i * stride + k] = array[order[i] * stride + k];
+    });
+
+    array.swap(sorted);
+}
+
+}
+
+#endif
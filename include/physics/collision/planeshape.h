@@ -32,6 +32,17 @@ public:
 
 };
 
+// Accessors are inline so that collision kernels can be inlined into their
+// batch loops.
+
+inline glm::vec3 PlaneShape::getNormal() const {
+    return normal;
+}
+
+inline float PlaneShape::getDistance() const {
+    return dist;
+}
+
 }
 
 #endif
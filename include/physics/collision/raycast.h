@@ -0,0 +1,94 @@
+/**
+ * @file raycast.h
+ *
+ * @brief Ray casts against shapes and batches of ray casts against the
+ * broadphase
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __RAYCAST_H
+#define __RAYCAST_H
+
+#include <physics/collision/broadphase.h>
+#include <physics/threadpool.h>
+#include <vector>
+
+namespace Physics {
+namespace Collision {
+
+// Number of rays traced together when rays are coherent
+#define RAY_PACKET_SIZE 8
+
+/**
+ * @brief Ray to cast into the scene
+ */
+struct Ray {
+    glm::vec3 origin;      //!< Ray origin
+    glm::vec3 direction;   //!< Ray direction, which must be unit length
+    float     maxDistance; //!< Hits further than this along the ray are ignored
+};
+
+/**
+ * @brief Ray hit. Rays which start inside a shape hit it at distance 0, with
+ * the normal facing back along the ray.
+ */
+struct RayHit {
+    int       index;    //!< Index of shape which was hit, or -1 for no hit
+    float     distance; //!< Distance along ray
+    glm::vec3 point;    //!< Hit point in world space
+    glm::vec3 normal;   //!< Surface normal at hit point in world space
+};
+
+/**
+ * @brief Cast a ray against one shape
+ *
+ * @param[in]  shape       Shape
+ * @param[in]  t           Transform of the body corresponding to this shape
+ * @param[in]  ray         Ray
+ * @param[in]  maxDistance Ignore hits further than this
+ * @param[out] hit         Distance, point and normal are filled in on a hit
+ *
+ * @return True if the ray hit the shape
+ */
+bool PHYSICS_EXPORT raycast(const Shape & shape, const Transform & t, const Ray & ray,
+    float maxDistance, RayHit & hit);
+
+/**
+ * @brief Find the closest hit for each of a batch of rays. Rays are grouped
+ * into packets of RAY_PACKET_SIZE consecutive rays, and packets whose rays point
+ * into the same octant traverse the broadphase together. Packets are spread
+ * over the thread pool.
+ *
+ * @param[in]  broadphase Broadphase built over the shapes
+ * @param[in]  shapes     Shapes, indexed like the broadphase boxes
+ * @param[in]  transforms Transforms, indexed like the broadphase boxes
+ * @param[in]  rays       Rays
+ * @param[in]  count      Number of rays
+ * @param[out] hits       One hit per ray
+ * @param[in]  pool       Thread pool
+ */
+void PHYSICS_EXPORT raycastClosest(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const Ray *rays, size_t count, RayHit *hits,
+    ThreadPool & pool);
+
+/**
+ * @brief Find every hit for each of a batch of rays. Hits for ray i are stored
+ * in hits[offsets[i]] up to hits[offsets[i + 1]], sorted by distance.
+ *
+ * @param[in]  broadphase Broadphase built over the shapes
+ * @param[in]  shapes     Shapes, indexed like the broadphase boxes
+ * @param[in]  transforms Transforms, indexed like the broadphase boxes
+ * @param[in]  rays       Rays
+ * @param[in]  count      Number of rays
+ * @param[out] hits       Hits, grouped by ray
+ * @param[out] offsets    count + 1 offsets into hits
+ * @param[in]  pool       Thread pool
+ */
+void PHYSICS_EXPORT raycastAll(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const Ray *rays, size_t count,
+    std::vector<RayHit> & hits, std::vector<size_t> & offsets, ThreadPool & pool);
+
+}}
+
+#endif
@@ -30,7 +30,8 @@ public:
      * @brief Shape types, used to avoid requiring RTTI
      */
     enum ShapeType {
-        // Note: When adding to this table, update dispatchTable in collision.cpp.
+        // Note: When adding to this table, update ShapeClass and the dispatch
+        // tables in collision.cpp.
         Sphere,  //!< Sphere shape type
         Plane,   //!< Plane shape type
         Cube,    //!< Cube shape type
@@ -70,6 +71,10 @@ public:
 
 };
 
+inline enum Shape::ShapeType Shape::getShapeType() const {
+    return shapeType;
+}
+
 }
 
 #endif
@@ -28,6 +28,13 @@ public:
 
 };
 
+// Accessors are inline so that collision kernels can be inlined into their
+// batch loops.
+
+inline float SphereShape::getRadius() const {
+    return r;
+}
+
 }
 
 #endif
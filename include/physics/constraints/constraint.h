@@ -14,17 +14,45 @@
 
 namespace Physics {
 
+/**
+ * @brief Constraint between bodies. Like Shape, each constraint has a type so
+ * that solvers can handle each kind directly without RTTI. Constraints only
+ * describe how bodies are connected. System::addConstraint() copies them into
+ * a pool per type, such as RodPool, which the solvers work from.
+ */
 class PHYSICS_EXPORT Constraint {
 public:
 
-    Constraint();
+    /**
+     * @brief Constraint types, used to avoid requiring RTTI
+     */
+    enum ConstraintType {
+        Rod,    //!< Rod constraint type
+        Spring, //!< Spring constraint type
+        Count   //!< Number of constraint types
+    };
+
+private:
+
+    enum ConstraintType constraintType; //!< Constraint type
+
+public:
+
+    Constraint(enum ConstraintType type);
 
     virtual ~Constraint() = 0;
 
-    virtual void apply(double t, double dt) = 0;
+    /**
+     * @brief Get this constraint's type
+     */
+    enum ConstraintType getConstraintType() const;
 
 };
 
+inline enum Constraint::ConstraintType Constraint::getConstraintType() const {
+    return constraintType;
+}
+
 }
 
 #endif
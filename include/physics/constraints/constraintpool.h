@@ -0,0 +1,89 @@
+/**
+ * @file constraintpool.h
+ *
+ * @brief Constraints of one type, stored as a structure of arrays
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __CONSTRAINTPOOL_H
+#define __CONSTRAINTPOOL_H
+
+#include <physics/defs.h>
+#include <vector>
+
+namespace Physics {
+
+/**
+ * @brief Rod (fixed distance) constraints between the centers of mass of pairs
+ * of bodies. Bodies are referred to by their index in the System, and each
+ * field is stored in its own array, so that solvers run one tight loop over
+ * every rod.
+ *
+ * The solver state is refreshed at the start of each step, or each substep
+ * when substepping.
+ */
+struct PHYSICS_EXPORT RodPool {
+    std::vector<int>       body1;   //!< Index of first body
+    std::vector<int>       body2;   //!< Index of second body
+    std::vector<float>     length;  //!< Rest length
+
+    std::vector<glm::vec3> normal;  //!< Direction from first body to second
+    std::vector<float>     mass;    //!< Effective mass along the normal
+    std::vector<float>     bias;    //!< Velocity which corrects the length error
+    std::vector<float>     impulse; //!< Accumulated impulse along the normal
+
+    /**
+     * @brief Add a rod, returning its index
+     */
+    int add(int body1, int body2, float length);
+
+    /**
+     * @brief Get the number of rods
+     */
+    int size() const;
+
+};
+
+/**
+ * @brief Damped spring constraints between the centers of mass of pairs of
+ * bodies, stored like RodPool. Velocity solvers treat each spring as a soft
+ * rod, whose softness and bias are derived from its stiffness and damping so
+ * that the spring is stable at any step.
+ */
+struct PHYSICS_EXPORT SpringPool {
+    std::vector<int>       body1;     //!< Index of first body
+    std::vector<int>       body2;     //!< Index of second body
+    std::vector<float>     stiffness; //!< Spring constant
+    std::vector<float>     length;    //!< Rest length
+    std::vector<float>     damping;   //!< Damping coefficient
+
+    std::vector<glm::vec3> normal;    //!< Direction from first body to second
+    std::vector<float>     mass;      //!< Effective mass along the normal, including softness
+    std::vector<float>     bias;      //!< Velocity which corrects the length error
+    std::vector<float>     softness;  //!< Velocity error per unit of accumulated impulse
+    std::vector<float>     impulse;   //!< Accumulated impulse along the normal
+
+    /**
+     * @brief Add a spring, returning its index
+     */
+    int add(int body1, int body2, float stiffness, float length, float damping);
+
+    /**
+     * @brief Get the number of springs
+     */
+    int size() const;
+
+};
+
+inline int RodPool::size() const {
+    return (int)body1.size();
+}
+
+inline int SpringPool::size() const {
+    return (int)body1.size();
+}
+
+}
+
+#endif
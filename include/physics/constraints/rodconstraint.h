@@ -28,10 +28,26 @@ public:
 
     ~RodConstraint();
 
-    void apply(double t, double dt);
+    Body *getBody1() const;
+
+    Body *getBody2() const;
+
+    float getLength() const;
 
 };
 
+inline Body *RodConstraint::getBody1() const {
+    return b1.get();
+}
+
+inline Body *RodConstraint::getBody2() const {
+    return b2.get();
+}
+
+inline float RodConstraint::getLength() const {
+    return length;
+}
+
 }
 
 #endif
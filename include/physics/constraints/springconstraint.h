@@ -30,10 +30,38 @@ public:
 
     ~SpringConstraint();
 
-    void apply(double t, double dt);
+    Body *getBody1() const;
+
+    Body *getBody2() const;
+
+    float getStiffness() const;
+
+    float getLength() const;
+
+    float getDamping() const;
 
 };
 
+inline Body *SpringConstraint::getBody1() const {
+    return b1.get();
+}
+
+inline Body *SpringConstraint::getBody2() const {
+    return b2.get();
+}
+
+inline float SpringConstraint::getStiffness() const {
+    return k;
+}
+
+inline float SpringConstraint::getLength() const {
+    return length;
+}
+
+inline float SpringConstraint::getDamping() const {
+    return damping;
+}
+
 }
 
 #endif
@@ -0,0 +1,222 @@
+/**
+ * @file articulation.h
+ *
+ * @brief Tree of bodies connected by joints, simulated in joint coordinates
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __ARTICULATION_H
+#define __ARTICULATION_H
+
+#include <physics/defs.h>
+#include <memory>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+
+/**
+ * @brief Tree of links connected by joints, such as a chain or a ragdoll.
+ * Links are ordinary bodies, which collide like any other, but they are moved
+ * by the articulation rather than integrated freely. The articulation is
+ * described by joint positions and velocities, so joints never drift apart,
+ * however long the chain.
+ *
+ * Forward dynamics use Featherstone's articulated body algorithm, which takes
+ * time linear in the number of links. Spatial quantities are expressed in
+ * world space, about each link's own center of mass, which keeps them small
+ * however far the links are from the world origin. The root is fixed if its
+ * body is fixed, and otherwise floats freely.
+ *
+ * Contacts and constraints are solved against the links as if they were
+ * unjointed. The impulses applied to each link since the last sync are then
+ * propagated through the tree as one articulation space impulse, which gives
+ * joint velocities consistent with them. The system does this after every
+ * solver iteration of the links' island.
+ */
+class PHYSICS_EXPORT Articulation {
+public:
+
+    enum JointType {
+        Revolute,  //!< Rotates about an axis through the anchor
+        Prismatic, //!< Slides along an axis
+        Spherical, //!< Rotates freely about the anchor
+        Fixed      //!< Welds the link to its parent
+    };
+
+private:
+
+    // Spatial motion or force vector, about a link's center of mass
+    struct SpatialVector {
+        glm::vec3 angular; //!< Angular velocity, or torque
+        glm::vec3 linear;  //!< Velocity of the body point at the center of mass, or force
+    };
+
+    // 6x6 matrix, in 3x3 blocks [ a b ; c d ]
+    struct SpatialMatrix {
+        glm::mat3 a, b, c, d;
+    };
+
+    struct Link {
+        std::shared_ptr<Body> body;
+        int       parent;          //!< Index of parent link, or -1 for the root
+        JointType type;
+        glm::vec3 parentAnchor;    //!< Joint in parent space, at zero joint position
+        glm::vec3 childAnchor;     //!< Joint in link space
+        glm::vec3 axis;            //!< Joint axis in parent space
+        glm::quat restOrientation; //!< Link orientation in parent space at zero joint position
+        float     position;        //!< Revolute angle or prismatic offset
+        glm::quat rotation;        //!< Spherical rotation in parent space
+        glm::vec3 velocity;        //!< Joint velocity. Spherical joints use all three, in parent space.
+        glm::vec3 force;           //!< Joint torque or force, like velocity
+        float     damping;         //!< Joint torque or force per unit of velocity
+
+        // Step state
+        int           dofs;               //!< Number of joint degrees of freedom
+        SpatialVector subspace[3];        //!< Motion of each degree of freedom
+        SpatialVector motion;             //!< Link velocity
+        SpatialVector bias;               //!< Velocity product acceleration
+        SpatialMatrix inertia;            //!< Articulated body inertia
+        SpatialVector biasForce;          //!< Articulated bias force, or impulse when propagating impulses
+        SpatialVector projected[3];       //!< Articulated inertia times subspace
+        float         invDofInertia[9];   //!< Inverse of subspace^T projected
+        float         dofForce[3];        //!< Joint force less bias force
+        SpatialVector change;             //!< Acceleration, or velocity change when propagating impulses
+        glm::vec3     syncLinear;         //!< Body velocity when last synced
+        glm::vec3     syncAngular;        //!< Body angular velocity when last synced
+    };
+
+    std::vector<Link> links;
+    float rootInverse[36]; // Inverse articulated inertia of a floating root
+
+    static int getDofs(JointType type);
+
+    static SpatialVector shiftMotion(const SpatialVector & motion, const glm::vec3 & offset);
+
+    void computeSubspaces();
+
+    void propagate(bool impulses, float dt);
+
+    void updateVelocities();
+
+    void writeVelocities();
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] root Root link. Fix it to attach the articulation to the world.
+     */
+    Articulation(std::shared_ptr<Body> root);
+
+    ~Articulation();
+
+    /**
+     * @brief Add a link jointed to an existing one, returning its index. Links
+     * must be placed where they should rest at zero joint position before
+     * they are added.
+     *
+     * @param[in] parent Index of parent link. The root is 0.
+     * @param[in] body   Link body
+     * @param[in] type   Joint type
+     * @param[in] anchor Joint position in world space
+     * @param[in] axis   Joint axis in world space, for revolute and prismatic
+     *                   joints
+     */
+    int addLink(int parent, std::shared_ptr<Body> body, JointType type, glm::vec3 anchor,
+        glm::vec3 axis = glm::vec3(0, 1, 0));
+
+    int getNumLinks();
+
+    std::shared_ptr<Body> getLink(int link);
+
+    int getParent(int link);
+
+    JointType getJointType(int link);
+
+    /**
+     * @brief Get revolute angle in radians, or prismatic offset
+     */
+    float getJointPosition(int link);
+
+    /**
+     * @brief Get spherical joint rotation, in parent space
+     */
+    glm::quat getJointRotation(int link);
+
+    /**
+     * @brief Get joint velocity. Revolute and prismatic joints use x.
+     * Spherical joints give angular velocity in parent space.
+     */
+    glm::vec3 getJointVelocity(int link);
+
+    /**
+     * @brief Set joint torque or force, applied every step until changed.
+     * Revolute and prismatic joints use x. Spherical joints take a torque in
+     * parent space.
+     */
+    void setJointForce(int link, glm::vec3 force);
+
+    /**
+     * @brief Set joint damping, as torque or force per unit of joint velocity
+     */
+    void setJointDamping(int link, float damping);
+
+    /**
+     * @brief Apply gravity, accumulated link forces and joint forces over a
+     * step, and set link velocities to match. Forces are not cleared.
+     */
+    void computeDynamics(const glm::vec3 & gravity, float dt);
+
+    /**
+     * @brief Propagate impulses applied to links since the last sync through
+     * the joints, and set link velocities to match
+     */
+    void applyImpulses();
+
+    /**
+     * @brief Advance joint positions and place links to match
+     */
+    void integrate(float dt);
+
+    /**
+     * @brief Clear forces accumulated on links
+     */
+    void clearForces();
+
+};
+
+inline int Articulation::getNumLinks() {
+    return (int)links.size();
+}
+
+inline std::shared_ptr<Body> Articulation::getLink(int link) {
+    return links[link].body;
+}
+
+inline int Articulation::getParent(int link) {
+    return links[link].parent;
+}
+
+inline Articulation::JointType Articulation::getJointType(int link) {
+    return links[link].type;
+}
+
+inline float Articulation::getJointPosition(int link) {
+    return links[link].position;
+}
+
+inline glm::quat Articulation::getJointRotation(int link) {
+    return links[link].rotation;
+}
+
+inline glm::vec3 Articulation::getJointVelocity(int link) {
+    return links[link].velocity;
+}
+
+}
+
+#endif
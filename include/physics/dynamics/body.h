@@ -38,13 +38,52 @@ private:
     // inertia tensor too? Bodies may also store a collision shape, which will
     // be used to detect and correct collisions with other collision shapes
     // attached to bodies. TODO why not required.
+    //
+    // Bodies which may move further than their own size in one step, such as
+    // projectiles, can be flagged as fast movers. The system generates
+    // speculative contacts for them ahead of time so they do not tunnel.
+    //
+    // Bodies belong to one or more collision groups, and have a mask of the
+    // groups they collide with. Two bodies are only checked for collision if
+    // each one's group overlaps the other's mask. By default bodies are in
+    // every group and collide with every group.
+    //
+    // Penetration may be resolved with pseudo velocities, which move the body
+    // during the next transform integration and are then discarded, so that
+    // pushing bodies apart does not add momentum.
+    //
+    // Bodies moved by setPosition(), setOrientation() or setShape() are
+    // flagged as teleported until the system next refreshes its broadphase,
+    // so that scene queries between steps see them where they now are.
+    //
+    // Sensor bodies detect overlaps and report contact events, but their
+    // contacts are never solved, so nothing collides with them.
+    //
+    // Friction between two bodies uses the geometric mean of their friction
+    // coefficients. Rolling friction resists rolling with a torque of up to
+    // the rolling friction coefficient, a length, times the normal force. It
+    // uses the larger of the two bodies' coefficients, and defaults to 0.
+    //
+    // Articulated bodies are links of an Articulation, which moves them along
+    // with their joints. The system does not integrate them itself, and the
+    // articulation consumes their accumulated forces.
 
     Transform transform;
     glm::vec3 linearVelocity;
     glm::vec3 angularVelocity; // axis * angle
+    glm::vec3 pseudoLinearVelocity;
+    glm::vec3 pseudoAngularVelocity;
     glm::vec3 force;
     glm::vec3 torque;       // axis * angle
     bool      fixed;
+    bool      fastMover;
+    bool      sensor;
+    bool      articulated;
+    bool      teleported;
+    float     friction;
+    float     rollingFriction;
+    unsigned  collisionGroup;
+    unsigned  collisionMask;
     float     mass;
     float     invMass;
     glm::mat3 inertiaTensor; // TODO: Transform this when using it
@@ -75,6 +114,28 @@ public:
 
     void setFixed(bool fixed);
 
+    void setFastMover(bool fastMover);
+
+    /**
+     * @brief Set collision group and mask bits
+     *
+     * @param[in] group Groups this body belongs to
+     * @param[in] mask  Groups this body collides with
+     */
+    void setCollisionFilter(unsigned group, unsigned mask);
+
+    void setSensor(bool sensor);
+
+    /**
+     * @brief Mark the body as a link of an Articulation. Set by
+     * System::addArticulation().
+     */
+    void setArticulated(bool articulated);
+
+    void setFriction(float friction);
+
+    void setRollingFriction(float rollingFriction);
+
     void addLinearVelocity(glm::vec3 velocity);
 
     void addAngularVelocity(glm::vec3 angularVelocity);
@@ -85,12 +146,23 @@ public:
 
     void addImpulse(glm::vec3 impulse, glm::vec3 relPos);
 
+    /**
+     * @brief Apply an impulse to the pseudo velocities, which only affect the
+     * next transform integration
+     */
+    void addPseudoImpulse(glm::vec3 impulse, glm::vec3 relPos);
+
     void addLinearForce(glm::vec3 force);
 
     void addTorque(glm::vec3 torque);
 
     void addForce(glm::vec3 force, glm::vec3 relPos);
 
+    /**
+     * @brief Discard accumulated forces and torques
+     */
+    void clearForces();
+
     Transform & getTransform();
 
     glm::mat4 getLocalToWorld();
@@ -105,6 +177,8 @@ public:
 
     glm::vec3 getVelocityAtPoint(glm::vec3 relPos);
 
+    glm::vec3 getPseudoVelocityAtPoint(glm::vec3 relPos);
+
     float getMass();
 
     float getInverseMass();
@@ -115,6 +189,32 @@ public:
 
     bool getFixed();
 
+    bool getFastMover();
+
+    unsigned getCollisionGroup();
+
+    unsigned getCollisionMask();
+
+    bool getSensor();
+
+    bool getArticulated();
+
+    /**
+     * @brief Get whether the body was moved or reshaped by hand since the
+     * system last refreshed its broadphase
+     */
+    bool getTeleported();
+
+    void clearTeleported();
+
+    glm::vec3 getForce();
+
+    glm::vec3 getTorque();
+
+    float getFriction();
+
+    float getRollingFriction();
+
     void integrateVelocities(double dt);
 
     void integrateTransform(double dt);
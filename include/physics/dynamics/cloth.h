@@ -0,0 +1,243 @@
+/**
+ * @file cloth.h
+ *
+ * @brief Grid of particles held together by distance constraints
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __CLOTH_H
+#define __CLOTH_H
+
+#include <physics/collision/aabb.h>
+#include <physics/collision/particlecollider.h>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+class ThreadPool;
+
+/**
+ * @brief Cloth, such as a flag or a tarp, simulated by extended position based
+ * dynamics. Particles are stored as structures of arrays, in rows of a grid.
+ *
+ * Neighbouring particles are held at their rest distance along the grid and
+ * its diagonals, and particles two apart along the grid resist bending. Each
+ * step is split into substeps which project every constraint once. Constraints
+ * are colored so that no two of a color share a particle, and each color is
+ * projected in parallel.
+ *
+ * Particles collide with sphere, plane and cube bodies found by the system's
+ * broadphase, and push back on those that are free. They also collide with
+ * each other, unless they are within the thickness of each other at rest.
+ * Pairs which may touch are found through a spatial hash, and are kept over
+ * steps until particles have moved far enough that a pair may be missed.
+ *
+ * Particles with zero inverse mass are pinned, and are only moved by setting
+ * their position.
+ */
+class PHYSICS_EXPORT Cloth {
+private:
+
+    // Particles
+    int width;
+    int height;
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> previous;      // Position at start of substep
+    std::vector<glm::vec3> velocities;
+    std::vector<float>     inverseMasses;
+    std::vector<glm::vec3> restPositions;
+    float                  particleInverseMass;
+
+    // Constraints, sorted by color. Color c is constraints colorOffsets[c] up to
+    // colorOffsets[c + 1].
+    std::vector<int>   particle1;
+    std::vector<int>   particle2;
+    std::vector<float> lengths;
+    std::vector<float> compliances;
+    std::vector<int>   colorOffsets;
+    bool               colored;
+
+    // Self collision. Particle i may touch neighbors[i * maxNeighbors] up to
+    // neighbors[i * maxNeighbors + neighborCounts[i]], found when particles were
+    // at neighborPositions.
+    std::vector<int>       cellStarts;
+    std::vector<int>       cellParticles;
+    std::vector<int>       neighbors;
+    std::vector<int>       neighborCounts;
+    std::vector<glm::vec3> neighborPositions;
+    std::vector<glm::vec3> corrections;
+
+    // Colliders, and their reaction impulses per thread
+    ParticleColliders colliders;
+
+    float thickness;
+    float friction;
+    int   substeps;
+    bool  selfCollision;
+
+    int addConstraint(int p1, int p2, float compliance);
+
+    void color();
+
+    void findNeighbors(float distance, ThreadPool & pool);
+
+    float getMaxTravel(const glm::vec3 & gravity, float dt);
+
+    void collideBodies(float h, ThreadPool & pool);
+
+    void collideSelf(ThreadPool & pool);
+
+public:
+
+    /**
+     * @brief Constructor. Particle (x, y) starts at
+     * origin + spacing * (x * across + y * down).
+     *
+     * @param[in] width             Particles across
+     * @param[in] height            Particles down
+     * @param[in] spacing           Rest distance between neighboring particles
+     * @param[in] mass              Total mass, shared evenly between particles
+     * @param[in] origin            Position of particle (0, 0)
+     * @param[in] across            Direction of rows
+     * @param[in] down              Direction of columns
+     * @param[in] stretchCompliance Inverse stiffness of the grid and its diagonals
+     * @param[in] bendCompliance    Inverse stiffness against bending
+     */
+    Cloth(int width, int height, float spacing, float mass,
+        glm::vec3 origin = glm::vec3(0, 0, 0), glm::vec3 across = glm::vec3(1, 0, 0),
+        glm::vec3 down = glm::vec3(0, 0, 1), float stretchCompliance = 0.0f,
+        float bendCompliance = 1e-4f);
+
+    ~Cloth();
+
+    /**
+     * @brief Get index of the particle at (x, y)
+     */
+    int getParticle(int x, int y);
+
+    int getWidth();
+
+    int getHeight();
+
+    int getNumParticles();
+
+    int getNumConstraints();
+
+    /**
+     * @brief Get number of colors, after the first step
+     */
+    int getNumColors();
+
+    const std::vector<glm::vec3> & getPositions();
+
+    const std::vector<glm::vec3> & getVelocities();
+
+    void setPosition(int particle, glm::vec3 position);
+
+    void setVelocity(int particle, glm::vec3 velocity);
+
+    /**
+     * @brief Pin a particle in place, or release it with its share of the mass
+     */
+    void setPinned(int particle, bool pinned);
+
+    /**
+     * @brief Hold two particles at a distance, such as to sew seams
+     */
+    void addDistanceConstraint(int particle1, int particle2, float length, float compliance);
+
+    /**
+     * @brief Set the distance particles keep from bodies and from each other
+     */
+    void setThickness(float thickness);
+
+    float getThickness();
+
+    void setFriction(float friction);
+
+    float getFriction();
+
+    /**
+     * @brief Set number of substeps per step. Cloth is stiffer with more.
+     */
+    void setSubsteps(int substeps);
+
+    int getSubsteps();
+
+    void setSelfCollision(bool selfCollision);
+
+    bool getSelfCollision();
+
+    /**
+     * @brief Get box around the particles, grown by the thickness and by how far
+     * they may move in a step
+     */
+    AABB getBounds(const glm::vec3 & gravity, float dt);
+
+    /**
+     * @brief Advance by one step
+     *
+     * @param[in] gravity   Gravity
+     * @param[in] dt        Step length, in seconds
+     * @param[in] bodies    Bodies which may touch the cloth
+     * @param[in] numBodies Number of bodies
+     * @param[in] pool      Threads to spread the step over
+     */
+    void step(const glm::vec3 & gravity, float dt, Body *const *bodies, int numBodies,
+        ThreadPool & pool);
+
+};
+
+inline int Cloth::getParticle(int x, int y) {
+    return y * width + x;
+}
+
+inline int Cloth::getWidth() {
+    return width;
+}
+
+inline int Cloth::getHeight() {
+    return height;
+}
+
+inline int Cloth::getNumParticles() {
+    return (int)positions.size();
+}
+
+inline int Cloth::getNumConstraints() {
+    return (int)particle1.size();
+}
+
+inline int Cloth::getNumColors() {
+    return colorOffsets.empty() ? 0 : (int)colorOffsets.size() - 1;
+}
+
+inline const std::vector<glm::vec3> & Cloth::getPositions() {
+    return positions;
+}
+
+inline const std::vector<glm::vec3> & Cloth::getVelocities() {
+    return velocities;
+}
+
+inline float Cloth::getThickness() {
+    return thickness;
+}
+
+inline float Cloth::getFriction() {
+    return friction;
+}
+
+inline int Cloth::getSubsteps() {
+    return substeps;
+}
+
+inline bool Cloth::getSelfCollision() {
+    return selfCollision;
+}
+
+}
+
+#endif
@@ -0,0 +1,285 @@
+/**
+ * @file continuum.h
+ *
+ * @brief Deformable continuum, simulated by the material point method
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __CONTINUUM_H
+#define __CONTINUUM_H
+
+#include <physics/collision/aabb.h>
+#include <physics/collision/particlecollider.h>
+#include <physics/collision/particlegrid.h>
+#include <physics/dynamics/fixedstep.h>
+#include <glm/mat3x3.hpp>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+class ThreadPool;
+
+/**
+ * @brief Material of part of a continuum
+ */
+struct PHYSICS_EXPORT ContinuumMaterial {
+
+    /**
+     * @brief How the material responds to deformation
+     */
+    enum Model {
+        Snow,   //!< Elastic, but breaks and compacts past critical strains, hardening as it does
+        Sand,   //!< Holds shear up to a friction angle under pressure, with no cohesion
+        Liquid, //!< Resists only compression, and shear through viscosity
+    };
+
+    Model model;
+    float density;              //!< Mass per unit volume
+    float youngsModulus;        //!< Stiffness
+    float poissonRatio;         //!< Resistance to change in volume, below 0.5
+    float criticalCompression;  //!< Snow: compression past which it deforms plastically
+    float criticalStretch;      //!< Snow: stretch past which it deforms plastically
+    float hardening;            //!< Snow: how much stiffer it becomes as it compacts
+    float frictionAngle;        //!< Sand: angle of internal friction, in radians
+    float viscosity;            //!< Liquid: dynamic viscosity, in pascal seconds
+
+    ContinuumMaterial(Model model = Snow, float density = 400.0f, float youngsModulus = 1.4e5f,
+        float poissonRatio = 0.2f);
+
+    /**
+     * @brief Get packed snow (Stomakhin et al., "A Material Point Method for
+     * Snow Simulation")
+     */
+    static ContinuumMaterial snow();
+
+    /**
+     * @brief Get dry sand (Klar et al., "Drucker-Prager Elastoplasticity for
+     * Sand Animation")
+     */
+    static ContinuumMaterial sand();
+
+    /**
+     * @brief Get mud, as a thick liquid
+     */
+    static ContinuumMaterial mud();
+};
+
+/**
+ * @brief Material which deforms far beyond what soft bodies or fluids handle,
+ * such as snow, sand or mud, simulated by the moving least squares material
+ * point method (Hu et al., "A Moving Least Squares Material Point Method with
+ * Displacement Discontinuity and Two-Way Rigid Body Coupling"). Particles
+ * carry mass, velocity, an affine velocity field and a deformation gradient,
+ * stored as structures of arrays.
+ *
+ * Each step transfers particle momentum and stress to the nodes of a
+ * background grid, updates node velocities with gravity and colliders, and
+ * transfers velocities back to move the particles. The grid is sparse: nodes
+ * are stored in blocks of 4x4x4, and only for blocks near particles.
+ *
+ * Particles are counting sorted by block in parallel, and their arrays
+ * reordered, so particle order changes from step to step. Each block's
+ * particles write to the nodes of that block and of the next block along each
+ * axis. Blocks are colored by whether their coordinates are odd or even, and
+ * blocks of each of the eight colors write to disjoint nodes, so they are
+ * transferred in parallel without atomics, and results do not depend on the
+ * number of threads.
+ *
+ * Nodes inside sphere, plane and cube bodies found by the system's broadphase
+ * lose the velocity into the body, less friction, and push back on free bodies
+ * with the impulse.
+ *
+ * Steps must let sound cross no more than part of a cell, so continua take
+ * steps of their own length, usually several per system step.
+ */
+class PHYSICS_EXPORT Continuum {
+private:
+
+    // Particles, in block order
+    std::vector<glm::vec3>     positions;
+    std::vector<glm::vec3>     velocities;
+    std::vector<glm::mat3>     affines;
+    std::vector<glm::mat3>     deformations;
+    std::vector<float>         plasticVolumes;   // Snow: volume kept by plastic deformation
+    std::vector<unsigned char> materials;
+
+    // Scratch for reordering
+    std::vector<glm::vec3>     sortedVectors;
+    std::vector<glm::mat3>     sortedMatrices;
+    std::vector<float>         sortedFloats;
+    std::vector<unsigned char> sortedMaterials;
+
+    std::vector<ContinuumMaterial> materialTable;
+    std::vector<float>             shearModuli;
+    std::vector<float>             lameLambdas;    // Or the bulk modulus of liquids
+    std::vector<float>             frictionSlopes; // Sand: yield surface slope
+
+    // Grid, with nodes at multiples of the spacing from blockOrigin. Particles
+    // are sorted into blocks offset by half a node, so that each particle's
+    // nodes start in the block it is sorted into.
+    float      spacing;
+    float      invSpacing;
+    float      particleVolume;
+    float      friction;
+    glm::ivec3 blockOrigin;
+
+    // Block c holds particles blockStarts[c] up to blockStarts[c + 1], and
+    // its nodes are nodes[blockNodes[c]] onward, or -1 if it has none. Nodes
+    // hold momentum and mass, and then velocity.
+    ParticleGrid           grid;
+    std::vector<int>       blockStarts;
+    std::vector<int>       blockNodes;
+    std::vector<int>       activeBlocks;
+    std::vector<int>       colorBlocks[8];
+    std::vector<glm::vec4> nodes;
+    std::vector<int>       order;
+
+    // Colliders, and their reaction impulses per thread
+    ParticleColliders colliders;
+
+    // Motion over the last step
+    std::vector<AABB>  threadBounds;
+    std::vector<float> threadSpeeds;
+    AABB               bounds;
+    float              maxSpeed;
+
+    FixedStep clock;
+
+    void buildGrid(ThreadPool & pool);
+
+    void particlesToGrid(ThreadPool & pool);
+
+    void updateGrid(const glm::vec3 & gravity, ThreadPool & pool);
+
+    void gridToParticles(ThreadPool & pool);
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] spacing Distance between grid nodes. Particles are packed
+     *                    half this apart.
+     */
+    Continuum(float spacing);
+
+    ~Continuum();
+
+    /**
+     * @brief Add a material, and get its ID. There may be up to 256 materials.
+     */
+    int addMaterial(const ContinuumMaterial & material);
+
+    const std::vector<ContinuumMaterial> & getMaterials();
+
+    /**
+     * @brief Add a particle, which stands for an eighth of a cell
+     */
+    void addParticle(const glm::vec3 & position, int material,
+        const glm::vec3 & velocity = glm::vec3());
+
+    /**
+     * @brief Fill a box with particles, two per cell along each axis
+     */
+    void addBox(const glm::vec3 & min, const glm::vec3 & max, int material,
+        const glm::vec3 & velocity = glm::vec3());
+
+    int getNumParticles();
+
+    const std::vector<glm::vec3> & getPositions();
+
+    const std::vector<glm::vec3> & getVelocities();
+
+    const std::vector<glm::mat3> & getDeformations();
+
+    const std::vector<unsigned char> & getMaterialIDs();
+
+    float getSpacing();
+
+    /**
+     * @brief Get number of grid blocks with nodes, as of the last step
+     */
+    int getNumActiveBlocks();
+
+    /**
+     * @brief Set friction between the continuum and bodies
+     */
+    void setFriction(float friction);
+
+    /**
+     * @brief Set the continuum's step, in seconds
+     */
+    void setStep(float step);
+
+    float getStep();
+
+    /**
+     * @brief Get a step in which sound crosses a third of a cell in the
+     * stiffest material, at its hardest. Fast particles need shorter steps.
+     */
+    float getStableStep();
+
+    /**
+     * @brief Add time passed in the system, and get the number of steps of the
+     * continuum's length which are now due
+     */
+    int advance(float dt);
+
+    /**
+     * @brief Get box around the grid nodes particles may reach in a step
+     */
+    AABB getBounds(const glm::vec3 & gravity);
+
+    /**
+     * @brief Advance by one step of the continuum's length
+     *
+     * @param[in] gravity   Gravity
+     * @param[in] bodies    Bodies which may touch the continuum
+     * @param[in] numBodies Number of bodies
+     * @param[in] pool      Threads to spread the step over
+     */
+    void step(const glm::vec3 & gravity, Body *const *bodies, int numBodies, ThreadPool & pool);
+
+};
+
+inline const std::vector<ContinuumMaterial> & Continuum::getMaterials() {
+    return materialTable;
+}
+
+inline int Continuum::getNumParticles() {
+    return (int)positions.size();
+}
+
+inline const std::vector<glm::vec3> & Continuum::getPositions() {
+    return positions;
+}
+
+inline const std::vector<glm::vec3> & Continuum::getVelocities() {
+    return velocities;
+}
+
+inline const std::vector<glm::mat3> & Continuum::getDeformations() {
+    return deformations;
+}
+
+inline const std::vector<unsigned char> & Continuum::getMaterialIDs() {
+    return materials;
+}
+
+inline float Continuum::getSpacing() {
+    return spacing;
+}
+
+inline int Continuum::getNumActiveBlocks() {
+    return (int)activeBlocks.size();
+}
+
+inline float Continuum::getStep() {
+    return clock.getStep();
+}
+
+}
+
+#endif
@@ -0,0 +1,141 @@
+/**
+ * @file directsolver.h
+ *
+ * @brief Sparse direct solver for rod and spring constraint graphs
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __DIRECTSOLVER_H
+#define __DIRECTSOLVER_H
+
+#include <physics/constraints/constraintpool.h>
+#include <memory>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+
+/**
+ * @brief Solves all rods and springs of a connected group exactly, instead of
+ * iterating over them. Rods and springs are rows of the system
+ * J M^-1 J^T x = -b, where two rows are coupled when they share a body which
+ * is not fixed. Each connected group of rows is a component, which is
+ * factored as L D L^T.
+ *
+ * The structure is built when constraints are added or bodies become fixed or
+ * free. Rows are ordered by minimum degree, which gives no fill for chains and
+ * trees and little for graphs with a few loops, and the pattern of L and the
+ * slots each update writes to are cached. Factoring and solving a component
+ * then take time linear in the size of L.
+ *
+ * Rows are numbered with rods first, then springs. Springs add their softness
+ * to the diagonal.
+ */
+class PHYSICS_EXPORT DirectSolver {
+private:
+
+    // Coupling between two rows through a shared body, added into the lower
+    // triangle of the matrix
+    struct Coupling {
+        int   slot; //!< Entry of L for the pair of rows
+        int   row1; //!< Position of the lower numbered row
+        int   row2; //!< Position of the higher numbered row
+        int   body; //!< Shared body
+        float sign; //!< Product of the rows' signs for the shared body
+    };
+
+    // Update made by eliminating a column, as slots in L
+    struct Update {
+        int entry1; //!< Entry of the eliminated column for the higher row
+        int entry2; //!< Entry of the eliminated column for the lower row
+        int slot;   //!< Entry of L which is updated
+    };
+
+    int numRods;
+    int numSprings;
+    std::vector<char> bodyFixed; // Whether each body was fixed when built
+
+    std::vector<int> rows;             // Row of each position, in elimination order
+    std::vector<int> componentOffsets; // Positions of each component
+    std::vector<int> columnOffsets;    // Entries of L in each column
+    std::vector<int> columnRows;       // Position of each entry of L
+    std::vector<Coupling> couplings;
+    std::vector<int> updateOffsets;    // Updates made by each column
+    std::vector<Update> updates;
+
+    std::vector<float> values;    // Entries of L
+    std::vector<float> diagonal;  // D
+    std::vector<float> scratch;
+
+    void build(const std::vector<std::shared_ptr<Body>> & bodies, const RodPool & rods,
+        const SpringPool & springs);
+
+    void getRow(const RodPool & rods, const SpringPool & springs, int row, int & body1,
+        int & body2) const;
+
+public:
+
+    DirectSolver();
+
+    ~DirectSolver();
+
+    /**
+     * @brief Rebuild the structure if constraints were added or bodies changed
+     * between fixed and free since it was built
+     */
+    void update(const std::vector<std::shared_ptr<Body>> & bodies, const RodPool & rods,
+        const SpringPool & springs);
+
+    /**
+     * @brief Get the number of components
+     */
+    int getNumComponents() const;
+
+    /**
+     * @brief Get the number of rows in a component
+     */
+    int getNumRows(int component) const;
+
+    /**
+     * @brief Get the bodies of a component's first row, which identify the
+     * island it belongs to
+     */
+    void getComponentBodies(const RodPool & rods, const SpringPool & springs, int component,
+        int & body1, int & body2) const;
+
+    /**
+     * @brief Factor a component from the normals and effective masses set up
+     * for this step
+     */
+    void factor(int component, const std::vector<std::shared_ptr<Body>> & bodies,
+        const RodPool & rods, const SpringPool & springs);
+
+    /**
+     * @brief Solve a factored component for the impulses which correct every
+     * row's velocity error at once, and apply them
+     *
+     * @param[in]  component    Component
+     * @param[in]  bodies       Bodies
+     * @param[in]  rods         Rods, whose impulses are accumulated
+     * @param[in]  springs      Springs, whose impulses are accumulated
+     * @param[out] impulseDelta Set to at least the largest impulse applied
+     * @param[out] residual     Set to at least the largest velocity error
+     */
+    void solve(int component, const std::vector<std::shared_ptr<Body>> & bodies,
+        RodPool & rods, SpringPool & springs, float & impulseDelta, float & residual);
+
+};
+
+inline int DirectSolver::getNumComponents() const {
+    return (int)componentOffsets.size() - 1;
+}
+
+inline int DirectSolver::getNumRows(int component) const {
+    return componentOffsets[component + 1] - componentOffsets[component];
+}
+
+}
+
+#endif
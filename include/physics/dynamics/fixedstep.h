@@ -0,0 +1,67 @@
+/**
+ * @file fixedstep.h
+ *
+ * @brief Accumulator for simulations which take steps of their own length
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __FIXEDSTEP_H
+#define __FIXEDSTEP_H
+
+#include <physics/defs.h>
+
+namespace Physics {
+
+/**
+ * @brief Collects time passed in the system and hands it out in steps of a
+ * fixed length, such as the short steps of fluids, grains and continua. Time
+ * left over from one system step is carried into the next.
+ */
+class FixedStep {
+private:
+
+    float step;
+    float elapsed;
+
+public:
+
+    FixedStep(float step);
+
+    void setStep(float step);
+
+    float getStep() const;
+
+    /**
+     * @brief Add time passed, and get the number of steps which are now due
+     */
+    int advance(float dt);
+
+};
+
+inline FixedStep::FixedStep(float step)
+    : step(step),
+      elapsed(0.0f)
+{
+}
+
+inline void FixedStep::setStep(float step) {
+    this->step = step;
+}
+
+inline float FixedStep::getStep() const {
+    return step;
+}
+
+inline int FixedStep::advance(float dt) {
+    elapsed += dt;
+
+    int steps = (int)(elapsed / step);
+    elapsed -= steps * step;
+
+    return steps;
+}
+
+}
+
+#endif
@@ -0,0 +1,241 @@
+/**
+ * @file fluid.h
+ *
+ * @brief Particle fluid, simulated by smoothed particle hydrodynamics
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __FLUID_H
+#define __FLUID_H
+
+#include <physics/collision/aabb.h>
+#include <physics/collision/particlecollider.h>
+#include <physics/collision/particlegrid.h>
+#include <physics/dynamics/fixedstep.h>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+class ThreadPool;
+
+/**
+ * @brief Liquid, such as water poured over a scene, simulated by smoothed
+ * particle hydrodynamics with position based incompressibility. Particles are
+ * stored as structures of arrays.
+ *
+ * Each step predicts particle positions, then corrects them over a few
+ * iterations until each particle's density, summed over neighbours within the
+ * kernel radius, is no more than the rest density. Corrections are found for
+ * every particle in parallel, from the last iteration's positions. Velocities
+ * follow from how far particles moved, and are smoothed by XSPH viscosity.
+ *
+ * Neighbours are found once per step through a uniform grid of cells as wide
+ * as the kernel radius, over the box around the particles. Particles are
+ * counting sorted by cell in parallel, and their arrays reordered, so that each
+ * cell and each row of three cells is contiguous. Particle order therefore
+ * changes from step to step.
+ *
+ * Sphere, plane and cube bodies found by the system's broadphase are sampled
+ * with boundary particles near the fluid each step. Boundary particles add to
+ * the density of fluid particles near them, so that fluid rests on bodies at
+ * its rest density, and push back on free bodies with the impulse of the
+ * corrections they cause. Particles are also projected out of bodies, so that
+ * fast particles cannot pass through.
+ *
+ * The fluid takes steps of its own length, which is usually longer than the
+ * system's.
+ */
+class PHYSICS_EXPORT Fluid {
+private:
+
+    // Particles, in cell order
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<glm::vec3> predicted;
+    std::vector<glm::vec3> corrections;
+    std::vector<glm::vec3> sorted;     // Scratch for reordering
+    std::vector<float>     lambdas;
+    std::vector<float>     densities;
+    std::vector<int>       order;
+
+    // Material
+    float radius;
+    float kernelRadius;
+    float restDensity;
+    float mass;
+    float poly6;           // Scale of the density kernel
+    float spiky;           // Scale of the gradient kernel
+    float relaxation;      // Added to the constraint gradient, against instability
+    float viscosity;
+
+    // Grid over the predicted positions. Cell c holds particles cellStarts[c]
+    // up to cellStarts[c + 1].
+    ParticleGrid     grid;
+    std::vector<int> cellStarts;
+    std::vector<int> boundaryCellStarts;
+
+    // Particle i is near neighbors[i * maxNeighbors] up to
+    // neighbors[i * maxNeighbors + neighborCounts[i]], and likewise for
+    // boundary particles
+    std::vector<int> neighbors;
+    std::vector<int> neighborCounts;
+    std::vector<int> boundaryNeighbors;
+    std::vector<int> boundaryNeighborCounts;
+
+    // Boundary particles, in cell order, with the collider they belong to
+    std::vector<glm::vec3> boundaryPositions;
+    std::vector<float>     boundaryVolumes;
+    std::vector<int>       boundaryColliders;
+    std::vector<glm::vec3> boundarySorted;
+    std::vector<float>     boundarySortedVolumes;
+    std::vector<int>       boundarySortedColliders;
+    std::vector<int>       boundaryOrder;
+
+    // Colliders, and their reaction impulses per thread
+    ParticleColliders colliders;
+
+    FixedStep clock;
+    int       iterations;
+    float     densityError;
+    std::vector<float> threadErrors;
+
+    float kernel(float r2) const;
+
+    glm::vec3 kernelGradient(const glm::vec3 & d, float r2) const;
+
+    float getBoundaryVolume(float spacing1, float spacing2) const;
+
+    void addBoundaryParticle(const glm::vec3 & point, float volume, int index);
+
+    void sampleBoundary(const ParticleCollider & collider, int index, const AABB & box);
+
+    void buildGrid(ThreadPool & pool);
+
+    void findNeighbors(ThreadPool & pool);
+
+    void solveDensity(ThreadPool & pool);
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] radius      Particle radius. Particles are packed twice this
+     *                        apart at rest.
+     * @param[in] restDensity Mass per unit volume
+     */
+    Fluid(float radius, float restDensity = 1000.0f);
+
+    ~Fluid();
+
+    /**
+     * @brief Add a particle
+     */
+    void addParticle(const glm::vec3 & position, const glm::vec3 & velocity = glm::vec3());
+
+    /**
+     * @brief Fill a box with particles at their rest spacing
+     */
+    void addBox(const glm::vec3 & min, const glm::vec3 & max,
+        const glm::vec3 & velocity = glm::vec3());
+
+    int getNumParticles();
+
+    const std::vector<glm::vec3> & getPositions();
+
+    const std::vector<glm::vec3> & getVelocities();
+
+    /**
+     * @brief Get particle densities, as of the last iteration of the last step
+     */
+    const std::vector<float> & getDensities();
+
+    float getRadius();
+
+    float getRestDensity();
+
+    /**
+     * @brief Set the fluid's step, in seconds
+     */
+    void setStep(float step);
+
+    float getStep();
+
+    /**
+     * @brief Set the number of incompressibility iterations per step
+     */
+    void setIterations(int iterations);
+
+    /**
+     * @brief Set XSPH viscosity, as the fraction of the difference from the
+     * velocity of neighbours removed per step
+     */
+    void setViscosity(float viscosity);
+
+    /**
+     * @brief Get the average density above the rest density, relative to it,
+     * before the last iteration of the last step
+     */
+    float getDensityError();
+
+    /**
+     * @brief Add time passed in the system, and get the number of steps of the
+     * fluid's length which are now due
+     */
+    int advance(float dt);
+
+    /**
+     * @brief Get box around the particles, grown by the kernel radius and by
+     * how far they may move in a step
+     */
+    AABB getBounds(const glm::vec3 & gravity);
+
+    /**
+     * @brief Advance by one step of the fluid's length
+     *
+     * @param[in] gravity   Gravity
+     * @param[in] bodies    Bodies which may touch the fluid
+     * @param[in] numBodies Number of bodies
+     * @param[in] pool      Threads to spread the step over
+     */
+    void step(const glm::vec3 & gravity, Body *const *bodies, int numBodies, ThreadPool & pool);
+
+};
+
+inline int Fluid::getNumParticles() {
+    return (int)positions.size();
+}
+
+inline const std::vector<glm::vec3> & Fluid::getPositions() {
+    return positions;
+}
+
+inline const std::vector<glm::vec3> & Fluid::getVelocities() {
+    return velocities;
+}
+
+inline const std::vector<float> & Fluid::getDensities() {
+    return densities;
+}
+
+inline float Fluid::getRadius() {
+    return radius;
+}
+
+inline float Fluid::getRestDensity() {
+    return restDensity;
+}
+
+inline float Fluid::getStep() {
+    return clock.getStep();
+}
+
+inline float Fluid::getDensityError() {
+    return densityError;
+}
+
+}
+
+#endif
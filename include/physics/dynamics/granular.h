@@ -0,0 +1,234 @@
+/**
+ * @file granular.h
+ *
+ * @brief Granular material, simulated by the discrete element method
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __GRANULAR_H
+#define __GRANULAR_H
+
+#include <physics/collision/aabb.h>
+#include <physics/collision/particlecollider.h>
+#include <physics/collision/particlegrid.h>
+#include <physics/dynamics/fixedstep.h>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+class ThreadPool;
+
+/**
+ * @brief Material of a kind of grain
+ */
+struct PHYSICS_EXPORT GranularMaterial {
+    float density;         //!< Mass per unit volume
+    float stiffness;       //!< Normal spring stiffness, as force per unit overlap
+    float restitution;     //!< Ratio of separating to approaching normal speed
+    float friction;        //!< Sliding friction coefficient
+    float rollingFriction; //!< Rolling friction coefficient, as a length per radius
+
+    GranularMaterial(float density = 2500.0f, float stiffness = 1e5f, float restitution = 0.5f,
+        float friction = 0.5f, float rollingFriction = 0.05f);
+};
+
+/**
+ * @brief Bulk material, such as grain, gravel or pellets, made of many spheres
+ * simulated by the discrete element method. Grains are stored as structures of
+ * compact arrays: position, velocity, angular velocity, radius and material.
+ *
+ * Touching grains push apart with a linear spring and dashpot along the
+ * normal, damped to match the restitution of their materials. Across the
+ * normal, a spring follows the sliding of the contact since it began, and
+ * slips once it would exceed the friction limit, which holds piles up. Rolling
+ * friction resists relative rotation. Forces are found for every grain in
+ * parallel, each grain summing the forces on itself, and grains are then
+ * advanced by semi-implicit Euler.
+ *
+ * Each grain keeps a list of the grains within a skin distance of touching,
+ * found through a grid of cells. Grains are sorted by cell in parallel and
+ * reordered when lists are rebuilt, which happens once any grain may have
+ * moved half the skin. Grain order therefore changes from time to time.
+ *
+ * Grains collide with sphere, plane and cube bodies found by the system's
+ * broadphase, through the same contact model. Fixed bodies are static
+ * obstacles, and free bodies are pushed back as dynamic obstacles.
+ *
+ * Steps must be well under the contact duration, pi sqrt(m / k), of the
+ * lightest grains, so grains take steps of their own length, usually many per
+ * system step.
+ */
+class PHYSICS_EXPORT Granular {
+private:
+
+    // Grains, in cell order as of the last rebuild of the neighbour lists
+    std::vector<glm::vec3>     positions;
+    std::vector<glm::vec3>     velocities;
+    std::vector<glm::vec3>     angularVelocities;
+    std::vector<float>         radii;
+    std::vector<unsigned char> materials;
+
+    // Derived from radius and material
+    std::vector<float>         masses;
+
+    std::vector<GranularMaterial> materialTable;
+    std::vector<float>            dampingRatios;
+
+    // Forces over a step
+    std::vector<glm::vec3> forces;
+    std::vector<glm::vec3> torques;
+
+    // Grain i may touch grains neighbors[i * maxNeighbors] up to
+    // neighbors[i * maxNeighbors + neighborCounts[i]], found when grains were at
+    // listPositions, and keeps the tangential spring of each contact in
+    // tangents
+    std::vector<int>       neighbors;
+    std::vector<int>       neighborCounts;
+    std::vector<glm::vec3> tangents;
+    std::vector<glm::vec3> listPositions;
+    float                  skin;
+    float                  maxRadius;
+    float                  maxMoved;
+    bool                   rebuild;
+
+    // Tangential springs of contacts with bodies, likewise
+    std::vector<Body *>    bodyContacts;
+    std::vector<int>       bodyContactCounts;
+    std::vector<glm::vec3> bodyTangents;
+
+    // Neighbour search
+    ParticleGrid     grid;
+    std::vector<int> cellStarts;
+    std::vector<int> order;
+    std::vector<int> newIndices;
+
+    // Colliders, and their reaction impulses per thread
+    ParticleColliders colliders;
+
+    // Motion over the last step
+    std::vector<AABB>  threadBounds;
+    std::vector<float> threadMoved;
+    std::vector<float> threadSpeeds;
+    AABB               bounds;
+    float              maxSpeed;
+
+    FixedStep clock;
+
+    void buildNeighbors(ThreadPool & pool);
+
+    void computeForces(const glm::vec3 & gravity, ThreadPool & pool);
+
+    void integrate(ThreadPool & pool);
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] skin Distance within which grains are kept as neighbours
+     *                 before they touch. Larger skins rebuild lists less
+     *                 often, but keep more neighbours.
+     */
+    Granular(float skin = 0.001f);
+
+    ~Granular();
+
+    /**
+     * @brief Add a material, and get its ID. There may be up to 256 materials.
+     */
+    int addMaterial(const GranularMaterial & material);
+
+    const std::vector<GranularMaterial> & getMaterials();
+
+    /**
+     * @brief Add a grain
+     */
+    void addGrain(const glm::vec3 & position, float radius, int material,
+        const glm::vec3 & velocity = glm::vec3());
+
+    int getNumGrains();
+
+    const std::vector<glm::vec3> & getPositions();
+
+    const std::vector<glm::vec3> & getVelocities();
+
+    const std::vector<glm::vec3> & getAngularVelocities();
+
+    const std::vector<float> & getRadii();
+
+    const std::vector<unsigned char> & getMaterialIDs();
+
+    /**
+     * @brief Set the grains' step, in seconds
+     */
+    void setStep(float step);
+
+    float getStep();
+
+    /**
+     * @brief Get a step which is a tenth of the contact duration of the
+     * lightest grains with the stiffest material
+     */
+    float getStableStep();
+
+    /**
+     * @brief Add time passed in the system, and get the number of steps of the
+     * grains' length which are now due
+     */
+    int advance(float dt);
+
+    /**
+     * @brief Get box around the grains, grown by how far they may move in a
+     * step
+     */
+    AABB getBounds(const glm::vec3 & gravity);
+
+    /**
+     * @brief Advance by one step of the grains' length
+     *
+     * @param[in] gravity   Gravity
+     * @param[in] bodies    Bodies which may touch the grains
+     * @param[in] numBodies Number of bodies
+     * @param[in] pool      Threads to spread the step over
+     */
+    void step(const glm::vec3 & gravity, Body *const *bodies, int numBodies, ThreadPool & pool);
+
+};
+
+inline const std::vector<GranularMaterial> & Granular::getMaterials() {
+    return materialTable;
+}
+
+inline int Granular::getNumGrains() {
+    return (int)positions.size();
+}
+
+inline const std::vector<glm::vec3> & Granular::getPositions() {
+    return positions;
+}
+
+inline const std::vector<glm::vec3> & Granular::getVelocities() {
+    return velocities;
+}
+
+inline const std::vector<glm::vec3> & Granular::getAngularVelocities() {
+    return angularVelocities;
+}
+
+inline const std::vector<float> & Granular::getRadii() {
+    return radii;
+}
+
+inline const std::vector<unsigned char> & Granular::getMaterialIDs() {
+    return materials;
+}
+
+inline float Granular::getStep() {
+    return clock.getStep();
+}
+
+}
+
+#endif
@@ -0,0 +1,259 @@
+/**
+ * @file softbody.h
+ *
+ * @brief Deformable body of tetrahedra, simulated by the finite element method
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __SOFTBODY_H
+#define __SOFTBODY_H
+
+#include <physics/collision/aabb.h>
+#include <physics/collision/particlecollider.h>
+#include <memory>
+#include <vector>
+
+namespace Physics {
+
+class Body;
+class ThreadPool;
+
+// Number of elements whose rotations are found together
+#define SOFTBODY_BATCH_SIZE 8
+
+/**
+ * @brief Deformable body, such as a rubber prop, meshed with tetrahedra and
+ * simulated by corotational linear finite elements. Nodes and elements are
+ * stored as structures of arrays.
+ *
+ * Each step finds the rotation of every element from its deformation by polar
+ * decomposition, warm started from the last step, for batches of elements at
+ * once. Linear elasticity is applied in each element's rotated frame, which
+ * handles large rotations without the artifacts of linear elasticity, and
+ * without the cost of nonlinear materials.
+ *
+ * Steps are implicit. With rotations held fixed, (M + (h^2 + h b) K) dv =
+ * h (f - (h + b) K v) is solved for the change in velocity by conjugate
+ * gradients preconditioned with the diagonal, where b is the stiffness
+ * damping. The stiffness matrix is never built. Products are found for each
+ * element, then gathered for each node, both in parallel.
+ *
+ * Nodes collide with sphere, plane and cube bodies found by the system's
+ * broadphase, and push back on those that are free. The boundary of the mesh
+ * is kept as a triangle surface, for drawing.
+ */
+class PHYSICS_EXPORT SoftBody {
+private:
+
+    // Nodes
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<float>     masses;       // Zero for fixed nodes
+    std::vector<float>     lumpedMasses;
+    std::vector<float>     stiffnessDiagonal;
+
+    // Elements. Element e has nodes tetrahedra[4 * e] to tetrahedra[4 * e + 3].
+    std::vector<int>       tetrahedra;
+    std::vector<glm::mat3> restInverses; // Inverse of rest edges from the first node
+    std::vector<float>     volumes;
+    std::vector<glm::quat> orientations; // Rotation, warm starting the next step
+    std::vector<glm::mat3> rotations;
+    std::vector<glm::vec3> elementForces; // Per element, on nodes 1 to 3
+
+    // Elements of node i are adjacency[adjacencyOffsets[i]] up to
+    // adjacency[adjacencyOffsets[i + 1]], as 4 * element + corner
+    std::vector<int> adjacencyOffsets;
+    std::vector<int> adjacency;
+
+    // Surface, as triangles of surface vertices, each of which is a node
+    std::vector<int> surfaceNodes;
+    std::vector<int> surfaceTriangles;
+
+    // Material
+    float mu;
+    float lambda;
+    float damping;
+
+    // Solver state
+    std::vector<glm::vec3> forces;
+    std::vector<glm::vec3> preconditioner;
+    std::vector<glm::vec3> change;
+    std::vector<glm::vec3> residual;
+    std::vector<glm::vec3> direction;
+    std::vector<glm::vec3> product;
+    std::vector<glm::vec3> scaled;
+    std::vector<double>    partials;
+
+    int   maxIterations;
+    float tolerance;
+    int   iterations;
+    float error;
+
+    // Collision
+    ParticleColliders colliders;
+    float             thickness;
+    float             friction;
+
+    void buildAdjacency();
+
+    void buildSurface();
+
+    void computeRotations(ThreadPool & pool);
+
+    void computeElementProducts(ThreadPool & pool, const std::vector<glm::vec3> & x);
+
+    glm::vec3 gatherElements(int node);
+
+    void multiply(ThreadPool & pool, float scale, const std::vector<glm::vec3> & x,
+        std::vector<glm::vec3> & y, double & dot);
+
+    void collide(float h, ThreadPool & pool);
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] positions     Node positions, at rest
+     * @param[in] tetrahedra    Four node indices per element
+     * @param[in] density       Mass per unit volume
+     * @param[in] youngsModulus Stiffness, as stress per unit strain
+     * @param[in] poissonRatio  Ratio of contraction across to stretch along,
+     *                          below 0.5
+     */
+    SoftBody(const std::vector<glm::vec3> & positions, const std::vector<int> & tetrahedra,
+        float density, float youngsModulus, float poissonRatio);
+
+    ~SoftBody();
+
+    /**
+     * @brief Create a box of nx by ny by nz cells, each split into six
+     * tetrahedra
+     */
+    static std::shared_ptr<SoftBody> createBox(glm::vec3 center, glm::vec3 size, int nx,
+        int ny, int nz, float density, float youngsModulus, float poissonRatio);
+
+    int getNumNodes();
+
+    int getNumElements();
+
+    const std::vector<glm::vec3> & getPositions();
+
+    const std::vector<glm::vec3> & getVelocities();
+
+    const std::vector<int> & getTetrahedra();
+
+    void setPosition(int node, glm::vec3 position);
+
+    void setVelocity(int node, glm::vec3 velocity);
+
+    /**
+     * @brief Fix a node in place, or release it with its lumped mass
+     */
+    void setFixed(int node, bool fixed);
+
+    /**
+     * @brief Set stiffness damping, as the time over which damping forces
+     * match elastic forces
+     */
+    void setDamping(float damping);
+
+    /**
+     * @brief Set the distance nodes keep from bodies
+     */
+    void setThickness(float thickness);
+
+    void setFriction(float friction);
+
+    /**
+     * @brief Set the most conjugate gradient iterations per step
+     */
+    void setSolverIterations(int maxIterations);
+
+    /**
+     * @brief Set the residual, relative to the right hand side, at which the
+     * solve stops
+     */
+    void setSolverTolerance(float tolerance);
+
+    int getIterations();
+
+    float getError();
+
+    /**
+     * @brief Get nodes on the surface. Surface vertex i is node
+     * getSurfaceNodes()[i].
+     */
+    const std::vector<int> & getSurfaceNodes();
+
+    /**
+     * @brief Get surface triangles, as three surface vertices each, wound
+     * counterclockwise seen from outside
+     */
+    const std::vector<int> & getSurfaceTriangles();
+
+    /**
+     * @brief Compute area weighted normals of surface vertices
+     */
+    void computeSurfaceNormals(std::vector<glm::vec3> & normals);
+
+    /**
+     * @brief Get box around the nodes, grown by the thickness and by how far
+     * they may move in a step
+     */
+    AABB getBounds(const glm::vec3 & gravity, float dt);
+
+    /**
+     * @brief Advance by one step
+     *
+     * @param[in] gravity   Gravity
+     * @param[in] dt        Step length, in seconds
+     * @param[in] bodies    Bodies which may touch the soft body
+     * @param[in] numBodies Number of bodies
+     * @param[in] pool      Threads to spread the step over
+     */
+    void step(const glm::vec3 & gravity, float dt, Body *const *bodies, int numBodies,
+        ThreadPool & pool);
+
+};
+
+inline int SoftBody::getNumNodes() {
+    return (int)positions.size();
+}
+
+inline int SoftBody::getNumElements() {
+    return (int)volumes.size();
+}
+
+inline const std::vector<glm::vec3> & SoftBody::getPositions() {
+    return positions;
+}
+
+inline const std::vector<glm::vec3> & SoftBody::getVelocities() {
+    return velocities;
+}
+
+inline const std::vector<int> & SoftBody::getTetrahedra() {
+    return tetrahedra;
+}
+
+inline int SoftBody::getIterations() {
+    return iterations;
+}
+
+inline float SoftBody::getError() {
+    return error;
+}
+
+inline const std::vector<int> & SoftBody::getSurfaceNodes() {
+    return surfaceNodes;
+}
+
+inline const std::vector<int> & SoftBody::getSurfaceTriangles() {
+    return surfaceTriangles;
+}
+
+}
+
+#endif
@@ -0,0 +1,176 @@
+/**
+ * @file springnetwork.h
+ *
+ * @brief Network of particles and springs, integrated implicitly
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __SPRINGNETWORK_H
+#define __SPRINGNETWORK_H
+
+#include <physics/constraints/constraintpool.h>
+#include <vector>
+
+namespace Physics {
+
+class ThreadPool;
+class SpringConstraint;
+
+/**
+ * @brief Point masses connected by damped springs, such as soft bodies and
+ * ropes, integrated with backward Euler so that stiff springs are stable at
+ * large steps. Particles and springs are stored as structures of arrays.
+ *
+ * Each step solves (M - h^2 df/dx - h df/dv) dv = h (f + h df/dx v) for the
+ * change in velocity, by conjugate gradients preconditioned with the diagonal.
+ * The solve may stop before converging, which damps the network but stays
+ * stable. The matrix is never built. Each spring keeps its 3x3 block, and each
+ * product gathers over the springs of every particle, in parallel over
+ * particles. Compressed springs drop the part of their stiffness across the
+ * spring, which would otherwise make the matrix indefinite.
+ *
+ * Particles with zero mass are fixed, and are only moved by setting their
+ * position.
+ */
+class PHYSICS_EXPORT SpringNetwork {
+private:
+
+    // Particles
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec3> velocities;
+    std::vector<float>     masses;
+
+    // Springs. Bodies of the pool are particle indices, and its solver fields
+    // are unused.
+    SpringPool springs;
+
+    // Springs of particle i are adjacency[adjacencyOffsets[i]] up to
+    // adjacency[adjacencyOffsets[i + 1]]
+    std::vector<int> adjacencyOffsets;
+    std::vector<int> adjacency;
+    int              adjacencySprings; // Number of springs when built
+
+    // Solver state
+    std::vector<glm::mat3> blocks;       // h^2 stiffness plus h damping, per spring
+    std::vector<glm::vec3> forces;       // Force on first particle, plus h stiffness times velocity
+    std::vector<glm::vec3> preconditioner;
+    std::vector<glm::vec3> change;       // Velocity change
+    std::vector<glm::vec3> residual;
+    std::vector<glm::vec3> direction;
+    std::vector<glm::vec3> product;
+    std::vector<glm::vec3> scaled;       // Preconditioned residual
+    std::vector<double>    partials;     // Per thread partial sums
+
+    int   maxIterations;
+    float tolerance;
+    int   iterations;
+    float error;
+
+    void buildAdjacency();
+
+    void multiply(ThreadPool & pool, const std::vector<glm::vec3> & x,
+        std::vector<glm::vec3> & y, double & dot);
+
+public:
+
+    SpringNetwork();
+
+    ~SpringNetwork();
+
+    /**
+     * @brief Add a particle, returning its index
+     *
+     * @param[in] position Position
+     * @param[in] mass     Mass, or 0 for a fixed particle
+     */
+    int addParticle(glm::vec3 position, float mass);
+
+    /**
+     * @brief Add a damped spring between two particles, returning its index
+     *
+     * @param[in] particle1 Index of first particle
+     * @param[in] particle2 Index of second particle
+     * @param[in] stiffness Spring constant
+     * @param[in] length    Rest length
+     * @param[in] damping   Damping coefficient along the spring
+     */
+    int addSpring(int particle1, int particle2, float stiffness, float length, float damping);
+
+    /**
+     * @brief Add a spring with the stiffness, rest length and damping of a
+     * spring constraint. Its bodies are ignored.
+     */
+    int addSpring(int particle1, int particle2, const SpringConstraint & spring);
+
+    int getNumParticles();
+
+    const std::vector<glm::vec3> & getPositions();
+
+    const std::vector<glm::vec3> & getVelocities();
+
+    const SpringPool & getSprings();
+
+    void setPosition(int particle, glm::vec3 position);
+
+    void setVelocity(int particle, glm::vec3 velocity);
+
+    /**
+     * @brief Set the most conjugate gradient iterations per step
+     */
+    void setSolverIterations(int maxIterations);
+
+    /**
+     * @brief Set the residual, relative to the right hand side, at which the
+     * solve stops
+     */
+    void setSolverTolerance(float tolerance);
+
+    /**
+     * @brief Get conjugate gradient iterations run by the last step
+     */
+    int getIterations();
+
+    /**
+     * @brief Get relative residual at the end of the last step
+     */
+    float getError();
+
+    /**
+     * @brief Advance by one step
+     *
+     * @param[in] gravity Gravity
+     * @param[in] dt      Step length, in seconds
+     * @param[in] pool    Threads to spread the solve over
+     */
+    void step(const glm::vec3 & gravity, float dt, ThreadPool & pool);
+
+};
+
+inline int SpringNetwork::getNumParticles() {
+    return (int)positions.size();
+}
+
+inline const std::vector<glm::vec3> & SpringNetwork::getPositions() {
+    return positions;
+}
+
+inline const std::vector<glm::vec3> & SpringNetwork::getVelocities() {
+    return velocities;
+}
+
+inline const SpringPool & SpringNetwork::getSprings() {
+    return springs;
+}
+
+inline int SpringNetwork::getIterations() {
+    return iterations;
+}
+
+inline float SpringNetwork::getError() {
+    return error;
+}
+
+}
+
+#endif
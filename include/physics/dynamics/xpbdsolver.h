@@ -0,0 +1,97 @@
+/**
+ * @file xpbdsolver.h
+ *
+ * @brief Extended position based dynamics solver for contacts and constraints
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __XPBDSOLVER_H
+#define __XPBDSOLVER_H
+
+#include <physics/system.h>
+#include <vector>
+
+namespace Physics {
+
+/**
+ * @brief Solves contacts and constraints as compliant positional constraints
+ * (XPBD). Each step is split into substeps. A substep predicts positions from
+ * velocities, projects every constraint once onto positions, then derives
+ * velocities from the change in position. Contacts and rods are infinitely
+ * stiff, and springs use a compliance of 1 / stiffness.
+ *
+ * Contacts are found once per step. Each one keeps anchors in both bodies'
+ * local space, and its separation is updated from how the anchors have moved.
+ * Corrections are applied where the contact was found, so that rolling bodies
+ * are not spun by anchors which have turned away from the contact. Dynamic
+ * friction and restitution are applied to velocities at the end of each
+ * substep. Rolling friction is not supported.
+ */
+class PHYSICS_EXPORT XPBDSolver {
+private:
+
+    struct BodyState {
+        glm::vec3 prevPosition;    //!< Position before the substep
+        glm::quat prevOrientation; //!< Orientation before the substep
+    };
+
+    struct ContactState {
+        glm::vec3 anchor1;    //!< Contact point in first body space
+        glm::vec3 anchor2;    //!< Contact point in second body space
+        glm::vec3 arm1;       //!< Contact point relative to first body when found
+        glm::vec3 arm2;       //!< Contact point relative to second body when found
+        float     separation; //!< Separation when found, negative if penetrating
+        float     approach;   //!< Relative normal velocity before the substep's solve
+        float     lambda;     //!< Normal position multiplier from this substep
+    };
+
+    std::vector<BodyState>    bodyStates;
+    std::vector<ContactState> contactStates;
+    float                     elasticity;
+
+    static void applyPositionCorrection(Body *body, const glm::vec3 & correction,
+        const glm::vec3 & r);
+
+    static float getGeneralizedInverseMass(Body *body, const glm::vec3 & r,
+        const glm::vec3 & n);
+
+    void solveContacts(std::vector<System::ContactEx> & contacts, float h);
+
+    static void projectDistance(Body *b1, Body *b2, float length, float compliance,
+        float damping, float h);
+
+    void solveConstraints(std::vector<std::shared_ptr<Body>> & bodies, const RodPool & rods,
+        const SpringPool & springs, float h);
+
+    void solveVelocities(std::vector<System::ContactEx> & contacts, const glm::vec3 & gravity,
+        float h);
+
+public:
+
+    XPBDSolver();
+
+    ~XPBDSolver();
+
+    /**
+     * @brief Advance bodies by one step. Accumulated forces must already have
+     * been applied to velocities.
+     *
+     * @param[in] bodies      Bodies
+     * @param[in] contacts    Contacts found at the start of the step. Their
+     *                        impulse is set to the total normal impulse applied.
+     * @param[in] rods        Rods
+     * @param[in] springs     Springs
+     * @param[in] gravity     Gravity
+     * @param[in] dt          Step length, in seconds
+     * @param[in] substeps    Number of substeps
+     */
+    void step(std::vector<std::shared_ptr<Body>> & bodies,
+        std::vector<System::ContactEx> & contacts, const RodPool & rods,
+        const SpringPool & springs, const glm::vec3 & gravity, float dt, int substeps);
+
+};
+
+}
+
+#endif
@@ -0,0 +1,118 @@
+/**
+ * @file spscqueue.h
+ *
+ * @brief Bounded lock-free queue for one producer thread and one consumer thread
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __SPSCQUEUE_H
+#define __SPSCQUEUE_H
+
+#include <physics/defs.h>
+#include <vector>
+#include <atomic>
+
+namespace Physics {
+
+/**
+ * @brief Fixed-capacity ring buffer. One thread may push while another pops,
+ * without locking. Capacity is rounded up to a power of two. Push fails rather
+ * than blocking when the queue is full.
+ */
+template<typename T>
+class SPSCQueue {
+private:
+
+    std::vector<T>      items;
+    size_t              mask;
+    std::atomic<size_t> head; //!< Next slot to pop, written by the consumer
+    std::atomic<size_t> tail; //!< Next slot to push, written by the producer
+
+public:
+
+    SPSCQueue(size_t capacity = 4096);
+
+    ~SPSCQueue();
+
+    /**
+     * @brief Append an item. Producer thread only.
+     *
+     * @return False if the queue is full, in which case the item is dropped
+     */
+    bool push(const T & item);
+
+    /**
+     * @brief Remove the oldest item. Consumer thread only.
+     *
+     * @return False if the queue is empty
+     */
+    bool pop(T & item);
+
+    /**
+     * @brief Get the number of items in the queue. Only exact when neither
+     * thread is using the queue.
+     */
+    size_t size() const;
+
+    size_t capacity() const;
+
+};
+
+template<typename T>
+SPSCQueue<T>::SPSCQueue(size_t capacity)
+    : head(0),
+      tail(0)
+{
+    size_t size = 1;
+
+    while (size < capacity)
+        size <<= 1;
+
+    items.resize(size);
+    mask = size - 1;
+}
+
+template<typename T>
+SPSCQueue<T>::~SPSCQueue() {
+}
+
+template<typename T>
+bool SPSCQueue<T>::push(const T & item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+
+    if (t - head.load(std::memory_order_acquire) == items.size())
+        return false;
+
+    items[t & mask] = item;
+    tail.store(t + 1, std::memory_order_release);
+
+    return true;
+}
+
+template<typename T>
+bool SPSCQueue<T>::pop(T & item) {
+    size_t h = head.load(std::memory_order_relaxed);
+
+    if (h == tail.load(std::memory_order_acquire))
+        return false;
+
+    item = items[h & mask];
+    head.store(h + 1, std::memory_order_release);
+
+    return true;
+}
+
+template<typename T>
+size_t SPSCQueue<T>::size() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+template<typename T>
+size_t SPSCQueue<T>::capacity() const {
+    return items.size();
+}
+
+}
+
+#endif
@@ -13,11 +13,29 @@
 #include <vector>
 #include <memory>
 #include <physics/collision/collision.h>
+#include <physics/collision/contactcache.h>
+#include <physics/collision/contactevents.h>
+#include <physics/collision/broadphase.h>
+#include <physics/collision/overlap.h>
+#include <physics/collision/raycast.h>
+#include <physics/constraints/constraintpool.h>
+#include <physics/threadpool.h>
+#include <physics/spscqueue.h>
 
 namespace Physics {
 
 class Body;
+class Shape;
 class Constraint;
+class XPBDSolver;
+class DirectSolver;
+class Articulation;
+class SpringNetwork;
+class Cloth;
+class SoftBody;
+class Fluid;
+class Granular;
+class Continuum;
 
 // TODO: Using shared pointer everywhere might hurt perf
 
@@ -33,12 +51,128 @@ public:
         Collision::Contact  contact;
         Body               *b1;
         Body               *b2;
+        float               impulse;       //!< Normal impulse applied by the solver
+        float               pseudoImpulse; //!< Accumulated split impulse
+        float               target;        //!< Normal velocity the block solver aims for
+        glm::vec3           tangent1;      //!< First friction direction
+        glm::vec3           tangent2;      //!< Second friction direction
+        float               tangentImpulse1; //!< Accumulated friction impulse along tangent1
+        float               tangentImpulse2; //!< Accumulated friction impulse along tangent2
+        glm::vec3           rollingImpulse;  //!< Accumulated rolling friction angular impulse
+        float               friction;        //!< Combined friction coefficient
+        float               rollingFriction; //!< Combined rolling friction coefficient
     };
 
+    /**
+     * @brief Change in whether two bodies are touching. See
+     * setContactTracking().
+     */
+    struct ContactEvent {
+        Collision::PairEvent::Type  type;     //!< Begin, Persist or End
+        Body                       *b1;       //!< First body
+        Body                       *b2;       //!< Second body
+        glm::vec3                   point;    //!< Deepest contact point, or last known point for End
+        glm::vec3                   normal;   //!< Contact normal, pointing from b1 to b2
+        float                       impulse;  //!< Normal impulse summed over the pair's contacts
+    };
+
+    typedef SPSCQueue<ContactEvent> ContactEventQueue;
+
+    /**
+     * @brief Solver backend, chosen when the system is constructed
+     */
+    enum Backend {
+        /**
+         * Velocity impulses, run with the SolverMode set on the system. Rods
+         * and springs are solved together with contacts.
+         */
+        ImpulseBackend,
+
+        /**
+         * Extended position based dynamics. Contacts, rods and springs are
+         * solved as compliant positional constraints over getSubsteps()
+         * substeps per step. See XPBDSolver.
+         */
+        XPBDBackend
+    };
+
+    /**
+     * @brief How contacts are solved over a step by the impulse backend
+     */
+    enum SolverMode {
+        /**
+         * Contacts are found each step, and solved with several velocity
+         * iterations. Needs a small step for stiff stacks.
+         */
+        Impulse,
+
+        /**
+         * Temporal Gauss-Seidel. Contacts are found once per step, and the
+         * step is split into substeps which each run one velocity iteration,
+         * integrate positions, and then remove the velocity used to push
+         * bodies apart. Contact separation is updated from the bodies' motion
+         * between substeps, and contact impulses are warm started from the
+         * last step. Intended for large steps, such as 1/60 s.
+         */
+        TGS
+    };
+
+    /**
+     * @brief Solver statistics for one step. Contacts are split into islands
+     * of bodies which touch each other, and each island iterates until its
+     * impulses converge.
+     */
+    struct StepStats {
+        int   contacts;      //!< Number of solved contacts
+        int   constraints;   //!< Number of solved rods and springs
+        int   islands;       //!< Number of islands with contacts or constraints
+        int   iterations;    //!< Iterations summed over islands
+        int   maxIterations; //!< Most iterations run by one island
+        float impulseDelta;  //!< Largest impulse applied in an island's last iteration
+        float residual;      //!< Largest velocity error in an island's last iteration
+    };
+
+    /**
+     * @brief Result of a ray cast
+     */
+    struct RayHit {
+        Body      *body;     //!< Body which was hit, or null for no hit
+        glm::vec3  point;    //!< Hit point in world space
+        glm::vec3  normal;   //!< Surface normal at hit point in world space
+        float      distance; //!< Distance along ray
+    };
+
+    /**
+     * @brief Closest point on a body to a query point
+     */
+    struct PointHit {
+        Body      *body;     //!< Body
+        glm::vec3  point;    //!< Closest point on body, or the query point if inside
+        float      distance; //!< Distance to body, 0 if inside
+    };
+
+    /**
+     * @brief Pair filter. Returns false to stop two bodies from colliding.
+     * Only called for pairs whose boxes overlap and whose collision groups and
+     * masks allow them to collide.
+     */
+    typedef bool (*PairFilter)(void *userData, Body *b1, Body *b2);
+
 private:
 
     std::vector<std::shared_ptr<Body>> bodies;
-    std::vector<std::shared_ptr<Constraint>> constraints;
+    RodPool rods;
+    SpringPool springs;
+    std::vector<std::shared_ptr<Articulation>> articulations;
+    std::vector<int> articulationBodies; // Body index of each articulation's root
+    std::vector<int> linkParents;        // Body index of each link's parent link, or -1
+    std::vector<std::shared_ptr<SpringNetwork>> springNetworks;
+    std::vector<std::shared_ptr<Cloth>> cloths;
+    std::vector<std::shared_ptr<SoftBody>> softBodies;
+    std::vector<std::shared_ptr<Fluid>> fluids;
+    std::vector<std::shared_ptr<Granular>> granulars;
+    std::vector<std::shared_ptr<Continuum>> continua;
+    std::vector<Body *> deformableColliders;
     glm::vec3 gravity;
     double step;
     double accumTime;
@@ -46,22 +180,315 @@ private:
     double timeWarp; // TODO doubles are too big maybe
     std::vector<ContactEx> contacts;
 
-    void resolveContact(const ContactEx & contact);
+    std::unique_ptr<ThreadPool> threadPool;
+
+    // Broadphase, rebuilt each step and used by scene queries in between. It
+    // is refit to where bodies are before queries once they have moved.
+    Broadphase broadphase;
+    bool queriesDirty;
+    std::vector<AABB> boxes;
+    std::vector<unsigned> groups;
+    std::vector<unsigned> masks;
+    PairFilter pairFilter;
+    void *pairFilterData;
+    std::vector<Collision::Pair> candidatePairs;
+    bool amortizedBroadphase;
+
+    // Narrowphase scratch space, kept between steps to avoid reallocation
+    Collision::PairBuckets pairs;
+    std::vector<const Shape *> shapes;
+    std::vector<const Transform *> transforms;
+    Collision::SphereBatch sphereBatch;
+
+    Collision::ContactCache contactCache;
+    bool contactCaching;
+    std::vector<Collision::PairContact> pairContacts;
+    std::vector<Collision::PairContact> speculativeContacts;
+    std::vector<int> solverContacts; // Index into contacts for each pair contact, or -1
+
+    // Solver islands. Contacts of island i are islandContacts[islandOffsets[i]]
+    // up to islandContacts[islandOffsets[i + 1]], and rods and springs are
+    // listed the same way.
+    std::vector<int> contactBodies; // Non-fixed body index of each contact, or -1
+    std::vector<int> islandParent;
+    std::vector<int> islandContacts;
+    std::vector<int> islandOffsets;
+    std::vector<int> islandRods;
+    std::vector<int> islandRodOffsets;
+    std::vector<int> islandSprings;
+    std::vector<int> islandSpringOffsets;
+    std::vector<int> islandComponents;       // Direct solver components
+    std::vector<int> islandComponentOffsets;
+    std::vector<int> islandArticulations;
+    std::vector<int> islandArticulationOffsets;
+    std::vector<int> islandKeys;
+
+    // Shock propagation layers. Bodies touching each contact, and the
+    // contacts of body i are layerContacts[layerOffsets[i]] up to
+    // layerContacts[layerOffsets[i + 1]].
+    bool shockPropagation;
+    std::vector<Collision::Pair> contactPairs;
+    std::vector<int> bodyLayers;
+    std::vector<int> layerOffsets;
+    std::vector<int> layerContacts;
+    std::vector<int> layerQueue;
+
+    int minIterations;
+    int maxIterations;
+    float impulseTolerance;
+    float residualTolerance;
+    bool splitImpulse;
+    bool blockSolver;
+    bool directSolving;
+    std::unique_ptr<DirectSolver> directSolver;
+
+    // Contact state for the TGS solver, in the same order as contacts
+    struct SubstepContact {
+        glm::vec3 anchor1;    //!< Contact point in first body space
+        glm::vec3 anchor2;    //!< Contact point in second body space
+        glm::vec3 arm1;       //!< Contact point relative to first body when found
+        glm::vec3 arm2;       //!< Contact point relative to second body when found
+        float     separation; //!< Separation when found, negative if penetrating
+        float     mass;       //!< Effective mass along the normal
+        float     approach;   //!< Relative normal velocity when found
+        float     total;      //!< Normal impulse summed over the substeps
+    };
+
+    // Impulses of the last step's TGS contacts, sorted by pair, which warm
+    // start the contacts found in the next step
+    struct WarmContact {
+        uint64_t  key;            //!< Pair key, lower index in the high bits
+        glm::vec3 anchor;         //!< Contact point in first body space
+        float     impulse;        //!< Normal impulse of the last substep
+        glm::vec3 tangentImpulse; //!< Friction impulse of the last substep, in first body space
+        glm::vec3 rollingImpulse; //!< Rolling friction impulse, likewise
+    };
+
+    Backend backend;
+    std::unique_ptr<XPBDSolver> xpbdSolver;
+    SolverMode solverMode;
+    int substeps;
+    std::vector<SubstepContact> substepContacts;
+    std::vector<WarmContact> warmContacts;
+    std::vector<WarmContact> nextWarmContacts;
+
+    Collision::ContactTracker contactTracker;
+    bool contactTracking;
+    std::vector<Collision::PairEvent> pairEvents;
+    std::vector<ContactEvent> contactEvents;
+    ContactEventQueue *contactEventQueue;
+    long long droppedContactEvents;
+
+    StepStats stepStats;
+
+    std::vector<Collision::RayHit> rayHits;
+    std::vector<int> overlapResults;
+    std::vector<Collision::PointHit> pointHits;
+
+    void updateBroadphase(int numSteps = 0, bool refit = false);
+
+    void findPairs(int numSteps = 0);
+
+    static bool filterPair(void *ctx, int i1, int i2);
+
+    void prepareQueries();
+
+    void findDeformableColliders(const AABB & box);
+
+    void stepDeformables();
+
+    void findContacts(bool updatePairs);
+
+    void convertRayHit(const Collision::RayHit & hit, RayHit & result);
+
+    void resolveContact(ContactEx & contact, float & impulseDelta, float & residual,
+        float scale1 = 1.0f, float scale2 = 1.0f);
+
+    bool isSplit(const ContactEx & contact);
+
+    void resolvePenetration(ContactEx & contact, float & impulseDelta);
+
+    void resolveFriction(ContactEx & contact, const glm::vec3 & r1, const glm::vec3 & r2,
+        float normalImpulse, float scale1 = 1.0f, float scale2 = 1.0f);
+
+    float getTargetVelocity(const ContactEx & contact);
+
+    void resolveManifold(const int *indices, int count, float & impulseDelta,
+        float & residual, float scale1 = 1.0f, float scale2 = 1.0f);
+
+    void prepareConstraints(float h);
+
+    void solveRods(int start, int end, float & impulseDelta, float & residual);
+
+    void solveSprings(int start, int end, float & impulseDelta, float & residual);
+
+    bool isDirectIsland(int island);
+
+    int findIsland(int body);
+
+    int getIslandKey(int body1, int body2);
+
+    void applyArticulationImpulses(int start, int end);
+
+    void buildIslands();
+
+    void spreadLayers(int start);
+
+    void buildLayers();
+
+    void solveIslandPenetration(int island, float & impulseDelta);
+
+    void solveIsland(int island, bool direct, bool shock, float & impulseDelta,
+        float & residual);
+
+    void solveContacts();
+
+    void stepImpulse(bool updatePairs);
+
+    void solveSubstepContacts(float h, bool relax, float & impulseDelta, float & residual);
+
+    void stepTGS(bool updatePairs);
+
+    void stepXPBD(bool updatePairs);
+
+    void trackContacts();
 
 public:
 
-    System();
+    /**
+     * @brief Constructor
+     *
+     * @param[in] backend Solver backend
+     */
+    System(Backend backend = ImpulseBackend);
 
     ~System();
 
-    void addBody(std::shared_ptr<Body> body);
+    /**
+     * @brief Add a body, returning its index, which rods and springs use to
+     * refer to it
+     */
+    int addBody(std::shared_ptr<Body> body);
 
+    /**
+     * @brief Add a rod or spring constraint between two bodies which have
+     * already been added. The constraint is copied into a pool, and later
+     * changes to it have no effect. Each body is looked up by a linear search,
+     * so large rigs should use addRod() and addSpring() instead.
+     */
     void addConstraint(std::shared_ptr<Constraint> constraint);
 
+    /**
+     * @brief Add a rod which keeps the centers of mass of two bodies at a
+     * fixed distance
+     *
+     * @param[in] body1  Index of first body, from addBody()
+     * @param[in] body2  Index of second body, from addBody()
+     * @param[in] length Distance between the bodies
+     */
+    void addRod(int body1, int body2, float length);
+
+    /**
+     * @brief Add a damped spring between the centers of mass of two bodies
+     *
+     * @param[in] body1     Index of first body, from addBody()
+     * @param[in] body2     Index of second body, from addBody()
+     * @param[in] stiffness Spring constant
+     * @param[in] length    Rest length
+     * @param[in] damping   Damping coefficient
+     */
+    void addSpring(int body1, int body2, float stiffness, float length, float damping);
+
+    /**
+     * @brief Add an articulation, and each of its links as a body. Links must
+     * not be added separately. Articulations are only simulated by the
+     * impulse backend. The XPBD backend adds the links as free bodies, without
+     * their joints.
+     *
+     * Contacts between a link and its parent are ignored, since they
+     * usually overlap at the joint.
+     */
+    void addArticulation(std::shared_ptr<Articulation> articulation);
+
+    const std::vector<std::shared_ptr<Articulation>> & getArticulations();
+
+    /**
+     * @brief Add a spring network, which is stepped with the system over its
+     * thread pool. Networks do not interact with bodies.
+     */
+    void addSpringNetwork(std::shared_ptr<SpringNetwork> network);
+
+    const std::vector<std::shared_ptr<SpringNetwork>> & getSpringNetworks();
+
+    /**
+     * @brief Add a cloth, which is stepped with the system over its thread
+     * pool. Cloth collides with bodies found by the broadphase, except
+     * sensors, and pushes back on free bodies.
+     */
+    void addCloth(std::shared_ptr<Cloth> cloth);
+
+    const std::vector<std::shared_ptr<Cloth>> & getCloths();
+
+    /**
+     * @brief Add a soft body, which is stepped with the system over its thread
+     * pool. Soft bodies collide with bodies found by the broadphase, except
+     * sensors, and push back on free bodies. They do not collide with each
+     * other, or with cloth.
+     */
+    void addSoftBody(std::shared_ptr<SoftBody> softBody);
+
+    const std::vector<std::shared_ptr<SoftBody>> & getSoftBodies();
+
+    /**
+     * @brief Add a fluid, which is stepped with the system over its thread
+     * pool, in steps of the fluid's own length. Fluids collide with bodies
+     * found by the broadphase, except sensors, and push back on free bodies.
+     * They do not collide with each other, with cloth, or with soft bodies.
+     */
+    void addFluid(std::shared_ptr<Fluid> fluid);
+
+    const std::vector<std::shared_ptr<Fluid>> & getFluids();
+
+    /**
+     * @brief Add a granular material, which is stepped with the system over its
+     * thread pool, in steps of the material's own length. Grains collide with
+     * bodies found by the broadphase, except sensors, and push back on free
+     * bodies. They do not collide with fluids, cloth, or soft bodies.
+     */
+    void addGranular(std::shared_ptr<Granular> granular);
+
+    const std::vector<std::shared_ptr<Granular>> & getGranulars();
+
+    /**
+     * @brief Add a continuum, such as snow, sand or mud, which is stepped with
+     * the system over its thread pool, in steps of the continuum's own length.
+     * Continua collide with bodies found by the broadphase, except sensors,
+     * and push back on free bodies. They do not collide with each other, or
+     * with other deformables.
+     */
+    void addContinuum(std::shared_ptr<Continuum> continuum);
+
+    const std::vector<std::shared_ptr<Continuum>> & getContinua();
+
+    const RodPool & getRods();
+
+    const SpringPool & getSprings();
+
     double getTimeWarp();
 
     void setTimeWarp(double timeWarp);
 
+    /**
+     * @brief Get fixed simulation step, in seconds
+     */
+    double getStep();
+
+    /**
+     * @brief Set fixed simulation step, in seconds. Bodies which would move
+     * further than their size in one step should be flagged as fast movers.
+     */
+    void setStep(double step);
+
     // TODO: in seconds
     void integrate(double t, double dt);
 
@@ -71,8 +498,240 @@ public:
 
     std::vector<ContactEx> & getContacts(); // TODO
 
+    /**
+     * @brief Set the range of solver iterations run on each island per step.
+     * Islands stop early once both tolerances are met, but not before
+     * minIterations.
+     */
+    void setSolverIterations(int minIterations, int maxIterations);
+
+    /**
+     * @brief Set solver convergence tolerances
+     *
+     * @param[in] impulseTolerance  Largest impulse applied to any contact in
+     *                              the last iteration
+     * @param[in] residualTolerance Largest velocity error of any contact in
+     *                              the last iteration
+     */
+    void setSolverTolerance(float impulseTolerance, float residualTolerance);
+
+    /**
+     * @brief Enable or disable split impulses. Normally penetration is
+     * corrected by adding a bias to the contact impulse, which adds energy.
+     * With split impulses, penetration deeper than 1 cm is corrected after
+     * the velocity iterations by separate passes over pseudo velocities,
+     * which move bodies apart without changing their momentum.
+     */
+    void setSplitImpulse(bool splitImpulse);
+
+    bool getSplitImpulse();
+
+    /**
+     * @brief Enable or disable the block solver. When enabled, the points of a
+     * contact manifold are solved together rather than one at a time, which
+     * keeps boxes resting on a face from rocking between their corners. Two
+     * point manifolds are solved exactly. Larger manifolds are solved directly
+     * when possible, and otherwise as pairs of points. Manifolds solved this
+     * way only bounce when they approach faster than 1 m/s, while single
+     * points, and all points with the block solver disabled, bounce at any
+     * speed.
+     */
+    void setBlockSolver(bool blockSolver);
+
+    bool getBlockSolver();
+
+    /**
+     * @brief Enable or disable the direct solver for rods and springs. When
+     * enabled, islands made up mostly of constraints solve each connected
+     * group of them exactly in every iteration, so that long ropes and chains
+     * do not stretch. See DirectSolver. Other islands iterate over their
+     * constraints one at a time.
+     */
+    void setDirectSolver(bool directSolver);
+
+    bool getDirectSolver();
+
+    /**
+     * @brief Enable or disable shock propagation. Bodies are layered by how
+     * many contacts separate them from a fixed body, and each island's
+     * contacts are solved from the bottom layer up. After the usual
+     * iterations, one more iteration treats the lower body of each contact as
+     * infinitely heavy, so that the weight of a stack reaches the ground even
+     * with few iterations. Islands which do not touch a fixed body are
+     * layered up from their lowest body.
+     */
+    void setShockPropagation(bool shockPropagation);
+
+    bool getShockPropagation();
+
+    /**
+     * @brief Get the shock propagation layer of each body, in the order of
+     * getBodies(), as of the last step. Fixed bodies are in layer 0, and bodies
+     * without contacts are -1. Only updated while shock propagation is
+     * enabled.
+     */
+    const std::vector<int> & getBodyLayers();
+
+    Backend getBackend();
+
+    /**
+     * @brief Set how contacts are solved by the impulse backend. See
+     * SolverMode.
+     */
+    void setSolverMode(SolverMode solverMode);
+
+    SolverMode getSolverMode();
+
+    /**
+     * @brief Set the number of substeps per step in TGS mode and with the
+     * XPBD backend. Defaults to 8.
+     */
+    void setSubsteps(int substeps);
+
+    int getSubsteps();
+
+    /**
+     * @brief Get solver statistics for the last step
+     */
+    const StepStats & getStepStats();
+
+    /**
+     * @brief Enable or disable contact events. When enabled, the system tracks
+     * which pairs of bodies are touching from step to step, and reports when
+     * they begin touching, keep touching and stop touching.
+     */
+    void setContactTracking(bool contactTracking);
+
+    bool getContactTracking();
+
+    /**
+     * @brief Get the contact events generated by the last call to integrate(),
+     * in step order
+     */
+    const std::vector<ContactEvent> & getContactEvents();
+
+    /**
+     * @brief Set a queue which contact events are also pushed to, so that they
+     * can be consumed on another thread, or null for none. The thread calling
+     * integrate() is the producer. Events which do not fit are dropped.
+     */
+    void setContactEventQueue(ContactEventQueue *queue);
+
+    /**
+     * @brief Get number of contact events dropped because the queue was full
+     */
+    long long getDroppedContactEvents();
+
+    /**
+     * @brief Set a function which may reject pairs of bodies during the
+     * broadphase, before any narrowphase work, or null for none. Pairs which
+     * can be excluded by collision group and mask (see
+     * Body::setCollisionFilter()) should be, as that is much cheaper.
+     *
+     * @param[in] filter   Filter function
+     * @param[in] userData Passed to each call of the filter
+     */
+    void setPairFilter(PairFilter filter, void *userData);
+
+    /**
+     * @brief Enable or disable running the broadphase once per integrate()
+     * call instead of once per step. Bounding boxes are inflated by the
+     * furthest each body could travel under its current velocity and gravity
+     * over all of the call's steps, and each step only runs the narrowphase on
+     * the resulting pairs. Contacts may be missed if a body is pushed much
+     * faster during the call, for example by an explosion.
+     */
+    void setAmortizedBroadphase(bool amortizedBroadphase);
+
+    bool getAmortizedBroadphase();
+
+    /**
+     * @brief Enable or disable reuse of narrowphase results between steps,
+     * for pairs whose relative transform has barely changed. See ContactCache.
+     */
+    void setContactCaching(bool contactCaching);
+
+    bool getContactCaching();
+
+    /**
+     * @brief Get contact cache, to adjust tolerances or read hit and miss
+     * counters
+     */
+    Collision::ContactCache & getContactCache();
+
     std::vector<std::shared_ptr<Body>> & getBodies();
 
+    /**
+     * @brief Set number of threads used for parallel work, including the
+     * calling thread. 0 uses one thread per hardware thread.
+     */
+    void setThreadCount(int numThreads);
+
+    ThreadPool & getThreadPool();
+
+    /**
+     * @brief Find the closest hit for each of a batch of rays. Coherent rays are
+     * traced in packets, and the batch is spread over the thread pool. Queries
+     * see bodies where they are now, including bodies moved by setPosition(),
+     * setOrientation() or setShape() since the last step. Transforms changed
+     * directly through getTransform() are seen after the next step.
+     *
+     * @param[in]  rays  Rays
+     * @param[in]  count Number of rays
+     * @param[out] hits  One hit per ray. Misses have a null body.
+     */
+    void raycast(const Collision::Ray *rays, size_t count, RayHit *hits);
+
+    /**
+     * @brief Find every hit for each of a batch of rays. Hits for ray i are
+     * hits[offsets[i]] up to hits[offsets[i + 1]], sorted by distance.
+     *
+     * @param[in]  rays    Rays
+     * @param[in]  count   Number of rays
+     * @param[out] hits    Hits, grouped by ray
+     * @param[out] offsets count + 1 offsets into hits
+     */
+    void raycastAll(const Collision::Ray *rays, size_t count, std::vector<RayHit> & hits,
+        std::vector<size_t> & offsets);
+
+    /**
+     * @brief Find bodies overlapping each of a batch of spheres. Query i owns
+     * results[i * maxResults] up to results[(i + 1) * maxResults]. Like
+     * raycast(), queries see bodies where they are now.
+     *
+     * @param[in]  centers    Sphere centers
+     * @param[in]  radii      Sphere radii
+     * @param[in]  count      Number of queries
+     * @param[in]  maxResults Slots per query
+     * @param[out] results    Overlapping bodies, count * maxResults slots
+     * @param[out] counts     Number of overlapping bodies per query, which may be
+     *                        larger than maxResults if some were dropped
+     */
+    void overlapSpheres(const glm::vec3 *centers, const float *radii, size_t count,
+        int maxResults, Body **results, int *counts);
+
+    /**
+     * @brief Find bodies overlapping each of a batch of axis-aligned boxes. See
+     * overlapSpheres().
+     */
+    void overlapBoxes(const AABB *boxes, size_t count, int maxResults, Body **results,
+        int *counts);
+
+    /**
+     * @brief Find the k bodies nearest to each of a batch of points. Query i
+     * owns results[i * k] up to results[(i + 1) * k], sorted nearest first by
+     * where bodies are now, as for raycast().
+     *
+     * @param[in]  points      Query points
+     * @param[in]  count       Number of queries
+     * @param[in]  k           Number of neighbors per query
+     * @param[in]  maxDistance Bodies further than this are ignored
+     * @param[out] results     Neighbors, count * k slots
+     * @param[out] counts      Number of neighbors found per query, at most k
+     */
+    void nearest(const glm::vec3 *points, size_t count, int k, float maxDistance,
+        PointHit *results, int *counts);
+
 };
 
 }
@@ -0,0 +1,96 @@
+/**
+ * @file threadpool.h
+ *
+ * @brief Pool of worker threads for data-parallel loops
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#ifndef __THREADPOOL_H
+#define __THREADPOOL_H
+
+#include <physics/defs.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace Physics {
+
+/**
+ * @brief Pool of worker threads which run parallel loops. The calling thread
+ * takes part in each loop, so a pool with one thread runs everything inline.
+ * Only one loop runs at a time, and loops must not be started from inside a
+ * loop body.
+ */
+class PHYSICS_EXPORT ThreadPool {
+public:
+
+    /**
+     * @brief Loop body. Called with the index of the thread running it, from 0
+     * to getThreadCount() - 1, and a range of iterations [begin, end).
+     */
+    typedef void (*RangeFunc)(void *ctx, int thread, int begin, int end);
+
+private:
+
+    std::vector<std::thread> workers;
+    std::mutex               mutex;
+    std::condition_variable  wake;
+    std::condition_variable  done;
+    RangeFunc                func;
+    void                    *ctx;
+    int                      count;
+    int                      grain;
+    std::atomic<int>         next;
+    int                      active;
+    unsigned                 generation;
+    bool                     quit;
+
+    void workerMain(int thread);
+
+    void runChunks(int thread);
+
+    template<typename F>
+    static void rangeTrampoline(void *ctx, int thread, int begin, int end) {
+        (*static_cast<const F *>(ctx))(thread, begin, end);
+    }
+
+public:
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] numThreads Total number of threads including the caller, or 0
+     *                       to use one per hardware thread
+     */
+    ThreadPool(int numThreads = 0);
+
+    ~ThreadPool();
+
+    /**
+     * @brief Get total number of threads, including the calling thread
+     */
+    int getThreadCount() const;
+
+    /**
+     * @brief Run func over [0, count) in chunks of grain iterations, spread
+     * over all threads. Returns once every chunk has finished.
+     */
+    void parallelFor(int count, int grain, RangeFunc func, void *ctx);
+
+    /**
+     * @brief Convenience wrapper which accepts a callable taking
+     * (int thread, int begin, int end)
+     */
+    template<typename F>
+    void parallelFor(int count, int grain, const F & f) {
+        parallelFor(count, grain, &rangeTrampoline<F>, (void *)&f);
+    }
+
+};
+
+}
+
+#endif
@@ -29,6 +29,7 @@ namespace Physics {
 class System;
 class Body;
 class Contact;
+class SoftBody;
 
 namespace Util {
 
@@ -45,6 +46,11 @@ private:
         std::shared_ptr<Body> body;
     };
 
+    struct MeshSoftBodyPair {
+        std::shared_ptr<Mesh>     mesh;
+        std::shared_ptr<SoftBody> softBody;
+    };
+
 #pragma pack(push, 1)
     struct SceneUniforms {
         glm::mat4 viewProjection;
@@ -72,6 +78,7 @@ private:
     double                              time;                  //!< Current time
     double                              debug_time;            //!< Time debug string last updated
     std::vector<MeshBodyPair>           meshes;                //!< List of meshes to draw
+    std::vector<MeshSoftBodyPair>       softBodyMeshes;        //!< Soft body surfaces, streamed each frame
     float                               shadowBounds;          //!< Shadow view rectangle width/height
     float                               shadowNear;            //!< Shadow near plane
     float                               shadowFar;             //!< Shadow far plane
@@ -199,6 +206,12 @@ protected:
      */
     void addMesh(std::shared_ptr<Mesh> mesh, std::shared_ptr<Body> body);
 
+    /**
+     * @brief Draw the surface of a soft body, which must also be added to the
+     * system to be simulated
+     */
+    void addSoftBody(std::shared_ptr<SoftBody> softBody);
+
 public:
 
     /**
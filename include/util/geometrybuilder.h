@@ -3,6 +3,12 @@
 
 #include <util/mesh.h>
 
+namespace Physics {
+
+class SoftBody;
+
+}
+
 class UTIL_EXPORT GeometryBuilder {
 public:
 
@@ -20,6 +26,17 @@ public:
         int nv,
         float r);
 
+    /**
+     * @brief Create a mesh of a soft body's surface, in world space. Vertices
+     * are streamed from the soft body by updateSoftBody().
+     */
+    static std::shared_ptr<Mesh> createSoftBody(
+        Physics::SoftBody & softBody);
+
+    static void updateSoftBody(
+        Mesh & mesh,
+        Physics::SoftBody & softBody);
+
 };
 
 #endif
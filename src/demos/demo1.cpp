@@ -80,6 +80,7 @@ protected:
             getSystem()->addBody(sphereBody);
             sphereBody->setPosition(cam->getPosition());
             sphereBody->setLinearVelocity(glm::normalize(cam->getTarget() - cam->getPosition()) * 100.0f);
+            sphereBody->setFastMover(true);
             sphereBody->setShape(std::make_shared<SphereShape>(3.0f));
             sphereBody->setMass(5.0f);
             float I = 2.0f * 5.0f * 3.0f * 3.0f / 5.0f;
@@ -68,6 +68,7 @@ protected:
             getSystem()->addBody(cubeBody);
             cubeBody->setPosition(cam->getPosition());
             cubeBody->setLinearVelocity(glm::normalize(cam->getTarget() - cam->getPosition()) * 60.0f);
+            cubeBody->setFastMover(true);
             cubeBody->setShape(std::make_shared<CubeShape>(3, 3, 3));
             cubeBody->setMass(3.0f);
             float I = 2.0f / 3.0f;
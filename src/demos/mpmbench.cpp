@@ -0,0 +1,99 @@
+/**
+ * @file mpmbench.cpp
+ *
+ * @brief Material point method benchmark entrypoint. Drops boxes of sand of
+ * growing size onto an obstacle and a free ball, and prints throughput at
+ * each size, so that scaling with particle count can be tracked.
+ *
+ * Usage: mpmbench [max particles] [threads] [frames]
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/sphereshape.h>
+#include <physics/collision/planeshape.h>
+#include <physics/collision/cubeshape.h>
+#include <physics/dynamics/body.h>
+#include <physics/dynamics/continuum.h>
+#include <physics/system.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace Physics;
+
+// Grid spacing. Each cell holds eight particles.
+static const float spacing = 0.02f;
+
+/**
+ * @brief Run the scene with about the given number of particles, and print
+ * its throughput
+ */
+static void runScene(int numParticles, int numThreads, int frames) {
+    System system;
+
+    if (numThreads > 0)
+        system.setThreadCount(numThreads);
+
+    system.setStep(1.0 / 60.0);
+
+    // Ground plane, and a box the sand falls onto
+    auto ground = std::make_shared<Body>();
+    ground->setShape(std::make_shared<PlaneShape>(glm::vec3(0, 1, 0), 0));
+    ground->setFixed(true);
+    system.addBody(ground);
+
+    // Cube of sand with about the given number of particles
+    float side = cbrtf(numParticles * spacing * spacing * spacing / 8.0f);
+
+    auto obstacle = std::make_shared<Body>();
+    obstacle->setShape(std::make_shared<CubeShape>(side, 0.5f * side, 0.25f * side));
+    obstacle->setPosition(glm::vec3(0, 0.25f * side, 0));
+    obstacle->setFixed(true);
+    system.addBody(obstacle);
+
+    auto ball = std::make_shared<Body>();
+    float radius = 0.2f * side;
+    float mass = 1000.0f * 4.0f / 3.0f * 3.14159f * radius * radius * radius;
+    ball->setShape(std::make_shared<SphereShape>(radius));
+    ball->setMass(mass);
+    ball->setInertiaTensor(glm::mat3(0.4f * mass * radius * radius));
+    ball->setPosition(glm::vec3(0.6f * side, radius, 0.6f * side));
+    system.addBody(ball);
+
+    auto sand = std::make_shared<Continuum>(spacing);
+    int material = sand->addMaterial(ContinuumMaterial::sand());
+    glm::vec3 min(-0.5f * side, 0.6f * side, -0.5f * side);
+    sand->addBox(min, min + glm::vec3(side), material);
+    sand->setStep(sand->getStableStep());
+    system.addContinuum(sand);
+
+    auto start = std::chrono::high_resolution_clock::now();
+
+    for (int frame = 0; frame < frames; frame++)
+        system.integrate(frame / 60.0, 1.0 / 60.0);
+
+    auto end = std::chrono::high_resolution_clock::now();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    double steps = frames / 60.0 / sand->getStep();
+    double particleSteps = steps * sand->getNumParticles();
+
+    printf("%10d %10d %10.0f %12.3f %12.1f %12.2f\n", sand->getNumParticles(),
+        sand->getNumActiveBlocks(), steps, 1000.0 * seconds / steps,
+        1e9 * seconds / particleSteps, particleSteps / seconds * 1e-6);
+}
+
+int main(int argc, char *argv[]) {
+    int maxParticles = argc > 1 ? atoi(argv[1]) : 1 << 20;
+    int numThreads = argc > 2 ? atoi(argv[2]) : 0;
+    int frames = argc > 3 ? atoi(argv[3]) : 30;
+
+    printf("%10s %10s %10s %12s %12s %12s\n", "particles", "blocks", "steps", "ms/step",
+        "ns/particle", "M/s");
+
+    for (int numParticles = 1 << 14; numParticles <= maxParticles; numParticles *= 4)
+        runScene(numParticles, numThreads, frames);
+
+    return 0;
+}
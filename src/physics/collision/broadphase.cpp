@@ -0,0 +1,250 @@
+/**
+ * @file broadphase.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/broadphase.h>
+#include <algorithm>
+
+namespace Physics {
+
+// Maximum number of bodies in a leaf
+#define LEAF_SIZE 4
+
+// Group and mask bits used when none are given
+#define ALL_BITS 0xFFFFFFFFu
+
+Broadphase::Broadphase()
+    : filter(nullptr),
+      filterCtx(nullptr)
+{
+}
+
+Broadphase::~Broadphase() {
+}
+
+void Broadphase::build(const AABB *boxes, size_t count, const unsigned *groups,
+    const unsigned *masks)
+{
+    this->boxes.assign(boxes, boxes + count);
+
+    if (groups)
+        this->groups.assign(groups, groups + count);
+    else
+        this->groups.assign(count, ALL_BITS);
+
+    if (masks)
+        this->masks.assign(masks, masks + count);
+    else
+        this->masks.assign(count, ALL_BITS);
+
+    items.clear();
+    unbounded.clear();
+    nodes.clear();
+    centers.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const AABB & box = boxes[i];
+
+        if (box.isEmpty())
+            continue;
+
+        if (box.isInfinite())
+            unbounded.push_back((int)i);
+        else {
+            items.push_back((int)i);
+            centers[i] = box.getCenter();
+        }
+    }
+
+    if (!items.empty())
+        buildNode(0, (int)items.size());
+}
+
+void Broadphase::buildNode(int start, int count) {
+    int index = (int)nodes.size();
+    nodes.push_back(Node());
+
+    AABB box = AABB::empty();
+    AABB centerBox = AABB::empty();
+    unsigned nodeGroups = 0;
+    unsigned nodeMasks = 0;
+
+    for (int i = start; i < start + count; i++) {
+        box.merge(boxes[items[i]]);
+        centerBox.merge(centers[items[i]]);
+        nodeGroups |= groups[items[i]];
+        nodeMasks |= masks[items[i]];
+    }
+
+    nodes[index].box = box;
+    nodes[index].groups = nodeGroups;
+    nodes[index].masks = nodeMasks;
+
+    if (count <= LEAF_SIZE) {
+        nodes[index].start = start;
+        nodes[index].count = count;
+        nodes[index].right = -1;
+        return;
+    }
+
+    // Split at the median along the axis where centers are most spread out,
+    // which keeps the tree balanced
+    glm::vec3 extent = centerBox.max - centerBox.min;
+    int axis = 0;
+
+    if (extent.y > extent.x)
+        axis = 1;
+
+    if (extent.z > extent[axis])
+        axis = 2;
+
+    int half = count / 2;
+    const glm::vec3 *c = &centers[0];
+
+    std::nth_element(items.begin() + start, items.begin() + start + half,
+        items.begin() + start + count, [c, axis](int a, int b) {
+            return c[a][axis] < c[b][axis];
+        });
+
+    nodes[index].start = start;
+    nodes[index].count = 0;
+
+    buildNode(start, half);
+    nodes[index].right = (int)nodes.size();
+    buildNode(start + half, count - half);
+}
+
+bool Broadphase::refit(const AABB *boxes, size_t count, const unsigned *groups,
+    const unsigned *masks)
+{
+    if (count != this->boxes.size())
+        return false;
+
+    // Bodies which became empty, bounded or unbounded belong elsewhere in
+    // the tree
+    for (size_t i = 0; i < count; i++) {
+        const AABB & box = boxes[i];
+        const AABB & old = this->boxes[i];
+
+        if (box.isEmpty() != old.isEmpty() || box.isInfinite() != old.isInfinite())
+            return false;
+    }
+
+    this->boxes.assign(boxes, boxes + count);
+
+    if (groups)
+        this->groups.assign(groups, groups + count);
+
+    if (masks)
+        this->masks.assign(masks, masks + count);
+
+    // Children follow their parents, so walking backwards visits them first
+    for (int index = (int)nodes.size() - 1; index >= 0; index--) {
+        Node & node = nodes[index];
+
+        if (node.count > 0) {
+            node.box = AABB::empty();
+            node.groups = 0;
+            node.masks = 0;
+
+            for (int i = node.start; i < node.start + node.count; i++) {
+                node.box.merge(this->boxes[items[i]]);
+                node.groups |= this->groups[items[i]];
+                node.masks |= this->masks[items[i]];
+            }
+        }
+        else {
+            const Node & left = nodes[index + 1];
+            const Node & right = nodes[node.right];
+
+            node.box = left.box;
+            node.box.merge(right.box);
+            node.groups = left.groups | right.groups;
+            node.masks = left.masks | right.masks;
+        }
+    }
+
+    return true;
+}
+
+void Broadphase::setPairFilter(PairFilter filter, void *ctx) {
+    this->filter = filter;
+    this->filterCtx = ctx;
+}
+
+inline void Broadphase::addPair(int i1, int i2, std::vector<Collision::Pair> & pairs) const {
+    if (filter && !filter(filterCtx, i1, i2))
+        return;
+
+    Collision::Pair pair;
+    pair.i1 = i1 < i2 ? i1 : i2;
+    pair.i2 = i1 < i2 ? i2 : i1;
+    pairs.push_back(pair);
+}
+
+void Broadphase::findPairs(std::vector<Collision::Pair> & pairs) const {
+    // Unbounded bodies overlap everything
+    for (size_t i = 0; i < unbounded.size(); i++) {
+        for (size_t j = i + 1; j < unbounded.size(); j++)
+            if (interacts(unbounded[i], unbounded[j]))
+                addPair(unbounded[i], unbounded[j], pairs);
+
+        for (int item : items)
+            if (interacts(unbounded[i], item))
+                addPair(unbounded[i], item, pairs);
+    }
+
+    if (!nodes.empty())
+        findPairsNode(0, pairs);
+}
+
+void Broadphase::findPairsNode(int index, std::vector<Collision::Pair> & pairs) const {
+    const Node & node = nodes[index];
+
+    // Nothing below this node can interact with anything else below it
+    if (!(node.groups & node.masks))
+        return;
+
+    if (node.count > 0) {
+        for (int i = node.start; i < node.start + node.count; i++)
+            for (int j = i + 1; j < node.start + node.count; j++)
+                if (interacts(items[i], items[j]) && boxes[items[i]].overlaps(boxes[items[j]]))
+                    addPair(items[i], items[j], pairs);
+
+        return;
+    }
+
+    findPairsNode(index + 1, pairs);
+    findPairsNode(node.right, pairs);
+    findPairsNodes(index + 1, node.right, pairs);
+}
+
+void Broadphase::findPairsNodes(int a, int b, std::vector<Collision::Pair> & pairs) const {
+    const Node & nodeA = nodes[a];
+    const Node & nodeB = nodes[b];
+
+    if (!(nodeA.groups & nodeB.masks) || !(nodeB.groups & nodeA.masks))
+        return;
+
+    if (!nodeA.box.overlaps(nodeB.box))
+        return;
+
+    if (nodeA.count > 0 && nodeB.count > 0) {
+        for (int i = nodeA.start; i < nodeA.start + nodeA.count; i++)
+            for (int j = nodeB.start; j < nodeB.start + nodeB.count; j++)
+                if (interacts(items[i], items[j]) && boxes[items[i]].overlaps(boxes[items[j]]))
+                    addPair(items[i], items[j], pairs);
+    }
+    else if (nodeA.count == 0) {
+        findPairsNodes(a + 1, b, pairs);
+        findPairsNodes(nodeA.right, b, pairs);
+    }
+    else {
+        findPairsNodes(a, b + 1, pairs);
+        findPairsNodes(a, nodeB.right, pairs);
+    }
+}
+
+}
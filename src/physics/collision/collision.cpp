@@ -9,204 +9,906 @@
 #include <physics/collision/planeshape.h>
 #include <physics/collision/cubeshape.h>
 #include <iostream>
+#include <algorithm>
+#include <limits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 namespace Physics {
 namespace Collision {
 
-// TODO collision function
-typedef bool (*collisionFunc)(const Shape &, const Shape &, const Transform &,
-    const Transform &, Contact &);
+static_assert(Shape::Count == 3, "Update ShapeClass and dispatch tables for new shape types");
+
+/**
+ * @brief Maps a shape type to the class implementing it, so that collision
+ * functions can be selected and inlined at compile time.
+ */
+template<Shape::ShapeType T> struct ShapeClass;
+template<> struct ShapeClass<Shape::Sphere> { typedef SphereShape type; };
+template<> struct ShapeClass<Shape::Plane>  { typedef PlaneShape  type; };
+template<> struct ShapeClass<Shape::Cube>   { typedef CubeShape   type; };
+
+/**
+ * @brief Collision function for a pair of shape types. The general case checks
+ * the reversed pair and flips the normals, so each pair of types only needs to
+ * be implemented once, as a specialization below.
+ */
+template<Shape::ShapeType T1, Shape::ShapeType T2>
+struct Kernel {
+    typedef typename ShapeClass<T1>::type S1;
+    typedef typename ShapeClass<T2>::type S2;
+
+    static inline bool check(const S1 & s1, const S2 & s2, const Transform & t1,
+        const Transform & t2, float margin, Manifold & manifold)
+    {
+        if (Kernel<T2, T1>::check(s2, s1, t2, t1, margin, manifold)) {
+            for (int i = 0; i < manifold.count; i++)
+                manifold.contacts[i].normal = -manifold.contacts[i].normal;
+
+            return true;
+        }
+
+        return false;
+    }
+};
+
+template<>
+struct Kernel<Shape::Sphere, Shape::Sphere> {
+    static inline bool check(const SphereShape & sphere1, const SphereShape & sphere2,
+        const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+    {
+        glm::vec3 diff = t2.position - t1.position;
+        float r1 = sphere1.getRadius();
+        float r2 = sphere2.getRadius();
+
+        float dist2 = glm::dot(diff, diff);
+        float reach = r1 + r2 + margin;
+
+        if (dist2 < reach * reach) {
+            float dist = sqrtf(dist2);
+            glm::vec3 norm = dist > 0.0f ? diff / dist : glm::vec3(0, 1, 0);
+
+            Contact & contact = manifold.contacts[0];
+            contact.normal = norm;
+            contact.depth = r1 + r2 - dist;
+            contact.position = t1.position + norm * r1;
+            manifold.count = 1;
+
+            return true;
+        }
 
-// TODO
-static collisionFunc dispatchTable[Shape::Count][Shape::Count];
-static bool initialized = false;
+        return false;
+    }
+};
+
+template<>
+struct Kernel<Shape::Sphere, Shape::Plane> {
+    static inline bool check(const SphereShape & sphere, const PlaneShape & plane,
+        const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+    {
+        glm::vec3 p1 = t1.position;
+        glm::vec3 norm = plane.getNormal();
+        float planeDist = plane.getDistance();
+        float sphereR = sphere.getRadius();
+
+        float dist = glm::dot(p1, norm) - planeDist;
+
+        if (dist < sphereR + margin) {
+            Contact & contact = manifold.contacts[0];
+            contact.normal = -norm;
+            contact.depth = sphereR - dist;
+            contact.position = p1 + contact.normal * (sphereR - contact.depth);
+            manifold.count = 1;
+
+            return true;
+        }
 
-// TODO header
-bool checkCollisionSphereSphere(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+        return false;
+    }
+};
+
+template<>
+struct Kernel<Shape::Sphere, Shape::Cube> {
+    static inline bool check(const SphereShape & sphere, const CubeShape & cube,
+        const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+    {
+        return false;
+    }
+};
+
+template<>
+struct Kernel<Shape::Plane, Shape::Plane> {
+    static inline bool check(const PlaneShape & plane1, const PlaneShape & plane2,
+        const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+    {
+        return false;
+    }
+};
+
+static inline glm::vec3 getHalfExtents(const CubeShape & cube) {
+    return glm::vec3(cube.getWidth(), cube.getHeight(), cube.getDepth()) * 0.5f;
+}
+
+/**
+ * @brief Reduce a set of contact points with a shared normal to at most
+ * MAX_MANIFOLD_CONTACTS. Keeps the deepest point, the point furthest from it,
+ * and the points on either side of the line between them which span the
+ * largest triangles, so that the kept points cover the contact area.
+ */
+static void reduceManifold(const glm::vec3 *points, const float *depths, int count,
+    const glm::vec3 & normal, Manifold & manifold)
 {
-    const SphereShape & sphere1 = static_cast<const SphereShape &>(s1);
-    const SphereShape & sphere2 = static_cast<const SphereShape &>(s2);
+    int keep[MAX_MANIFOLD_CONTACTS];
+    int kept = 0;
 
-    glm::vec3 diff = t2.position - t1.position;
-    float r1 = sphere1.getRadius();
-    float r2 = sphere2.getRadius();
+    if (count <= MAX_MANIFOLD_CONTACTS) {
+        for (int i = 0; i < count; i++)
+            keep[kept++] = i;
+    }
+    else {
+        int deepest = 0;
 
-    float dist = glm::length(diff); // TODO could use dist squared maybe
+        for (int i = 1; i < count; i++)
+            if (depths[i] > depths[deepest])
+                deepest = i;
 
-    if (dist < r1 + r2) {
-        glm::vec3 norm = diff / dist;
+        int furthest = deepest == 0 ? 1 : 0;
+        float furthestDist = -1.0f;
 
-        contact.normal = norm;
-        contact.depth = r1 + r2 - dist;
-        contact.position = t1.position + norm * r1;
+        for (int i = 0; i < count; i++) {
+            glm::vec3 d = points[i] - points[deepest];
+            float dist = glm::dot(d, d);
 
-        return true;
+            if (i != deepest && dist > furthestDist) {
+                furthest = i;
+                furthestDist = dist;
+            }
+        }
+
+        int left = -1;
+        int right = -1;
+        float maxArea = 0.0f;
+        float minArea = 0.0f;
+
+        for (int i = 0; i < count; i++) {
+            float area = glm::dot(glm::cross(points[furthest] - points[deepest],
+                points[i] - points[deepest]), normal);
+
+            if (area > maxArea) {
+                left = i;
+                maxArea = area;
+            }
+            else if (area < minArea) {
+                right = i;
+                minArea = area;
+            }
+        }
+
+        keep[kept++] = deepest;
+        keep[kept++] = furthest;
+
+        if (left >= 0)
+            keep[kept++] = left;
+
+        if (right >= 0)
+            keep[kept++] = right;
     }
 
-    return false;
+    for (int i = 0; i < kept; i++) {
+        Contact & contact = manifold.contacts[i];
+        contact.position = points[keep[i]];
+        contact.normal = normal;
+        contact.depth = depths[keep[i]];
+    }
+
+    manifold.count = kept;
 }
 
-bool checkCollisionSpherePlane(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+template<>
+struct Kernel<Shape::Cube, Shape::Plane> {
+    static inline bool check(const CubeShape & cube, const PlaneShape & plane,
+        const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+    {
+        float planeDist = plane.getDistance();
+        glm::vec3 norm = plane.getNormal();
+
+        glm::vec3 delta = getHalfExtents(cube);
+
+        glm::vec3 points[8];
+        float depths[8];
+        int count = 0;
+
+        // Every corner below the plane, or within the margin of it, is a
+        // contact point. A resting face gives four.
+        for (int i = 0; i < 8; i++) {
+            glm::vec3 point = glm::vec3(
+                i & 1 ? delta.x : -delta.x,
+                i & 2 ? delta.y : -delta.y,
+                i & 4 ? delta.z : -delta.z);
+
+            t1.transform(point);
+
+            float depth = planeDist - glm::dot(point, norm);
+
+            if (depth > -margin) {
+                points[count] = point;
+                depths[count] = depth;
+                count++;
+            }
+        }
+
+        if (count == 0)
+            return false;
+
+        reduceManifold(points, depths, count, -norm, manifold);
+
+        return true;
+    }
+};
+
+/**
+ * @brief Clip a convex polygon against the plane dot(p, n) <= d. Returns the
+ * number of output vertices, which is at most one more than the input.
+ */
+static int clipPolygon(const glm::vec3 *in, int count, const glm::vec3 & n, float d,
+    glm::vec3 *out)
 {
-    const SphereShape & sphere = static_cast<const SphereShape &>(s1);
-    const PlaneShape & plane = static_cast<const PlaneShape &>(s2);
+    int result = 0;
 
-    glm::vec3 p1 = t1.position;
-    glm::vec3 norm = plane.getNormal();
-    float planeDist = plane.getDistance();
-    float sphereR = sphere.getRadius();
+    for (int i = 0; i < count; i++) {
+        const glm::vec3 & a = in[i];
+        const glm::vec3 & b = in[(i + 1) % count];
 
-    float dist = glm::dot(p1, norm) - planeDist;
+        float da = glm::dot(a, n) - d;
+        float db = glm::dot(b, n) - d;
 
-    if (dist < sphereR) {
-        contact.normal = -norm;
-        contact.depth = sphereR - dist;
-        contact.position = p1 + contact.normal * (sphereR - contact.depth);
+        if (da <= 0.0f)
+            out[result++] = a;
 
-        return true;
+        if ((da < 0.0f && db > 0.0f) || (da > 0.0f && db < 0.0f))
+            out[result++] = a + (b - a) * (da / (da - db));
     }
 
-    return false;
+    return result;
 }
 
-bool checkCollisionPlaneSphere(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
-{
-    if (checkCollisionSpherePlane(s2, s1, t2, t1, contact)) {
-        contact.normal = -contact.normal; // TODO
+template<>
+struct Kernel<Shape::Cube, Shape::Cube> {
+    static inline bool check(const CubeShape & cube1, const CubeShape & cube2,
+        const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+    {
+        // Face axes are preferred over edge axes, and the first cube's faces
+        // over the second's, unless the other axis separates the cubes by at
+        // least this much more. Keeps the manifold from flipping between
+        // nearly equal axes from one step to the next.
+        const float tolerance = 0.005f;
+
+        glm::vec3 h1 = getHalfExtents(cube1);
+        glm::vec3 h2 = getHalfExtents(cube2);
+        glm::mat3 a1 = glm::mat3_cast(t1.orientation);
+        glm::mat3 a2 = glm::mat3_cast(t2.orientation);
+        glm::vec3 d = t2.position - t1.position;
+
+        // Separating axis test. Separation is negative while overlapping.
+        float faceSeparation = -std::numeric_limits<float>::infinity();
+        glm::vec3 faceAxis;
+        int face = 0;
+
+        for (int i = 0; i < 6; i++) {
+            glm::vec3 axis = i < 3 ? a1[i] : a2[i - 3];
+
+            float radius =
+                h1.x * fabsf(glm::dot(a1[0], axis)) +
+                h1.y * fabsf(glm::dot(a1[1], axis)) +
+                h1.z * fabsf(glm::dot(a1[2], axis)) +
+                h2.x * fabsf(glm::dot(a2[0], axis)) +
+                h2.y * fabsf(glm::dot(a2[1], axis)) +
+                h2.z * fabsf(glm::dot(a2[2], axis));
+
+            float separation = fabsf(glm::dot(d, axis)) - radius;
+
+            if (separation > margin)
+                return false;
+
+            if (separation > faceSeparation + (i >= 3 && face < 3 ? tolerance : 0.0f)) {
+                faceSeparation = separation;
+                faceAxis = axis;
+                face = i;
+            }
+        }
+
+        float edgeSeparation = -std::numeric_limits<float>::infinity();
+        glm::vec3 edgeAxis;
+        int edge1 = 0;
+        int edge2 = 0;
+
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                glm::vec3 axis = glm::cross(a1[i], a2[j]);
+                float length = glm::length(axis);
+
+                // Parallel edges are covered by the face axes
+                if (length < 1e-4f)
+                    continue;
+
+                axis /= length;
+
+                float radius =
+                    h1.x * fabsf(glm::dot(a1[0], axis)) +
+                    h1.y * fabsf(glm::dot(a1[1], axis)) +
+                    h1.z * fabsf(glm::dot(a1[2], axis)) +
+                    h2.x * fabsf(glm::dot(a2[0], axis)) +
+                    h2.y * fabsf(glm::dot(a2[1], axis)) +
+                    h2.z * fabsf(glm::dot(a2[2], axis));
+
+                float separation = fabsf(glm::dot(d, axis)) - radius;
+
+                if (separation > margin)
+                    return false;
+
+                if (separation > edgeSeparation) {
+                    edgeSeparation = separation;
+                    edgeAxis = axis;
+                    edge1 = i;
+                    edge2 = j;
+                }
+            }
+        }
+
+        if (edgeSeparation > faceSeparation + tolerance) {
+            // Edge/edge contact. The single point is halfway between the
+            // closest points of the two supporting edges.
+            glm::vec3 n = glm::dot(d, edgeAxis) < 0.0f ? -edgeAxis : edgeAxis;
+
+            glm::vec3 p1 = t1.position;
+            glm::vec3 p2 = t2.position;
+
+            for (int k = 0; k < 3; k++) {
+                if (k != edge1)
+                    p1 += a1[k] * (glm::dot(a1[k], n) > 0.0f ? h1[k] : -h1[k]);
+
+                if (k != edge2)
+                    p2 += a2[k] * (glm::dot(a2[k], n) > 0.0f ? -h2[k] : h2[k]);
+            }
+
+            glm::vec3 e1 = a1[edge1];
+            glm::vec3 e2 = a2[edge2];
+            glm::vec3 w = p1 - p2;
+
+            float b = glm::dot(e1, e2);
+            float denom = 1.0f - b * b;
+            float s = 0.0f;
+
+            if (denom > 1e-6f)
+                s = (b * glm::dot(e2, w) - glm::dot(e1, w)) / denom;
+
+            s = glm::clamp(s, -h1[edge1], h1[edge1]);
+
+            float t = glm::clamp(glm::dot(e2, w) + s * b, -h2[edge2], h2[edge2]);
+
+            Contact & contact = manifold.contacts[0];
+            contact.position = ((p1 + e1 * s) + (p2 + e2 * t)) * 0.5f;
+            contact.normal = n;
+            contact.depth = -edgeSeparation;
+            manifold.count = 1;
+
+            return true;
+        }
+
+        // Face contact. Clip the face of the other cube which faces the
+        // reference face most directly against the reference face's sides.
+        bool flip = face >= 3;
+        int axis = flip ? face - 3 : face;
+
+        const Transform & refTransform = flip ? t2 : t1;
+        const glm::mat3 & refAxes = flip ? a2 : a1;
+        const glm::mat3 & incAxes = flip ? a1 : a2;
+        glm::vec3 refHalf = flip ? h2 : h1;
+        glm::vec3 incHalf = flip ? h1 : h2;
+        glm::vec3 incPosition = flip ? t1.position : t2.position;
+
+        // Reference face normal, pointing towards the incident cube
+        glm::vec3 refNormal = glm::dot(faceAxis, incPosition - refTransform.position) < 0.0f ?
+            -faceAxis : faceAxis;
+
+        int incident = 0;
+        float minDot = std::numeric_limits<float>::infinity();
+
+        for (int k = 0; k < 3; k++) {
+            float dot = glm::dot(incAxes[k], refNormal);
+
+            if (-fabsf(dot) < minDot) {
+                minDot = -fabsf(dot);
+                incident = k;
+            }
+        }
+
+        glm::vec3 incNormal = incAxes[incident];
+
+        if (glm::dot(incNormal, refNormal) > 0.0f)
+            incNormal = -incNormal;
+
+        glm::vec3 incCenter = incPosition + incNormal * incHalf[incident];
+        glm::vec3 u = incAxes[(incident + 1) % 3] * incHalf[(incident + 1) % 3];
+        glm::vec3 v = incAxes[(incident + 2) % 3] * incHalf[(incident + 2) % 3];
+
+        glm::vec3 polygon[8];
+        glm::vec3 clipped[8];
+        int count = 4;
+
+        polygon[0] = incCenter + u + v;
+        polygon[1] = incCenter - u + v;
+        polygon[2] = incCenter - u - v;
+        polygon[3] = incCenter + u - v;
+
+        for (int k = 1; k < 3 && count > 0; k++) {
+            int side = (axis + k) % 3;
+            glm::vec3 sideAxis = refAxes[side];
+            float offset = glm::dot(refTransform.position, sideAxis);
+
+            count = clipPolygon(polygon, count, sideAxis, offset + refHalf[side], clipped);
+            count = clipPolygon(clipped, count, -sideAxis, -offset + refHalf[side], polygon);
+        }
+
+        // Points are placed halfway between the two surfaces
+        float refOffset = glm::dot(refTransform.position, refNormal) + refHalf[axis];
+        glm::vec3 points[8];
+        float depths[8];
+        int found = 0;
+
+        for (int k = 0; k < count; k++) {
+            float depth = refOffset - glm::dot(polygon[k], refNormal);
+
+            if (depth > -margin) {
+                points[found] = polygon[k] + refNormal * (depth * 0.5f);
+                depths[found] = depth;
+                found++;
+            }
+        }
+
+        if (found == 0)
+            return false;
+
+        reduceManifold(points, depths, found, flip ? -refNormal : refNormal, manifold);
+
         return true;
     }
+};
 
-    return false;
+/**
+ * @brief Check a single pair of shapes whose types are known at compile time
+ */
+template<Shape::ShapeType T1, Shape::ShapeType T2>
+static bool checkCollisionPair(const Shape & s1, const Shape & s2,
+    const Transform & t1, const Transform & t2, float margin, Manifold & manifold)
+{
+    typedef typename ShapeClass<T1>::type S1;
+    typedef typename ShapeClass<T2>::type S2;
+
+    return Kernel<T1, T2>::check(static_cast<const S1 &>(s1), static_cast<const S2 &>(s2),
+        t1, t2, margin, manifold);
 }
 
-bool checkCollisionSphereCube(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+/**
+ * @brief Check a bucket of pairs whose types are known at compile time. The
+ * collision function is inlined into this loop.
+ */
+template<Shape::ShapeType T1, Shape::ShapeType T2>
+static void checkCollisionBatch(const Pair *pairs, size_t count, const Shape * const *shapes,
+    const Transform * const *transforms, std::vector<PairContact> & contacts)
 {
-    return false;
+    typedef typename ShapeClass<T1>::type S1;
+    typedef typename ShapeClass<T2>::type S2;
+
+    Manifold manifold;
+    PairContact result;
+
+    for (size_t i = 0; i < count; i++) {
+        const Pair & pair = pairs[i];
+
+        if (Kernel<T1, T2>::check(
+            static_cast<const S1 &>(*shapes[pair.i1]),
+            static_cast<const S2 &>(*shapes[pair.i2]),
+            *transforms[pair.i1], *transforms[pair.i2], 0.0f, manifold))
+        {
+            result.i1 = pair.i1;
+            result.i2 = pair.i2;
+
+            for (int k = 0; k < manifold.count; k++) {
+                result.contact = manifold.contacts[k];
+                contacts.push_back(result);
+            }
+        }
+    }
 }
 
-bool checkCollisionPlanePlane(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
-{
-    return false;
+// Pairs are tested by the batched kernels in chunks of this size, so that
+// surviving pair indices fit in a fixed buffer on the stack
+#define BATCH_CHUNK 256
+
+#ifdef __AVX2__
+/**
+ * @brief For each 8-bit lane mask, the indices of the set lanes packed into
+ * 4-bit fields, lowest first. Used to left-pack surviving lanes.
+ */
+struct PackTable {
+    unsigned int lanes[256];
+
+    PackTable() {
+        for (int mask = 0; mask < 256; mask++) {
+            unsigned int packed = 0;
+            int n = 0;
+
+            for (int lane = 0; lane < 8; lane++)
+                if (mask & (1 << lane))
+                    packed |= lane << (4 * n++);
+
+            lanes[mask] = packed;
+        }
+    }
+};
+
+static const PackTable packTable;
+
+/**
+ * @brief Load the indices of 8 pairs as two vectors
+ */
+static inline void loadPairs8(const Pair *pairs, __m256i & i1, __m256i & i2) {
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+
+    __m256i lo = _mm256_loadu_si256((const __m256i *)pairs);
+    __m256i hi = _mm256_loadu_si256((const __m256i *)(pairs + 4));
+
+    lo = _mm256_permutevar8x32_epi32(lo, split);
+    hi = _mm256_permutevar8x32_epi32(hi, split);
+
+    i1 = _mm256_permute2x128_si256(lo, hi, 0x20);
+    i2 = _mm256_permute2x128_si256(lo, hi, 0x31);
 }
 
-bool checkCollisionCubeSphere(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
-{
-    return false;
+/**
+ * @brief Store the indices of the lanes set in mask contiguously at hits, and
+ * return the number stored. Always writes 8 entries.
+ */
+static inline int storeHits8(int *hits, int base, int mask) {
+    const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+
+    __m256i lanes = _mm256_srlv_epi32(_mm256_set1_epi32(packTable.lanes[mask]), shifts);
+    lanes = _mm256_and_si256(lanes, _mm256_set1_epi32(7));
+    lanes = _mm256_add_epi32(lanes, _mm256_set1_epi32(base));
+
+    _mm256_storeu_si256((__m256i *)hits, lanes);
+
+    return _mm_popcnt_u32(mask);
 }
+#endif
 
-bool checkCollisionCubePlane(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+/**
+ * @brief Find the pairs in a chunk of at most BATCH_CHUNK sphere/sphere pairs
+ * whose spheres overlap. Returns the number of overlapping pairs, whose offsets
+ * into the chunk are written to hits. hits must have room for BATCH_CHUNK + 8
+ * entries.
+ */
+static int findSphereSphereHits(const Pair *pairs, int count, const float *x,
+    const float *y, const float *z, const float *radius, int *hits)
 {
-    const CubeShape & cube = static_cast<const CubeShape &>(s1);
-    const PlaneShape & plane = static_cast<const PlaneShape &>(s2);
+    int n = 0;
+    int k = 0;
 
-    float planeDist = plane.getDistance();
-    glm::vec3 norm = plane.getNormal();
+#ifdef __AVX2__
+    for (; k + 8 <= count; k += 8) {
+        __m256i i1, i2;
+        loadPairs8(pairs + k, i1, i2);
 
-    glm::vec3 delta = glm::vec3(cube.getWidth(), cube.getHeight(), cube.getDepth()) / 2.0f;
+        __m256 dx = _mm256_sub_ps(_mm256_i32gather_ps(x, i2, 4), _mm256_i32gather_ps(x, i1, 4));
+        __m256 dy = _mm256_sub_ps(_mm256_i32gather_ps(y, i2, 4), _mm256_i32gather_ps(y, i1, 4));
+        __m256 dz = _mm256_sub_ps(_mm256_i32gather_ps(z, i2, 4), _mm256_i32gather_ps(z, i1, 4));
+        __m256 r = _mm256_add_ps(_mm256_i32gather_ps(radius, i1, 4),
+            _mm256_i32gather_ps(radius, i2, 4));
 
-    // TODO make this better
-    glm::vec3 points[8];
-    points[0] = glm::vec3(-delta.x, -delta.y, -delta.z);
-    points[1] = glm::vec3( delta.x, -delta.y, -delta.z);
-    points[2] = glm::vec3(-delta.x,  delta.y, -delta.z);
-    points[3] = glm::vec3( delta.x,  delta.y, -delta.z);
-    points[4] = glm::vec3(-delta.x, -delta.y,  delta.z);
-    points[5] = glm::vec3( delta.x, -delta.y,  delta.z);
-    points[6] = glm::vec3(-delta.x,  delta.y,  delta.z);
-    points[7] = glm::vec3( delta.x,  delta.y,  delta.z);
+        __m256 dist2 = _mm256_mul_ps(dx, dx);
+        dist2 = _mm256_add_ps(dist2, _mm256_mul_ps(dy, dy));
+        dist2 = _mm256_add_ps(dist2, _mm256_mul_ps(dz, dz));
 
-    // Transform points to world space
-    for (int i = 0; i < 8; i++)
-        t1.transform(points[i]);
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(dist2, _mm256_mul_ps(r, r), _CMP_LT_OQ));
 
-    float maxDepth = 0.0f;
-    glm::vec3 maxPoint;
-    bool found = false;
+        n += storeHits8(hits + n, k, mask);
+    }
+#endif
 
-    // Check each point. TODO: check if the max depth is the best. Might be able
-    // to merge with above loop to avoid some math.
-    for (int i = 0; i < 8; i++) {
-        float depth = -(glm::dot(points[i], norm) - planeDist); // TODO could move negative
+    // Remainder, or everything without AVX2. Writing unconditionally and
+    // advancing by the result keeps this loop branch free.
+    for (; k < count; k++) {
+        int i1 = pairs[k].i1;
+        int i2 = pairs[k].i2;
 
-        if (depth > 0.0f && depth > maxDepth) {
-            maxDepth = depth;
-            maxPoint = points[i];
-            found = true;
-        }
+        float dx = x[i2] - x[i1];
+        float dy = y[i2] - y[i1];
+        float dz = z[i2] - z[i1];
+        float r = radius[i1] + radius[i2];
+
+        hits[n] = k;
+        n += dx * dx + dy * dy + dz * dz < r * r;
     }
 
-    if (found) {
-        contact.position = maxPoint;
-        contact.depth = maxDepth;
-        contact.normal = -norm;
+    return n;
+}
 
-        return true;
+/**
+ * @brief Find the pairs in a chunk of sphere/plane pairs where the sphere
+ * crosses the plane. See findSphereSphereHits().
+ */
+static int findSpherePlaneHits(const Pair *pairs, int count, const float *x,
+    const float *y, const float *z, const float *radius, const float *nx,
+    const float *ny, const float *nz, const float *dist, int *hits)
+{
+    int n = 0;
+    int k = 0;
+
+#ifdef __AVX2__
+    for (; k + 8 <= count; k += 8) {
+        __m256i i1, i2;
+        loadPairs8(pairs + k, i1, i2);
+
+        __m256 d = _mm256_mul_ps(_mm256_i32gather_ps(x, i1, 4), _mm256_i32gather_ps(nx, i2, 4));
+        d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_i32gather_ps(y, i1, 4),
+            _mm256_i32gather_ps(ny, i2, 4)));
+        d = _mm256_add_ps(d, _mm256_mul_ps(_mm256_i32gather_ps(z, i1, 4),
+            _mm256_i32gather_ps(nz, i2, 4)));
+        d = _mm256_sub_ps(d, _mm256_i32gather_ps(dist, i2, 4));
+
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(d, _mm256_i32gather_ps(radius, i1, 4),
+            _CMP_LT_OQ));
+
+        n += storeHits8(hits + n, k, mask);
+    }
+#endif
+
+    for (; k < count; k++) {
+        int i1 = pairs[k].i1;
+        int i2 = pairs[k].i2;
+
+        float d = x[i1] * nx[i2] + y[i1] * ny[i2] + z[i1] * nz[i2] - dist[i2];
+
+        hits[n] = k;
+        n += d < radius[i1];
     }
 
-    return false;
+    return n;
 }
 
-bool checkCollisionPlaneCube(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+void checkCollisionSphereSphereBatch(const Pair *pairs, size_t count,
+    const float *x, const float *y, const float *z, const float *radius,
+    std::vector<PairContact> & contacts)
 {
-    if (checkCollisionCubePlane(s2, s1, t2, t1, contact)) {
-        contact.normal = -contact.normal;
-        return true;
-    }
+    int hits[BATCH_CHUNK + 8];
+    PairContact result;
+
+    for (size_t start = 0; start < count; start += BATCH_CHUNK) {
+        const Pair *chunk = pairs + start;
+        int chunkSize = (int)std::min((size_t)BATCH_CHUNK, count - start);
+
+        int n = findSphereSphereHits(chunk, chunkSize, x, y, z, radius, hits);
+
+        for (int h = 0; h < n; h++) {
+            const Pair & pair = chunk[hits[h]];
 
-    return false;
+            glm::vec3 p1 = glm::vec3(x[pair.i1], y[pair.i1], z[pair.i1]);
+            glm::vec3 p2 = glm::vec3(x[pair.i2], y[pair.i2], z[pair.i2]);
+            float r1 = radius[pair.i1];
+            float r2 = radius[pair.i2];
+
+            glm::vec3 diff = p2 - p1;
+            float dist = glm::length(diff);
+            glm::vec3 norm = dist > 0.0f ? diff / dist : glm::vec3(0, 1, 0);
+
+            result.i1 = pair.i1;
+            result.i2 = pair.i2;
+            result.contact.normal = norm;
+            result.contact.depth = r1 + r2 - dist;
+            result.contact.position = p1 + norm * r1;
+
+            contacts.push_back(result);
+        }
+    }
 }
 
-bool checkCollisionCubeCube(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+void checkCollisionSpherePlaneBatch(const Pair *pairs, size_t count,
+    const float *x, const float *y, const float *z, const float *radius,
+    const float *nx, const float *ny, const float *nz, const float *dist,
+    std::vector<PairContact> & contacts)
 {
-    return false;
+    int hits[BATCH_CHUNK + 8];
+    PairContact result;
+
+    for (size_t start = 0; start < count; start += BATCH_CHUNK) {
+        const Pair *chunk = pairs + start;
+        int chunkSize = (int)std::min((size_t)BATCH_CHUNK, count - start);
+
+        int n = findSpherePlaneHits(chunk, chunkSize, x, y, z, radius, nx, ny, nz,
+            dist, hits);
+
+        for (int h = 0; h < n; h++) {
+            const Pair & pair = chunk[hits[h]];
+
+            glm::vec3 p1 = glm::vec3(x[pair.i1], y[pair.i1], z[pair.i1]);
+            glm::vec3 norm = glm::vec3(nx[pair.i2], ny[pair.i2], nz[pair.i2]);
+            float d = glm::dot(p1, norm) - dist[pair.i2];
+
+            result.i1 = pair.i1;
+            result.i2 = pair.i2;
+            result.contact.normal = -norm;
+            result.contact.depth = radius[pair.i1] - d;
+            result.contact.position = p1 - norm * d;
+
+            contacts.push_back(result);
+        }
+    }
 }
 
-bool checkCollisionUndefined(const Shape & s1, const Shape & s2,
-    const Transform & t1, const Transform & t2, Contact & contact)
+void SphereBatch::gather(const Shape * const *shapes, const Transform * const *transforms,
+    size_t count)
 {
-    assert(false && "Dispatch table missing an entry");
-	return false;
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    radius.resize(count);
+    nx.resize(count);
+    ny.resize(count);
+    nz.resize(count);
+    dist.resize(count);
+
+    for (size_t i = 0; i < count; i++) {
+        const Shape *shape = shapes[i];
+
+        if (shape == nullptr)
+            continue;
+
+        glm::vec3 position = transforms[i]->position;
+        x[i] = position.x;
+        y[i] = position.y;
+        z[i] = position.z;
+
+        switch (shape->getShapeType()) {
+        case Shape::Sphere:
+            radius[i] = static_cast<const SphereShape *>(shape)->getRadius();
+            break;
+        case Shape::Plane: {
+            const PlaneShape *plane = static_cast<const PlaneShape *>(shape);
+            glm::vec3 normal = plane->getNormal();
+            nx[i] = normal.x;
+            ny[i] = normal.y;
+            nz[i] = normal.z;
+            dist[i] = plane->getDistance();
+            break;
+        }
+        default:
+            break;
+        }
+    }
 }
 
-void initialize() {
-    if (initialized)
-        return;
+typedef bool (*collisionFunc)(const Shape &, const Shape &, const Transform &,
+    const Transform &, float, Manifold &);
+
+typedef void (*collisionBatchFunc)(const Pair *, size_t, const Shape * const *,
+    const Transform * const *, std::vector<PairContact> &);
+
+// Both tables are constant-initialized, so there is nothing to set up at
+// runtime. Batches only use the upper triangle, see PairBuckets. Sphere/sphere
+// and sphere/plane batches go through the SoA kernels instead.
+
+static const collisionFunc dispatchTable[Shape::Count][Shape::Count] = {
+    { checkCollisionPair<Shape::Sphere, Shape::Sphere>,
+      checkCollisionPair<Shape::Sphere, Shape::Plane>,
+      checkCollisionPair<Shape::Sphere, Shape::Cube> },
+    { checkCollisionPair<Shape::Plane,  Shape::Sphere>,
+      checkCollisionPair<Shape::Plane,  Shape::Plane>,
+      checkCollisionPair<Shape::Plane,  Shape::Cube> },
+    { checkCollisionPair<Shape::Cube,   Shape::Sphere>,
+      checkCollisionPair<Shape::Cube,   Shape::Plane>,
+      checkCollisionPair<Shape::Cube,   Shape::Cube> }
+};
+
+static const collisionBatchFunc batchTable[Shape::Count][Shape::Count] = {
+    { nullptr,
+      nullptr,
+      checkCollisionBatch<Shape::Sphere, Shape::Cube> },
+    { nullptr,
+      checkCollisionBatch<Shape::Plane,  Shape::Plane>,
+      checkCollisionBatch<Shape::Plane,  Shape::Cube> },
+    { nullptr,
+      nullptr,
+      checkCollisionBatch<Shape::Cube,   Shape::Cube> }
+};
+
+void PairBuckets::clear() {
+    for (int i = 0; i < Shape::Count; i++)
+        for (int j = i; j < Shape::Count; j++)
+            buckets[i][j].clear();
+}
 
-    initialized = true;
+size_t PairBuckets::size() const {
+    size_t count = 0;
 
-    // Make sure any missing functions will cause an error
     for (int i = 0; i < Shape::Count; i++)
-        for (int j = 0; j < Shape::Count; j++)
-            dispatchTable[i][j] = checkCollisionUndefined;
+        for (int j = i; j < Shape::Count; j++)
+            count += buckets[i][j].size();
 
-    // Set up dispatch table
-    dispatchTable[Shape::Sphere][Shape::Sphere] = checkCollisionSphereSphere;
-    dispatchTable[Shape::Sphere][Shape::Plane]  = checkCollisionSpherePlane;
-    dispatchTable[Shape::Sphere][Shape::Cube]   = checkCollisionSphereCube;
-    dispatchTable[Shape::Plane][Shape::Sphere]  = checkCollisionPlaneSphere;
-    dispatchTable[Shape::Plane][Shape::Plane]   = checkCollisionPlanePlane;
-    dispatchTable[Shape::Plane][Shape::Cube]    = checkCollisionPlaneCube;
-    dispatchTable[Shape::Cube][Shape::Sphere]   = checkCollisionCubeSphere;
-    dispatchTable[Shape::Cube][Shape::Plane]    = checkCollisionCubePlane;
-    dispatchTable[Shape::Cube][Shape::Cube]     = checkCollisionCubeCube;
+    return count;
+}
+
+void getBoundingBox(const Shape & shape, const Transform & t, AABB & box) {
+    switch (shape.getShapeType()) {
+    case Shape::Sphere: {
+        float r = static_cast<const SphereShape &>(shape).getRadius();
+        box.min = t.position - glm::vec3(r);
+        box.max = t.position + glm::vec3(r);
+        break;
+    }
+    case Shape::Cube: {
+        const CubeShape & cube = static_cast<const CubeShape &>(shape);
+        glm::vec3 half = glm::vec3(cube.getWidth(), cube.getHeight(), cube.getDepth()) * 0.5f;
+
+        // Project the rotated half extents onto each world axis
+        glm::mat3 rotation = glm::mat3_cast(t.orientation);
+        glm::vec3 extent =
+            glm::abs(rotation[0]) * half.x +
+            glm::abs(rotation[1]) * half.y +
+            glm::abs(rotation[2]) * half.z;
+
+        box.min = t.position - extent;
+        box.max = t.position + extent;
+        break;
+    }
+    default:
+        box = AABB::infinite();
+        break;
+    }
 }
 
 bool checkCollision(const Shape & s1, const Shape & s2, const Transform & t1,
-    const Transform & t2, Contact & contact)
+    const Transform & t2, Manifold & manifold, float margin)
 {
     Shape::ShapeType s1_type = s1.getShapeType();
     Shape::ShapeType s2_type = s2.getShapeType();
 
-    return dispatchTable[s1_type][s2_type](s1, s2, t1, t2, contact);
+    return dispatchTable[s1_type][s2_type](s1, s2, t1, t2, margin, manifold);
+}
+
+void checkCollisions(const PairBuckets & buckets, const Shape * const *shapes,
+    const Transform * const *transforms, size_t count, SphereBatch & batch,
+    std::vector<PairContact> & contacts)
+{
+    const std::vector<Pair> & sphereSphere = buckets.getBucket(Shape::Sphere, Shape::Sphere);
+    const std::vector<Pair> & spherePlane = buckets.getBucket(Shape::Sphere, Shape::Plane);
+
+    if (!sphereSphere.empty() || !spherePlane.empty()) {
+        batch.gather(shapes, transforms, count);
+
+        if (!sphereSphere.empty())
+            checkCollisionSphereSphereBatch(&sphereSphere[0], sphereSphere.size(),
+                &batch.x[0], &batch.y[0], &batch.z[0], &batch.radius[0], contacts);
+
+        if (!spherePlane.empty())
+            checkCollisionSpherePlaneBatch(&spherePlane[0], spherePlane.size(),
+                &batch.x[0], &batch.y[0], &batch.z[0], &batch.radius[0],
+                &batch.nx[0], &batch.ny[0], &batch.nz[0], &batch.dist[0], contacts);
+    }
+
+    for (int i = 0; i < Shape::Count; i++) {
+        for (int j = i; j < Shape::Count; j++) {
+            const std::vector<Pair> & bucket = buckets.getBucket((Shape::ShapeType)i,
+                (Shape::ShapeType)j);
+
+            if (bucket.empty() || batchTable[i][j] == nullptr)
+                continue;
+
+            batchTable[i][j](&bucket[0], bucket.size(), shapes, transforms, contacts);
+        }
+    }
 }
 
 }}
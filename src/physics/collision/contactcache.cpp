@@ -0,0 +1,149 @@
+/**
+ * @file contactcache.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/contactcache.h>
+
+namespace Physics {
+namespace Collision {
+
+ContactCache::ContactCache(float linearTolerance, float angularTolerance)
+    : stamp(0),
+      hits(0),
+      misses(0)
+{
+    setTolerance(linearTolerance, angularTolerance);
+}
+
+ContactCache::~ContactCache() {
+}
+
+uint64_t ContactCache::key(int i1, int i2) {
+    if (i1 > i2)
+        std::swap(i1, i2);
+
+    return ((uint64_t)(uint32_t)i1 << 32) | (uint32_t)i2;
+}
+
+void ContactCache::setTolerance(float linearTolerance, float angularTolerance) {
+    this->linearTolerance = linearTolerance;
+
+    // Compare orientations by quaternion dot product, which is cos(angle / 2)
+    this->minOrientationDot = cosf(angularTolerance * 0.5f);
+}
+
+void ContactCache::beginStep() {
+    stamp++;
+}
+
+void ContactCache::endStep() {
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (it->second.stamp != stamp)
+            it = entries.erase(it);
+        else
+            ++it;
+    }
+}
+
+void ContactCache::clear() {
+    entries.clear();
+}
+
+bool ContactCache::lookup(int i1, int i2, const Transform & t1, const Transform & t2,
+    std::vector<PairContact> & contacts)
+{
+    auto it = entries.find(key(i1, i2));
+
+    if (it == entries.end()) {
+        misses++;
+        return false;
+    }
+
+    Entry & entry = it->second;
+
+    // Entries keep the pair order the narrowphase used
+    const Transform & e1 = entry.i1 == i1 ? t1 : t2;
+    const Transform & e2 = entry.i1 == i1 ? t2 : t1;
+
+    glm::quat invOrientation = glm::conjugate(e1.orientation);
+    glm::vec3 relPosition = invOrientation * (e2.position - e1.position);
+    glm::quat relOrientation = invOrientation * e2.orientation;
+
+    glm::vec3 moved = relPosition - entry.relPosition;
+
+    if (glm::dot(moved, moved) > linearTolerance * linearTolerance ||
+        fabsf(glm::dot(relOrientation, entry.relOrientation)) < minOrientationDot)
+    {
+        misses++;
+        return false;
+    }
+
+    hits++;
+    entry.stamp = stamp;
+
+    // Project contacts to the current pose. Motion of the second body along
+    // the normal changes the depth.
+    PairContact result;
+    result.i1 = entry.i1;
+    result.i2 = entry.i2;
+
+    for (int i = 0; i < entry.count; i++) {
+        result.contact.position = e1.position + e1.orientation * entry.position[i];
+        result.contact.normal = e1.orientation * entry.normal[i];
+        result.contact.depth = entry.depth[i] - glm::dot(moved, entry.normal[i]);
+        contacts.push_back(result);
+    }
+
+    return true;
+}
+
+void ContactCache::store(int i1, int i2, const Transform & t1, const Transform & t2) {
+    Entry & entry = entries[key(i1, i2)];
+
+    glm::quat invOrientation = glm::conjugate(t1.orientation);
+
+    entry.i1 = i1;
+    entry.i2 = i2;
+    entry.relPosition = invOrientation * (t2.position - t1.position);
+    entry.relOrientation = invOrientation * t2.orientation;
+    entry.count = 0;
+    entry.stamp = stamp;
+}
+
+void ContactCache::addContact(const PairContact & contact, const Transform & t1) {
+    auto it = entries.find(key(contact.i1, contact.i2));
+
+    if (it == entries.end())
+        return;
+
+    Entry & entry = it->second;
+
+    if (entry.count == MAX_CACHED_CONTACTS) {
+        entries.erase(it);
+        return;
+    }
+
+    glm::quat invOrientation = glm::conjugate(t1.orientation);
+
+    entry.position[entry.count] = invOrientation * (contact.contact.position - t1.position);
+    entry.normal[entry.count] = invOrientation * contact.contact.normal;
+    entry.depth[entry.count] = contact.contact.depth;
+    entry.count++;
+}
+
+long long ContactCache::getHits() const {
+    return hits;
+}
+
+long long ContactCache::getMisses() const {
+    return misses;
+}
+
+void ContactCache::resetCounters() {
+    hits = 0;
+    misses = 0;
+}
+
+}}
@@ -0,0 +1,130 @@
+/**
+ * @file contactevents.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/contactevents.h>
+#include <algorithm>
+
+namespace Physics {
+namespace Collision {
+
+ContactTracker::ContactTracker(int endDelay)
+    : endDelay(endDelay)
+{
+}
+
+void ContactTracker::setEndDelay(int endDelay) {
+    this->endDelay = endDelay;
+}
+
+ContactTracker::~ContactTracker() {
+}
+
+void ContactTracker::beginStep() {
+    current.clear();
+}
+
+void ContactTracker::addContact(const PairContact & contact, float impulse) {
+    Touch touch;
+
+    // Narrowphase batches may order a pair either way. Keys and normals always
+    // use the lower index first.
+    if (contact.i1 < contact.i2) {
+        touch.key = ((uint64_t)contact.i1 << 32) | (uint32_t)contact.i2;
+        touch.normal = contact.contact.normal;
+    }
+    else {
+        touch.key = ((uint64_t)contact.i2 << 32) | (uint32_t)contact.i1;
+        touch.normal = -contact.contact.normal;
+    }
+
+    touch.position = contact.contact.position;
+    touch.depth = contact.contact.depth;
+    touch.impulse = impulse;
+    touch.missed = 0;
+
+    current.push_back(touch);
+}
+
+void ContactTracker::addEvent(PairEvent::Type type, const Touch & touch,
+    std::vector<PairEvent> & events)
+{
+    PairEvent event;
+    event.type = type;
+    event.i1 = (int)(touch.key >> 32);
+    event.i2 = (int)(uint32_t)touch.key;
+    event.position = touch.position;
+    event.normal = touch.normal;
+    event.impulse = type == PairEvent::End ? 0.0f : touch.impulse;
+    events.push_back(event);
+}
+
+void ContactTracker::endStep(std::vector<PairEvent> & events) {
+    std::sort(current.begin(), current.end(), [](const Touch & a, const Touch & b) {
+        return a.key < b.key;
+    });
+
+    // Merge contacts of the same pair, keeping the deepest point
+    size_t count = 0;
+
+    for (size_t i = 0; i < current.size(); i++) {
+        if (count > 0 && current[count - 1].key == current[i].key) {
+            Touch & merged = current[count - 1];
+
+            merged.impulse += current[i].impulse;
+
+            if (current[i].depth > merged.depth) {
+                merged.position = current[i].position;
+                merged.normal = current[i].normal;
+                merged.depth = current[i].depth;
+            }
+        }
+        else
+            current[count++] = current[i];
+    }
+
+    current.resize(count);
+
+    // Both lists are sorted, so walk them together. The list for the next
+    // step stays sorted because pairs are added in key order.
+    size_t i = 0;
+    size_t j = 0;
+
+    next.clear();
+
+    while (i < previous.size() || j < current.size()) {
+        if (j == current.size() || (i < previous.size() && previous[i].key < current[j].key)) {
+            Touch touch = previous[i++];
+
+            if (touch.missed < endDelay) {
+                touch.missed++;
+                touch.impulse = 0.0f;
+                addEvent(PairEvent::Persist, touch, events);
+                next.push_back(touch);
+            }
+            else
+                addEvent(PairEvent::End, touch, events);
+        }
+        else if (i == previous.size() || current[j].key < previous[i].key) {
+            addEvent(PairEvent::Begin, current[j], events);
+            next.push_back(current[j++]);
+        }
+        else {
+            addEvent(PairEvent::Persist, current[j], events);
+            next.push_back(current[j++]);
+            i++;
+        }
+    }
+
+    previous.swap(next);
+}
+
+void ContactTracker::clear() {
+    previous.clear();
+    current.clear();
+    next.clear();
+}
+
+}}
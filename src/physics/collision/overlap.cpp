@@ -0,0 +1,347 @@
+/**
+ * @file overlap.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/overlap.h>
+#include <physics/collision/sphereshape.h>
+#include <physics/collision/planeshape.h>
+#include <physics/collision/cubeshape.h>
+#include <limits>
+
+namespace Physics {
+namespace Collision {
+
+static inline glm::vec3 getHalfExtents(const CubeShape & cube) {
+    return glm::vec3(cube.getWidth(), cube.getHeight(), cube.getDepth()) * 0.5f;
+}
+
+/**
+ * @brief Closest point on a cube to a point, found by clamping in the cube's
+ * local space
+ */
+static inline glm::vec3 closestPointCube(const CubeShape & cube, const Transform & t,
+    const glm::vec3 & point)
+{
+    glm::vec3 half = getHalfExtents(cube);
+    glm::vec3 local = glm::conjugate(t.orientation) * (point - t.position);
+
+    local = glm::clamp(local, -half, half);
+
+    return t.position + t.orientation * local;
+}
+
+bool overlapSphere(const Shape & shape, const Transform & t, const glm::vec3 & center,
+    float radius)
+{
+    switch (shape.getShapeType()) {
+    case Shape::Sphere: {
+        float r = static_cast<const SphereShape &>(shape).getRadius() + radius;
+        glm::vec3 diff = center - t.position;
+        return glm::dot(diff, diff) <= r * r;
+    }
+    case Shape::Plane: {
+        const PlaneShape & plane = static_cast<const PlaneShape &>(shape);
+        return glm::dot(center, plane.getNormal()) - plane.getDistance() <= radius;
+    }
+    case Shape::Cube: {
+        glm::vec3 diff = center - closestPointCube(static_cast<const CubeShape &>(shape), t,
+            center);
+        return glm::dot(diff, diff) <= radius * radius;
+    }
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Separating axis test between an axis-aligned box and an oriented box
+ */
+static bool overlapBoxCube(const AABB & box, const CubeShape & cube, const Transform & t) {
+    glm::vec3 ea = (box.max - box.min) * 0.5f;
+    glm::vec3 eb = getHalfExtents(cube);
+    glm::vec3 d = t.position - box.getCenter();
+
+    // Columns of r are the cube's axes in world space, so r[j][i] is the
+    // component of cube axis j along world axis i
+    glm::mat3 r = glm::mat3_cast(t.orientation);
+    glm::mat3 ar;
+
+    // Small epsilon avoids false separation when edges are nearly parallel
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            ar[j][i] = fabsf(r[j][i]) + 1e-6f;
+
+    // World axes
+    for (int i = 0; i < 3; i++) {
+        float rb = eb.x * ar[0][i] + eb.y * ar[1][i] + eb.z * ar[2][i];
+
+        if (fabsf(d[i]) > ea[i] + rb)
+            return false;
+    }
+
+    // Cube axes
+    for (int j = 0; j < 3; j++) {
+        float ra = ea.x * ar[j][0] + ea.y * ar[j][1] + ea.z * ar[j][2];
+        float dist = d.x * r[j][0] + d.y * r[j][1] + d.z * r[j][2];
+
+        if (fabsf(dist) > ra + eb[j])
+            return false;
+    }
+
+    // Cross products of world axis i and cube axis j
+    for (int i = 0; i < 3; i++) {
+        int i1 = (i + 1) % 3;
+        int i2 = (i + 2) % 3;
+
+        for (int j = 0; j < 3; j++) {
+            int j1 = (j + 1) % 3;
+            int j2 = (j + 2) % 3;
+
+            float ra = ea[i1] * ar[j][i2] + ea[i2] * ar[j][i1];
+            float rb = eb[j1] * ar[j2][i] + eb[j2] * ar[j1][i];
+            float dist = d[i2] * r[j][i1] - d[i1] * r[j][i2];
+
+            if (fabsf(dist) > ra + rb)
+                return false;
+        }
+    }
+
+    return true;
+}
+
+bool overlapBox(const Shape & shape, const Transform & t, const AABB & box) {
+    switch (shape.getShapeType()) {
+    case Shape::Sphere: {
+        float r = static_cast<const SphereShape &>(shape).getRadius();
+        glm::vec3 diff = t.position - glm::clamp(t.position, box.min, box.max);
+        return glm::dot(diff, diff) <= r * r;
+    }
+    case Shape::Plane: {
+        const PlaneShape & plane = static_cast<const PlaneShape &>(shape);
+        glm::vec3 n = plane.getNormal();
+        glm::vec3 half = (box.max - box.min) * 0.5f;
+        float extent = glm::dot(half, glm::abs(n));
+        return glm::dot(box.getCenter(), n) - plane.getDistance() <= extent;
+    }
+    case Shape::Cube:
+        return overlapBoxCube(box, static_cast<const CubeShape &>(shape), t);
+    default:
+        return false;
+    }
+}
+
+float closestPoint(const Shape & shape, const Transform & t, const glm::vec3 & point,
+    glm::vec3 & closest)
+{
+    switch (shape.getShapeType()) {
+    case Shape::Sphere: {
+        float r = static_cast<const SphereShape &>(shape).getRadius();
+        glm::vec3 diff = point - t.position;
+        float dist = glm::length(diff);
+
+        if (dist <= r) {
+            closest = point;
+            return 0.0f;
+        }
+
+        closest = t.position + diff * (r / dist);
+        return dist - r;
+    }
+    case Shape::Plane: {
+        const PlaneShape & plane = static_cast<const PlaneShape &>(shape);
+        glm::vec3 n = plane.getNormal();
+        float dist = glm::dot(point, n) - plane.getDistance();
+
+        if (dist <= 0.0f) {
+            closest = point;
+            return 0.0f;
+        }
+
+        closest = point - n * dist;
+        return dist;
+    }
+    case Shape::Cube:
+        closest = closestPointCube(static_cast<const CubeShape &>(shape), t, point);
+        return glm::length(point - closest);
+    default:
+        closest = point;
+        return std::numeric_limits<float>::infinity();
+    }
+}
+
+/**
+ * @brief Run a batch of broadphase queries, storing the indices of overlapping
+ * shapes in each query's slots
+ */
+template<typename Test>
+static void overlapBatch(const Broadphase & broadphase, size_t count, int maxResults,
+    int *results, int *counts, ThreadPool & pool, const Test & test)
+{
+    pool.parallelFor((int)count, 16, [&](int thread, int begin, int end) {
+        for (int q = begin; q < end; q++) {
+            int *slots = results + (size_t)q * maxResults;
+            int found = 0;
+
+            auto visitor = [&](int index) {
+                if (test(q, index)) {
+                    if (found < maxResults)
+                        slots[found] = index;
+
+                    found++;
+                }
+            };
+
+            AABB bounds;
+            test.getBounds(q, bounds);
+            broadphase.query(bounds, visitor);
+
+            counts[q] = found;
+        }
+    });
+}
+
+struct SphereTest {
+    const Shape * const     *shapes;
+    const Transform * const *transforms;
+    const glm::vec3         *centers;
+    const float             *radii;
+
+    void getBounds(int q, AABB & bounds) const {
+        bounds.min = centers[q] - glm::vec3(radii[q]);
+        bounds.max = centers[q] + glm::vec3(radii[q]);
+    }
+
+    bool operator()(int q, int index) const {
+        return overlapSphere(*shapes[index], *transforms[index], centers[q], radii[q]);
+    }
+};
+
+struct BoxTest {
+    const Shape * const     *shapes;
+    const Transform * const *transforms;
+    const AABB              *boxes;
+
+    void getBounds(int q, AABB & bounds) const {
+        bounds = boxes[q];
+    }
+
+    bool operator()(int q, int index) const {
+        return overlapBox(*shapes[index], *transforms[index], boxes[q]);
+    }
+};
+
+void overlapSpheres(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const glm::vec3 *centers, const float *radii,
+    size_t count, int maxResults, int *results, int *counts, ThreadPool & pool)
+{
+    SphereTest test = { shapes, transforms, centers, radii };
+    overlapBatch(broadphase, count, maxResults, results, counts, pool, test);
+}
+
+void overlapBoxes(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const AABB *boxes, size_t count, int maxResults,
+    int *results, int *counts, ThreadPool & pool)
+{
+    BoxTest test = { shapes, transforms, boxes };
+    overlapBatch(broadphase, count, maxResults, results, counts, pool, test);
+}
+
+static inline float distanceToBox(const AABB & box, const glm::vec3 & point) {
+    glm::vec3 d = glm::max(glm::max(box.min - point, point - box.max), glm::vec3(0.0f));
+    return glm::length(d);
+}
+
+/**
+ * @brief Insert a neighbor into a list sorted nearest first, holding at most k
+ * entries. When the list is full the furthest entry is replaced, so the caller
+ * must check the neighbor is nearer than it.
+ */
+static inline void insertNeighbor(PointHit *slots, int & found, int k, const PointHit & hit) {
+    int i = found < k ? found++ : k - 1;
+
+    while (i > 0 && slots[i - 1].distance > hit.distance) {
+        slots[i] = slots[i - 1];
+        i--;
+    }
+
+    slots[i] = hit;
+}
+
+void nearest(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const glm::vec3 *points, size_t count, int k,
+    float maxDistance, PointHit *results, int *counts, ThreadPool & pool)
+{
+    if (k <= 0)
+        return;
+
+    const std::vector<Broadphase::Node> & nodes = broadphase.getNodes();
+    const std::vector<int> & items = broadphase.getItems();
+
+    pool.parallelFor((int)count, 16, [&](int thread, int begin, int end) {
+        for (int q = begin; q < end; q++) {
+            PointHit *slots = results + (size_t)q * k;
+            glm::vec3 point = points[q];
+            int found = 0;
+
+            // Distance a shape must beat to be added
+            auto bound = [&]() {
+                return found < k ? maxDistance : slots[k - 1].distance;
+            };
+
+            auto visit = [&](int index) {
+                PointHit hit;
+                hit.index = index;
+                hit.distance = closestPoint(*shapes[index], *transforms[index], point, hit.point);
+
+                if (hit.distance <= bound())
+                    insertNeighbor(slots, found, k, hit);
+            };
+
+            for (int index : broadphase.getUnbounded())
+                visit(index);
+
+            if (!nodes.empty()) {
+                int stack[BROADPHASE_MAX_DEPTH];
+                int top = 0;
+
+                stack[top++] = 0;
+
+                while (top > 0) {
+                    int index = stack[--top];
+                    const Broadphase::Node & node = nodes[index];
+
+                    if (distanceToBox(node.box, point) > bound())
+                        continue;
+
+                    if (node.count > 0) {
+                        for (int i = node.start; i < node.start + node.count; i++)
+                            if (distanceToBox(broadphase.getBox(items[i]), point) <= bound())
+                                visit(items[i]);
+                    }
+                    else {
+                        int left = index + 1;
+                        int right = node.right;
+
+                        // Visit nearer child first, so the bound tightens sooner
+                        if (distanceToBox(nodes[left].box, point) <=
+                            distanceToBox(nodes[right].box, point))
+                        {
+                            stack[top++] = right;
+                            stack[top++] = left;
+                        }
+                        else {
+                            stack[top++] = left;
+                            stack[top++] = right;
+                        }
+                    }
+                }
+            }
+
+            counts[q] = found;
+        }
+    });
+}
+
+}}
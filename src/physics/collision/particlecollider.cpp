@@ -0,0 +1,94 @@
+/**
+ * @file particlecollider.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/particlecollider.h>
+#include <physics/collision/sphereshape.h>
+#include <physics/collision/planeshape.h>
+#include <physics/collision/cubeshape.h>
+#include <physics/dynamics/body.h>
+
+namespace Physics {
+
+bool ParticleCollider::set(Body *body) {
+    Shape *shape = body->getShape().get();
+
+    if (!shape)
+        return false;
+
+    this->body = body;
+    type = shape->getShapeType();
+    position = body->getPosition();
+    orientation = body->getOrientation();
+    linearVelocity = body->getLinearVelocity();
+    angularVelocity = body->getAngularVelocity();
+    distance = 0.0f;
+
+    switch (type) {
+    case Shape::Sphere:
+        size = glm::vec3(static_cast<SphereShape *>(shape)->getRadius());
+        return true;
+    case Shape::Plane:
+        size = static_cast<PlaneShape *>(shape)->getNormal();
+        distance = static_cast<PlaneShape *>(shape)->getDistance();
+        return true;
+    case Shape::Cube:
+    {
+        CubeShape *cube = static_cast<CubeShape *>(shape);
+        size = glm::vec3(cube->getWidth(), cube->getHeight(), cube->getDepth()) * 0.5f;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+ParticleColliders::ParticleColliders()
+    : numThreads(0)
+{
+}
+
+ParticleColliders::~ParticleColliders() {
+}
+
+void ParticleColliders::set(Body *const *bodies, int numBodies, int numThreads) {
+    this->numThreads = numThreads;
+    colliders.clear();
+
+    for (int k = 0; k < numBodies; k++) {
+        ParticleCollider collider;
+
+        if (collider.set(bodies[k]))
+            colliders.push_back(collider);
+    }
+
+    linearImpulses.assign(numThreads * colliders.size(), glm::vec3());
+    angularImpulses.assign(numThreads * colliders.size(), glm::vec3());
+}
+
+void ParticleColliders::apply() {
+    int numColliders = (int)colliders.size();
+
+    // Articulated links are moved by their articulation, and are treated as
+    // kinematic
+    for (int k = 0; k < numColliders; k++) {
+        Body *body = colliders[k].body;
+
+        if (body->getFixed() || body->getArticulated())
+            continue;
+
+        glm::vec3 linear, angular;
+
+        for (int t = 0; t < numThreads; t++) {
+            linear += linearImpulses[t * numColliders + k];
+            angular += angularImpulses[t * numColliders + k];
+        }
+
+        body->addLinearImpulse(linear);
+        body->addAngularImpulse(angular);
+    }
+}
+
+}
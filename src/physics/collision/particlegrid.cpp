@@ -0,0 +1,168 @@
+/**
+ * @file particlegrid.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/particlegrid.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+ParticleGrid::ParticleGrid()
+    : bounds(AABB::empty()),
+      size(1),
+      cellSize(1.0f),
+      invCellSize(1.0f)
+{
+}
+
+ParticleGrid::~ParticleGrid() {
+}
+
+void ParticleGrid::fit(ThreadPool & pool, const glm::vec3 *points, int count, float minCellSize,
+    int maxCells)
+{
+    int numThreads = pool.getThreadCount();
+
+    threadBounds.assign(numThreads, AABB::empty());
+
+    pool.parallelFor(count, grain, [&](int thread, int begin, int end) {
+        AABB box = threadBounds[thread];
+
+        for (int i = begin; i < end; i++)
+            box.merge(points[i]);
+
+        threadBounds[thread] = box;
+    });
+
+    bounds = AABB::empty();
+
+    for (int t = 0; t < numThreads; t++)
+        bounds.merge(threadBounds[t]);
+
+    if (count == 0)
+        bounds.min = bounds.max = glm::vec3();
+
+    glm::vec3 extent = bounds.max - bounds.min;
+
+    cellSize = minCellSize;
+
+    while (true) {
+        size = glm::ivec3(glm::floor(extent / cellSize)) + glm::ivec3(1);
+
+        double numCells = (double)size.x * size.y * size.z;
+
+        if (numCells <= maxCells)
+            break;
+
+        cellSize *= 1.01f * (float)cbrt(numCells / maxCells);
+    }
+
+    invCellSize = 1.0f / cellSize;
+}
+
+void ParticleGrid::fit(const glm::vec3 & origin, const glm::ivec3 & size, float cellSize) {
+    this->size = size;
+    this->cellSize = cellSize;
+    invCellSize = 1.0f / cellSize;
+
+    bounds.min = origin;
+    bounds.max = origin + glm::vec3(size) * cellSize;
+}
+
+void ParticleGrid::sort(ThreadPool & pool, const glm::vec3 *points, int count,
+    std::vector<int> & starts, std::vector<int> & order)
+{
+    int numCells = getNumCells();
+    int numThreads = pool.getThreadCount();
+
+    if (counts.size() < (size_t)numCells)
+        std::vector<std::atomic<int>>(numCells + numCells / 2).swap(counts);
+
+    keys.resize(count);
+    starts.resize(numCells + 1);
+    order.resize(count);
+
+    pool.parallelFor(count, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            keys[i] = getCellIndex(getCell(points[i]));
+    });
+
+    pool.parallelFor(numCells, 4 * grain, [&](int thread, int begin, int end) {
+        for (int c = begin; c < end; c++)
+            counts[c].store(0, std::memory_order_relaxed);
+    });
+
+    pool.parallelFor(count, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            counts[keys[i]].fetch_add(1, std::memory_order_relaxed);
+    });
+
+    // Prefix sum over blocks of cells. Each block is summed, then the block
+    // sums are scanned, then each block is scanned from its start. Counts
+    // become the next free slot of each cell.
+    int numBlocks = std::min(4 * numThreads, numCells);
+    int blockSize = (numCells + numBlocks - 1) / numBlocks;
+
+    blockSums.resize(numBlocks);
+
+    pool.parallelFor(numBlocks, 1, [&](int thread, int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            int sum = 0;
+
+            for (int c = b * blockSize; c < std::min((b + 1) * blockSize, numCells); c++)
+                sum += counts[c].load(std::memory_order_relaxed);
+
+            blockSums[b] = sum;
+        }
+    });
+
+    int total = 0;
+
+    for (int b = 0; b < numBlocks; b++) {
+        int sum = blockSums[b];
+        blockSums[b] = total;
+        total += sum;
+    }
+
+    pool.parallelFor(numBlocks, 1, [&](int thread, int begin, int end) {
+        for (int b = begin; b < end; b++) {
+            int start = blockSums[b];
+
+            for (int c = b * blockSize; c < std::min((b + 1) * blockSize, numCells); c++) {
+                int cellCount = counts[c].load(std::memory_order_relaxed);
+                starts[c] = start;
+                counts[c].store(start, std::memory_order_relaxed);
+                start += cellCount;
+            }
+        }
+    });
+
+    starts[numCells] = count;
+
+    pool.parallelFor(count, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            order[counts[keys[i]].fetch_add(1, std::memory_order_relaxed)] = i;
+    });
+
+    // Threads fill each cell in any order, so sort cells by index to keep the
+    // order deterministic. Each thread fills its part of a cell in order, so
+    // cells are often sorted already. Cells may hold hundreds of points, such
+    // as the blocks of a continuum, so others are sorted in n log n.
+    pool.parallelFor(numCells, 4 * grain, [&](int thread, int begin, int end) {
+        for (int c = begin; c < end; c++) {
+            std::vector<int>::iterator first = order.begin() + starts[c];
+            std::vector<int>::iterator last = order.begin() + starts[c + 1];
+
+            if (!std::is_sorted(first, last))
+                std::sort(first, last);
+        }
+    });
+}
+
+}
@@ -18,14 +18,6 @@ PlaneShape::PlaneShape(glm::vec3 normal, float dist)
 PlaneShape::~PlaneShape() {
 }
 
-glm::vec3 PlaneShape::getNormal() const {
-    return normal;
-}
-
-float PlaneShape::getDistance() const {
-    return dist;
-}
-
 /*void PlaneShape::getBoundingBox(Transform & t, glm::vec3 & min, glm::vec3 & max) {
     min = glm::vec3(-1.0 / 0.0, 0.0f, -1.0 / 0.0); // TODO
     min = glm::vec3( 1.0 / 0.0, 0.0f,  1.0 / 0.0);
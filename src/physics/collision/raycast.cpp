@@ -0,0 +1,592 @@
+/**
+ * @file raycast.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/collision/raycast.h>
+#include <physics/collision/sphereshape.h>
+#include <physics/collision/planeshape.h>
+#include <physics/collision/cubeshape.h>
+#include <algorithm>
+
+namespace Physics {
+namespace Collision {
+
+static inline void hitInside(const Ray & ray, RayHit & hit) {
+    hit.distance = 0.0f;
+    hit.point = ray.origin;
+    hit.normal = -ray.direction;
+}
+
+static inline bool raycastSphere(const SphereShape & sphere, const Transform & t,
+    const Ray & ray, float maxDistance, RayHit & hit)
+{
+    glm::vec3 oc = ray.origin - t.position;
+    float r = sphere.getRadius();
+    float b = glm::dot(oc, ray.direction);
+    float c = glm::dot(oc, oc) - r * r;
+
+    if (c <= 0.0f) {
+        hitInside(ray, hit);
+        return true;
+    }
+
+    float disc = b * b - c;
+
+    // Missed, or starts outside and points away
+    if (disc < 0.0f || b > 0.0f)
+        return false;
+
+    float dist = -b - sqrtf(disc);
+
+    if (dist > maxDistance)
+        return false;
+
+    hit.distance = dist;
+    hit.point = ray.origin + ray.direction * dist;
+    hit.normal = (hit.point - t.position) / r;
+
+    return true;
+}
+
+static inline bool raycastPlane(const PlaneShape & plane, const Ray & ray, float maxDistance,
+    RayHit & hit)
+{
+    glm::vec3 norm = plane.getNormal();
+    float dist = glm::dot(ray.origin, norm) - plane.getDistance();
+
+    // Everything behind the plane is solid
+    if (dist <= 0.0f) {
+        hitInside(ray, hit);
+        return true;
+    }
+
+    float denom = glm::dot(ray.direction, norm);
+
+    if (denom >= 0.0f)
+        return false;
+
+    float t = -dist / denom;
+
+    if (t > maxDistance)
+        return false;
+
+    hit.distance = t;
+    hit.point = ray.origin + ray.direction * t;
+    hit.normal = norm;
+
+    return true;
+}
+
+static inline bool raycastCube(const CubeShape & cube, const Transform & t, const Ray & ray,
+    float maxDistance, RayHit & hit)
+{
+    // Slab test in the cube's local space
+    glm::quat invOrientation = glm::conjugate(t.orientation);
+    glm::vec3 o = invOrientation * (ray.origin - t.position);
+    glm::vec3 d = invOrientation * ray.direction;
+    glm::vec3 half = glm::vec3(cube.getWidth(), cube.getHeight(), cube.getDepth()) * 0.5f;
+
+    float tmin = -std::numeric_limits<float>::infinity();
+    float tmax = maxDistance;
+    int axis = -1;
+    float sign = 0.0f;
+
+    for (int i = 0; i < 3; i++) {
+        if (fabsf(d[i]) < 1e-12f) {
+            if (o[i] < -half[i] || o[i] > half[i])
+                return false;
+
+            continue;
+        }
+
+        float inv = 1.0f / d[i];
+        float t1 = (-half[i] - o[i]) * inv;
+        float t2 = ( half[i] - o[i]) * inv;
+        float s = -1.0f;
+
+        if (t1 > t2) {
+            std::swap(t1, t2);
+            s = 1.0f;
+        }
+
+        if (t1 > tmin) {
+            tmin = t1;
+            axis = i;
+            sign = s;
+        }
+
+        if (t2 < tmax)
+            tmax = t2;
+
+        if (tmin > tmax)
+            return false;
+    }
+
+    if (tmax < 0.0f)
+        return false;
+
+    if (tmin <= 0.0f) {
+        hitInside(ray, hit);
+        return true;
+    }
+
+    glm::vec3 normal(0.0f);
+    normal[axis] = sign;
+
+    hit.distance = tmin;
+    hit.point = ray.origin + ray.direction * tmin;
+    hit.normal = t.orientation * normal;
+
+    return true;
+}
+
+bool raycast(const Shape & shape, const Transform & t, const Ray & ray, float maxDistance,
+    RayHit & hit)
+{
+    switch (shape.getShapeType()) {
+    case Shape::Sphere:
+        return raycastSphere(static_cast<const SphereShape &>(shape), t, ray, maxDistance, hit);
+    case Shape::Plane:
+        return raycastPlane(static_cast<const PlaneShape &>(shape), ray, maxDistance, hit);
+    case Shape::Cube:
+        return raycastCube(static_cast<const CubeShape &>(shape), t, ray, maxDistance, hit);
+    default:
+        return false;
+    }
+}
+
+static inline bool rayHitsBox(const AABB & box, const glm::vec3 & origin,
+    const glm::vec3 & invDirection, float maxDistance)
+{
+    glm::vec3 t1 = (box.min - origin) * invDirection;
+    glm::vec3 t2 = (box.max - origin) * invDirection;
+    glm::vec3 tnear = glm::min(t1, t2);
+    glm::vec3 tfar = glm::max(t1, t2);
+
+    float enter = std::max(std::max(tnear.x, tnear.y), std::max(tnear.z, 0.0f));
+    float exit = std::min(std::min(tfar.x, tfar.y), std::min(tfar.z, maxDistance));
+
+    return enter <= exit;
+}
+
+/**
+ * @brief Traverse the broadphase with one ray, calling visitor(int index,
+ * float & maxDistance) for each body whose box the ray reaches. The visitor may
+ * shorten maxDistance to prune the rest of the traversal.
+ */
+template<typename Visitor>
+static void traverseRay(const Broadphase & broadphase, const Ray & ray, float maxDistance,
+    Visitor & visitor)
+{
+    for (int index : broadphase.getUnbounded())
+        visitor(index, maxDistance);
+
+    const std::vector<Broadphase::Node> & nodes = broadphase.getNodes();
+    const std::vector<int> & items = broadphase.getItems();
+
+    if (nodes.empty())
+        return;
+
+    glm::vec3 invDirection = 1.0f / ray.direction;
+
+    int stack[BROADPHASE_MAX_DEPTH];
+    int top = 0;
+
+    stack[top++] = 0;
+
+    while (top > 0) {
+        int index = stack[--top];
+        const Broadphase::Node & node = nodes[index];
+
+        if (!rayHitsBox(node.box, ray.origin, invDirection, maxDistance))
+            continue;
+
+        if (node.count > 0) {
+            for (int i = node.start; i < node.start + node.count; i++)
+                if (rayHitsBox(broadphase.getBox(items[i]), ray.origin, invDirection, maxDistance))
+                    visitor(items[i], maxDistance);
+        }
+        else {
+            // Visit the nearer child first, so closest hit queries prune more
+            int left = index + 1;
+            int right = node.right;
+
+            glm::vec3 toRight = nodes[right].box.getCenter() - nodes[left].box.getCenter();
+
+            if (glm::dot(toRight, ray.direction) >= 0.0f) {
+                stack[top++] = right;
+                stack[top++] = left;
+            }
+            else {
+                stack[top++] = left;
+                stack[top++] = right;
+            }
+        }
+    }
+}
+
+static void raycastClosestSingle(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const Ray & ray, RayHit & hit)
+{
+    hit.index = -1;
+
+    RayHit test;
+
+    auto visitor = [&](int index, float & maxDistance) {
+        if (raycast(*shapes[index], *transforms[index], ray, maxDistance, test)) {
+            hit = test;
+            hit.index = index;
+            maxDistance = test.distance;
+        }
+    };
+
+    traverseRay(broadphase, ray, ray.maxDistance, visitor);
+}
+
+/**
+ * @brief Rays in structure-of-arrays layout. Unused lanes have a negative
+ * maximum distance, so they never hit anything.
+ */
+struct RayPacket {
+    float ox[RAY_PACKET_SIZE];   //!< Origin
+    float oy[RAY_PACKET_SIZE];
+    float oz[RAY_PACKET_SIZE];
+    float dx[RAY_PACKET_SIZE];   //!< Direction
+    float dy[RAY_PACKET_SIZE];
+    float dz[RAY_PACKET_SIZE];
+    float ix[RAY_PACKET_SIZE];   //!< Inverse direction
+    float iy[RAY_PACKET_SIZE];
+    float iz[RAY_PACKET_SIZE];
+    float tmax[RAY_PACKET_SIZE]; //!< Closest hit so far, or maximum distance
+    int   index[RAY_PACKET_SIZE]; //!< Closest shape so far
+};
+
+// The packet kernels below are written as fixed-width loops over lanes with no
+// branches, so that the compiler turns each loop into a few SIMD instructions.
+
+static inline bool packetHitsBox(const RayPacket & p, const AABB & box) {
+    int any = 0;
+
+    for (int l = 0; l < RAY_PACKET_SIZE; l++) {
+        float tx1 = (box.min.x - p.ox[l]) * p.ix[l];
+        float tx2 = (box.max.x - p.ox[l]) * p.ix[l];
+        float ty1 = (box.min.y - p.oy[l]) * p.iy[l];
+        float ty2 = (box.max.y - p.oy[l]) * p.iy[l];
+        float tz1 = (box.min.z - p.oz[l]) * p.iz[l];
+        float tz2 = (box.max.z - p.oz[l]) * p.iz[l];
+
+        float enter = tx1 < tx2 ? tx1 : tx2;
+        float exit = tx1 < tx2 ? tx2 : tx1;
+
+        float tyn = ty1 < ty2 ? ty1 : ty2;
+        float tyf = ty1 < ty2 ? ty2 : ty1;
+        float tzn = tz1 < tz2 ? tz1 : tz2;
+        float tzf = tz1 < tz2 ? tz2 : tz1;
+
+        enter = enter > tyn ? enter : tyn;
+        enter = enter > tzn ? enter : tzn;
+        enter = enter > 0.0f ? enter : 0.0f;
+        exit = exit < tyf ? exit : tyf;
+        exit = exit < tzf ? exit : tzf;
+        exit = exit < p.tmax[l] ? exit : p.tmax[l];
+
+        any |= enter <= exit;
+    }
+
+    return any != 0;
+}
+
+static inline void packetSphere(RayPacket & p, int item, const SphereShape & sphere,
+    const Transform & t)
+{
+    float r = sphere.getRadius();
+    float cx = t.position.x;
+    float cy = t.position.y;
+    float cz = t.position.z;
+
+    for (int l = 0; l < RAY_PACKET_SIZE; l++) {
+        float ocx = p.ox[l] - cx;
+        float ocy = p.oy[l] - cy;
+        float ocz = p.oz[l] - cz;
+
+        float b = ocx * p.dx[l] + ocy * p.dy[l] + ocz * p.dz[l];
+        float c = ocx * ocx + ocy * ocy + ocz * ocz - r * r;
+        float disc = b * b - c;
+
+        float dist = -b - sqrtf(disc > 0.0f ? disc : 0.0f);
+        bool inside = c <= 0.0f;
+        dist = inside ? 0.0f : dist;
+
+        bool hit = (inside || (disc >= 0.0f && b <= 0.0f)) && dist <= p.tmax[l];
+
+        p.tmax[l] = hit ? dist : p.tmax[l];
+        p.index[l] = hit ? item : p.index[l];
+    }
+}
+
+static inline void packetPlane(RayPacket & p, int item, const PlaneShape & plane) {
+    glm::vec3 n = plane.getNormal();
+    float pd = plane.getDistance();
+
+    for (int l = 0; l < RAY_PACKET_SIZE; l++) {
+        float dist = p.ox[l] * n.x + p.oy[l] * n.y + p.oz[l] * n.z - pd;
+        float denom = p.dx[l] * n.x + p.dy[l] * n.y + p.dz[l] * n.z;
+
+        bool inside = dist <= 0.0f;
+        float t = inside ? 0.0f : -dist / (denom < 0.0f ? denom : -1.0f);
+
+        bool hit = (inside || denom < 0.0f) && t <= p.tmax[l];
+
+        p.tmax[l] = hit ? t : p.tmax[l];
+        p.index[l] = hit ? item : p.index[l];
+    }
+}
+
+static inline void packetCube(RayPacket & p, int item, const CubeShape & cube,
+    const Transform & t)
+{
+    // Columns of the rotation are the cube axes, so local coordinates are dot
+    // products with the columns
+    glm::mat3 r = glm::mat3_cast(t.orientation);
+    glm::vec3 half = glm::vec3(cube.getWidth(), cube.getHeight(), cube.getDepth()) * 0.5f;
+    glm::vec3 c = t.position;
+
+    for (int l = 0; l < RAY_PACKET_SIZE; l++) {
+        float rx = p.ox[l] - c.x;
+        float ry = p.oy[l] - c.y;
+        float rz = p.oz[l] - c.z;
+
+        float ox = rx * r[0].x + ry * r[0].y + rz * r[0].z;
+        float oy = rx * r[1].x + ry * r[1].y + rz * r[1].z;
+        float oz = rx * r[2].x + ry * r[2].y + rz * r[2].z;
+
+        float ix = 1.0f / (p.dx[l] * r[0].x + p.dy[l] * r[0].y + p.dz[l] * r[0].z);
+        float iy = 1.0f / (p.dx[l] * r[1].x + p.dy[l] * r[1].y + p.dz[l] * r[1].z);
+        float iz = 1.0f / (p.dx[l] * r[2].x + p.dy[l] * r[2].y + p.dz[l] * r[2].z);
+
+        float tx1 = (-half.x - ox) * ix;
+        float tx2 = ( half.x - ox) * ix;
+        float ty1 = (-half.y - oy) * iy;
+        float ty2 = ( half.y - oy) * iy;
+        float tz1 = (-half.z - oz) * iz;
+        float tz2 = ( half.z - oz) * iz;
+
+        float enter = tx1 < tx2 ? tx1 : tx2;
+        float exit = tx1 < tx2 ? tx2 : tx1;
+
+        float tyn = ty1 < ty2 ? ty1 : ty2;
+        float tyf = ty1 < ty2 ? ty2 : ty1;
+        float tzn = tz1 < tz2 ? tz1 : tz2;
+        float tzf = tz1 < tz2 ? tz2 : tz1;
+
+        enter = enter > tyn ? enter : tyn;
+        enter = enter > tzn ? enter : tzn;
+        exit = exit < tyf ? exit : tyf;
+        exit = exit < tzf ? exit : tzf;
+
+        float dist = enter > 0.0f ? enter : 0.0f;
+        bool hit = enter <= exit && exit >= 0.0f && dist <= p.tmax[l];
+
+        p.tmax[l] = hit ? dist : p.tmax[l];
+        p.index[l] = hit ? item : p.index[l];
+    }
+}
+
+static inline void packetShape(RayPacket & p, int item, const Shape & shape,
+    const Transform & t)
+{
+    switch (shape.getShapeType()) {
+    case Shape::Sphere:
+        packetSphere(p, item, static_cast<const SphereShape &>(shape), t);
+        break;
+    case Shape::Plane:
+        packetPlane(p, item, static_cast<const PlaneShape &>(shape));
+        break;
+    case Shape::Cube:
+        packetCube(p, item, static_cast<const CubeShape &>(shape), t);
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * @brief Whether rays all point into the same octant, in which case they tend
+ * to visit the same nodes and are worth tracing as a packet
+ */
+static bool isCoherent(const Ray *rays, int count) {
+    glm::vec3 d0 = rays[0].direction;
+
+    for (int i = 1; i < count; i++) {
+        glm::vec3 d = rays[i].direction;
+
+        if (d.x * d0.x < 0.0f || d.y * d0.y < 0.0f || d.z * d0.z < 0.0f)
+            return false;
+    }
+
+    return true;
+}
+
+static void raycastClosestPacket(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const Ray *rays, int count, RayHit *hits)
+{
+    RayPacket p;
+
+    for (int l = 0; l < RAY_PACKET_SIZE; l++) {
+        const Ray & ray = rays[l < count ? l : 0];
+
+        p.ox[l] = ray.origin.x;
+        p.oy[l] = ray.origin.y;
+        p.oz[l] = ray.origin.z;
+        p.dx[l] = ray.direction.x;
+        p.dy[l] = ray.direction.y;
+        p.dz[l] = ray.direction.z;
+        p.ix[l] = 1.0f / ray.direction.x;
+        p.iy[l] = 1.0f / ray.direction.y;
+        p.iz[l] = 1.0f / ray.direction.z;
+        p.tmax[l] = l < count ? ray.maxDistance : -1.0f;
+        p.index[l] = -1;
+    }
+
+    for (int index : broadphase.getUnbounded())
+        packetShape(p, index, *shapes[index], *transforms[index]);
+
+    const std::vector<Broadphase::Node> & nodes = broadphase.getNodes();
+    const std::vector<int> & items = broadphase.getItems();
+
+    if (!nodes.empty()) {
+        glm::vec3 direction = rays[0].direction;
+
+        int stack[BROADPHASE_MAX_DEPTH];
+        int top = 0;
+
+        stack[top++] = 0;
+
+        while (top > 0) {
+            int index = stack[--top];
+            const Broadphase::Node & node = nodes[index];
+
+            if (!packetHitsBox(p, node.box))
+                continue;
+
+            if (node.count > 0) {
+                for (int i = node.start; i < node.start + node.count; i++)
+                    packetShape(p, items[i], *shapes[items[i]], *transforms[items[i]]);
+            }
+            else {
+                int left = index + 1;
+                int right = node.right;
+
+                glm::vec3 toRight = nodes[right].box.getCenter() - nodes[left].box.getCenter();
+
+                if (glm::dot(toRight, direction) >= 0.0f) {
+                    stack[top++] = right;
+                    stack[top++] = left;
+                }
+                else {
+                    stack[top++] = left;
+                    stack[top++] = right;
+                }
+            }
+        }
+    }
+
+    // Packet kernels only find distances. Fill in points and normals for the
+    // closest hits.
+    for (int l = 0; l < count; l++) {
+        RayHit & hit = hits[l];
+        hit.index = p.index[l];
+
+        if (hit.index < 0)
+            continue;
+
+        const Ray & ray = rays[l];
+
+        if (!raycast(*shapes[hit.index], *transforms[hit.index], ray, ray.maxDistance, hit)) {
+            // Grazing hit which the scalar test disagreed with
+            hit.distance = p.tmax[l];
+            hit.point = ray.origin + ray.direction * p.tmax[l];
+            hit.normal = -ray.direction;
+        }
+    }
+}
+
+void raycastClosest(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const Ray *rays, size_t count, RayHit *hits,
+    ThreadPool & pool)
+{
+    int numPackets = (int)((count + RAY_PACKET_SIZE - 1) / RAY_PACKET_SIZE);
+
+    pool.parallelFor(numPackets, 4, [&](int thread, int begin, int end) {
+        for (int packet = begin; packet < end; packet++) {
+            size_t start = (size_t)packet * RAY_PACKET_SIZE;
+            int n = (int)std::min((size_t)RAY_PACKET_SIZE, count - start);
+
+            if (n > 1 && isCoherent(rays + start, n))
+                raycastClosestPacket(broadphase, shapes, transforms, rays + start, n,
+                    hits + start);
+            else {
+                for (int i = 0; i < n; i++)
+                    raycastClosestSingle(broadphase, shapes, transforms, rays[start + i],
+                        hits[start + i]);
+            }
+        }
+    });
+}
+
+void raycastAll(const Broadphase & broadphase, const Shape * const *shapes,
+    const Transform * const *transforms, const Ray *rays, size_t count,
+    std::vector<RayHit> & hits, std::vector<size_t> & offsets, ThreadPool & pool)
+{
+    struct TaggedHit {
+        size_t ray;
+        RayHit hit;
+    };
+
+    std::vector<std::vector<TaggedHit>> threadHits(pool.getThreadCount());
+
+    offsets.assign(count + 1, 0);
+
+    pool.parallelFor((int)count, 32, [&](int thread, int begin, int end) {
+        std::vector<TaggedHit> & out = threadHits[thread];
+        TaggedHit tagged;
+
+        for (int i = begin; i < end; i++) {
+            const Ray & ray = rays[i];
+            tagged.ray = i;
+
+            auto visitor = [&](int index, float & maxDistance) {
+                if (raycast(*shapes[index], *transforms[index], ray, maxDistance, tagged.hit)) {
+                    tagged.hit.index = index;
+                    out.push_back(tagged);
+                    offsets[i + 1]++;
+                }
+            };
+
+            traverseRay(broadphase, ray, ray.maxDistance, visitor);
+        }
+    });
+
+    // Counts to offsets, then scatter each thread's hits into place
+    for (size_t i = 0; i < count; i++)
+        offsets[i + 1] += offsets[i];
+
+    hits.resize(offsets[count]);
+
+    std::vector<size_t> cursor(offsets.begin(), offsets.end() - 1);
+
+    for (auto & out : threadHits)
+        for (auto & tagged : out)
+            hits[cursor[tagged.ray]++] = tagged.hit;
+
+    for (size_t i = 0; i < count; i++) {
+        std::sort(hits.begin() + offsets[i], hits.begin() + offsets[i + 1],
+            [](const RayHit & a, const RayHit & b) {
+                return a.distance < b.distance;
+            });
+    }
+}
+
+}}
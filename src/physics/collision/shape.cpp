@@ -16,8 +16,4 @@ Shape::Shape(enum Shape::ShapeType shapeType)
 Shape::~Shape() {
 }
 
-enum Shape::ShapeType Shape::getShapeType() const {
-    return shapeType;
-}
-
 }
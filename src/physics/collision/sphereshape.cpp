@@ -17,10 +17,6 @@ SphereShape::SphereShape(float radius)
 SphereShape::~SphereShape() {
 }
 
-float SphereShape::getRadius() const {
-    return r;
-}
-
 /*void SphereShape::getBoundingBox(Transform & t, glm::vec3 & min, glm::vec3 & max) {
     glm::vec3 position = t.position;
     glm::vec3 rad = glm::vec3(r, r, r);
@@ -8,13 +8,12 @@
 
 namespace Physics {
 
-Constraint::Constraint() {
+Constraint::Constraint(enum Constraint::ConstraintType constraintType)
+    : constraintType(constraintType)
+{
 }
 
 Constraint::~Constraint() {
 }
 
-void Constraint::apply(double t, double dt) {
-}
-
 }
@@ -0,0 +1,40 @@
+/**
+ * @file constraintpool.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/constraints/constraintpool.h>
+
+namespace Physics {
+
+int RodPool::add(int body1, int body2, float length) {
+    this->body1.push_back(body1);
+    this->body2.push_back(body2);
+    this->length.push_back(length);
+
+    normal.push_back(glm::vec3(0.0f));
+    mass.push_back(0.0f);
+    bias.push_back(0.0f);
+    impulse.push_back(0.0f);
+
+    return size() - 1;
+}
+
+int SpringPool::add(int body1, int body2, float stiffness, float length, float damping) {
+    this->body1.push_back(body1);
+    this->body2.push_back(body2);
+    this->stiffness.push_back(stiffness);
+    this->length.push_back(length);
+    this->damping.push_back(damping);
+
+    normal.push_back(glm::vec3(0.0f));
+    mass.push_back(0.0f);
+    bias.push_back(0.0f);
+    softness.push_back(0.0f);
+    impulse.push_back(0.0f);
+
+    return size() - 1;
+}
+
+}
@@ -0,0 +1,514 @@
+/**
+ * @file articulation.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/articulation.h>
+#include <physics/dynamics/body.h>
+
+namespace Physics {
+
+// Matrix m such that m * x = cross(v, x)
+static glm::mat3 skew(const glm::vec3 & v) {
+    return glm::mat3(
+        0.0f,  v.z, -v.y,
+        -v.z, 0.0f,  v.x,
+         v.y, -v.x, 0.0f);
+}
+
+// Invert a small symmetric positive definite matrix in place, by Gauss-Jordan
+// elimination without pivoting
+static void invertSmall(float *m, int n) {
+    float inv[36];
+
+    for (int r = 0; r < n; r++)
+        for (int c = 0; c < n; c++)
+            inv[r * n + c] = r == c ? 1.0f : 0.0f;
+
+    for (int col = 0; col < n; col++) {
+        float pivot = m[col * n + col];
+        float scale = fabsf(pivot) > 1e-12f ? 1.0f / pivot : 0.0f;
+
+        for (int c = 0; c < n; c++) {
+            m[col * n + c] *= scale;
+            inv[col * n + c] *= scale;
+        }
+
+        for (int r = 0; r < n; r++) {
+            if (r == col)
+                continue;
+
+            float f = m[r * n + col];
+
+            for (int c = 0; c < n; c++) {
+                m[r * n + c] -= f * m[col * n + c];
+                inv[r * n + c] -= f * inv[col * n + c];
+            }
+        }
+    }
+
+    for (int i = 0; i < n * n; i++)
+        m[i] = inv[i];
+}
+
+Articulation::Articulation(std::shared_ptr<Body> root) {
+    Link link = Link();
+    link.body = root;
+    link.parent = -1;
+    link.type = Fixed;
+    link.syncLinear = root->getLinearVelocity();
+    link.syncAngular = root->getAngularVelocity();
+    links.push_back(link);
+}
+
+Articulation::~Articulation() {
+}
+
+int Articulation::getDofs(JointType type) {
+    switch (type) {
+    case Revolute:
+    case Prismatic:
+        return 1;
+    case Spherical:
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+Articulation::SpatialVector Articulation::shiftMotion(const SpatialVector & motion,
+    const glm::vec3 & offset)
+{
+    SpatialVector result;
+    result.angular = motion.angular;
+    result.linear = motion.linear + glm::cross(motion.angular, offset);
+    return result;
+}
+
+int Articulation::addLink(int parent, std::shared_ptr<Body> body, JointType type,
+    glm::vec3 anchor, glm::vec3 axis)
+{
+    Transform & t1 = links[parent].body->getTransform();
+    Transform & t2 = body->getTransform();
+
+    Link link = Link();
+    link.body = body;
+    link.parent = parent;
+    link.type = type;
+    link.parentAnchor = glm::conjugate(t1.orientation) * (anchor - t1.position);
+    link.childAnchor = glm::conjugate(t2.orientation) * (anchor - t2.position);
+    link.axis = glm::conjugate(t1.orientation) * glm::normalize(axis);
+    link.restOrientation = glm::conjugate(t1.orientation) * t2.orientation;
+    link.syncLinear = body->getLinearVelocity();
+    link.syncAngular = body->getAngularVelocity();
+
+    links.push_back(link);
+
+    return (int)links.size() - 1;
+}
+
+void Articulation::setJointForce(int link, glm::vec3 force) {
+    links[link].force = force;
+}
+
+void Articulation::setJointDamping(int link, float damping) {
+    links[link].damping = damping;
+}
+
+void Articulation::computeSubspaces() {
+    Link & root = links[0];
+
+    // A floating root is free in all six directions, which the algorithm
+    // handles directly rather than through a subspace
+    if (root.body->getFixed()) {
+        root.dofs = 0;
+        root.motion.angular = glm::vec3();
+        root.motion.linear = glm::vec3();
+    }
+    else {
+        root.dofs = 6;
+        root.motion.angular = root.body->getAngularVelocity();
+        root.motion.linear = root.body->getLinearVelocity();
+    }
+
+    for (size_t i = 1; i < links.size(); i++) {
+        Link & link = links[i];
+        Transform & t1 = links[link.parent].body->getTransform();
+        Transform & t2 = link.body->getTransform();
+
+        // Center of mass relative to the joint
+        glm::vec3 arm = -(t2.orientation * link.childAnchor);
+
+        link.dofs = getDofs(link.type);
+
+        switch (link.type) {
+        case Revolute: {
+            glm::vec3 axis = t1.orientation * link.axis;
+            link.subspace[0].angular = axis;
+            link.subspace[0].linear = glm::cross(axis, arm);
+            break;
+        }
+        case Prismatic:
+            link.subspace[0].angular = glm::vec3();
+            link.subspace[0].linear = t1.orientation * link.axis;
+            break;
+        case Spherical:
+            for (int k = 0; k < 3; k++) {
+                glm::vec3 axis;
+                axis[k] = 1.0f;
+                axis = t1.orientation * axis;
+
+                link.subspace[k].angular = axis;
+                link.subspace[k].linear = glm::cross(axis, arm);
+            }
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void Articulation::updateVelocities() {
+    for (size_t i = 1; i < links.size(); i++) {
+        Link & link = links[i];
+        const Link & parent = links[link.parent];
+        link.motion = shiftMotion(parent.motion,
+            link.body->getPosition() - parent.body->getPosition());
+
+        for (int k = 0; k < link.dofs; k++) {
+            link.motion.angular += link.subspace[k].angular * link.velocity[k];
+            link.motion.linear += link.subspace[k].linear * link.velocity[k];
+        }
+    }
+}
+
+void Articulation::writeVelocities() {
+    for (size_t i = 0; i < links.size(); i++) {
+        Link & link = links[i];
+
+        if (link.body->getFixed())
+            continue;
+
+        link.syncAngular = link.motion.angular;
+        link.syncLinear = link.motion.linear;
+
+        link.body->setAngularVelocity(link.syncAngular);
+        link.body->setLinearVelocity(link.syncLinear);
+    }
+}
+
+void Articulation::propagate(bool impulses, float dt) {
+    int numLinks = (int)links.size();
+
+    // Inwards, folding each link's articulated inertia and bias force into its
+    // parent's. The inertias only depend on positions, so propagating impulses
+    // reuses those from the dynamics pass.
+    for (int i = numLinks - 1; i > 0; i--) {
+        Link & link = links[i];
+        Link & parent = links[link.parent];
+        int dofs = link.dofs;
+        glm::vec3 offset = link.body->getPosition() - parent.body->getPosition();
+
+        if (!impulses) {
+            float dofInertia[9];
+
+            for (int k = 0; k < dofs; k++) {
+                const SpatialVector & s = link.subspace[k];
+                link.projected[k].angular = link.inertia.a * s.angular + link.inertia.b * s.linear;
+                link.projected[k].linear = link.inertia.c * s.angular + link.inertia.d * s.linear;
+            }
+
+            for (int k = 0; k < dofs; k++)
+                for (int l = 0; l < dofs; l++)
+                    dofInertia[k * dofs + l] =
+                        glm::dot(link.subspace[k].angular, link.projected[l].angular) +
+                        glm::dot(link.subspace[k].linear, link.projected[l].linear);
+
+            invertSmall(dofInertia, dofs);
+
+            for (int k = 0; k < dofs * dofs; k++)
+                link.invDofInertia[k] = dofInertia[k];
+        }
+
+        for (int k = 0; k < dofs; k++) {
+            float force = impulses ? 0.0f : link.force[k] - link.damping * link.velocity[k];
+
+            link.dofForce[k] = force -
+                glm::dot(link.subspace[k].angular, link.biasForce.angular) -
+                glm::dot(link.subspace[k].linear, link.biasForce.linear);
+        }
+
+        SpatialVector biasForce = link.biasForce;
+
+        for (int k = 0; k < dofs; k++) {
+            float f = 0.0f;
+
+            for (int l = 0; l < dofs; l++)
+                f += link.invDofInertia[k * dofs + l] * link.dofForce[l];
+
+            biasForce.angular += link.projected[k].angular * f;
+            biasForce.linear += link.projected[k].linear * f;
+        }
+
+        if (!impulses) {
+            SpatialMatrix inertia = link.inertia;
+
+            for (int k = 0; k < dofs; k++) {
+                SpatialVector v = SpatialVector();
+
+                for (int l = 0; l < dofs; l++) {
+                    float f = link.invDofInertia[k * dofs + l];
+                    v.angular += link.projected[l].angular * f;
+                    v.linear += link.projected[l].linear * f;
+                }
+
+                const SpatialVector & u = link.projected[k];
+                inertia.a -= glm::outerProduct(u.angular, v.angular);
+                inertia.b -= glm::outerProduct(u.angular, v.linear);
+                inertia.c -= glm::outerProduct(u.linear, v.angular);
+                inertia.d -= glm::outerProduct(u.linear, v.linear);
+            }
+
+            biasForce.angular += inertia.a * link.bias.angular + inertia.b * link.bias.linear;
+            biasForce.linear += inertia.c * link.bias.angular + inertia.d * link.bias.linear;
+
+            // Move the inertia to the parent's center of mass, as X^T I X
+            // where X shifts motion from the parent to the link
+            glm::mat3 r = skew(offset);
+            parent.inertia.a += inertia.a - inertia.b * r + r * inertia.c - r * inertia.d * r;
+            parent.inertia.b += inertia.b + r * inertia.d;
+            parent.inertia.c += inertia.c - inertia.d * r;
+            parent.inertia.d += inertia.d;
+        }
+
+        parent.biasForce.angular += biasForce.angular + glm::cross(offset, biasForce.linear);
+        parent.biasForce.linear += biasForce.linear;
+    }
+
+    // The root accelerates against its whole articulated inertia, unless fixed
+    Link & root = links[0];
+    root.change = SpatialVector();
+
+    if (root.dofs == 6) {
+        if (!impulses) {
+            const SpatialMatrix & m = root.inertia;
+
+            for (int r = 0; r < 3; r++) {
+                for (int c = 0; c < 3; c++) {
+                    rootInverse[r * 6 + c] = m.a[c][r];
+                    rootInverse[r * 6 + c + 3] = m.b[c][r];
+                    rootInverse[(r + 3) * 6 + c] = m.c[c][r];
+                    rootInverse[(r + 3) * 6 + c + 3] = m.d[c][r];
+                }
+            }
+
+            invertSmall(rootInverse, 6);
+        }
+
+        float p[6] = {
+            root.biasForce.angular.x, root.biasForce.angular.y, root.biasForce.angular.z,
+            root.biasForce.linear.x, root.biasForce.linear.y, root.biasForce.linear.z
+        };
+
+        float a[6];
+
+        for (int r = 0; r < 6; r++) {
+            a[r] = 0.0f;
+
+            for (int c = 0; c < 6; c++)
+                a[r] -= rootInverse[r * 6 + c] * p[c];
+        }
+
+        root.change.angular = glm::vec3(a[0], a[1], a[2]);
+        root.change.linear = glm::vec3(a[3], a[4], a[5]);
+
+        // The spatial acceleration is of the body point at the center of mass,
+        // which differs from the acceleration of the center of mass itself
+        if (impulses) {
+            root.motion.angular += root.change.angular;
+            root.motion.linear += root.change.linear;
+        }
+        else {
+            root.motion.linear += (root.change.linear +
+                glm::cross(root.motion.angular, root.motion.linear)) * dt;
+            root.motion.angular += root.change.angular * dt;
+        }
+    }
+
+    // Outwards, solving for each joint's acceleration or velocity change given
+    // its parent's
+    for (int i = 1; i < numLinks; i++) {
+        Link & link = links[i];
+        const Link & parent = links[link.parent];
+        int dofs = link.dofs;
+
+        SpatialVector change = shiftMotion(parent.change,
+            link.body->getPosition() - parent.body->getPosition());
+
+        if (!impulses) {
+            change.angular += link.bias.angular;
+            change.linear += link.bias.linear;
+        }
+
+        float dofChange[3];
+
+        for (int k = 0; k < dofs; k++)
+            dofChange[k] = link.dofForce[k] -
+                glm::dot(change.angular, link.projected[k].angular) -
+                glm::dot(change.linear, link.projected[k].linear);
+
+        for (int k = 0; k < dofs; k++) {
+            float f = 0.0f;
+
+            for (int l = 0; l < dofs; l++)
+                f += link.invDofInertia[k * dofs + l] * dofChange[l];
+
+            change.angular += link.subspace[k].angular * f;
+            change.linear += link.subspace[k].linear * f;
+            link.velocity[k] += impulses ? f : f * dt;
+        }
+
+        link.change = change;
+    }
+}
+
+void Articulation::computeDynamics(const glm::vec3 & gravity, float dt) {
+    computeSubspaces();
+    updateVelocities();
+
+    for (size_t i = 0; i < links.size(); i++) {
+        Link & link = links[i];
+        Body *body = link.body.get();
+
+        link.inertia.a = link.inertia.b = link.inertia.c = link.inertia.d = glm::mat3(0.0f);
+        link.biasForce = SpatialVector();
+
+        if (body->getFixed())
+            continue;
+
+        // Spatial inertia about the center of mass
+        float mass = body->getMass();
+        glm::mat3 rotation = glm::mat3_cast(body->getOrientation());
+
+        link.inertia.a = rotation * body->getInertiaTensor() * glm::transpose(rotation);
+        link.inertia.d = glm::mat3(mass);
+
+        // Acceleration from the joint moving with its parent
+        SpatialVector jointMotion = SpatialVector();
+
+        for (int k = 0; k < link.dofs && i > 0; k++) {
+            jointMotion.angular += link.subspace[k].angular * link.velocity[k];
+            jointMotion.linear += link.subspace[k].linear * link.velocity[k];
+        }
+
+        const glm::vec3 & w = link.motion.angular;
+        const glm::vec3 & v = link.motion.linear;
+
+        link.bias.angular = glm::cross(w, jointMotion.angular);
+        link.bias.linear = glm::cross(w, jointMotion.linear) + glm::cross(v, jointMotion.angular);
+
+        // Gyroscopic force less external forces
+        link.biasForce.angular = glm::cross(w, link.inertia.a * w) - body->getTorque();
+        link.biasForce.linear = mass * glm::cross(w, v) - gravity * mass - body->getForce();
+    }
+
+    propagate(false, dt);
+
+    updateVelocities();
+    writeVelocities();
+}
+
+void Articulation::applyImpulses() {
+    bool any = false;
+
+    for (size_t i = 0; i < links.size(); i++) {
+        Link & link = links[i];
+        Body *body = link.body.get();
+
+        link.biasForce = SpatialVector();
+
+        if (body->getFixed())
+            continue;
+
+        glm::vec3 linear = body->getLinearVelocity() - link.syncLinear;
+        glm::vec3 angular = body->getAngularVelocity() - link.syncAngular;
+
+        if (linear == glm::vec3() && angular == glm::vec3())
+            continue;
+
+        // Recover the impulse from the change in velocity, using the same
+        // inertia the body applied it with
+        glm::vec3 impulse = linear * body->getMass();
+        glm::vec3 angularImpulse = body->getInertiaTensor() * angular;
+
+        link.biasForce.angular = -angularImpulse;
+        link.biasForce.linear = -impulse;
+
+        any = true;
+    }
+
+    if (!any)
+        return;
+
+    propagate(true, 0.0f);
+
+    updateVelocities();
+    writeVelocities();
+}
+
+void Articulation::integrate(float dt) {
+    Body *root = links[0].body.get();
+
+    if (!root->getFixed())
+        root->integrateTransform(dt);
+
+    for (size_t i = 1; i < links.size(); i++) {
+        Link & link = links[i];
+        Transform & t1 = links[link.parent].body->getTransform();
+
+        glm::quat rotation;
+        glm::vec3 anchor = link.parentAnchor;
+
+        switch (link.type) {
+        case Revolute:
+            link.position += link.velocity.x * dt;
+            rotation = glm::angleAxis(link.position, link.axis);
+            break;
+        case Prismatic:
+            link.position += link.velocity.x * dt;
+            anchor += link.axis * link.position;
+            break;
+        case Spherical: {
+            float angle = glm::length(link.velocity);
+
+            if (angle != 0.0f)
+                link.rotation = glm::normalize(
+                    glm::angleAxis(angle * dt, link.velocity / angle) * link.rotation);
+
+            rotation = link.rotation;
+            break;
+        }
+        default:
+            break;
+        }
+
+        glm::quat orientation = glm::normalize(t1.orientation * rotation * link.restOrientation);
+
+        link.body->setOrientation(orientation);
+        link.body->setPosition(t1.position + t1.orientation * anchor -
+            orientation * link.childAnchor);
+    }
+
+    // Link velocities follow the joints to their new positions
+    computeSubspaces();
+    updateVelocities();
+    writeVelocities();
+}
+
+void Articulation::clearForces() {
+    for (auto & link : links)
+        link.body->clearForces();
+}
+
+}
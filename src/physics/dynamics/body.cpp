@@ -13,6 +13,14 @@ namespace Physics {
 
 Body::Body(std::shared_ptr<Shape> shape)
     : fixed(false),
+      fastMover(false),
+      sensor(false),
+      articulated(false),
+      teleported(false),
+      friction(0.4f),
+      rollingFriction(0.0f),
+      collisionGroup(0xFFFFFFFFu),
+      collisionMask(0xFFFFFFFFu),
       mass(1.0f),
       invMass(1.0f),
       shape(shape)
@@ -28,6 +36,7 @@ std::shared_ptr<Shape> Body::getShape() {
 
 void Body::setShape(std::shared_ptr<Shape> shape) {
     this->shape = shape;
+    teleported = true;
 }
 
 glm::vec3 Body::getPosition() {
@@ -54,6 +63,10 @@ glm::vec3 Body::getVelocityAtPoint(glm::vec3 relPos) {
     return linearVelocity + glm::cross(angularVelocity, relPos);
 }
 
+glm::vec3 Body::getPseudoVelocityAtPoint(glm::vec3 relPos) {
+    return pseudoLinearVelocity + glm::cross(pseudoAngularVelocity, relPos);
+}
+
 float Body::getMass() {
 	if (fixed)
 		return std::numeric_limits<float>::infinity();
@@ -86,16 +99,62 @@ bool Body::getFixed() {
     return fixed;
 }
 
+bool Body::getFastMover() {
+    return fastMover;
+}
+
+unsigned Body::getCollisionGroup() {
+    return collisionGroup;
+}
+
+unsigned Body::getCollisionMask() {
+    return collisionMask;
+}
+
+bool Body::getSensor() {
+    return sensor;
+}
+
+bool Body::getArticulated() {
+    return articulated;
+}
+
+bool Body::getTeleported() {
+    return teleported;
+}
+
+void Body::clearTeleported() {
+    teleported = false;
+}
+
+glm::vec3 Body::getForce() {
+    return force;
+}
+
+glm::vec3 Body::getTorque() {
+    return torque;
+}
+
+float Body::getFriction() {
+    return friction;
+}
+
+float Body::getRollingFriction() {
+    return rollingFriction;
+}
+
 glm::mat4 Body::getLocalToWorld() {
     return transform.getLocalToWorld();
 }
 
 void Body::setPosition(glm::vec3 position) {
     transform.position = position;
+    teleported = true;
 }
 
 void Body::setOrientation(glm::quat orientation) {
     transform.orientation = orientation;
+    teleported = true;
 }
 
 void Body::setLinearVelocity(glm::vec3 velocity) {
@@ -120,6 +179,31 @@ void Body::setFixed(bool fixed) {
     this->fixed = fixed;
 }
 
+void Body::setFastMover(bool fastMover) {
+    this->fastMover = fastMover;
+}
+
+void Body::setCollisionFilter(unsigned group, unsigned mask) {
+    this->collisionGroup = group;
+    this->collisionMask = mask;
+}
+
+void Body::setSensor(bool sensor) {
+    this->sensor = sensor;
+}
+
+void Body::setArticulated(bool articulated) {
+    this->articulated = articulated;
+}
+
+void Body::setFriction(float friction) {
+    this->friction = friction;
+}
+
+void Body::setRollingFriction(float rollingFriction) {
+    this->rollingFriction = rollingFriction;
+}
+
 void Body::addLinearVelocity(glm::vec3 velocity) {
     // TODO Inline these functions
     // TODO Fixed makes a branch
@@ -149,6 +233,14 @@ void Body::addImpulse(glm::vec3 impulse, glm::vec3 relPos) {
     addAngularImpulse(glm::cross(relPos, impulse));
 }
 
+void Body::addPseudoImpulse(glm::vec3 impulse, glm::vec3 relPos) {
+    if (fixed)
+        return;
+
+    pseudoLinearVelocity += invMass * impulse;
+    pseudoAngularVelocity += invInertiaTensor * glm::cross(relPos, impulse);
+}
+
 void Body::addLinearForce(glm::vec3 force) {
     this->force += force;
 }
@@ -165,6 +257,11 @@ void Body::addForce(glm::vec3 force, glm::vec3 relPos) {
     addTorque(glm::cross(relPos, force));
 }
 
+void Body::clearForces() {
+    force = glm::vec3();
+    torque = glm::vec3();
+}
+
 void Body::integrateVelocities(double dt) {
     addLinearVelocity(invMass * force * (float)dt);
     addAngularVelocity(invInertiaTensor * torque * (float)dt);
@@ -173,23 +270,26 @@ void Body::integrateVelocities(double dt) {
     //linearVelocity *= 1.0f - 0.1f * dt;
     //angularVelocity *= 1.0f - 0.1f * dt;
 
-    force = glm::vec3();
-    torque = glm::vec3();
+    clearForces();
 }
 
 void Body::integrateTransform(double dt) {
-    transform.position += linearVelocity * (float)dt;
+    transform.position += (linearVelocity + pseudoLinearVelocity) * (float)dt;
+
+    glm::vec3 scaledAngularVelocity = angularVelocity + pseudoAngularVelocity;
 
-    glm::vec3 scaledAngularVelocity = angularVelocity;
+    pseudoLinearVelocity = glm::vec3();
+    pseudoAngularVelocity = glm::vec3();
 
     float angle = glm::length(scaledAngularVelocity);
 
     if (angle != 0.0f) {
         glm::vec3 axis = scaledAngularVelocity / angle;
 
-        // TODO GLM is in degrees...
-        transform.orientation = glm::rotate(transform.orientation,
-            angle * 180.0f / (float)M_PI * (float)dt, axis);
+        // Angular velocity is in world space, so the rotation is applied
+        // after the current orientation. GLM angles are in radians.
+        transform.orientation = glm::normalize(
+            glm::angleAxis(angle * (float)dt, axis) * transform.orientation);
     }
 }
 
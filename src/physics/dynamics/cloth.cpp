@@ -0,0 +1,495 @@
+/**
+ * @file cloth.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/cloth.h>
+#include <physics/dynamics/body.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+// Most particles each particle may collide with in a step
+static const int maxNeighbors = 32;
+
+// Hash of a cell, for a table whose size is a power of two
+static inline int hashCell(int x, int y, int z, int tableSize) {
+    unsigned h = ((unsigned)x * 92837111u) ^ ((unsigned)y * 689287499u) ^ ((unsigned)z * 283923481u);
+    return (int)(h & (unsigned)(tableSize - 1));
+}
+
+Cloth::Cloth(int width, int height, float spacing, float mass, glm::vec3 origin,
+    glm::vec3 across, glm::vec3 down, float stretchCompliance, float bendCompliance)
+    : width(width),
+      height(height),
+      colored(false),
+      thickness(0.5f * spacing),
+      friction(0.3f),
+      substeps(2),
+      selfCollision(true)
+{
+    int numParticles = width * height;
+
+    particleInverseMass = (float)numParticles / mass;
+
+    positions.resize(numParticles);
+    previous.resize(numParticles);
+    velocities.resize(numParticles);
+    inverseMasses.assign(numParticles, particleInverseMass);
+
+    for (int y = 0; y < height; y++)
+        for (int x = 0; x < width; x++)
+            positions[getParticle(x, y)] = origin + spacing * ((float)x * across + (float)y * down);
+
+    restPositions = positions;
+
+    // Grid edges and diagonals, then particles two apart along the grid
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int p = getParticle(x, y);
+
+            if (x + 1 < width)
+                addConstraint(p, getParticle(x + 1, y), stretchCompliance);
+
+            if (y + 1 < height)
+                addConstraint(p, getParticle(x, y + 1), stretchCompliance);
+
+            if (x + 1 < width && y + 1 < height) {
+                addConstraint(p, getParticle(x + 1, y + 1), stretchCompliance);
+                addConstraint(getParticle(x + 1, y), getParticle(x, y + 1), stretchCompliance);
+            }
+
+            if (x + 2 < width)
+                addConstraint(p, getParticle(x + 2, y), bendCompliance);
+
+            if (y + 2 < height)
+                addConstraint(p, getParticle(x, y + 2), bendCompliance);
+        }
+    }
+}
+
+Cloth::~Cloth() {
+}
+
+int Cloth::addConstraint(int p1, int p2, float compliance) {
+    particle1.push_back(p1);
+    particle2.push_back(p2);
+    lengths.push_back(glm::length(positions[p1] - positions[p2]));
+    compliances.push_back(compliance);
+
+    colored = false;
+
+    return (int)particle1.size() - 1;
+}
+
+void Cloth::addDistanceConstraint(int particle1, int particle2, float length, float compliance) {
+    int index = addConstraint(particle1, particle2, compliance);
+    lengths[index] = length;
+}
+
+void Cloth::setPosition(int particle, glm::vec3 position) {
+    positions[particle] = position;
+}
+
+void Cloth::setVelocity(int particle, glm::vec3 velocity) {
+    velocities[particle] = velocity;
+}
+
+void Cloth::setPinned(int particle, bool pinned) {
+    inverseMasses[particle] = pinned ? 0.0f : particleInverseMass;
+
+    if (pinned)
+        velocities[particle] = glm::vec3();
+}
+
+void Cloth::setThickness(float thickness) {
+    this->thickness = thickness;
+
+    // Pairs are found again at the new distance
+    neighborPositions.clear();
+}
+
+void Cloth::setFriction(float friction) {
+    this->friction = friction;
+}
+
+void Cloth::setSubsteps(int substeps) {
+    this->substeps = std::max(substeps, 1);
+}
+
+void Cloth::setSelfCollision(bool selfCollision) {
+    this->selfCollision = selfCollision;
+}
+
+void Cloth::color() {
+    int numParticles = (int)positions.size();
+    int numConstraints = (int)particle1.size();
+
+    // Counting sort of constraint ends by particle
+    std::vector<int> offsets(numParticles + 1, 0);
+
+    for (int c = 0; c < numConstraints; c++) {
+        offsets[particle1[c] + 1]++;
+        offsets[particle2[c] + 1]++;
+    }
+
+    for (int i = 1; i <= numParticles; i++)
+        offsets[i] += offsets[i - 1];
+
+    std::vector<int> adjacency(numConstraints * 2);
+    std::vector<int> next(offsets.begin(), offsets.end() - 1);
+
+    for (int c = 0; c < numConstraints; c++) {
+        adjacency[next[particle1[c]]++] = c;
+        adjacency[next[particle2[c]]++] = c;
+    }
+
+    // Greedily give each constraint the lowest color not taken by a constraint
+    // sharing a particle. Colors taken are marked with the constraint's index,
+    // so the marks never need clearing.
+    std::vector<int> colors(numConstraints, -1);
+    std::vector<int> taken;
+    int numColors = 0;
+
+    for (int c = 0; c < numConstraints; c++) {
+        int ends[2] = { particle1[c], particle2[c] };
+
+        for (int e = 0; e < 2; e++) {
+            for (int k = offsets[ends[e]]; k < offsets[ends[e] + 1]; k++) {
+                int other = colors[adjacency[k]];
+
+                if (other >= 0)
+                    taken[other] = c;
+            }
+        }
+
+        int color = 0;
+
+        while (color < numColors && taken[color] == c)
+            color++;
+
+        if (color == numColors) {
+            taken.push_back(-1);
+            numColors++;
+        }
+
+        colors[c] = color;
+    }
+
+    // Counting sort of constraints by color
+    colorOffsets.assign(numColors + 1, 0);
+
+    for (int c = 0; c < numConstraints; c++)
+        colorOffsets[colors[c] + 1]++;
+
+    for (int i = 1; i <= numColors; i++)
+        colorOffsets[i] += colorOffsets[i - 1];
+
+    next.assign(colorOffsets.begin(), colorOffsets.end() - 1);
+
+    std::vector<int>   sorted1(numConstraints);
+    std::vector<int>   sorted2(numConstraints);
+    std::vector<float> sortedLengths(numConstraints);
+    std::vector<float> sortedCompliances(numConstraints);
+
+    for (int c = 0; c < numConstraints; c++) {
+        int slot = next[colors[c]]++;
+        sorted1[slot] = particle1[c];
+        sorted2[slot] = particle2[c];
+        sortedLengths[slot] = lengths[c];
+        sortedCompliances[slot] = compliances[c];
+    }
+
+    particle1.swap(sorted1);
+    particle2.swap(sorted2);
+    lengths.swap(sortedLengths);
+    compliances.swap(sortedCompliances);
+
+    colored = true;
+}
+
+float Cloth::getMaxTravel(const glm::vec3 & gravity, float dt) {
+    float maxSpeed2 = 0.0f;
+
+    for (size_t i = 0; i < velocities.size(); i++)
+        if (inverseMasses[i] != 0.0f)
+            maxSpeed2 = std::max(maxSpeed2, glm::dot(velocities[i], velocities[i]));
+
+    return sqrtf(maxSpeed2) * dt + glm::length(gravity) * dt * dt;
+}
+
+AABB Cloth::getBounds(const glm::vec3 & gravity, float dt) {
+    AABB box = AABB::empty();
+
+    for (auto & position : positions)
+        box.merge(position);
+
+    box.inflate(thickness + getMaxTravel(gravity, dt));
+
+    return box;
+}
+
+void Cloth::findNeighbors(float distance, ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+    int tableSize = 1;
+
+    while (tableSize < 2 * numParticles)
+        tableSize *= 2;
+
+    // Cells twice the distance across, so that each particle looks in at
+    // most two cells along each axis
+    float invCell = 0.5f / distance;
+    float distance2 = distance * distance;
+    float thickness2 = thickness * thickness;
+
+    // Counting sort of particles by hashed cell
+    cellStarts.assign(tableSize + 1, 0);
+    cellParticles.resize(numParticles);
+    neighbors.resize(numParticles * maxNeighbors);
+    neighborCounts.resize(numParticles);
+    corrections.resize(numParticles);
+    neighborPositions = positions;
+
+    std::vector<int> cells(numParticles);
+
+    for (int i = 0; i < numParticles; i++) {
+        glm::vec3 p = positions[i] * invCell;
+        cells[i] = hashCell((int)floorf(p.x), (int)floorf(p.y), (int)floorf(p.z), tableSize);
+        cellStarts[cells[i] + 1]++;
+    }
+
+    for (int i = 1; i <= tableSize; i++)
+        cellStarts[i] += cellStarts[i - 1];
+
+    std::vector<int> next(cellStarts.begin(), cellStarts.end() - 1);
+
+    for (int i = 0; i < numParticles; i++)
+        cellParticles[next[cells[i]]++] = i;
+
+    // Particles within the distance, which are not already within the
+    // thickness of each other at rest
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            int *list = &neighbors[i * maxNeighbors];
+            int count = 0;
+
+            glm::vec3 lo = (positions[i] - distance) * invCell;
+            glm::vec3 hi = (positions[i] + distance) * invCell;
+            int x0 = (int)floorf(lo.x), x1 = (int)floorf(hi.x);
+            int y0 = (int)floorf(lo.y), y1 = (int)floorf(hi.y);
+            int z0 = (int)floorf(lo.z), z1 = (int)floorf(hi.z);
+
+            for (int z = z0; z <= z1; z++) {
+                for (int y = y0; y <= y1; y++) {
+                    for (int x = x0; x <= x1; x++) {
+                        int cell = hashCell(x, y, z, tableSize);
+
+                        for (int k = cellStarts[cell]; k < cellStarts[cell + 1]; k++) {
+                            int j = cellParticles[k];
+
+                            if (j == i || count == maxNeighbors)
+                                continue;
+
+                            glm::vec3 d = positions[i] - positions[j];
+                            glm::vec3 r = restPositions[i] - restPositions[j];
+
+                            if (glm::dot(d, d) >= distance2 || glm::dot(r, r) <= thickness2)
+                                continue;
+
+                            // Cells which hash alike are visited twice
+                            if (std::find(list, list + count, j) == list + count)
+                                list[count++] = j;
+                        }
+                    }
+                }
+            }
+
+            neighborCounts[i] = count;
+        }
+    });
+}
+
+void Cloth::collideSelf(ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+
+    // Each particle moves itself apart from its neighbors by its share of the
+    // overlap, so that particles never write to each other
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            glm::vec3 correction;
+            float w1 = inverseMasses[i];
+
+            if (w1 != 0.0f) {
+                for (int k = 0; k < neighborCounts[i]; k++) {
+                    int j = neighbors[i * maxNeighbors + k];
+
+                    glm::vec3 d = positions[i] - positions[j];
+                    float dist2 = glm::dot(d, d);
+
+                    if (dist2 >= thickness * thickness || dist2 < 1e-12f)
+                        continue;
+
+                    float dist = sqrtf(dist2);
+                    float share = w1 / (w1 + inverseMasses[j]);
+                    correction += (share * (thickness - dist) / dist) * d;
+                }
+            }
+
+            corrections[i] = correction;
+        }
+    });
+
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            positions[i] += corrections[i];
+    });
+}
+
+void Cloth::collideBodies(float h, ThreadPool & pool) {
+    int numColliders = colliders.size();
+
+    pool.parallelFor((int)positions.size(), grain, [&](int thread, int begin, int end) {
+        glm::vec3 *linear = colliders.getLinearImpulses(thread);
+        glm::vec3 *angular = colliders.getAngularImpulses(thread);
+
+        for (int i = begin; i < end; i++) {
+            float w = inverseMasses[i];
+
+            if (w == 0.0f)
+                continue;
+
+            for (int k = 0; k < numColliders; k++) {
+                const ParticleCollider & collider = colliders[k];
+                glm::vec3 x = positions[i];
+                glm::vec3 normal;
+                float depth;
+
+                if (!collider.getContact(x, thickness, normal, depth))
+                    continue;
+
+                glm::vec3 corrected = x + depth * normal;
+
+                // Friction removes motion across the surface, relative to the
+                // body, up to the coefficient times the depth
+                glm::vec3 motion = corrected - previous[i] - h * collider.getVelocityAtPoint(corrected);
+                glm::vec3 tangent = motion - glm::dot(motion, normal) * normal;
+                float slip = glm::length(tangent);
+
+                if (slip > 0.0f)
+                    corrected -= std::min(friction * depth / slip, 1.0f) * tangent;
+
+                positions[i] = corrected;
+
+                // Equal and opposite impulse on the body
+                glm::vec3 impulse = (x - corrected) / (w * h);
+                linear[k] += impulse;
+                angular[k] += glm::cross(corrected - collider.position, impulse);
+            }
+        }
+    });
+}
+
+void Cloth::step(const glm::vec3 & gravity, float dt, Body *const *bodies, int numBodies,
+    ThreadPool & pool)
+{
+    int numParticles = (int)positions.size();
+    float h = dt / substeps;
+
+    if (!colored)
+        color();
+
+    previous.resize(numParticles);
+
+    // Copy colliders, so that substeps read them without touching the bodies
+    colliders.set(bodies, numBodies, pool.getThreadCount());
+
+    // Pairs are found up to the thickness plus a skin apart, and are kept until
+    // some particle may have moved half the skin since. Then no pair closer
+    // than the thickness can have been missed.
+    if (selfCollision) {
+        float skin = thickness;
+        float moved = 0.0f;
+
+        if (neighborPositions.size() != (size_t)numParticles)
+            moved = skin;
+        else {
+            for (int i = 0; i < numParticles; i++) {
+                glm::vec3 d = positions[i] - neighborPositions[i];
+                moved = std::max(moved, glm::dot(d, d));
+            }
+
+            moved = sqrtf(moved) + getMaxTravel(gravity, dt);
+        }
+
+        if (moved >= 0.5f * skin)
+            findNeighbors(thickness + skin, pool);
+    }
+
+    for (int s = 0; s < substeps; s++) {
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                previous[i] = positions[i];
+
+                if (inverseMasses[i] == 0.0f)
+                    continue;
+
+                velocities[i] += h * gravity;
+                positions[i] += h * velocities[i];
+            }
+        });
+
+        // Constraints of a color share no particles. With one projection per
+        // substep, each starts from zero Lagrange multiplier.
+        for (int c = 0; c + 1 < (int)colorOffsets.size(); c++) {
+            int first = colorOffsets[c];
+
+            pool.parallelFor(colorOffsets[c + 1] - first, grain, [&](int thread, int begin, int end) {
+                for (int k = first + begin; k < first + end; k++) {
+                    int p1 = particle1[k];
+                    int p2 = particle2[k];
+                    float w1 = inverseMasses[p1];
+                    float w2 = inverseMasses[p2];
+                    float w = w1 + w2;
+
+                    if (w == 0.0f)
+                        continue;
+
+                    glm::vec3 d = positions[p1] - positions[p2];
+                    float dist = glm::length(d);
+
+                    if (dist < 1e-6f)
+                        continue;
+
+                    float alpha = compliances[k] / (h * h);
+                    float lambda = (lengths[k] - dist) / (w + alpha);
+                    glm::vec3 n = d / dist;
+
+                    positions[p1] += (w1 * lambda) * n;
+                    positions[p2] -= (w2 * lambda) * n;
+                }
+            });
+        }
+
+        if (colliders.size() > 0)
+            collideBodies(h, pool);
+
+        if (selfCollision)
+            collideSelf(pool);
+
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            for (int i = begin; i < end; i++)
+                if (inverseMasses[i] != 0.0f)
+                    velocities[i] = (positions[i] - previous[i]) / h;
+        });
+    }
+
+    // Push back on free bodies
+    colliders.apply();
+}
+
+}
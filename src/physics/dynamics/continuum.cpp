@@ -0,0 +1,606 @@
+/**
+ * @file continuum.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/continuum.h>
+#include <physics/dynamics/body.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+#include <cfloat>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+// Nodes along each side of a block, and in a block
+static const int blockSize = 4;
+static const int blockNodeCount = blockSize * blockSize * blockSize;
+
+// Jacobi sweeps per singular value decomposition
+static const int svdSweeps = 4;
+
+// Limits on how much snow stiffens or softens as it compacts or stretches
+static const float minHardening = 0.1f;
+static const float maxHardening = 5.0f;
+
+ContinuumMaterial::ContinuumMaterial(Model model, float density, float youngsModulus,
+    float poissonRatio)
+    : model(model),
+      density(density),
+      youngsModulus(youngsModulus),
+      poissonRatio(poissonRatio),
+      criticalCompression(2.5e-2f),
+      criticalStretch(7.5e-3f),
+      hardening(10.0f),
+      frictionAngle(0.5236f),
+      viscosity(0.0f)
+{
+}
+
+ContinuumMaterial ContinuumMaterial::snow() {
+    return ContinuumMaterial(Snow, 400.0f, 1.4e5f, 0.2f);
+}
+
+ContinuumMaterial ContinuumMaterial::sand() {
+    return ContinuumMaterial(Sand, 2200.0f, 3.537e5f, 0.3f);
+}
+
+ContinuumMaterial ContinuumMaterial::mud() {
+    ContinuumMaterial material(Liquid, 1600.0f, 1e5f, 0.3f);
+    material.viscosity = 100.0f;
+
+    return material;
+}
+
+/**
+ * @brief Singular value decomposition F = U diag(sigma) V^T, by one-sided
+ * Jacobi rotations which make the columns of F V orthogonal. U and V are
+ * rotations, so an inverted F has a negative singular value.
+ */
+static void svd(const glm::mat3 & F, glm::mat3 & U, glm::vec3 & sigma, glm::mat3 & V) {
+    glm::mat3 A = F;
+    V = glm::mat3(1.0f);
+
+    for (int sweep = 0; sweep < svdSweeps; sweep++) {
+        for (int p = 0; p < 2; p++) {
+            for (int q = p + 1; q < 3; q++) {
+                float alpha = glm::dot(A[p], A[p]);
+                float beta = glm::dot(A[q], A[q]);
+                float gamma = glm::dot(A[p], A[q]);
+
+                if (gamma * gamma <= 1e-14f * alpha * beta)
+                    continue;
+
+                float zeta = (beta - alpha) / (2.0f * gamma);
+                float t = (zeta >= 0.0f ? 1.0f : -1.0f) / (fabsf(zeta) + sqrtf(1.0f + zeta * zeta));
+                float c = 1.0f / sqrtf(1.0f + t * t);
+                float s = c * t;
+
+                glm::vec3 ap = A[p], aq = A[q];
+                A[p] = c * ap - s * aq;
+                A[q] = s * ap + c * aq;
+
+                glm::vec3 vp = V[p], vq = V[q];
+                V[p] = c * vp - s * vq;
+                V[q] = s * vp + c * vq;
+            }
+        }
+    }
+
+    for (int i = 0; i < 3; i++)
+        sigma[i] = glm::length(A[i]);
+
+    // The column of the smallest singular value completes the rotation, so
+    // that it may vanish or flip
+    int k = sigma.x < sigma.y ? (sigma.x < sigma.z ? 0 : 2) : (sigma.y < sigma.z ? 1 : 2);
+    int i = (k + 1) % 3, j = (k + 2) % 3;
+
+    if (sigma[j] < 1e-6f) {
+        U = glm::mat3(1.0f);
+        return;
+    }
+
+    U[i] = A[i] / sigma[i];
+    U[j] = A[j] / sigma[j];
+    U[j] = glm::normalize(U[j] - glm::dot(U[j], U[i]) * U[i]);
+    U[k] = glm::cross(U[i], U[j]);
+    sigma[k] = glm::dot(A[k], U[k]);
+}
+
+/**
+ * @brief Get matrix with the given diagonal
+ */
+static inline glm::mat3 diagonal(const glm::vec3 & d) {
+    return glm::mat3(d.x, 0.0f, 0.0f, 0.0f, d.y, 0.0f, 0.0f, 0.0f, d.z);
+}
+
+Continuum::Continuum(float spacing)
+    : spacing(spacing),
+      invSpacing(1.0f / spacing),
+      particleVolume(0.125f * spacing * spacing * spacing),
+      friction(0.5f),
+      blockOrigin(0),
+      bounds(AABB::empty()),
+      maxSpeed(0.0f),
+      clock(1e-3f)
+{
+}
+
+Continuum::~Continuum() {
+}
+
+int Continuum::addMaterial(const ContinuumMaterial & material) {
+    float E = material.youngsModulus;
+    float nu = material.poissonRatio;
+    float sinAngle = sinf(material.frictionAngle);
+
+    materialTable.push_back(material);
+
+    if (material.model == ContinuumMaterial::Liquid) {
+        shearModuli.push_back(0.0f);
+        lameLambdas.push_back(E / (3.0f * (1.0f - 2.0f * nu)));
+    }
+    else {
+        shearModuli.push_back(E / (2.0f * (1.0f + nu)));
+        lameLambdas.push_back(E * nu / ((1.0f + nu) * (1.0f - 2.0f * nu)));
+    }
+
+    frictionSlopes.push_back(sqrtf(2.0f / 3.0f) * 2.0f * sinAngle / (3.0f - sinAngle));
+
+    return (int)materialTable.size() - 1;
+}
+
+void Continuum::addParticle(const glm::vec3 & position, int material,
+    const glm::vec3 & velocity)
+{
+    positions.push_back(position);
+    velocities.push_back(velocity);
+    affines.push_back(glm::mat3(0.0f));
+    deformations.push_back(glm::mat3(1.0f));
+    plasticVolumes.push_back(1.0f);
+    materials.push_back((unsigned char)material);
+
+    bounds.merge(position);
+    maxSpeed = std::max(maxSpeed, glm::length(velocity));
+}
+
+void Continuum::addBox(const glm::vec3 & min, const glm::vec3 & max, int material,
+    const glm::vec3 & velocity)
+{
+    float gap = 0.5f * spacing;
+    glm::ivec3 count = glm::max(glm::ivec3((max - min) / gap), glm::ivec3(1));
+
+    for (int z = 0; z < count.z; z++)
+        for (int y = 0; y < count.y; y++)
+            for (int x = 0; x < count.x; x++)
+                addParticle(min + (glm::vec3((float)x, (float)y, (float)z) + 0.5f) * gap,
+                    material, velocity);
+}
+
+void Continuum::setFriction(float friction) {
+    this->friction = friction;
+}
+
+void Continuum::setStep(float step) {
+    clock.setStep(step);
+}
+
+float Continuum::getStableStep() {
+    float step = FLT_MAX;
+
+    for (size_t m = 0; m < materialTable.size(); m++) {
+        const ContinuumMaterial & material = materialTable[m];
+        float modulus = lameLambdas[m] + 2.0f * shearModuli[m];
+
+        if (material.model == ContinuumMaterial::Snow)
+            modulus *= maxHardening;
+
+        step = std::min(step, spacing / (3.0f * sqrtf(modulus / material.density)));
+
+        if (material.viscosity > 0.0f)
+            step = std::min(step, material.density * spacing * spacing / (6.0f * material.viscosity));
+    }
+
+    return step == FLT_MAX ? clock.getStep() : step;
+}
+
+int Continuum::advance(float dt) {
+    return clock.advance(dt);
+}
+
+AABB Continuum::getBounds(const glm::vec3 & gravity) {
+    AABB box = bounds;
+    float dt = clock.getStep();
+
+    box.inflate(2.0f * spacing + maxSpeed * dt + glm::length(gravity) * dt * dt);
+
+    return box;
+}
+
+void Continuum::buildGrid(ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+
+    // Blocks of nodes around the particles, with one to spare on each side,
+    // so that no particle is clamped into a block
+    glm::vec3 lo = glm::floor((bounds.min * invSpacing - 0.5f) * (1.0f / blockSize));
+    glm::vec3 hi = glm::floor((bounds.max * invSpacing - 0.5f) * (1.0f / blockSize));
+    glm::ivec3 first = glm::ivec3(lo) - glm::ivec3(1);
+    glm::ivec3 last = glm::ivec3(hi) + glm::ivec3(2);
+
+    blockOrigin = first * blockSize;
+
+    grid.fit((glm::vec3(blockOrigin) + 0.5f) * spacing, last - first + glm::ivec3(1),
+        blockSize * spacing);
+    grid.sort(pool, &positions[0], numParticles, blockStarts, order);
+
+    ParticleGrid::reorder(pool, order, positions, sortedVectors);
+    ParticleGrid::reorder(pool, order, velocities, sortedVectors);
+    ParticleGrid::reorder(pool, order, affines, sortedMatrices);
+    ParticleGrid::reorder(pool, order, deformations, sortedMatrices);
+    ParticleGrid::reorder(pool, order, plasticVolumes, sortedFloats);
+    ParticleGrid::reorder(pool, order, materials, sortedMaterials);
+
+    // Blocks with particles, and the next blocks along each axis, which their
+    // particles reach, have nodes. The table of blocks is much smaller than
+    // the particles, so it is walked in serial.
+    glm::ivec3 size = grid.getSize();
+    int numBlocks = grid.getNumCells();
+
+    blockNodes.assign(numBlocks, -1);
+    activeBlocks.clear();
+
+    for (int color = 0; color < 8; color++)
+        colorBlocks[color].clear();
+
+    for (int z = 0; z < size.z; z++) {
+        for (int y = 0; y < size.y; y++) {
+            for (int x = 0; x < size.x; x++) {
+                int c = grid.getCellIndex(glm::ivec3(x, y, z));
+
+                if (blockStarts[c] == blockStarts[c + 1])
+                    continue;
+
+                colorBlocks[(x & 1) + 2 * (y & 1) + 4 * (z & 1)].push_back(c);
+
+                for (int k = 0; k < 8; k++)
+                    blockNodes[grid.getCellIndex(glm::ivec3(x + (k & 1), y + ((k >> 1) & 1),
+                        z + (k >> 2)))] = 0;
+            }
+        }
+    }
+
+    for (int c = 0; c < numBlocks; c++) {
+        if (blockNodes[c] == 0) {
+            blockNodes[c] = (int)activeBlocks.size() * blockNodeCount;
+            activeBlocks.push_back(c);
+        }
+    }
+
+    nodes.resize(activeBlocks.size() * blockNodeCount);
+
+    pool.parallelFor((int)nodes.size(), 16 * grain, [&](int thread, int begin, int end) {
+        for (int n = begin; n < end; n++)
+            nodes[n] = glm::vec4();
+    });
+}
+
+/**
+ * @brief Get a particle's first node relative to the block origin, the
+ * weights of its nodes along each axis, and the offset of its first node from
+ * it in cells
+ */
+static inline glm::ivec3 getStencil(const glm::vec3 & point, const glm::vec3 & origin,
+    float invSpacing, glm::vec3 weights[3], glm::vec3 & offset)
+{
+    glm::vec3 t = (point - origin) * invSpacing;
+    glm::vec3 base = glm::floor(t);
+    glm::vec3 fx = t - base + 0.5f;
+
+    weights[0] = 0.5f * (1.5f - fx) * (1.5f - fx);
+    weights[1] = 0.75f - (fx - 1.0f) * (fx - 1.0f);
+    weights[2] = 0.5f * (fx - 0.5f) * (fx - 0.5f);
+    offset = -fx;
+
+    return glm::ivec3(base);
+}
+
+void Continuum::particlesToGrid(ThreadPool & pool) {
+    glm::vec3 origin = grid.getBounds().min;
+    float dt = clock.getStep();
+    glm::ivec3 size = grid.getSize();
+    float stressScale = -dt * particleVolume * 4.0f * invSpacing * invSpacing;
+
+    // Blocks of one color at a time, which write to disjoint nodes
+    for (int color = 0; color < 8; color++) {
+        const std::vector<int> & blocks = colorBlocks[color];
+
+        pool.parallelFor((int)blocks.size(), 1, [&](int thread, int begin, int end) {
+            for (int b = begin; b < end; b++) {
+                int c = blocks[b];
+
+                // Nodes of this block and the next along each axis
+                glm::ivec3 coords(c % size.x, (c / size.x) % size.y, c / (size.x * size.y));
+                glm::vec4 *blockNodePointers[8];
+
+                for (int k = 0; k < 8; k++)
+                    blockNodePointers[k] = &nodes[blockNodes[grid.getCellIndex(coords +
+                        glm::ivec3(k & 1, (k >> 1) & 1, k >> 2))]];
+
+                for (int i = blockStarts[c]; i < blockStarts[c + 1]; i++) {
+                    const ContinuumMaterial & material = materialTable[materials[i]];
+                    glm::mat3 C = affines[i];
+                    glm::mat3 F = (glm::mat3(1.0f) + dt * C) * deformations[i];
+                    float mu = shearModuli[materials[i]];
+                    float lambda = lameLambdas[materials[i]];
+                    glm::mat3 stress;
+
+                    switch (material.model) {
+                    case ContinuumMaterial::Snow:
+                    {
+                        // Clamp stretches past the critical strains, keeping
+                        // the change in volume as plastic compaction
+                        glm::mat3 U, V;
+                        glm::vec3 sigma;
+                        svd(F, U, sigma, V);
+
+                        glm::vec3 clamped = glm::clamp(sigma, 1.0f - material.criticalCompression,
+                            1.0f + material.criticalStretch);
+                        float J = clamped.x * clamped.y * clamped.z;
+
+                        plasticVolumes[i] *= sigma.x * sigma.y * sigma.z / J;
+                        F = U * diagonal(clamped) * glm::transpose(V);
+
+                        float h = glm::clamp(expf(material.hardening * (1.0f - plasticVolumes[i])),
+                            minHardening, maxHardening);
+
+                        // Fixed corotated elasticity
+                        glm::mat3 R = U * glm::transpose(V);
+                        stress = (2.0f * mu * h) * (F - R) * glm::transpose(F) +
+                            glm::mat3(lambda * h * J * (J - 1.0f));
+                        break;
+                    }
+                    case ContinuumMaterial::Sand:
+                    {
+                        // Return Hencky strain to the Drucker-Prager cone.
+                        // Sand pulled apart loses all strain.
+                        glm::mat3 U, V;
+                        glm::vec3 sigma;
+                        svd(F, U, sigma, V);
+
+                        glm::vec3 strain = glm::log(glm::max(glm::abs(sigma), glm::vec3(1e-4f)));
+                        float trace = strain.x + strain.y + strain.z;
+
+                        if (trace >= 0.0f)
+                            strain = glm::vec3();
+                        else {
+                            glm::vec3 deviator = strain - trace / 3.0f;
+                            float norm = glm::length(deviator);
+                            float yield = norm + (3.0f * lambda + 2.0f * mu) / (2.0f * mu) *
+                                trace * frictionSlopes[materials[i]];
+
+                            if (yield > 0.0f && norm > 0.0f)
+                                strain -= (yield / norm) * deviator;
+                        }
+
+                        F = U * diagonal(glm::exp(strain)) * glm::transpose(V);
+
+                        float newTrace = strain.x + strain.y + strain.z;
+                        stress = U * diagonal(2.0f * mu * strain + lambda * newTrace) *
+                            glm::transpose(U);
+                        break;
+                    }
+                    case ContinuumMaterial::Liquid:
+                    {
+                        // Keep only the change in volume, with viscous stress
+                        // from the velocity gradient
+                        float J = glm::max(glm::determinant(F), 0.1f);
+
+                        F = glm::mat3(cbrtf(J));
+                        stress = glm::mat3(lambda * J * (J - 1.0f)) +
+                            (material.viscosity * J) * (C + glm::transpose(C));
+                        break;
+                    }
+                    }
+
+                    deformations[i] = F;
+
+                    float mass = material.density * particleVolume;
+                    glm::mat3 affine = stressScale * stress + mass * C;
+                    glm::vec3 momentum = mass * velocities[i];
+
+                    glm::vec3 weights[3], offset;
+                    glm::ivec3 base = getStencil(positions[i], origin, invSpacing, weights, offset) -
+                        coords * blockSize;
+
+                    for (int z = 0; z < 3; z++) {
+                        int nz = base.z + z;
+
+                        for (int y = 0; y < 3; y++) {
+                            int ny = base.y + y;
+                            float wyz = weights[y].y * weights[z].z;
+
+                            for (int x = 0; x < 3; x++) {
+                                int nx = base.x + x;
+                                float w = weights[x].x * wyz;
+                                glm::vec3 d = (offset + glm::vec3((float)x, (float)y, (float)z)) *
+                                    spacing;
+
+                                glm::vec4 & node = blockNodePointers[(nx >> 2) + 2 * (ny >> 2) +
+                                    4 * (nz >> 2)][(nx & 3) + blockSize * ((ny & 3) + blockSize * (nz & 3))];
+
+                                node += w * glm::vec4(momentum + affine * d, mass);
+                            }
+                        }
+                    }
+                }
+            }
+        });
+    }
+}
+
+void Continuum::updateGrid(const glm::vec3 & gravity, ThreadPool & pool) {
+    int numColliders = colliders.size();
+    glm::ivec3 size = grid.getSize();
+    float dt = clock.getStep();
+
+    pool.parallelFor((int)activeBlocks.size(), 1, [&](int thread, int begin, int end) {
+        glm::vec3 *linear = colliders.getLinearImpulses(thread);
+        glm::vec3 *angular = colliders.getAngularImpulses(thread);
+
+        for (int b = begin; b < end; b++) {
+            int c = activeBlocks[b];
+            glm::ivec3 first = blockOrigin + blockSize *
+                glm::ivec3(c % size.x, (c / size.x) % size.y, c / (size.x * size.y));
+            glm::vec4 *blockNodePointer = &nodes[blockNodes[c]];
+
+            for (int n = 0; n < blockNodeCount; n++) {
+                glm::vec4 & node = blockNodePointer[n];
+
+                if (node.w <= 0.0f)
+                    continue;
+
+                glm::vec3 v = glm::vec3(node) / node.w + gravity * dt;
+                glm::vec3 point = glm::vec3(first + glm::ivec3(n & 3, (n >> 2) & 3, n >> 4)) * spacing;
+
+                // Remove velocity into colliders the node is inside or on, and
+                // slow sliding by friction
+                for (int k = 0; k < numColliders; k++) {
+                    const ParticleCollider & collider = colliders[k];
+                    glm::vec3 normal;
+                    float depth;
+
+                    if (!collider.getContact(point, 0.5f * spacing, normal, depth))
+                        continue;
+
+                    glm::vec3 bodyVelocity = collider.getVelocityAtPoint(point);
+                    glm::vec3 relative = v - bodyVelocity;
+                    float normalSpeed = glm::dot(relative, normal);
+
+                    if (normalSpeed >= 0.0f)
+                        continue;
+
+                    glm::vec3 slide = relative - normalSpeed * normal;
+                    float slideSpeed = glm::length(slide);
+
+                    if (slideSpeed > 0.0f)
+                        slide *= std::max(1.0f + friction * normalSpeed / slideSpeed, 0.0f);
+
+                    glm::vec3 corrected = bodyVelocity + slide;
+
+                    // Equal and opposite impulse on the body
+                    glm::vec3 impulse = node.w * (v - corrected);
+                    linear[k] += impulse;
+                    angular[k] += glm::cross(point - collider.position, impulse);
+
+                    v = corrected;
+                }
+
+                node = glm::vec4(v, node.w);
+            }
+        }
+    });
+}
+
+void Continuum::gridToParticles(ThreadPool & pool) {
+    int numThreads = pool.getThreadCount();
+    glm::vec3 origin = grid.getBounds().min;
+    glm::ivec3 size = grid.getSize();
+    float dt = clock.getStep();
+    float affineScale = 4.0f * invSpacing * invSpacing;
+
+    threadBounds.assign(numThreads, AABB::empty());
+    threadSpeeds.assign(numThreads, 0.0f);
+
+    pool.parallelFor((int)activeBlocks.size(), 1, [&](int thread, int begin, int end) {
+        AABB box = threadBounds[thread];
+        float speed = threadSpeeds[thread];
+
+        for (int b = begin; b < end; b++) {
+            int c = activeBlocks[b];
+
+            if (blockStarts[c] == blockStarts[c + 1])
+                continue;
+
+            glm::ivec3 coords(c % size.x, (c / size.x) % size.y, c / (size.x * size.y));
+            const glm::vec4 *blockNodePointers[8];
+
+            for (int k = 0; k < 8; k++)
+                blockNodePointers[k] = &nodes[blockNodes[grid.getCellIndex(coords +
+                    glm::ivec3(k & 1, (k >> 1) & 1, k >> 2))]];
+
+            for (int i = blockStarts[c]; i < blockStarts[c + 1]; i++) {
+                glm::vec3 weights[3], offset;
+                glm::ivec3 base = getStencil(positions[i], origin, invSpacing, weights, offset) -
+                    coords * blockSize;
+
+                glm::vec3 v;
+                glm::mat3 C(0.0f);
+
+                for (int z = 0; z < 3; z++) {
+                    int nz = base.z + z;
+
+                    for (int y = 0; y < 3; y++) {
+                        int ny = base.y + y;
+                        float wyz = weights[y].y * weights[z].z;
+
+                        for (int x = 0; x < 3; x++) {
+                            int nx = base.x + x;
+                            float w = weights[x].x * wyz;
+                            glm::vec3 d = (offset + glm::vec3((float)x, (float)y, (float)z)) * spacing;
+
+                            const glm::vec4 & node = blockNodePointers[(nx >> 2) + 2 * (ny >> 2) +
+                                4 * (nz >> 2)][(nx & 3) + blockSize * ((ny & 3) + blockSize * (nz & 3))];
+                            glm::vec3 nodeVelocity(node);
+
+                            v += w * nodeVelocity;
+                            C += glm::outerProduct(w * nodeVelocity, d);
+                        }
+                    }
+                }
+
+                velocities[i] = v;
+                affines[i] = affineScale * C;
+                positions[i] += v * dt;
+
+                box.merge(positions[i]);
+                speed = std::max(speed, glm::dot(v, v));
+            }
+        }
+
+        threadBounds[thread] = box;
+        threadSpeeds[thread] = speed;
+    });
+
+    bounds = AABB::empty();
+    maxSpeed = 0.0f;
+
+    for (int t = 0; t < numThreads; t++) {
+        bounds.merge(threadBounds[t]);
+        maxSpeed = std::max(maxSpeed, threadSpeeds[t]);
+    }
+
+    maxSpeed = sqrtf(maxSpeed);
+}
+
+void Continuum::step(const glm::vec3 & gravity, Body *const *bodies, int numBodies,
+    ThreadPool & pool)
+{
+    if (positions.empty())
+        return;
+
+    // Copy colliders, so that nodes read them without touching the bodies
+    colliders.set(bodies, numBodies, pool.getThreadCount());
+
+    buildGrid(pool);
+    particlesToGrid(pool);
+    updateGrid(gravity, pool);
+    gridToParticles(pool);
+
+    // Push back on free bodies
+    colliders.apply();
+}
+
+}
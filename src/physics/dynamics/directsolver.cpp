@@ -0,0 +1,403 @@
+/**
+ * @file directsolver.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/directsolver.h>
+#include <physics/dynamics/body.h>
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <set>
+
+namespace Physics {
+
+DirectSolver::DirectSolver()
+    : numRods(0),
+      numSprings(0),
+      componentOffsets(1, 0)
+{
+}
+
+DirectSolver::~DirectSolver() {
+}
+
+void DirectSolver::getRow(const RodPool & rods, const SpringPool & springs, int row,
+    int & body1, int & body2) const
+{
+    if (row < numRods) {
+        body1 = rods.body1[row];
+        body2 = rods.body2[row];
+    }
+    else {
+        body1 = springs.body1[row - numRods];
+        body2 = springs.body2[row - numRods];
+    }
+}
+
+void DirectSolver::getComponentBodies(const RodPool & rods, const SpringPool & springs,
+    int component, int & body1, int & body2) const
+{
+    getRow(rods, springs, rows[componentOffsets[component]], body1, body2);
+}
+
+void DirectSolver::update(const std::vector<std::shared_ptr<Body>> & bodies,
+    const RodPool & rods, const SpringPool & springs)
+{
+    bool rebuild = rods.size() != numRods || springs.size() != numSprings;
+
+    // Bodies added since the last build have no constraints yet
+    for (size_t i = bodyFixed.size(); i < bodies.size() && !rebuild; i++)
+        bodyFixed.push_back(bodies[i]->getFixed());
+
+    for (size_t i = 0; i < bodies.size() && !rebuild; i++)
+        rebuild = bodyFixed[i] != (char)bodies[i]->getFixed();
+
+    if (rebuild)
+        build(bodies, rods, springs);
+}
+
+// Find the entry of L for a row in a column. Elimination guarantees that it
+// exists.
+static int findSlot(const std::vector<int> & columnOffsets, const std::vector<int> & columnRows,
+    int row, int column)
+{
+    return (int)(std::lower_bound(columnRows.begin() + columnOffsets[column],
+        columnRows.begin() + columnOffsets[column + 1], row) - columnRows.begin());
+}
+
+void DirectSolver::build(const std::vector<std::shared_ptr<Body>> & bodies,
+    const RodPool & rods, const SpringPool & springs)
+{
+    numRods = rods.size();
+    numSprings = springs.size();
+
+    int numRows = numRods + numSprings;
+    int numBodies = (int)bodies.size();
+
+    bodyFixed.resize(numBodies);
+
+    for (int i = 0; i < numBodies; i++)
+        bodyFixed[i] = bodies[i]->getFixed();
+
+    // List the rows of each free body, with a counting sort. Fixed bodies do
+    // not couple rows, so that everything hanging from the same fixed body is
+    // not one component.
+    std::vector<int> bodyOffsets(numBodies + 1, 0);
+    std::vector<int> bodyRows;
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int row = 0; row < numRows; row++) {
+            int body[2];
+            getRow(rods, springs, row, body[0], body[1]);
+
+            for (int k = 0; k < 2; k++) {
+                if (bodyFixed[body[k]] || (k == 1 && body[1] == body[0]))
+                    continue;
+
+                if (pass == 0)
+                    bodyOffsets[body[k] + 1]++;
+                else
+                    bodyRows[bodyOffsets[body[k]]++] = row;
+            }
+        }
+
+        if (pass == 0) {
+            for (int i = 1; i <= numBodies; i++)
+                bodyOffsets[i] += bodyOffsets[i - 1];
+
+            bodyRows.resize(bodyOffsets[numBodies]);
+        }
+        else {
+            for (int i = numBodies; i > 0; i--)
+                bodyOffsets[i] = bodyOffsets[i - 1];
+
+            bodyOffsets[0] = 0;
+        }
+    }
+
+    // Rows sharing a free body are coupled
+    std::vector<std::set<int>> adjacency(numRows);
+
+    for (int body = 0; body < numBodies; body++) {
+        for (int i = bodyOffsets[body]; i < bodyOffsets[body + 1]; i++) {
+            for (int j = bodyOffsets[body]; j < i; j++) {
+                adjacency[bodyRows[i]].insert(bodyRows[j]);
+                adjacency[bodyRows[j]].insert(bodyRows[i]);
+            }
+        }
+    }
+
+    // Order each component by minimum degree on the elimination graph.
+    // Eliminating a row connects all of its remaining neighbors, which are the
+    // entries of its column of L.
+    typedef std::pair<int, int> Degree;
+    std::priority_queue<Degree, std::vector<Degree>, std::greater<Degree>> queue;
+    std::vector<int> position(numRows, -1);
+    std::vector<std::vector<int>> patterns(numRows);
+    std::vector<char> visited(numRows, 0);
+    std::vector<int> members;
+
+    rows.clear();
+    componentOffsets.assign(1, 0);
+
+    for (int seed = 0; seed < numRows; seed++) {
+        if (visited[seed])
+            continue;
+
+        members.clear();
+        members.push_back(seed);
+        visited[seed] = 1;
+
+        for (size_t head = 0; head < members.size(); head++) {
+            for (int other : adjacency[members[head]]) {
+                if (!visited[other]) {
+                    visited[other] = 1;
+                    members.push_back(other);
+                }
+            }
+        }
+
+        for (int member : members)
+            queue.push(Degree((int)adjacency[member].size(), member));
+
+        while (!queue.empty()) {
+            Degree top = queue.top();
+            queue.pop();
+
+            int row = top.second;
+
+            // Degrees change as neighbors are eliminated, so skip stale entries
+            if (position[row] >= 0 || top.first != (int)adjacency[row].size())
+                continue;
+
+            position[row] = (int)rows.size();
+            rows.push_back(row);
+
+            std::vector<int> & pattern = patterns[row];
+            pattern.assign(adjacency[row].begin(), adjacency[row].end());
+
+            for (int a : pattern) {
+                adjacency[a].erase(row);
+
+                for (int b : pattern)
+                    if (b != a)
+                        adjacency[a].insert(b);
+            }
+
+            for (int a : pattern)
+                queue.push(Degree((int)adjacency[a].size(), a));
+
+            adjacency[row].clear();
+        }
+
+        componentOffsets.push_back((int)rows.size());
+    }
+
+    // Pattern of L by column, with entries sorted by position
+    columnOffsets.resize(numRows + 1);
+    columnRows.clear();
+
+    for (int k = 0; k < numRows; k++) {
+        columnOffsets[k] = (int)columnRows.size();
+
+        for (int row : patterns[rows[k]])
+            columnRows.push_back(position[row]);
+
+        std::sort(columnRows.begin() + columnOffsets[k], columnRows.end());
+    }
+
+    columnOffsets[numRows] = (int)columnRows.size();
+
+    // Entries updated by eliminating each column
+    updateOffsets.resize(numRows + 1);
+    updates.clear();
+
+    for (int k = 0; k < numRows; k++) {
+        updateOffsets[k] = (int)updates.size();
+
+        for (int e1 = columnOffsets[k]; e1 < columnOffsets[k + 1]; e1++) {
+            for (int e2 = columnOffsets[k]; e2 < e1; e2++) {
+                Update update;
+                update.entry1 = e1;
+                update.entry2 = e2;
+                update.slot = findSlot(columnOffsets, columnRows, columnRows[e1],
+                    columnRows[e2]);
+                updates.push_back(update);
+            }
+        }
+    }
+
+    updateOffsets[numRows] = (int)updates.size();
+
+    // Entries of the matrix itself, ordered by column so that each component's
+    // couplings are together
+    couplings.clear();
+
+    for (int body = 0; body < numBodies; body++) {
+        for (int i = bodyOffsets[body]; i < bodyOffsets[body + 1]; i++) {
+            for (int j = bodyOffsets[body]; j < i; j++) {
+                int row1 = bodyRows[i];
+                int row2 = bodyRows[j];
+                int body1, body2;
+
+                Coupling coupling;
+                coupling.row1 = std::min(position[row1], position[row2]);
+                coupling.row2 = std::max(position[row1], position[row2]);
+                coupling.slot = findSlot(columnOffsets, columnRows, coupling.row2,
+                    coupling.row1);
+                coupling.body = body;
+
+                // The constraint pushes its second body along the normal and
+                // its first body against it
+                getRow(rods, springs, row1, body1, body2);
+                coupling.sign = body2 == body ? 1.0f : -1.0f;
+                getRow(rods, springs, row2, body1, body2);
+                coupling.sign *= body2 == body ? 1.0f : -1.0f;
+
+                couplings.push_back(coupling);
+            }
+        }
+    }
+
+    std::sort(couplings.begin(), couplings.end(),
+        [](const Coupling & a, const Coupling & b) { return a.row1 < b.row1; });
+
+    values.resize(columnRows.size());
+    diagonal.resize(numRows);
+    scratch.resize(numRows);
+}
+
+void DirectSolver::factor(int component, const std::vector<std::shared_ptr<Body>> & bodies,
+    const RodPool & rods, const SpringPool & springs)
+{
+    int start = componentOffsets[component];
+    int end = componentOffsets[component + 1];
+
+    // Rows which are inactive this step, such as rods between coincident
+    // bodies, are left out with a zero diagonal
+    for (int k = start; k < end; k++) {
+        int row = rows[k];
+        int body1, body2;
+        getRow(rods, springs, row, body1, body2);
+
+        float d = bodies[body1]->getInverseMass() + bodies[body2]->getInverseMass();
+
+        if (row < numRods)
+            d = rods.mass[row] > 0.0f ? d : 0.0f;
+        else
+            d = springs.mass[row - numRods] > 0.0f ? d + springs.softness[row - numRods] : 0.0f;
+
+        diagonal[k] = d;
+        scratch[k] = d;
+    }
+
+    std::fill(values.begin() + columnOffsets[start], values.begin() + columnOffsets[end], 0.0f);
+
+    std::vector<Coupling>::const_iterator first = std::lower_bound(couplings.begin(),
+        couplings.end(), start,
+        [](const Coupling & coupling, int row) { return coupling.row1 < row; });
+
+    for (std::vector<Coupling>::const_iterator it = first;
+        it != couplings.end() && it->row1 < end; ++it)
+    {
+        int row1 = rows[it->row1];
+        int row2 = rows[it->row2];
+
+        glm::vec3 n1 = row1 < numRods ? rods.normal[row1] : springs.normal[row1 - numRods];
+        glm::vec3 n2 = row2 < numRods ? rods.normal[row2] : springs.normal[row2 - numRods];
+
+        if (diagonal[it->row1] > 0.0f && diagonal[it->row2] > 0.0f)
+            values[it->slot] += it->sign * bodies[it->body]->getInverseMass() *
+                glm::dot(n1, n2);
+    }
+
+    // Right looking L D L^T. Every update lands on an entry of L, because the
+    // pattern includes fill. Pivots which have lost nearly all of their
+    // original value belong to redundant rows, such as a closed loop of rods,
+    // and are dropped.
+    for (int k = start; k < end; k++) {
+        float d = diagonal[k];
+
+        if (d <= 1e-5f * scratch[k])
+            d = 0.0f;
+
+        diagonal[k] = d;
+
+        float inv = d > 0.0f ? 1.0f / d : 0.0f;
+
+        for (int e = columnOffsets[k]; e < columnOffsets[k + 1]; e++)
+            values[e] *= inv;
+
+        for (int e = columnOffsets[k]; e < columnOffsets[k + 1]; e++)
+            diagonal[columnRows[e]] -= values[e] * values[e] * d;
+
+        for (int u = updateOffsets[k]; u < updateOffsets[k + 1]; u++)
+            values[updates[u].slot] -= values[updates[u].entry1] * values[updates[u].entry2] * d;
+    }
+}
+
+void DirectSolver::solve(int component, const std::vector<std::shared_ptr<Body>> & bodies,
+    RodPool & rods, SpringPool & springs, float & impulseDelta, float & residual)
+{
+    int start = componentOffsets[component];
+    int end = componentOffsets[component + 1];
+
+    for (int k = start; k < end; k++) {
+        int row = rows[k];
+        int body1, body2;
+        getRow(rods, springs, row, body1, body2);
+
+        glm::vec3 rvel = bodies[body2]->getLinearVelocity() - bodies[body1]->getLinearVelocity();
+        float error;
+
+        if (row < numRods)
+            error = glm::dot(rvel, rods.normal[row]) + rods.bias[row];
+        else
+            error = glm::dot(rvel, springs.normal[row - numRods]) + springs.bias[row - numRods] +
+                springs.softness[row - numRods] * springs.impulse[row - numRods];
+
+        if (diagonal[k] == 0.0f)
+            error = 0.0f;
+
+        scratch[k] = -error;
+        residual = std::max(residual, fabsf(error));
+    }
+
+    for (int k = start; k < end; k++)
+        for (int e = columnOffsets[k]; e < columnOffsets[k + 1]; e++)
+            scratch[columnRows[e]] -= values[e] * scratch[k];
+
+    for (int k = start; k < end; k++)
+        scratch[k] = diagonal[k] > 0.0f ? scratch[k] / diagonal[k] : 0.0f;
+
+    for (int k = end - 1; k >= start; k--)
+        for (int e = columnOffsets[k]; e < columnOffsets[k + 1]; e++)
+            scratch[k] -= values[e] * scratch[columnRows[e]];
+
+    for (int k = start; k < end; k++) {
+        int row = rows[k];
+        int body1, body2;
+        getRow(rods, springs, row, body1, body2);
+
+        float J = scratch[k];
+        glm::vec3 n;
+
+        if (row < numRods) {
+            n = rods.normal[row];
+            rods.impulse[row] += J;
+        }
+        else {
+            n = springs.normal[row - numRods];
+            springs.impulse[row - numRods] += J;
+        }
+
+        bodies[body1]->addLinearImpulse(-J * n);
+        bodies[body2]->addLinearImpulse( J * n);
+
+        impulseDelta = std::max(impulseDelta, fabsf(J));
+    }
+}
+
+}
@@ -0,0 +1,648 @@
+/**
+ * @file fluid.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/fluid.h>
+#include <physics/dynamics/body.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+#include <cfloat>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+// Most fluid and boundary particles each particle may be near in a step
+static const int maxNeighbors = 64;
+static const int maxBoundaryNeighbors = 48;
+
+// Neighbours of each particle, with a spare slot past the most kept
+static const int neighborStride = maxNeighbors + 1;
+static const int boundaryNeighborStride = maxBoundaryNeighbors + 1;
+
+// Cells along each axis within the kernel radius. Cells half the radius
+// across hold about one particle at rest, and make the search nearly a sphere.
+static const int cellsPerRadius = 2;
+
+static const float pi = 3.14159265358979f;
+
+// Find whether a particle which moved from a start point overlaps a collider.
+// Particles deep in a cube leave through the face they entered by, rather than
+// the nearest face, so that fast particles are not pushed through thin walls.
+static inline bool getContact(const ParticleCollider & collider, const glm::vec3 & start,
+    const glm::vec3 & point, float radius, glm::vec3 & normal, float & depth)
+{
+    if (!collider.getContact(point, radius, normal, depth))
+        return false;
+
+    if (collider.type == Shape::Cube) {
+        glm::quat inverse = glm::conjugate(collider.orientation);
+        glm::vec3 local = inverse * (point - collider.position);
+
+        if (glm::all(glm::lessThanEqual(glm::abs(local), collider.size))) {
+            glm::vec3 from = inverse * (start - collider.position);
+            glm::vec3 outside = glm::abs(from) - collider.size;
+            int axis = outside.x > outside.y ? (outside.x > outside.z ? 0 : 2) :
+                (outside.y > outside.z ? 1 : 2);
+
+            if (outside[axis] > 0.0f) {
+                float side = from[axis] < 0.0f ? -1.0f : 1.0f;
+                glm::vec3 face;
+                face[axis] = side;
+
+                normal = collider.orientation * face;
+                depth = collider.size[axis] + radius - side * local[axis];
+            }
+        }
+    }
+
+    return true;
+}
+
+Fluid::Fluid(float radius, float restDensity)
+    : radius(radius),
+      kernelRadius(4.0f * radius),
+      restDensity(restDensity),
+      viscosity(0.01f),
+      clock(1.0f / 60.0f),
+      iterations(4),
+      densityError(0.0f)
+{
+    float h = kernelRadius;
+
+    poly6 = 315.0f / (64.0f * pi * powf(h, 9.0f));
+    spiky = -45.0f / (pi * powf(h, 6.0f));
+
+    // Choose the mass so that particles packed at rest are at the rest
+    // density, and find the constraint gradient there
+    float spacing = 2.0f * radius;
+    float sum = 0.0f;
+    float gradient2 = 0.0f;
+
+    for (int z = -2; z <= 2; z++)
+        for (int y = -2; y <= 2; y++)
+            for (int x = -2; x <= 2; x++) {
+                glm::vec3 d = glm::vec3((float)x, (float)y, (float)z) * spacing;
+                float r2 = glm::dot(d, d);
+                glm::vec3 g = kernelGradient(d, r2);
+
+                sum += kernel(r2);
+                gradient2 += glm::dot(g, g);
+            }
+
+    mass = restDensity / sum;
+    relaxation = 0.01f * gradient2 * (mass / restDensity) * (mass / restDensity);
+}
+
+Fluid::~Fluid() {
+}
+
+inline float Fluid::kernel(float r2) const {
+    float h2 = kernelRadius * kernelRadius;
+
+    if (r2 >= h2)
+        return 0.0f;
+
+    float w = h2 - r2;
+    return poly6 * w * w * w;
+}
+
+inline glm::vec3 Fluid::kernelGradient(const glm::vec3 & d, float r2) const {
+    if (r2 >= kernelRadius * kernelRadius || r2 < 1e-12f)
+        return glm::vec3();
+
+    float r = sqrtf(r2);
+    float w = kernelRadius - r;
+
+    return (spiky * w * w / r) * d;
+}
+
+float Fluid::getBoundaryVolume(float spacing1, float spacing2) const {
+    // Volume of a boundary particle on a flat lattice, such that a particle a
+    // radius from the lattice, with fluid packed at rest on its side, is at the
+    // rest density. Then fluid in a corner is also at rest, because each wall
+    // makes up for the fluid missing beyond it.
+    float spacing = 2.0f * radius;
+    float fluidSum = 0.0f;
+    float boundarySum = 0.0f;
+
+    for (int z = 0; z <= 2; z++)
+        for (int y = -2; y <= 2; y++)
+            for (int x = -2; x <= 2; x++) {
+                glm::vec3 d = glm::vec3((float)x, (float)y, (float)z) * spacing;
+                fluidSum += kernel(glm::dot(d, d));
+            }
+
+    int n1 = (int)ceilf(kernelRadius / spacing1);
+    int n2 = (int)ceilf(kernelRadius / spacing2);
+
+    for (int j = -n2; j <= n2; j++)
+        for (int i = -n1; i <= n1; i++) {
+            float u = i * spacing1;
+            float v = j * spacing2;
+
+            boundarySum += kernel(u * u + v * v + radius * radius);
+        }
+
+    return std::max(restDensity - mass * fluidSum, 0.0f) / (restDensity * boundarySum);
+}
+
+void Fluid::addBoundaryParticle(const glm::vec3 & point, float volume, int index) {
+    // Skip points buried in other colliders, such as where walls meet the
+    // ground, which would count twice
+    for (int k = 0; k < colliders.size(); k++) {
+        glm::vec3 normal;
+        float depth;
+
+        if (k != index && colliders[k].getContact(point, -0.25f * radius, normal, depth) &&
+            depth > 0.0f)
+        {
+            return;
+        }
+    }
+
+    boundaryPositions.push_back(point);
+    boundaryVolumes.push_back(volume);
+    boundaryColliders.push_back(index);
+}
+
+void Fluid::addParticle(const glm::vec3 & position, const glm::vec3 & velocity) {
+    positions.push_back(position);
+    velocities.push_back(velocity);
+}
+
+void Fluid::addBox(const glm::vec3 & min, const glm::vec3 & max, const glm::vec3 & velocity) {
+    float spacing = 2.0f * radius;
+    glm::ivec3 count = glm::max(glm::ivec3((max - min) / spacing), glm::ivec3(1));
+
+    for (int z = 0; z < count.z; z++)
+        for (int y = 0; y < count.y; y++)
+            for (int x = 0; x < count.x; x++)
+                addParticle(min + (glm::vec3((float)x, (float)y, (float)z) + 0.5f) * spacing,
+                    velocity);
+}
+
+void Fluid::setStep(float step) {
+    clock.setStep(step);
+}
+
+void Fluid::setIterations(int iterations) {
+    this->iterations = iterations;
+}
+
+void Fluid::setViscosity(float viscosity) {
+    this->viscosity = viscosity;
+}
+
+int Fluid::advance(float dt) {
+    return clock.advance(dt);
+}
+
+AABB Fluid::getBounds(const glm::vec3 & gravity) {
+    AABB box = AABB::empty();
+    float maxSpeed2 = 0.0f;
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        box.merge(positions[i]);
+        maxSpeed2 = std::max(maxSpeed2, glm::dot(velocities[i], velocities[i]));
+    }
+
+    float dt = clock.getStep();
+    box.inflate(kernelRadius + sqrtf(maxSpeed2) * dt + glm::length(gravity) * dt * dt);
+
+    return box;
+}
+
+void Fluid::sampleBoundary(const ParticleCollider & collider, int index, const AABB & box) {
+    float spacing = 2.0f * radius;
+
+    switch (collider.type) {
+    case Shape::Sphere:
+    {
+        float r = collider.size.x;
+        AABB bounds;
+        bounds.min = collider.position - glm::vec3(r);
+        bounds.max = collider.position + glm::vec3(r);
+
+        if (!bounds.overlaps(box))
+            return;
+
+        // Points spiraling over the sphere, about the spacing apart
+        float area = 4.0f * pi * r * r;
+        int count = std::max((int)ceilf(area / (spacing * spacing)), 1);
+        float volume = getBoundaryVolume(sqrtf(area / count), sqrtf(area / count));
+        float turn = pi * (3.0f - sqrtf(5.0f));
+
+        for (int k = 0; k < count; k++) {
+            float y = 1.0f - (2.0f * k + 1.0f) / count;
+            float ring = sqrtf(std::max(1.0f - y * y, 0.0f));
+            float angle = turn * k;
+            glm::vec3 point = collider.position + r * glm::vec3(cosf(angle) * ring, y,
+                sinf(angle) * ring);
+
+            if (glm::all(glm::greaterThanEqual(point, box.min)) &&
+                glm::all(glm::lessThanEqual(point, box.max)))
+            {
+                addBoundaryParticle(point, volume, index);
+            }
+        }
+
+        return;
+    }
+    case Shape::Plane:
+    {
+        // Lattice fixed to the plane, over the part of it in the box
+        glm::vec3 normal = collider.size;
+        glm::vec3 origin = normal * collider.distance;
+        glm::vec3 tangent1 = glm::normalize(glm::cross(normal,
+            fabsf(normal.x) < 0.9f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+        glm::vec3 tangent2 = glm::cross(normal, tangent1);
+        glm::vec3 lo(FLT_MAX), hi(-FLT_MAX);
+
+        for (int c = 0; c < 8; c++) {
+            glm::vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y,
+                (c & 4) ? box.max.z : box.min.z);
+            glm::vec3 local(glm::dot(corner - origin, tangent1), glm::dot(corner - origin, tangent2),
+                glm::dot(corner - origin, normal));
+
+            lo = glm::min(lo, local);
+            hi = glm::max(hi, local);
+        }
+
+        if (lo.z > 0.0f || hi.z < 0.0f)
+            return;
+
+        float volume = getBoundaryVolume(spacing, spacing);
+
+        for (int j = (int)ceilf(lo.y / spacing); j <= (int)floorf(hi.y / spacing); j++)
+            for (int i = (int)ceilf(lo.x / spacing); i <= (int)floorf(hi.x / spacing); i++) {
+                glm::vec3 point = origin + (i * spacing) * tangent1 + (j * spacing) * tangent2;
+
+                if (glm::all(glm::greaterThanEqual(point, box.min)) &&
+                    glm::all(glm::lessThanEqual(point, box.max)))
+                {
+                    addBoundaryParticle(point, volume, index);
+                }
+            }
+
+        return;
+    }
+    case Shape::Cube:
+    {
+        // Lattice over the faces, in body space, over the part of the cube in
+        // the box. Points on an edge belong to the face of the lowest axis.
+        glm::mat3 rotation = glm::mat3_cast(collider.orientation);
+        glm::vec3 center = glm::transpose(rotation) * (box.getCenter() - collider.position);
+        glm::vec3 half = 0.5f * (box.max - box.min);
+        glm::vec3 extent = glm::abs(glm::transpose(rotation)[0]) * half.x +
+            glm::abs(glm::transpose(rotation)[1]) * half.y +
+            glm::abs(glm::transpose(rotation)[2]) * half.z;
+        glm::vec3 lo = center - extent;
+        glm::vec3 hi = center + extent;
+        glm::vec3 size = collider.size;
+        glm::ivec3 count = glm::max(glm::ivec3(glm::round(2.0f * size / spacing)), glm::ivec3(1));
+        glm::vec3 step = 2.0f * size / glm::vec3(count);
+
+        for (int axis = 0; axis < 3; axis++) {
+            int axis1 = (axis + 1) % 3;
+            int axis2 = (axis + 2) % 3;
+            float volume = getBoundaryVolume(step[axis1], step[axis2]);
+
+            // Range of lattice points along the face, without edges already
+            // on faces of lower axes
+            int begin1 = axis1 < axis ? 1 : 0;
+            int end1 = axis1 < axis ? count[axis1] - 1 : count[axis1];
+            int begin2 = axis2 < axis ? 1 : 0;
+            int end2 = axis2 < axis ? count[axis2] - 1 : count[axis2];
+
+            begin1 = std::max(begin1, (int)ceilf((lo[axis1] + size[axis1]) / step[axis1]));
+            end1 = std::min(end1, (int)floorf((hi[axis1] + size[axis1]) / step[axis1]));
+            begin2 = std::max(begin2, (int)ceilf((lo[axis2] + size[axis2]) / step[axis2]));
+            end2 = std::min(end2, (int)floorf((hi[axis2] + size[axis2]) / step[axis2]));
+
+            for (int side = -1; side <= 1; side += 2) {
+                float face = side * size[axis];
+
+                if (face < lo[axis] || face > hi[axis])
+                    continue;
+
+                for (int j = begin2; j <= end2; j++)
+                    for (int i = begin1; i <= end1; i++) {
+                        glm::vec3 local;
+                        local[axis] = face;
+                        local[axis1] = i * step[axis1] - size[axis1];
+                        local[axis2] = j * step[axis2] - size[axis2];
+
+                        addBoundaryParticle(collider.position + rotation * local, volume, index);
+                    }
+            }
+        }
+
+        return;
+    }
+    default:
+        return;
+    }
+}
+
+void Fluid::buildGrid(ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+
+    // Sort particles by cell, and reorder them so that cells are contiguous
+    grid.fit(pool, &predicted[0], numParticles, kernelRadius / cellsPerRadius,
+        std::max(4 * numParticles, 4096));
+    grid.sort(pool, &predicted[0], numParticles, cellStarts, order);
+
+    ParticleGrid::reorder(pool, order, positions, sorted);
+    ParticleGrid::reorder(pool, order, velocities, sorted);
+    ParticleGrid::reorder(pool, order, predicted, sorted);
+
+    // Boundary particles near the fluid, sorted into the same grid
+    AABB box = grid.getBounds();
+    box.inflate(kernelRadius);
+
+    boundaryPositions.clear();
+    boundaryVolumes.clear();
+    boundaryColliders.clear();
+
+    for (int k = 0; k < colliders.size(); k++)
+        sampleBoundary(colliders[k], k, box);
+
+    int numBoundary = (int)boundaryPositions.size();
+
+    grid.sort(pool, numBoundary ? &boundaryPositions[0] : nullptr, numBoundary,
+        boundaryCellStarts, boundaryOrder);
+
+    boundarySorted.resize(numBoundary);
+    boundarySortedVolumes.resize(numBoundary);
+    boundarySortedColliders.resize(numBoundary);
+
+    pool.parallelFor(numBoundary, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            int b = boundaryOrder[i];
+
+            boundarySorted[i] = boundaryPositions[b];
+            boundarySortedVolumes[i] = boundaryVolumes[b];
+            boundarySortedColliders[i] = boundaryColliders[b];
+        }
+    });
+
+    boundaryPositions.swap(boundarySorted);
+    boundaryVolumes.swap(boundarySortedVolumes);
+    boundaryColliders.swap(boundarySortedColliders);
+}
+
+void Fluid::findNeighbors(ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+    float h2 = kernelRadius * kernelRadius;
+
+    neighbors.resize(numParticles * neighborStride);
+    neighborCounts.resize(numParticles);
+    boundaryNeighbors.resize(numParticles * boundaryNeighborStride);
+    boundaryNeighborCounts.resize(numParticles);
+
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        const glm::vec3 *fluidPositions = &predicted[0];
+        const glm::vec3 *boundaryPoints = boundaryPositions.empty() ? nullptr : &boundaryPositions[0];
+        const int *fluidStarts = &cellStarts[0];
+        const int *boundaryStarts = &boundaryCellStarts[0];
+        glm::ivec3 size = grid.getSize();
+
+        for (int i = begin; i < end; i++) {
+            glm::vec3 p = fluidPositions[i];
+            glm::ivec3 cell = grid.getCell(p);
+            int *fluid = &neighbors[i * neighborStride];
+            int *boundary = &boundaryNeighbors[i * boundaryNeighborStride];
+            int numFluid = 0;
+            int numBoundary = 0;
+
+            int x0 = std::max(cell.x - cellsPerRadius, 0);
+            int x1 = std::min(cell.x + cellsPerRadius, size.x - 1);
+            int y0 = std::max(cell.y - cellsPerRadius, 0);
+            int y1 = std::min(cell.y + cellsPerRadius, size.y - 1);
+            int z0 = std::max(cell.z - cellsPerRadius, 0);
+            int z1 = std::min(cell.z + cellsPerRadius, size.z - 1);
+
+            // Cells along x are contiguous, so each row is one range. Each
+            // candidate is written to the next slot, and kept by counting it,
+            // which avoids a branch that is hard to predict.
+            for (int z = z0; z <= z1; z++)
+                for (int y = y0; y <= y1; y++) {
+                    int row = size.x * (y + size.y * z);
+                    int fluidEnd = fluidStarts[row + x1 + 1];
+                    int boundaryEnd = boundaryStarts[row + x1 + 1];
+
+                    for (int j = fluidStarts[row + x0]; j < fluidEnd; j++) {
+                        glm::vec3 d = p - fluidPositions[j];
+
+                        fluid[numFluid] = j;
+                        numFluid += (glm::dot(d, d) < h2) & (j != i) & (numFluid < maxNeighbors);
+                    }
+
+                    for (int j = boundaryStarts[row + x0]; j < boundaryEnd; j++) {
+                        glm::vec3 d = p - boundaryPoints[j];
+
+                        boundary[numBoundary] = j;
+                        numBoundary += (glm::dot(d, d) < h2) & (numBoundary < maxBoundaryNeighbors);
+                    }
+                }
+
+            neighborCounts[i] = numFluid;
+            boundaryNeighborCounts[i] = numBoundary;
+        }
+    });
+}
+
+void Fluid::solveDensity(ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+    int numThreads = pool.getThreadCount();
+    int numColliders = colliders.size();
+    float invDensity = 1.0f / restDensity;
+    float scale = mass * invDensity;
+    float selfDensity = mass * kernel(0.0f);
+    float dt = clock.getStep();
+
+    lambdas.resize(numParticles);
+    densities.resize(numParticles);
+    corrections.resize(numParticles);
+    threadErrors.resize(numThreads);
+
+    for (int iteration = 0; iteration < iterations; iteration++) {
+        std::fill(threadErrors.begin(), threadErrors.end(), 0.0f);
+
+        // Density constraint C = density / rest density - 1, applied only when
+        // compressed, and its multiplier
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            float error = threadErrors[thread];
+
+            for (int i = begin; i < end; i++) {
+                glm::vec3 p = predicted[i];
+                const int *fluid = &neighbors[i * neighborStride];
+                const int *boundary = &boundaryNeighbors[i * boundaryNeighborStride];
+                float density = selfDensity;
+                glm::vec3 gradient;
+                float gradient2 = 0.0f;
+
+                for (int n = 0; n < neighborCounts[i]; n++) {
+                    glm::vec3 d = p - predicted[fluid[n]];
+                    float r2 = glm::dot(d, d);
+                    glm::vec3 g = scale * kernelGradient(d, r2);
+
+                    density += mass * kernel(r2);
+                    gradient += g;
+                    gradient2 += glm::dot(g, g);
+                }
+
+                for (int n = 0; n < boundaryNeighborCounts[i]; n++) {
+                    int b = boundary[n];
+                    glm::vec3 d = p - boundaryPositions[b];
+                    float r2 = glm::dot(d, d);
+
+                    density += restDensity * boundaryVolumes[b] * kernel(r2);
+                    gradient += boundaryVolumes[b] * kernelGradient(d, r2);
+                }
+
+                float c = density * invDensity - 1.0f;
+
+                densities[i] = density;
+                error += std::max(c, 0.0f);
+                lambdas[i] = c > 0.0f ? -c / (gradient2 + glm::dot(gradient, gradient) + relaxation) : 0.0f;
+            }
+
+            threadErrors[thread] = error;
+        });
+
+        densityError = 0.0f;
+
+        for (int t = 0; t < numThreads; t++)
+            densityError += threadErrors[t];
+
+        densityError /= numParticles;
+
+        // Corrections. Boundary particles do not move, so a particle takes the
+        // whole correction against them, and pushes the body back.
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            glm::vec3 *linear = colliders.getLinearImpulses(thread);
+            glm::vec3 *angular = colliders.getAngularImpulses(thread);
+
+            for (int i = begin; i < end; i++) {
+                glm::vec3 p = predicted[i];
+                const int *fluid = &neighbors[i * neighborStride];
+                const int *boundary = &boundaryNeighbors[i * boundaryNeighborStride];
+                float lambda = lambdas[i];
+                glm::vec3 correction;
+
+                for (int n = 0; n < neighborCounts[i]; n++) {
+                    int j = fluid[n];
+                    glm::vec3 d = p - predicted[j];
+
+                    correction += ((lambda + lambdas[j]) * scale) * kernelGradient(d, glm::dot(d, d));
+                }
+
+                if (lambda != 0.0f) {
+                    for (int n = 0; n < boundaryNeighborCounts[i]; n++) {
+                        int b = boundary[n];
+                        glm::vec3 d = p - boundaryPositions[b];
+                        glm::vec3 push = (lambda * boundaryVolumes[b]) * kernelGradient(d, glm::dot(d, d));
+                        glm::vec3 impulse = -mass / dt * push;
+                        int k = boundaryColliders[b];
+
+                        correction += push;
+                        linear[k] += impulse;
+                        angular[k] += glm::cross(boundaryPositions[b] - colliders[k].position, impulse);
+                    }
+                }
+
+                corrections[i] = correction;
+            }
+        });
+
+        // Apply corrections, then keep particles out of bodies
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            glm::vec3 *linear = colliders.getLinearImpulses(thread);
+            glm::vec3 *angular = colliders.getAngularImpulses(thread);
+
+            for (int i = begin; i < end; i++) {
+                glm::vec3 p = predicted[i] + corrections[i];
+
+                for (int k = 0; k < numColliders; k++) {
+                    glm::vec3 normal;
+                    float depth;
+
+                    if (!getContact(colliders[k], positions[i], p, radius, normal, depth))
+                        continue;
+
+                    glm::vec3 impulse = (-mass * depth / dt) * normal;
+
+                    p += depth * normal;
+                    linear[k] += impulse;
+                    angular[k] += glm::cross(p - colliders[k].position, impulse);
+                }
+
+                predicted[i] = p;
+            }
+        });
+    }
+}
+
+void Fluid::step(const glm::vec3 & gravity, Body *const *bodies, int numBodies,
+    ThreadPool & pool)
+{
+    int numParticles = (int)positions.size();
+    float dt = clock.getStep();
+
+    if (numParticles == 0)
+        return;
+
+    // Copy colliders, so that iterations read them without touching the bodies
+    colliders.set(bodies, numBodies, pool.getThreadCount());
+
+    predicted.resize(numParticles);
+
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            velocities[i] += gravity * dt;
+            predicted[i] = positions[i] + velocities[i] * dt;
+        }
+    });
+
+    buildGrid(pool);
+    findNeighbors(pool);
+    solveDensity(pool);
+
+    // Velocity from how far particles moved, then smoothed toward that of
+    // neighbours
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            velocities[i] = (predicted[i] - positions[i]) / dt;
+    });
+
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            glm::vec3 p = predicted[i];
+            glm::vec3 v = velocities[i];
+            const int *fluid = &neighbors[i * neighborStride];
+            glm::vec3 smoothing;
+
+            for (int n = 0; n < neighborCounts[i]; n++) {
+                int j = fluid[n];
+                glm::vec3 d = p - predicted[j];
+
+                smoothing += (mass / densities[j] * kernel(glm::dot(d, d))) * (velocities[j] - v);
+            }
+
+            corrections[i] = v + viscosity * smoothing;
+        }
+    });
+
+    velocities.swap(corrections);
+    positions.swap(predicted);
+
+    // Push back on free bodies
+    colliders.apply();
+}
+
+}
@@ -0,0 +1,466 @@
+/**
+ * @file granular.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/granular.h>
+#include <physics/dynamics/body.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+#include <cfloat>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+// Most grains and bodies each grain may touch. Grains of similar size touch
+// at most twelve others.
+static const int maxNeighbors = 16;
+static const int maxBodyContacts = 4;
+
+static const float pi = 3.14159265358979f;
+
+// Ratio of tangential to normal stiffness, as for elastic spheres
+static const float tangentialStiffness = 2.0f / 7.0f;
+
+GranularMaterial::GranularMaterial(float density, float stiffness, float restitution,
+    float friction, float rollingFriction)
+    : density(density),
+      stiffness(stiffness),
+      restitution(restitution),
+      friction(friction),
+      rollingFriction(rollingFriction)
+{
+}
+
+/**
+ * @brief Force on a grain from a contact, with a linear spring and dashpot
+ * along the normal, and a tangential spring limited by friction
+ *
+ * @param[in]    normal       Direction from the other grain or body
+ * @param[in]    overlap      Depth of the contact
+ * @param[in]    velocity     Velocity of the contact point relative to the other
+ * @param[in]    stiffness    Normal stiffness
+ * @param[in]    damping      Normal damping
+ * @param[in]    friction     Friction coefficient
+ * @param[in]    dt           Step length
+ * @param[inout] tangent      Tangential spring displacement
+ * @param[out]   normalForce  Magnitude of the normal force
+ */
+static inline glm::vec3 getContactForce(const glm::vec3 & normal, float overlap,
+    const glm::vec3 & velocity, float stiffness, float damping, float friction, float dt,
+    glm::vec3 & tangent, float & normalForce)
+{
+    float normalSpeed = glm::dot(velocity, normal);
+    glm::vec3 slide = velocity - normalSpeed * normal;
+
+    // The dashpot may not pull grains together
+    normalForce = std::max(stiffness * overlap - damping * normalSpeed, 0.0f);
+
+    // Keep the spring in the tangent plane as the contact turns
+    float kt = tangentialStiffness * stiffness;
+    float ct = sqrtf(tangentialStiffness) * damping;
+
+    tangent -= glm::dot(tangent, normal) * normal;
+    tangent += slide * dt;
+
+    glm::vec3 force = -kt * tangent - ct * slide;
+    float limit = friction * normalForce;
+    float force2 = glm::dot(force, force);
+
+    // Slip, leaving the spring where it holds the friction limit
+    if (force2 > limit * limit) {
+        force *= limit / sqrtf(force2);
+        tangent = -(force + ct * slide) / kt;
+    }
+
+    return normalForce * normal + force;
+}
+
+Granular::Granular(float skin)
+    : skin(skin),
+      maxRadius(0.0f),
+      maxMoved(0.0f),
+      rebuild(true),
+      bounds(AABB::empty()),
+      maxSpeed(0.0f),
+      clock(1e-4f)
+{
+}
+
+Granular::~Granular() {
+}
+
+int Granular::addMaterial(const GranularMaterial & material) {
+    // Damping ratio which gives the restitution, for a linear spring
+    float e = std::min(std::max(material.restitution, 1e-4f), 1.0f);
+    float l = logf(e);
+
+    materialTable.push_back(material);
+    dampingRatios.push_back(-l / sqrtf(pi * pi + l * l));
+
+    return (int)materialTable.size() - 1;
+}
+
+void Granular::addGrain(const glm::vec3 & position, float radius, int material,
+    const glm::vec3 & velocity)
+{
+    positions.push_back(position);
+    velocities.push_back(velocity);
+    angularVelocities.push_back(glm::vec3());
+    radii.push_back(radius);
+    materials.push_back((unsigned char)material);
+    masses.push_back(materialTable[material].density * 4.0f / 3.0f * pi * radius * radius * radius);
+
+    int numGrains = (int)positions.size();
+
+    neighbors.resize(numGrains * maxNeighbors);
+    tangents.resize(numGrains * maxNeighbors);
+    neighborCounts.push_back(0);
+    bodyContacts.resize(numGrains * maxBodyContacts);
+    bodyTangents.resize(numGrains * maxBodyContacts);
+    bodyContactCounts.push_back(0);
+
+    maxRadius = std::max(maxRadius, radius);
+    maxSpeed = std::max(maxSpeed, glm::length(velocity));
+    bounds.merge(position);
+    rebuild = true;
+}
+
+void Granular::setStep(float step) {
+    clock.setStep(step);
+}
+
+float Granular::getStableStep() {
+    float minMass = FLT_MAX;
+    float maxStiffness = 0.0f;
+
+    for (size_t i = 0; i < masses.size(); i++)
+        minMass = std::min(minMass, masses[i]);
+
+    for (auto & material : materialTable)
+        maxStiffness = std::max(maxStiffness, material.stiffness);
+
+    if (masses.empty() || maxStiffness == 0.0f)
+        return clock.getStep();
+
+    return 0.1f * pi * sqrtf(minMass / maxStiffness);
+}
+
+int Granular::advance(float dt) {
+    return clock.advance(dt);
+}
+
+AABB Granular::getBounds(const glm::vec3 & gravity) {
+    AABB box = bounds;
+    float dt = clock.getStep();
+
+    box.inflate(maxRadius + maxSpeed * dt + glm::length(gravity) * dt * dt);
+
+    return box;
+}
+
+void Granular::buildNeighbors(ThreadPool & pool) {
+    int numGrains = (int)positions.size();
+
+    // Cells as wide as the farthest two grains may be apart and be neighbours
+    grid.fit(pool, &positions[0], numGrains, 2.0f * maxRadius + skin,
+        std::max(2 * numGrains, 4096));
+    grid.sort(pool, &positions[0], numGrains, cellStarts, order);
+
+    // Reorder grains, with their contacts, so that cells are contiguous
+    std::vector<glm::vec3> sortedVectors;
+    std::vector<float> sortedFloats;
+    std::vector<int> sortedInts;
+    std::vector<unsigned char> sortedMaterials;
+    std::vector<Body *> sortedBodies;
+
+    ParticleGrid::reorder(pool, order, positions, sortedVectors);
+    ParticleGrid::reorder(pool, order, velocities, sortedVectors);
+    ParticleGrid::reorder(pool, order, angularVelocities, sortedVectors);
+    ParticleGrid::reorder(pool, order, radii, sortedFloats);
+    ParticleGrid::reorder(pool, order, materials, sortedMaterials);
+    ParticleGrid::reorder(pool, order, masses, sortedFloats);
+    ParticleGrid::reorder(pool, order, neighbors, sortedInts, maxNeighbors);
+    ParticleGrid::reorder(pool, order, tangents, sortedVectors, maxNeighbors);
+    ParticleGrid::reorder(pool, order, neighborCounts, sortedInts);
+    ParticleGrid::reorder(pool, order, bodyContacts, sortedBodies, maxBodyContacts);
+    ParticleGrid::reorder(pool, order, bodyTangents, sortedVectors, maxBodyContacts);
+    ParticleGrid::reorder(pool, order, bodyContactCounts, sortedInts);
+
+    newIndices.resize(numGrains);
+
+    pool.parallelFor(numGrains, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            newIndices[order[i]] = i;
+    });
+
+    // Each grain finds its neighbours, and keeps the springs of contacts it
+    // already had, whose neighbours are still in the old order
+    pool.parallelFor(numGrains, grain, [&](int thread, int begin, int end) {
+        glm::ivec3 size = grid.getSize();
+
+        for (int i = begin; i < end; i++) {
+            glm::vec3 p = positions[i];
+            float r = radii[i] + skin;
+            glm::ivec3 cell = grid.getCell(p);
+            int *row = &neighbors[i * maxNeighbors];
+            glm::vec3 *springs = &tangents[i * maxNeighbors];
+            int found[maxNeighbors];
+            glm::vec3 kept[maxNeighbors];
+            int numFound = 0;
+
+            int x0 = std::max(cell.x - 1, 0);
+            int x1 = std::min(cell.x + 1, size.x - 1);
+
+            for (int z = std::max(cell.z - 1, 0); z <= std::min(cell.z + 1, size.z - 1); z++)
+                for (int y = std::max(cell.y - 1, 0); y <= std::min(cell.y + 1, size.y - 1); y++) {
+                    int cells = grid.getCellIndex(glm::ivec3(0, y, z));
+                    int last = cellStarts[cells + x1 + 1];
+
+                    for (int j = cellStarts[cells + x0]; j < last && numFound < maxNeighbors; j++) {
+                        glm::vec3 d = p - positions[j];
+                        float reach = r + radii[j];
+
+                        if (j == i || glm::dot(d, d) >= reach * reach)
+                            continue;
+
+                        glm::vec3 spring;
+
+                        for (int k = 0; k < neighborCounts[i]; k++) {
+                            if (newIndices[row[k]] == j) {
+                                spring = springs[k];
+                                break;
+                            }
+                        }
+
+                        found[numFound] = j;
+                        kept[numFound] = spring;
+                        numFound++;
+                    }
+                }
+
+            for (int k = 0; k < numFound; k++) {
+                row[k] = found[k];
+                springs[k] = kept[k];
+            }
+
+            neighborCounts[i] = numFound;
+        }
+    });
+
+    listPositions = positions;
+    maxMoved = 0.0f;
+    rebuild = false;
+}
+
+void Granular::computeForces(const glm::vec3 & gravity, ThreadPool & pool) {
+    int numGrains = (int)positions.size();
+    int numColliders = colliders.size();
+    float dt = clock.getStep();
+
+    forces.resize(numGrains);
+    torques.resize(numGrains);
+
+    pool.parallelFor(numGrains, grain, [&](int thread, int begin, int end) {
+        glm::vec3 *linear = colliders.getLinearImpulses(thread);
+        glm::vec3 *angular = colliders.getAngularImpulses(thread);
+
+        for (int i = begin; i < end; i++) {
+            glm::vec3 p = positions[i];
+            glm::vec3 v = velocities[i];
+            glm::vec3 w = angularVelocities[i];
+            float r = radii[i];
+            float m = masses[i];
+            const GranularMaterial & material = materialTable[materials[i]];
+            float zeta = dampingRatios[materials[i]];
+            const int *row = &neighbors[i * maxNeighbors];
+            glm::vec3 *springs = &tangents[i * maxNeighbors];
+            glm::vec3 force = m * gravity;
+            glm::vec3 torque;
+
+            for (int k = 0; k < neighborCounts[i]; k++) {
+                int j = row[k];
+                glm::vec3 d = p - positions[j];
+                float reach = r + radii[j];
+                float dist2 = glm::dot(d, d);
+
+                if (dist2 >= reach * reach) {
+                    springs[k] = glm::vec3();
+                    continue;
+                }
+
+                // Properties of the pair are the mean of the two materials
+                const GranularMaterial & other = materialTable[materials[j]];
+                float dist = sqrtf(dist2);
+                glm::vec3 normal = dist > 0.0f ? d / dist : glm::vec3(0, 1, 0);
+                float stiffness = 0.5f * (material.stiffness + other.stiffness);
+                float mass = m * masses[j] / (m + masses[j]);
+                float damping = (zeta + dampingRatios[materials[j]]) * sqrtf(mass * stiffness);
+                float friction = 0.5f * (material.friction + other.friction);
+                glm::vec3 wj = angularVelocities[j];
+
+                glm::vec3 velocity = v - velocities[j] - glm::cross(w, r * normal) -
+                    glm::cross(wj, radii[j] * normal);
+
+                float normalForce;
+                glm::vec3 f = getContactForce(normal, reach - dist, velocity, stiffness, damping,
+                    friction, dt, springs[k], normalForce);
+
+                force += f;
+                torque += glm::cross(-r * normal, f - normalForce * normal);
+
+                // Rolling friction, no more than would stop the relative
+                // rotation this step
+                glm::vec3 roll = w - wj;
+                float rollSpeed = glm::length(roll);
+
+                if (rollSpeed > 0.0f) {
+                    float rolling = 0.5f * (material.rollingFriction + other.rollingFriction);
+                    float limit = 0.4f * m * r * r * rollSpeed / dt;
+                    float resist = std::min(rolling * normalForce * r * radii[j] / reach, 0.5f * limit);
+
+                    torque -= (resist / rollSpeed) * roll;
+                }
+            }
+
+            // Contacts with bodies, keeping the springs of bodies still
+            // touched
+            Body **contacts = &bodyContacts[i * maxBodyContacts];
+            glm::vec3 *bodySprings = &bodyTangents[i * maxBodyContacts];
+            Body *touched[maxBodyContacts];
+            glm::vec3 kept[maxBodyContacts];
+            int numTouched = 0;
+
+            for (int c = 0; c < numColliders && numTouched < maxBodyContacts; c++) {
+                const ParticleCollider & collider = colliders[c];
+                glm::vec3 normal;
+                float depth;
+
+                if (!collider.getContact(p, r, normal, depth))
+                    continue;
+
+                glm::vec3 spring;
+
+                for (int k = 0; k < bodyContactCounts[i]; k++) {
+                    if (contacts[k] == collider.body) {
+                        spring = bodySprings[k];
+                        break;
+                    }
+                }
+
+                glm::vec3 point = p - r * normal;
+                glm::vec3 velocity = v - glm::cross(w, r * normal) - collider.getVelocityAtPoint(point);
+                float damping = 2.0f * zeta * sqrtf(m * material.stiffness);
+
+                float normalForce;
+                glm::vec3 f = getContactForce(normal, depth, velocity, material.stiffness, damping,
+                    material.friction, dt, spring, normalForce);
+                glm::vec3 slide = f - normalForce * normal;
+
+                force += f;
+                torque += glm::cross(-r * normal, slide);
+
+                float rollSpeed = glm::length(w);
+
+                if (rollSpeed > 0.0f) {
+                    float limit = 0.4f * m * r * r * rollSpeed / dt;
+                    float resist = std::min(material.rollingFriction * normalForce * r, 0.5f * limit);
+
+                    torque -= (resist / rollSpeed) * w;
+                }
+
+                // Equal and opposite impulse on the body
+                glm::vec3 impulse = -f * dt;
+                linear[c] += impulse;
+                angular[c] += glm::cross(point - collider.position, impulse);
+
+                touched[numTouched] = collider.body;
+                kept[numTouched] = spring;
+                numTouched++;
+            }
+
+            for (int k = 0; k < numTouched; k++) {
+                contacts[k] = touched[k];
+                bodySprings[k] = kept[k];
+            }
+
+            bodyContactCounts[i] = numTouched;
+            forces[i] = force;
+            torques[i] = torque;
+        }
+    });
+}
+
+void Granular::integrate(ThreadPool & pool) {
+    int numGrains = (int)positions.size();
+    int numThreads = pool.getThreadCount();
+    float dt = clock.getStep();
+
+    threadBounds.assign(numThreads, AABB::empty());
+    threadMoved.assign(numThreads, 0.0f);
+    threadSpeeds.assign(numThreads, 0.0f);
+
+    pool.parallelFor(numGrains, grain, [&](int thread, int begin, int end) {
+        AABB box = threadBounds[thread];
+        float moved = threadMoved[thread];
+        float speed = threadSpeeds[thread];
+
+        for (int i = begin; i < end; i++) {
+            float m = masses[i];
+            float inertia = 0.4f * m * radii[i] * radii[i];
+
+            velocities[i] += forces[i] * (dt / m);
+            angularVelocities[i] += torques[i] * (dt / inertia);
+            positions[i] += velocities[i] * dt;
+
+            glm::vec3 d = positions[i] - listPositions[i];
+
+            box.merge(positions[i]);
+            moved = std::max(moved, glm::dot(d, d));
+            speed = std::max(speed, glm::dot(velocities[i], velocities[i]));
+        }
+
+        threadBounds[thread] = box;
+        threadMoved[thread] = moved;
+        threadSpeeds[thread] = speed;
+    });
+
+    bounds = AABB::empty();
+    maxMoved = 0.0f;
+    maxSpeed = 0.0f;
+
+    for (int t = 0; t < numThreads; t++) {
+        bounds.merge(threadBounds[t]);
+        maxMoved = std::max(maxMoved, threadMoved[t]);
+        maxSpeed = std::max(maxSpeed, threadSpeeds[t]);
+    }
+
+    maxMoved = sqrtf(maxMoved);
+    maxSpeed = sqrtf(maxSpeed);
+}
+
+void Granular::step(const glm::vec3 & gravity, Body *const *bodies, int numBodies,
+    ThreadPool & pool)
+{
+    if (positions.empty())
+        return;
+
+    // Copy colliders, so that grains read them without touching the bodies
+    colliders.set(bodies, numBodies, pool.getThreadCount());
+
+    // Pairs closer than the skin are in the lists, and the distance between
+    // two grains shrinks by at most twice the farthest any grain has moved
+    if (rebuild || 2.0f * maxMoved >= skin)
+        buildNeighbors(pool);
+
+    computeForces(gravity, pool);
+    integrate(pool);
+
+    // Push back on free bodies
+    colliders.apply();
+}
+
+}
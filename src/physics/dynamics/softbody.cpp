@@ -0,0 +1,677 @@
+/**
+ * @file softbody.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/softbody.h>
+#include <physics/dynamics/body.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+// Batches of elements handed to each thread at a time
+static const int batchGrain = 16;
+
+// Stride between threads' partial sums, so that they do not share cache lines
+static const int partialStride = 8;
+
+// Polar decomposition iterations per step. Rotations are warm started from the
+// last step, so they change little between iterations.
+static const int polarIterations = 4;
+
+// Faces of a positively oriented tetrahedron, wound counterclockwise from
+// outside
+static const int tetrahedronFaces[4][3] = {
+    { 0, 2, 1 },
+    { 0, 1, 3 },
+    { 0, 3, 2 },
+    { 1, 2, 3 }
+};
+
+SoftBody::SoftBody(const std::vector<glm::vec3> & positions, const std::vector<int> & tetrahedra,
+    float density, float youngsModulus, float poissonRatio)
+    : positions(positions),
+      velocities(positions.size()),
+      lumpedMasses(positions.size(), 0.0f),
+      stiffnessDiagonal(positions.size(), 0.0f),
+      tetrahedra(tetrahedra),
+      damping(0.01f),
+      maxIterations(50),
+      tolerance(1e-3f),
+      iterations(0),
+      error(0.0f),
+      thickness(0.01f),
+      friction(0.5f)
+{
+    mu = youngsModulus / (2.0f * (1.0f + poissonRatio));
+    lambda = youngsModulus * poissonRatio / ((1.0f + poissonRatio) * (1.0f - 2.0f * poissonRatio));
+
+    int numElements = (int)tetrahedra.size() / 4;
+
+    restInverses.resize(numElements);
+    volumes.resize(numElements);
+    orientations.resize(numElements);
+    rotations.resize(numElements);
+    elementForces.resize(numElements * 3);
+
+    for (int e = 0; e < numElements; e++) {
+        int *nodes = &this->tetrahedra[e * 4];
+        glm::vec3 x0 = positions[nodes[0]];
+
+        glm::mat3 edges(positions[nodes[1]] - x0, positions[nodes[2]] - x0,
+            positions[nodes[3]] - x0);
+
+        // Orient every element positively, so that faces wind outward
+        if (glm::determinant(edges) < 0.0f) {
+            std::swap(nodes[2], nodes[3]);
+            std::swap(edges[1], edges[2]);
+        }
+
+        restInverses[e] = glm::inverse(edges);
+        volumes[e] = glm::determinant(edges) / 6.0f;
+
+        // Gradients of the shape functions, which are the rows of the inverse,
+        // give each node's share of the stiffness diagonal
+        glm::mat3 gradients = glm::transpose(restInverses[e]);
+
+        for (int c = 0; c < 4; c++) {
+            glm::vec3 b = c == 0 ? -(gradients[0] + gradients[1] + gradients[2]) : gradients[c - 1];
+            float b2 = glm::dot(b, b);
+
+            lumpedMasses[nodes[c]] += density * volumes[e] * 0.25f;
+            stiffnessDiagonal[nodes[c]] += volumes[e] * (mu * b2 + (lambda + mu) * b2 / 3.0f);
+        }
+    }
+
+    masses = lumpedMasses;
+
+    buildAdjacency();
+    buildSurface();
+}
+
+SoftBody::~SoftBody() {
+}
+
+std::shared_ptr<SoftBody> SoftBody::createBox(glm::vec3 center, glm::vec3 size, int nx, int ny,
+    int nz, float density, float youngsModulus, float poissonRatio)
+{
+    std::vector<glm::vec3> positions;
+    std::vector<int> tetrahedra;
+
+    glm::vec3 corner = center - size * 0.5f;
+    glm::vec3 cell = size / glm::vec3((float)nx, (float)ny, (float)nz);
+
+    for (int z = 0; z <= nz; z++)
+        for (int y = 0; y <= ny; y++)
+            for (int x = 0; x <= nx; x++)
+                positions.push_back(corner + cell * glm::vec3((float)x, (float)y, (float)z));
+
+    // Each cell is split into six tetrahedra around its diagonal, the same way
+    // in every cell, so that neighboring cells share faces
+    static const int axes[6][2] = {
+        { 1, 2 }, { 1, 4 }, { 2, 1 }, { 2, 4 }, { 4, 1 }, { 4, 2 }
+    };
+
+    for (int z = 0; z < nz; z++) {
+        for (int y = 0; y < ny; y++) {
+            for (int x = 0; x < nx; x++) {
+                int corners[8];
+
+                for (int b = 0; b < 8; b++)
+                    corners[b] = ((z + (b >> 2)) * (ny + 1) + y + ((b >> 1) & 1)) * (nx + 1) +
+                        x + (b & 1);
+
+                for (int t = 0; t < 6; t++) {
+                    tetrahedra.push_back(corners[0]);
+                    tetrahedra.push_back(corners[axes[t][0]]);
+                    tetrahedra.push_back(corners[axes[t][0] | axes[t][1]]);
+                    tetrahedra.push_back(corners[7]);
+                }
+            }
+        }
+    }
+
+    return std::make_shared<SoftBody>(positions, tetrahedra, density, youngsModulus,
+        poissonRatio);
+}
+
+void SoftBody::setPosition(int node, glm::vec3 position) {
+    positions[node] = position;
+}
+
+void SoftBody::setVelocity(int node, glm::vec3 velocity) {
+    velocities[node] = velocity;
+}
+
+void SoftBody::setFixed(int node, bool fixed) {
+    masses[node] = fixed ? 0.0f : lumpedMasses[node];
+
+    if (fixed)
+        velocities[node] = glm::vec3();
+}
+
+void SoftBody::setDamping(float damping) {
+    this->damping = damping;
+}
+
+void SoftBody::setThickness(float thickness) {
+    this->thickness = thickness;
+}
+
+void SoftBody::setFriction(float friction) {
+    this->friction = friction;
+}
+
+void SoftBody::setSolverIterations(int maxIterations) {
+    this->maxIterations = maxIterations;
+}
+
+void SoftBody::setSolverTolerance(float tolerance) {
+    this->tolerance = tolerance;
+}
+
+void SoftBody::buildAdjacency() {
+    // Counting sort of element corners by node
+    int numNodes = (int)positions.size();
+    int numCorners = (int)tetrahedra.size();
+
+    adjacencyOffsets.assign(numNodes + 1, 0);
+
+    for (int k = 0; k < numCorners; k++)
+        adjacencyOffsets[tetrahedra[k] + 1]++;
+
+    for (int i = 1; i <= numNodes; i++)
+        adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+
+    adjacency.resize(numCorners);
+
+    std::vector<int> next(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+    for (int k = 0; k < numCorners; k++)
+        adjacency[next[tetrahedra[k]]++] = k;
+}
+
+void SoftBody::buildSurface() {
+    // Faces of one element only are on the surface. Faces are sorted by their
+    // sorted nodes, so that shared faces are next to each other.
+    struct Face {
+        int key[3];
+        int nodes[3];
+
+        bool operator<(const Face & other) const {
+            return std::lexicographical_compare(key, key + 3, other.key, other.key + 3);
+        }
+    };
+
+    int numElements = (int)volumes.size();
+    std::vector<Face> faces(numElements * 4);
+
+    for (int e = 0; e < numElements; e++) {
+        for (int f = 0; f < 4; f++) {
+            Face & face = faces[e * 4 + f];
+
+            for (int c = 0; c < 3; c++)
+                face.key[c] = face.nodes[c] = tetrahedra[e * 4 + tetrahedronFaces[f][c]];
+
+            std::sort(face.key, face.key + 3);
+        }
+    }
+
+    std::sort(faces.begin(), faces.end());
+
+    std::vector<int> vertices(positions.size(), -1);
+
+    surfaceNodes.clear();
+    surfaceTriangles.clear();
+
+    for (size_t f = 0; f < faces.size(); ) {
+        size_t next = f + 1;
+
+        while (next < faces.size() && !(faces[f] < faces[next]))
+            next++;
+
+        if (next == f + 1) {
+            for (int c = 0; c < 3; c++) {
+                int node = faces[f].nodes[c];
+
+                if (vertices[node] < 0) {
+                    vertices[node] = (int)surfaceNodes.size();
+                    surfaceNodes.push_back(node);
+                }
+
+                surfaceTriangles.push_back(vertices[node]);
+            }
+        }
+
+        f = next;
+    }
+}
+
+void SoftBody::computeSurfaceNormals(std::vector<glm::vec3> & normals) {
+    normals.assign(surfaceNodes.size(), glm::vec3());
+
+    for (size_t t = 0; t < surfaceTriangles.size(); t += 3) {
+        int v0 = surfaceTriangles[t];
+        int v1 = surfaceTriangles[t + 1];
+        int v2 = surfaceTriangles[t + 2];
+
+        glm::vec3 x0 = positions[surfaceNodes[v0]];
+        glm::vec3 n = glm::cross(positions[surfaceNodes[v1]] - x0, positions[surfaceNodes[v2]] - x0);
+
+        normals[v0] += n;
+        normals[v1] += n;
+        normals[v2] += n;
+    }
+
+    for (auto & normal : normals) {
+        float length = glm::length(normal);
+
+        if (length > 0.0f)
+            normal /= length;
+    }
+}
+
+AABB SoftBody::getBounds(const glm::vec3 & gravity, float dt) {
+    AABB box = AABB::empty();
+    float maxSpeed2 = 0.0f;
+
+    for (size_t i = 0; i < positions.size(); i++) {
+        box.merge(positions[i]);
+        maxSpeed2 = std::max(maxSpeed2, glm::dot(velocities[i], velocities[i]));
+    }
+
+    box.inflate(thickness + sqrtf(maxSpeed2) * dt + glm::length(gravity) * dt * dt);
+
+    return box;
+}
+
+void SoftBody::computeRotations(ThreadPool & pool) {
+    int numElements = (int)volumes.size();
+    int numBatches = (numElements + SOFTBODY_BATCH_SIZE - 1) / SOFTBODY_BATCH_SIZE;
+
+    pool.parallelFor(numBatches, batchGrain, [&](int thread, int begin, int end) {
+        for (int batch = begin; batch < end; batch++) {
+            int first = batch * SOFTBODY_BATCH_SIZE;
+
+            // Deformation gradients and rotations of the batch, by component.
+            // A short last batch repeats its last element.
+            float a[9][SOFTBODY_BATCH_SIZE];
+            float qw[SOFTBODY_BATCH_SIZE];
+            float qx[SOFTBODY_BATCH_SIZE];
+            float qy[SOFTBODY_BATCH_SIZE];
+            float qz[SOFTBODY_BATCH_SIZE];
+
+            for (int l = 0; l < SOFTBODY_BATCH_SIZE; l++) {
+                int e = std::min(first + l, numElements - 1);
+                const int *nodes = &tetrahedra[e * 4];
+                glm::vec3 x0 = positions[nodes[0]];
+
+                glm::mat3 edges(positions[nodes[1]] - x0, positions[nodes[2]] - x0,
+                    positions[nodes[3]] - x0);
+
+                glm::mat3 F = edges * restInverses[e];
+
+                for (int c = 0; c < 3; c++)
+                    for (int r = 0; r < 3; r++)
+                        a[c * 3 + r][l] = F[c][r];
+
+                qw[l] = orientations[e].w;
+                qx[l] = orientations[e].x;
+                qy[l] = orientations[e].y;
+                qz[l] = orientations[e].z;
+            }
+
+            // Extract the rotation of each deformation gradient by rotating
+            // toward the columns of the gradient (Muller et al., "A Robust
+            // Method to Extract the Rotational Part of Deformations"). The
+            // loop over lanes has no branches, so that the compiler turns it
+            // into a few SIMD instructions.
+            for (int it = 0; it < polarIterations; it++) {
+                for (int l = 0; l < SOFTBODY_BATCH_SIZE; l++) {
+                    float w = qw[l], x = qx[l], y = qy[l], z = qz[l];
+
+                    float r00 = 1.0f - 2.0f * (y * y + z * z);
+                    float r01 = 2.0f * (x * y + w * z);
+                    float r02 = 2.0f * (x * z - w * y);
+                    float r10 = 2.0f * (x * y - w * z);
+                    float r11 = 1.0f - 2.0f * (x * x + z * z);
+                    float r12 = 2.0f * (y * z + w * x);
+                    float r20 = 2.0f * (x * z + w * y);
+                    float r21 = 2.0f * (y * z - w * x);
+                    float r22 = 1.0f - 2.0f * (x * x + y * y);
+
+                    // Sum of columns of the rotation crossed with columns of
+                    // the gradient, over the sum of their dot products
+                    float ox = r01 * a[2][l] - r02 * a[1][l] + r11 * a[5][l] - r12 * a[4][l] +
+                        r21 * a[8][l] - r22 * a[7][l];
+                    float oy = r02 * a[0][l] - r00 * a[2][l] + r12 * a[3][l] - r10 * a[5][l] +
+                        r22 * a[6][l] - r20 * a[8][l];
+                    float oz = r00 * a[1][l] - r01 * a[0][l] + r10 * a[4][l] - r11 * a[3][l] +
+                        r20 * a[7][l] - r21 * a[6][l];
+
+                    float d = r00 * a[0][l] + r01 * a[1][l] + r02 * a[2][l] +
+                        r10 * a[3][l] + r11 * a[4][l] + r12 * a[5][l] +
+                        r20 * a[6][l] + r21 * a[7][l] + r22 * a[8][l];
+
+                    float scale = 0.5f / (fabsf(d) + 1e-9f);
+                    ox *= scale;
+                    oy *= scale;
+                    oz *= scale;
+
+                    // Rotate by the half angle vector, then renormalize
+                    float nw = w - (ox * x + oy * y + oz * z);
+                    float nx = x + ox * w + (oy * z - oz * y);
+                    float ny = y + oy * w + (oz * x - ox * z);
+                    float nz = z + oz * w + (ox * y - oy * x);
+
+                    float norm = 1.0f / sqrtf(nw * nw + nx * nx + ny * ny + nz * nz);
+
+                    qw[l] = nw * norm;
+                    qx[l] = nx * norm;
+                    qy[l] = ny * norm;
+                    qz[l] = nz * norm;
+                }
+            }
+
+            // Elastic forces, from linear stress in the rotated frame
+            for (int l = 0; l < SOFTBODY_BATCH_SIZE && first + l < numElements; l++) {
+                int e = first + l;
+
+                glm::quat q(qw[l], qx[l], qy[l], qz[l]);
+                glm::mat3 R = glm::mat3_cast(q);
+
+                glm::mat3 F;
+
+                for (int c = 0; c < 3; c++)
+                    for (int r = 0; r < 3; r++)
+                        F[c][r] = a[c * 3 + r][l];
+
+                glm::mat3 G = glm::transpose(R) * F - glm::mat3(1.0f);
+                glm::mat3 stress = mu * (G + glm::transpose(G)) +
+                    lambda * (G[0][0] + G[1][1] + G[2][2]) * glm::mat3(1.0f);
+
+                glm::mat3 H = -volumes[e] * (R * stress) * glm::transpose(restInverses[e]);
+
+                orientations[e] = q;
+                rotations[e] = R;
+                elementForces[e * 3] = H[0];
+                elementForces[e * 3 + 1] = H[1];
+                elementForces[e * 3 + 2] = H[2];
+            }
+        }
+    });
+}
+
+void SoftBody::computeElementProducts(ThreadPool & pool, const std::vector<glm::vec3> & x) {
+    // Stiffness times x, with each element's rotation held fixed
+    pool.parallelFor((int)volumes.size(), grain, [&](int thread, int begin, int end) {
+        for (int e = begin; e < end; e++) {
+            const int *nodes = &tetrahedra[e * 4];
+            glm::vec3 x0 = x[nodes[0]];
+
+            glm::mat3 edges(x[nodes[1]] - x0, x[nodes[2]] - x0, x[nodes[3]] - x0);
+
+            const glm::mat3 & R = rotations[e];
+            glm::mat3 G = glm::transpose(R) * edges * restInverses[e];
+            glm::mat3 stress = mu * (G + glm::transpose(G)) +
+                lambda * (G[0][0] + G[1][1] + G[2][2]) * glm::mat3(1.0f);
+
+            glm::mat3 H = volumes[e] * (R * stress) * glm::transpose(restInverses[e]);
+
+            elementForces[e * 3] = H[0];
+            elementForces[e * 3 + 1] = H[1];
+            elementForces[e * 3 + 2] = H[2];
+        }
+    });
+}
+
+glm::vec3 SoftBody::gatherElements(int node) {
+    glm::vec3 sum;
+
+    for (int k = adjacencyOffsets[node]; k < adjacencyOffsets[node + 1]; k++) {
+        int e = adjacency[k] >> 2;
+        int corner = adjacency[k] & 3;
+
+        // The first node takes the opposite of the others
+        if (corner == 0)
+            sum -= elementForces[e * 3] + elementForces[e * 3 + 1] + elementForces[e * 3 + 2];
+        else
+            sum += elementForces[e * 3 + corner - 1];
+    }
+
+    return sum;
+}
+
+void SoftBody::multiply(ThreadPool & pool, float scale, const std::vector<glm::vec3> & x,
+    std::vector<glm::vec3> & y, double & dot)
+{
+    computeElementProducts(pool, x);
+
+    std::fill(partials.begin(), partials.end(), 0.0);
+
+    pool.parallelFor((int)positions.size(), grain, [&](int thread, int begin, int end) {
+        double sum = 0.0;
+
+        for (int i = begin; i < end; i++) {
+            if (masses[i] == 0.0f) {
+                y[i] = glm::vec3();
+                continue;
+            }
+
+            y[i] = masses[i] * x[i] + scale * gatherElements(i);
+            sum += glm::dot(x[i], y[i]);
+        }
+
+        partials[thread * partialStride] += sum;
+    });
+
+    dot = 0.0;
+
+    for (size_t t = 0; t < partials.size(); t += partialStride)
+        dot += partials[t];
+}
+
+void SoftBody::collide(float h, ThreadPool & pool) {
+    int numColliders = colliders.size();
+
+    pool.parallelFor((int)positions.size(), grain, [&](int thread, int begin, int end) {
+        glm::vec3 *linear = colliders.getLinearImpulses(thread);
+        glm::vec3 *angular = colliders.getAngularImpulses(thread);
+
+        for (int i = begin; i < end; i++) {
+            if (masses[i] == 0.0f)
+                continue;
+
+            for (int k = 0; k < numColliders; k++) {
+                const ParticleCollider & collider = colliders[k];
+                glm::vec3 predicted = positions[i] + h * velocities[i];
+                glm::vec3 normal;
+                float depth;
+
+                if (!collider.getContact(predicted, thickness, normal, depth))
+                    continue;
+
+                // Stop approach, and slow sliding by friction
+                glm::vec3 bodyVel = collider.getVelocityAtPoint(predicted);
+                glm::vec3 relVel = velocities[i] - bodyVel;
+                float approach = glm::dot(relVel, normal);
+
+                glm::vec3 velocity = velocities[i];
+
+                if (approach < 0.0f) {
+                    glm::vec3 tangent = relVel - approach * normal;
+                    float slip = glm::length(tangent);
+                    float keep = slip > 0.0f ? std::max(1.0f + friction * approach / slip, 0.0f) : 0.0f;
+
+                    velocity = bodyVel + keep * tangent;
+                }
+
+                // Move out of any remaining overlap without adding velocity
+                float remaining = depth - std::max(h * glm::dot(velocity - velocities[i], normal), 0.0f);
+
+                if (remaining > 0.0f)
+                    positions[i] += remaining * normal;
+
+                // Equal and opposite impulse on the body
+                glm::vec3 impulse = masses[i] * (velocities[i] - velocity);
+                linear[k] += impulse;
+                angular[k] += glm::cross(predicted - collider.position, impulse);
+
+                velocities[i] = velocity;
+            }
+        }
+    });
+}
+
+void SoftBody::step(const glm::vec3 & gravity, float dt, Body *const *bodies, int numBodies,
+    ThreadPool & pool)
+{
+    int numNodes = (int)positions.size();
+    float h = dt;
+    float scale = h * h + h * damping;
+
+    forces.resize(numNodes);
+    change.resize(numNodes);
+    preconditioner.resize(numNodes);
+    residual.resize(numNodes);
+    direction.resize(numNodes);
+    product.resize(numNodes);
+    scaled.resize(numNodes);
+    partials.assign(pool.getThreadCount() * partialStride, 0.0);
+
+    // Elastic forces, then stiffness times velocity
+    computeRotations(pool);
+
+    pool.parallelFor(numNodes, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            forces[i] = gatherElements(i);
+    });
+
+    computeElementProducts(pool, velocities);
+
+    // Right hand side and the diagonal preconditioner. As for spring
+    // networks, the solve starts from no change, so that stopping early is
+    // stable.
+    pool.parallelFor(numNodes, grain, [&](int thread, int begin, int end) {
+        double rz = 0.0;
+        double rr = 0.0;
+
+        for (int i = begin; i < end; i++) {
+            change[i] = glm::vec3();
+
+            if (masses[i] == 0.0f) {
+                residual[i] = glm::vec3();
+                preconditioner[i] = glm::vec3();
+                scaled[i] = glm::vec3();
+                direction[i] = glm::vec3();
+                continue;
+            }
+
+            glm::vec3 force = masses[i] * gravity + forces[i] - (h + damping) * gatherElements(i);
+
+            residual[i] = h * force;
+            preconditioner[i] = glm::vec3(1.0f / (masses[i] + scale * stiffnessDiagonal[i]));
+            scaled[i] = preconditioner[i] * residual[i];
+            direction[i] = scaled[i];
+
+            rz += glm::dot(residual[i], scaled[i]);
+            rr += glm::dot(residual[i], residual[i]);
+        }
+
+        partials[thread * partialStride] += rz;
+        partials[thread * partialStride + 1] += rr;
+    });
+
+    double rz = 0.0;
+    double rr = 0.0;
+
+    for (size_t t = 0; t < partials.size(); t += partialStride) {
+        rz += partials[t];
+        rr += partials[t + 1];
+    }
+
+    double rhs = rr;
+    double threshold = (double)tolerance * tolerance * rhs;
+
+    iterations = 0;
+
+    while (iterations < maxIterations && rr > threshold) {
+        double pq;
+        multiply(pool, scale, direction, product, pq);
+
+        if (pq <= 0.0)
+            break;
+
+        float alpha = (float)(rz / pq);
+
+        std::fill(partials.begin(), partials.end(), 0.0);
+
+        pool.parallelFor(numNodes, grain, [&](int thread, int begin, int end) {
+            double rzNext = 0.0;
+            double rrNext = 0.0;
+
+            for (int i = begin; i < end; i++) {
+                change[i] += alpha * direction[i];
+                residual[i] -= alpha * product[i];
+                scaled[i] = preconditioner[i] * residual[i];
+                rzNext += glm::dot(residual[i], scaled[i]);
+                rrNext += glm::dot(residual[i], residual[i]);
+            }
+
+            partials[thread * partialStride] += rzNext;
+            partials[thread * partialStride + 1] += rrNext;
+        });
+
+        double rzNext = 0.0;
+        rr = 0.0;
+
+        for (size_t t = 0; t < partials.size(); t += partialStride) {
+            rzNext += partials[t];
+            rr += partials[t + 1];
+        }
+
+        iterations++;
+
+        if (rr <= threshold)
+            break;
+
+        float beta = (float)(rzNext / rz);
+        rz = rzNext;
+
+        pool.parallelFor(numNodes, grain, [&](int thread, int begin, int end) {
+            for (int i = begin; i < end; i++)
+                direction[i] = scaled[i] + beta * direction[i];
+        });
+    }
+
+    error = rhs > 0.0 ? (float)sqrt(std::min(rr, rhs) / rhs) : 0.0f;
+
+    pool.parallelFor(numNodes, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            if (masses[i] != 0.0f)
+                velocities[i] += change[i];
+    });
+
+    // Contacts with bodies, at the end of the step
+    colliders.set(bodies, numBodies, pool.getThreadCount());
+
+
+    if (colliders.size() > 0)
+        collide(h, pool);
+
+    pool.parallelFor(numNodes, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++)
+            if (masses[i] != 0.0f)
+                positions[i] += h * velocities[i];
+    });
+
+    // Push back on free bodies
+    colliders.apply();
+}
+
+}
@@ -0,0 +1,301 @@
+/**
+ * @file springnetwork.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/springnetwork.h>
+#include <physics/constraints/springconstraint.h>
+#include <physics/threadpool.h>
+#include <algorithm>
+
+namespace Physics {
+
+// Iterations handed to each thread at a time
+static const int grain = 256;
+
+// Stride between threads' partial sums, so that they do not share cache lines
+static const int partialStride = 8;
+
+SpringNetwork::SpringNetwork()
+    : adjacencySprings(-1),
+      maxIterations(50),
+      tolerance(1e-4f),
+      iterations(0),
+      error(0.0f)
+{
+}
+
+SpringNetwork::~SpringNetwork() {
+}
+
+int SpringNetwork::addParticle(glm::vec3 position, float mass) {
+    positions.push_back(position);
+    velocities.push_back(glm::vec3());
+    masses.push_back(mass);
+    change.push_back(glm::vec3());
+
+    // Springs are listed per particle again
+    adjacencySprings = -1;
+
+    return (int)positions.size() - 1;
+}
+
+int SpringNetwork::addSpring(int particle1, int particle2, float stiffness, float length,
+    float damping)
+{
+    return springs.add(particle1, particle2, stiffness, length, damping);
+}
+
+int SpringNetwork::addSpring(int particle1, int particle2, const SpringConstraint & spring) {
+    return addSpring(particle1, particle2, spring.getStiffness(), spring.getLength(),
+        spring.getDamping());
+}
+
+void SpringNetwork::setPosition(int particle, glm::vec3 position) {
+    positions[particle] = position;
+}
+
+void SpringNetwork::setVelocity(int particle, glm::vec3 velocity) {
+    velocities[particle] = velocity;
+}
+
+void SpringNetwork::setSolverIterations(int maxIterations) {
+    this->maxIterations = maxIterations;
+}
+
+void SpringNetwork::setSolverTolerance(float tolerance) {
+    this->tolerance = tolerance;
+}
+
+void SpringNetwork::buildAdjacency() {
+    // Counting sort of spring ends by particle
+    int numParticles = (int)positions.size();
+    int numSprings = springs.size();
+
+    adjacencyOffsets.assign(numParticles + 1, 0);
+
+    for (int i = 0; i < numSprings; i++) {
+        adjacencyOffsets[springs.body1[i] + 1]++;
+        adjacencyOffsets[springs.body2[i] + 1]++;
+    }
+
+    for (int i = 1; i <= numParticles; i++)
+        adjacencyOffsets[i] += adjacencyOffsets[i - 1];
+
+    adjacency.resize(numSprings * 2);
+
+    std::vector<int> next(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+
+    for (int i = 0; i < numSprings; i++) {
+        adjacency[next[springs.body1[i]]++] = i;
+        adjacency[next[springs.body2[i]]++] = i;
+    }
+
+    adjacencySprings = numSprings;
+}
+
+void SpringNetwork::multiply(ThreadPool & pool, const std::vector<glm::vec3> & x,
+    std::vector<glm::vec3> & y, double & dot)
+{
+    std::fill(partials.begin(), partials.end(), 0.0);
+
+    pool.parallelFor((int)positions.size(), grain, [&](int thread, int begin, int end) {
+        double sum = 0.0;
+
+        for (int i = begin; i < end; i++) {
+            if (masses[i] == 0.0f) {
+                y[i] = glm::vec3();
+                continue;
+            }
+
+            glm::vec3 result = masses[i] * x[i];
+
+            for (int k = adjacencyOffsets[i]; k < adjacencyOffsets[i + 1]; k++) {
+                int s = adjacency[k];
+                int other = springs.body1[s] == i ? springs.body2[s] : springs.body1[s];
+
+                // Fixed particles do not change velocity
+                glm::vec3 xo = masses[other] == 0.0f ? glm::vec3() : x[other];
+                result += blocks[s] * (x[i] - xo);
+            }
+
+            y[i] = result;
+            sum += glm::dot(x[i], result);
+        }
+
+        partials[thread * partialStride] += sum;
+    });
+
+    dot = 0.0;
+
+    for (size_t t = 0; t < partials.size(); t += partialStride)
+        dot += partials[t];
+}
+
+void SpringNetwork::step(const glm::vec3 & gravity, float dt, ThreadPool & pool) {
+    int numParticles = (int)positions.size();
+    int numSprings = springs.size();
+    float h = dt;
+
+    if (adjacencySprings != numSprings)
+        buildAdjacency();
+
+    blocks.resize(numSprings);
+    forces.resize(numSprings);
+    preconditioner.resize(numParticles);
+    residual.resize(numParticles);
+    direction.resize(numParticles);
+    product.resize(numParticles);
+    scaled.resize(numParticles);
+    partials.assign(pool.getThreadCount() * partialStride, 0.0);
+
+    // Linearize each spring about the current state
+    pool.parallelFor(numSprings, grain, [&](int thread, int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            int i1 = springs.body1[s];
+            int i2 = springs.body2[s];
+
+            glm::vec3 d = positions[i2] - positions[i1];
+            float dist = glm::length(d);
+
+            if (dist < 1e-6f) {
+                blocks[s] = glm::mat3(0.0f);
+                forces[s] = glm::vec3();
+                continue;
+            }
+
+            glm::vec3 n = d / dist;
+            float k = springs.stiffness[s];
+            float c = springs.damping[s];
+            glm::vec3 relVel = velocities[i2] - velocities[i1];
+
+            glm::mat3 along = glm::outerProduct(n, n);
+            float across = std::max(1.0f - springs.length[s] / dist, 0.0f);
+            glm::mat3 stiffness = k * (along + across * (glm::mat3(1.0f) - along));
+
+            glm::vec3 force = (k * (dist - springs.length[s]) + c * glm::dot(relVel, n)) * n;
+
+            forces[s] = force + h * (stiffness * relVel);
+            blocks[s] = (h * h) * stiffness + (h * c) * along;
+        }
+    });
+
+    // Right hand side and the diagonal preconditioner. The solve starts from
+    // no change, so the residual is the right hand side. Stopping early then
+    // still gives a change which has removed some of the error, which is not
+    // true when starting from the last step's change, and stiff networks blow
+    // up.
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        double rz = 0.0;
+        double rr = 0.0;
+
+        for (int i = begin; i < end; i++) {
+            change[i] = glm::vec3();
+
+            if (masses[i] == 0.0f) {
+                residual[i] = glm::vec3();
+                preconditioner[i] = glm::vec3();
+                scaled[i] = glm::vec3();
+                direction[i] = glm::vec3();
+                continue;
+            }
+
+            glm::vec3 force = masses[i] * gravity;
+            glm::vec3 diagonal = glm::vec3(masses[i]);
+
+            for (int k = adjacencyOffsets[i]; k < adjacencyOffsets[i + 1]; k++) {
+                int s = adjacency[k];
+                force += springs.body1[s] == i ? forces[s] : -forces[s];
+                diagonal += glm::vec3(blocks[s][0][0], blocks[s][1][1], blocks[s][2][2]);
+            }
+
+            residual[i] = h * force;
+            preconditioner[i] = 1.0f / diagonal;
+            scaled[i] = preconditioner[i] * residual[i];
+            direction[i] = scaled[i];
+
+            rz += glm::dot(residual[i], scaled[i]);
+            rr += glm::dot(residual[i], residual[i]);
+        }
+
+        partials[thread * partialStride] += rz;
+        partials[thread * partialStride + 1] += rr;
+    });
+
+    double rz = 0.0;
+    double rr = 0.0;
+
+    for (size_t t = 0; t < partials.size(); t += partialStride) {
+        rz += partials[t];
+        rr += partials[t + 1];
+    }
+
+    double rhs = rr;
+    double threshold = (double)tolerance * tolerance * rhs;
+
+    iterations = 0;
+
+    while (iterations < maxIterations && rr > threshold) {
+        double pq;
+        multiply(pool, direction, product, pq);
+
+        if (pq <= 0.0)
+            break;
+
+        float alpha = (float)(rz / pq);
+
+        std::fill(partials.begin(), partials.end(), 0.0);
+
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            double rzNext = 0.0;
+            double rrNext = 0.0;
+
+            for (int i = begin; i < end; i++) {
+                change[i] += alpha * direction[i];
+                residual[i] -= alpha * product[i];
+                scaled[i] = preconditioner[i] * residual[i];
+                rzNext += glm::dot(residual[i], scaled[i]);
+                rrNext += glm::dot(residual[i], residual[i]);
+            }
+
+            partials[thread * partialStride] += rzNext;
+            partials[thread * partialStride + 1] += rrNext;
+        });
+
+        double rzNext = 0.0;
+        rr = 0.0;
+
+        for (size_t t = 0; t < partials.size(); t += partialStride) {
+            rzNext += partials[t];
+            rr += partials[t + 1];
+        }
+
+        iterations++;
+
+        if (rr <= threshold)
+            break;
+
+        float beta = (float)(rzNext / rz);
+        rz = rzNext;
+
+        pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+            for (int i = begin; i < end; i++)
+                direction[i] = scaled[i] + beta * direction[i];
+        });
+    }
+
+    error = rhs > 0.0 ? (float)sqrt(std::min(rr, rhs) / rhs) : 0.0f;
+
+    pool.parallelFor(numParticles, grain, [&](int thread, int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            if (masses[i] == 0.0f)
+                continue;
+
+            velocities[i] += change[i];
+            positions[i] += h * velocities[i];
+        }
+    });
+}
+
+}
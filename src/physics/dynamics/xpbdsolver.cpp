@@ -0,0 +1,263 @@
+/**
+ * @file xpbdsolver.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/dynamics/xpbdsolver.h>
+#include <physics/dynamics/body.h>
+#include <algorithm>
+
+namespace Physics {
+
+XPBDSolver::XPBDSolver()
+    : elasticity(0.7f)
+{
+}
+
+XPBDSolver::~XPBDSolver() {
+}
+
+float XPBDSolver::getGeneralizedInverseMass(Body *body, const glm::vec3 & r,
+    const glm::vec3 & n)
+{
+    glm::vec3 rn = glm::cross(r, n);
+    return body->getInverseMass() + glm::dot(rn, body->getInvInertiaTensor() * rn);
+}
+
+void XPBDSolver::applyPositionCorrection(Body *body, const glm::vec3 & correction,
+    const glm::vec3 & r)
+{
+    if (body->getFixed())
+        return;
+
+    Transform & t = body->getTransform();
+    t.position += correction * body->getInverseMass();
+
+    glm::vec3 w = body->getInvInertiaTensor() * glm::cross(r, correction);
+    glm::quat dq(0.0f, w.x, w.y, w.z);
+    t.orientation = glm::normalize(t.orientation + (dq * t.orientation) * 0.5f);
+}
+
+void XPBDSolver::solveContacts(std::vector<System::ContactEx> & contacts, float h) {
+    for (size_t i = 0; i < contacts.size(); i++) {
+        System::ContactEx & contact = contacts[i];
+        ContactState & state = contactStates[i];
+
+        Transform & t1 = contact.b1->getTransform();
+        Transform & t2 = contact.b2->getTransform();
+        glm::vec3 n = contact.contact.normal;
+        glm::vec3 r1 = t1.orientation * state.anchor1;
+        glm::vec3 r2 = t2.orientation * state.anchor2;
+
+        // The anchors started at the same point, so their relative motion
+        // along the normal is the change in separation
+        float C = state.separation + glm::dot((t2.position + r2) - (t1.position + r1), n);
+
+        state.lambda = 0.0f;
+
+        if (C >= 0.0f)
+            continue;
+
+        // Corrections act where the contact was found. The anchors turn with
+        // rolling bodies, and pushing on them would spin the body.
+        float w = getGeneralizedInverseMass(contact.b1, state.arm1, n) +
+            getGeneralizedInverseMass(contact.b2, state.arm2, n);
+
+        if (w == 0.0f)
+            continue;
+
+        float dlambda = -C / w;
+        glm::vec3 p = dlambda * n;
+
+        applyPositionCorrection(contact.b1, -p, state.arm1);
+        applyPositionCorrection(contact.b2,  p, state.arm2);
+
+        state.lambda = dlambda;
+        contact.impulse += dlambda / h;
+    }
+}
+
+void XPBDSolver::projectDistance(Body *b1, Body *b2, float length, float compliance,
+    float damping, float h)
+{
+    // Rods and springs act between centers of mass
+    glm::vec3 d = b2->getPosition() - b1->getPosition();
+    float dist = glm::length(d);
+
+    if (dist == 0.0f)
+        return;
+
+    glm::vec3 n = d / dist;
+    float C = dist - length;
+    float w = b1->getInverseMass() + b2->getInverseMass();
+
+    // Compliance and damping scaled to the substep. The damping term uses
+    // the predicted motion over the substep along the constraint.
+    float alpha = compliance / (h * h);
+    float gamma = compliance * damping / h;
+    float motion = glm::dot(b2->getLinearVelocity() - b1->getLinearVelocity(), n) * h;
+
+    float denom = (1.0f + gamma) * w + alpha;
+
+    if (denom == 0.0f)
+        return;
+
+    float dlambda = (-C - gamma * motion) / denom;
+    glm::vec3 p = dlambda * n;
+
+    applyPositionCorrection(b1, -p, glm::vec3(0.0f));
+    applyPositionCorrection(b2,  p, glm::vec3(0.0f));
+}
+
+void XPBDSolver::solveConstraints(std::vector<std::shared_ptr<Body>> & bodies,
+    const RodPool & rods, const SpringPool & springs, float h)
+{
+    for (int i = 0; i < rods.size(); i++)
+        projectDistance(bodies[rods.body1[i]].get(), bodies[rods.body2[i]].get(),
+            rods.length[i], 0.0f, 0.0f, h);
+
+    for (int i = 0; i < springs.size(); i++)
+        projectDistance(bodies[springs.body1[i]].get(), bodies[springs.body2[i]].get(),
+            springs.length[i], 1.0f / springs.stiffness[i], springs.damping[i], h);
+}
+
+void XPBDSolver::solveVelocities(std::vector<System::ContactEx> & contacts,
+    const glm::vec3 & gravity, float h)
+{
+    // Slow contacts do not bounce, so that resting bodies stay at rest
+    float threshold = 2.0f * glm::length(gravity) * h;
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        System::ContactEx & contact = contacts[i];
+        const ContactState & state = contactStates[i];
+
+        if (state.lambda == 0.0f)
+            continue;
+
+        // Velocities are corrected where the contact was found, as in
+        // solveContacts()
+        glm::vec3 n = contact.contact.normal;
+        glm::vec3 r1 = state.arm1;
+        glm::vec3 r2 = state.arm2;
+
+        glm::vec3 rvel = contact.b2->getVelocityAtPoint(r2) -
+            contact.b1->getVelocityAtPoint(r1);
+        float vn = glm::dot(rvel, n);
+
+        // Dynamic friction, limited by the normal impulse of this substep
+        glm::vec3 vt = rvel - n * vn;
+        float slide = glm::length(vt);
+
+        if (slide > 0.0f && contact.friction > 0.0f) {
+            glm::vec3 t = vt / slide;
+            float wt = getGeneralizedInverseMass(contact.b1, r1, t) +
+                getGeneralizedInverseMass(contact.b2, r2, t);
+
+            if (wt > 0.0f) {
+                float Jt = std::min(slide / wt, contact.friction * state.lambda / h);
+
+                contact.b1->addImpulse( Jt * t, r1);
+                contact.b2->addImpulse(-Jt * t, r2);
+
+                vn = glm::dot(contact.b2->getVelocityAtPoint(r2) -
+                    contact.b1->getVelocityAtPoint(r1), n);
+            }
+        }
+
+        float e = fabsf(state.approach) > threshold ? elasticity : 0.0f;
+        float dv = -vn + std::max(-e * state.approach, 0.0f);
+
+        float w = getGeneralizedInverseMass(contact.b1, r1, n) +
+            getGeneralizedInverseMass(contact.b2, r2, n);
+
+        if (w == 0.0f)
+            continue;
+
+        float J = dv / w;
+
+        contact.b1->addImpulse(-J * n, r1);
+        contact.b2->addImpulse( J * n, r2);
+
+        contact.impulse += J;
+    }
+}
+
+void XPBDSolver::step(std::vector<std::shared_ptr<Body>> & bodies,
+    std::vector<System::ContactEx> & contacts, const RodPool & rods,
+    const SpringPool & springs, const glm::vec3 & gravity, float dt, int substeps)
+{
+    float h = dt / substeps;
+
+    bodyStates.resize(bodies.size());
+    contactStates.resize(contacts.size());
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        const System::ContactEx & contact = contacts[i];
+        ContactState & state = contactStates[i];
+
+        Transform & t1 = contact.b1->getTransform();
+        Transform & t2 = contact.b2->getTransform();
+        glm::vec3 p = contact.contact.position;
+
+        state.anchor1 = glm::conjugate(t1.orientation) * (p - t1.position);
+        state.anchor2 = glm::conjugate(t2.orientation) * (p - t2.position);
+        state.arm1 = p - t1.position;
+        state.arm2 = p - t2.position;
+        state.separation = -contact.contact.depth;
+        state.lambda = 0.0f;
+    }
+
+    for (int substep = 0; substep < substeps; substep++) {
+        // Predict positions
+        for (size_t i = 0; i < bodies.size(); i++) {
+            Body *body = bodies[i].get();
+
+            if (body->getFixed())
+                continue;
+
+            Transform & t = body->getTransform();
+            bodyStates[i].prevPosition = t.position;
+            bodyStates[i].prevOrientation = t.orientation;
+
+            body->addLinearVelocity(gravity * h);
+
+            t.position += body->getLinearVelocity() * h;
+
+            glm::vec3 w = body->getAngularVelocity();
+            glm::quat dq(0.0f, w.x, w.y, w.z);
+            t.orientation = glm::normalize(t.orientation + (dq * t.orientation) * (0.5f * h));
+        }
+
+        for (size_t i = 0; i < contacts.size(); i++) {
+            const System::ContactEx & contact = contacts[i];
+            ContactState & state = contactStates[i];
+
+            state.approach = glm::dot(contact.b2->getVelocityAtPoint(state.arm2) -
+                contact.b1->getVelocityAtPoint(state.arm1), contact.contact.normal);
+        }
+
+        solveContacts(contacts, h);
+        solveConstraints(bodies, rods, springs, h);
+
+        // Derive velocities from the change in position
+        for (size_t i = 0; i < bodies.size(); i++) {
+            Body *body = bodies[i].get();
+
+            if (body->getFixed())
+                continue;
+
+            Transform & t = body->getTransform();
+            body->setLinearVelocity((t.position - bodyStates[i].prevPosition) / h);
+
+            glm::quat dq = t.orientation * glm::conjugate(bodyStates[i].prevOrientation);
+            glm::vec3 w = glm::vec3(dq.x, dq.y, dq.z) * (2.0f / h);
+
+            body->setAngularVelocity(dq.w >= 0.0f ? w : -w);
+        }
+
+        solveVelocities(contacts, gravity, h);
+    }
+}
+
+}
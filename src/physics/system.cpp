@@ -7,22 +7,55 @@
 #include <physics/system.h>
 #include <physics/collision/shape.h>
 #include <physics/dynamics/body.h>
-#include <physics/constraints/constraint.h>
+#include <physics/constraints/rodconstraint.h>
+#include <physics/constraints/springconstraint.h>
+#include <physics/dynamics/xpbdsolver.h>
+#include <physics/dynamics/directsolver.h>
+#include <physics/dynamics/articulation.h>
+#include <physics/dynamics/springnetwork.h>
+#include <physics/dynamics/cloth.h>
+#include <physics/dynamics/softbody.h>
+#include <physics/dynamics/fluid.h>
+#include <physics/dynamics/granular.h>
+#include <physics/dynamics/continuum.h>
 #include <iostream>
+#include <algorithm>
 
 // TODO: constraints that don't require extra bodies
 // TODO: Categories of physics things
 
 namespace Physics {
 
-System::System()
+System::System(Backend backend)
     : gravity(glm::vec3(0, -9.8f, 0)),
       step(1.0 / 1000.0),
       accumTime(0.0),
       time(0.0),
-      timeWarp(1.0)
+      timeWarp(1.0),
+      threadPool(new ThreadPool()),
+      queriesDirty(false),
+      pairFilter(nullptr),
+      pairFilterData(nullptr),
+      amortizedBroadphase(false),
+      contactCaching(false),
+      shockPropagation(false),
+      minIterations(1),
+      maxIterations(5),
+      impulseTolerance(1e-4f),
+      residualTolerance(1e-3f),
+      splitImpulse(false),
+      blockSolver(true),
+      directSolving(true),
+      directSolver(new DirectSolver()),
+      backend(backend),
+      xpbdSolver(backend == XPBDBackend ? new XPBDSolver() : nullptr),
+      solverMode(Impulse),
+      substeps(8),
+      contactTracking(false),
+      contactEventQueue(nullptr),
+      droppedContactEvents(0),
+      stepStats()
 {
-    Collision::initialize();
 }
 
 System::~System() {
@@ -36,12 +69,149 @@ void System::setGravity(glm::vec3 gravity) {
     this->gravity = gravity;
 }
 
-void System::addBody(std::shared_ptr<Body> body) {
+int System::addBody(std::shared_ptr<Body> body) {
     bodies.push_back(body);
+    linkParents.push_back(-1);
+    return (int)bodies.size() - 1;
+}
+
+void System::addArticulation(std::shared_ptr<Articulation> articulation) {
+    // The XPBD backend has no joints, so links are simulated as free bodies
+    if (backend == XPBDBackend) {
+        for (int i = 0; i < articulation->getNumLinks(); i++)
+            addBody(articulation->getLink(i));
+
+        return;
+    }
+
+    // Links are added in order, so link k is body base + k
+    int base = (int)bodies.size();
+
+    for (int i = 0; i < articulation->getNumLinks(); i++) {
+        std::shared_ptr<Body> link = articulation->getLink(i);
+        link->setArticulated(true);
+        addBody(link);
+
+        int parent = articulation->getParent(i);
+        linkParents[base + i] = parent >= 0 ? base + parent : -1;
+    }
+
+    articulations.push_back(articulation);
+    articulationBodies.push_back(base);
+}
+
+const std::vector<std::shared_ptr<Articulation>> & System::getArticulations() {
+    return articulations;
+}
+
+void System::addSpringNetwork(std::shared_ptr<SpringNetwork> network) {
+    springNetworks.push_back(network);
+}
+
+const std::vector<std::shared_ptr<SpringNetwork>> & System::getSpringNetworks() {
+    return springNetworks;
+}
+
+void System::addCloth(std::shared_ptr<Cloth> cloth) {
+    cloths.push_back(cloth);
+}
+
+const std::vector<std::shared_ptr<Cloth>> & System::getCloths() {
+    return cloths;
+}
+
+void System::addSoftBody(std::shared_ptr<SoftBody> softBody) {
+    softBodies.push_back(softBody);
+}
+
+const std::vector<std::shared_ptr<SoftBody>> & System::getSoftBodies() {
+    return softBodies;
+}
+
+void System::addFluid(std::shared_ptr<Fluid> fluid) {
+    fluids.push_back(fluid);
+}
+
+const std::vector<std::shared_ptr<Fluid>> & System::getFluids() {
+    return fluids;
+}
+
+void System::addGranular(std::shared_ptr<Granular> granular) {
+    granulars.push_back(granular);
+}
+
+const std::vector<std::shared_ptr<Granular>> & System::getGranulars() {
+    return granulars;
+}
+
+void System::addContinuum(std::shared_ptr<Continuum> continuum) {
+    continua.push_back(continuum);
+}
+
+const std::vector<std::shared_ptr<Continuum>> & System::getContinua() {
+    return continua;
 }
 
 void System::addConstraint(std::shared_ptr<Constraint> constraint) {
-    constraints.push_back(constraint);
+    Body *b1 = nullptr;
+    Body *b2 = nullptr;
+
+    switch (constraint->getConstraintType()) {
+    case Constraint::Rod: {
+        RodConstraint *rod = static_cast<RodConstraint *>(constraint.get());
+        b1 = rod->getBody1();
+        b2 = rod->getBody2();
+        break;
+    }
+    case Constraint::Spring: {
+        SpringConstraint *spring = static_cast<SpringConstraint *>(constraint.get());
+        b1 = spring->getBody1();
+        b2 = spring->getBody2();
+        break;
+    }
+    default:
+        return;
+    }
+
+    int i1 = -1;
+    int i2 = -1;
+
+    for (size_t i = 0; i < bodies.size(); i++) {
+        if (bodies[i].get() == b1)
+            i1 = (int)i;
+
+        if (bodies[i].get() == b2)
+            i2 = (int)i;
+    }
+
+    // Both bodies must have been added first
+    if (i1 < 0 || i2 < 0)
+        return;
+
+    if (constraint->getConstraintType() == Constraint::Rod) {
+        RodConstraint *rod = static_cast<RodConstraint *>(constraint.get());
+        addRod(i1, i2, rod->getLength());
+    }
+    else {
+        SpringConstraint *spring = static_cast<SpringConstraint *>(constraint.get());
+        addSpring(i1, i2, spring->getStiffness(), spring->getLength(), spring->getDamping());
+    }
+}
+
+void System::addRod(int body1, int body2, float length) {
+    rods.add(body1, body2, length);
+}
+
+void System::addSpring(int body1, int body2, float stiffness, float length, float damping) {
+    springs.add(body1, body2, stiffness, length, damping);
+}
+
+const RodPool & System::getRods() {
+    return rods;
+}
+
+const SpringPool & System::getSprings() {
+    return springs;
 }
 
 double System::getTimeWarp() {
@@ -52,17 +222,31 @@ void System::setTimeWarp(double timeWarp) {
     this->timeWarp = timeWarp;
 }
 
+double System::getStep() {
+    return step;
+}
+
+void System::setStep(double step) {
+    this->step = step;
+}
+
 // TODO: Switch to addVelocity() to avoid constantly mul/div mass
 // TODO: Wrapper for addForce()
 // TODO: Test rest on ramp
 
-void System::resolveContact(const ContactEx & contact) {
+void System::resolveContact(ContactEx & contact, float & impulseDelta, float & residual,
+    float scale1, float scale2)
+{
     // Bodies may be penetrating. We want to apply an impulse which will cause
-    // them to separate. We also want to apply impulses which will eliminate
-    // relative velocity tangent to the collision normal, simulating friction.
+    // them to separate. Friction is applied separately, by resolveFriction().
     // We run this process several times over all constraints, hoping they
     // approach a stable set of impulses. We need to separate objects and
-    // apply friction but also keep stacks stable.
+    // apply friction but also keep stacks stable. The scales multiply each
+    // body's inverse mass, and are 0 for a body treated as infinitely heavy.
+    // A contact with such a body only removes approach velocity, because
+    // bouncing off a body that cannot move would add energy. Otherwise
+    // contacts bounce at any approach speed. Manifolds in the block solver
+    // only bounce above a threshold, see getTargetVelocity().
 
     float elasticity = 0.7f; // "Bounciness" or coefficient of restitution
     float bias = 0.01f;       // Additional impulse along normal for separation
@@ -73,10 +257,10 @@ void System::resolveContact(const ContactEx & contact) {
     glm::vec3 r2 = p - contact.b2->getPosition();
 
     // Inverse mass
-    float im1 = contact.b1->getInverseMass();
-    float im2 = contact.b2->getInverseMass();
-    glm::mat3 iI1 = contact.b1->getInvInertiaTensor();
-    glm::mat3 iI2 = contact.b2->getInvInertiaTensor();
+    float im1 = contact.b1->getInverseMass() * scale1;
+    float im2 = contact.b2->getInverseMass() * scale2;
+    glm::mat3 iI1 = contact.b1->getInvInertiaTensor() * scale1;
+    glm::mat3 iI2 = contact.b2->getInvInertiaTensor() * scale2;
 
     // Relative velocity along normal
     // Normal points from 1 -> 2
@@ -86,129 +270,1957 @@ void System::resolveContact(const ContactEx & contact) {
 
     float depth = contact.contact.depth;
 
-    if (depth < 0.0f) depth = 0.0f;
-
     float Jn = 0.0f;
 
     // Relative velocity along normal should be zero
     {
-        Jn = -(1.0f + elasticity) * vn + bias / step * depth;
+        // Speculative contacts have a gap, and only remove the part of the
+        // approach velocity which would close it during this step
+        if (depth < 0.0f)
+            Jn = -vn + depth / (float)step;
+        else if (scale1 == 0.0f || scale2 == 0.0f)
+            Jn = -vn;
+        else if (isSplit(contact))
+            Jn = -(1.0f + elasticity) * vn;
+        else
+            Jn = -(1.0f + elasticity) * vn + bias / step * depth;
+
         float div = im1 + im2;
         div += glm::dot(
             (iI1 * glm::cross(glm::cross(r1, n), r1) +
              iI2 * glm::cross(glm::cross(r2, n), r2)),
             n);
+
+        // Before clamping, this is the velocity error the impulse corrects
+        residual = Jn > 0.0f ? Jn : 0.0f;
+
         Jn /= div;
 
         // TODO: clamp acculuated value. TODO discuss.
         if (Jn < 0.0f)
             Jn = 0.0f;
 
-        contact.b1->addImpulse(-Jn * n, r1);
-        contact.b2->addImpulse( Jn * n, r2);
+        contact.b1->addImpulse(-Jn * scale1 * n, r1);
+        contact.b2->addImpulse( Jn * scale2 * n, r2);
+
+        contact.impulse += Jn;
+        impulseDelta = Jn;
     }
+}
+
+void System::resolveFriction(ContactEx & contact, const glm::vec3 & r1, const glm::vec3 & r2,
+    float normalImpulse, float scale1, float scale2)
+{
+    // Friction impulses are accumulated over iterations. The pair of tangent
+    // impulses is clamped to a circle whose radius is the friction coefficient
+    // times the normal impulse, and later iterations may take back impulse
+    // which overshot. Inverse masses are scaled as in resolveContact().
 
-    if (glm::length(rvel) == 0.0f)
+    if (contact.friction == 0.0f && contact.rollingFriction == 0.0f)
         return;
 
-    rvel = contact.b2->getVelocityAtPoint(r2) - contact.b1->getVelocityAtPoint(r1);
-    glm::vec3 t = rvel - n * vn;
-    float tl = glm::length(t);
+    Body *b1 = contact.b1;
+    Body *b2 = contact.b2;
+
+    float im = b1->getInverseMass() * scale1 + b2->getInverseMass() * scale2;
+    glm::mat3 iI1 = b1->getInvInertiaTensor() * scale1;
+    glm::mat3 iI2 = b2->getInvInertiaTensor() * scale2;
+
+    glm::vec3 rvel = b2->getVelocityAtPoint(r2) - b1->getVelocityAtPoint(r1);
+    glm::vec3 t1 = contact.tangent1;
+    glm::vec3 t2 = contact.tangent2;
+
+    glm::vec3 rt11 = glm::cross(r1, t1);
+    glm::vec3 rt21 = glm::cross(r2, t1);
+    glm::vec3 rt12 = glm::cross(r1, t2);
+    glm::vec3 rt22 = glm::cross(r2, t2);
+
+    float k1 = im + glm::dot(rt11, iI1 * rt11) + glm::dot(rt21, iI2 * rt21);
+    float k2 = im + glm::dot(rt12, iI1 * rt12) + glm::dot(rt22, iI2 * rt22);
+
+    float J1 = k1 > 0.0f ? -glm::dot(rvel, t1) / k1 : 0.0f;
+    float J2 = k2 > 0.0f ? -glm::dot(rvel, t2) / k2 : 0.0f;
 
-    if (tl == 0.0f)
+    float accumulated1 = contact.tangentImpulse1 + J1;
+    float accumulated2 = contact.tangentImpulse2 + J2;
+    float maxImpulse = contact.friction * normalImpulse;
+    float length = sqrtf(accumulated1 * accumulated1 + accumulated2 * accumulated2);
+
+    if (length > maxImpulse) {
+        accumulated1 *= maxImpulse / length;
+        accumulated2 *= maxImpulse / length;
+    }
+
+    glm::vec3 J = t1 * (accumulated1 - contact.tangentImpulse1) +
+        t2 * (accumulated2 - contact.tangentImpulse2);
+
+    contact.tangentImpulse1 = accumulated1;
+    contact.tangentImpulse2 = accumulated2;
+
+    b1->addImpulse(-J * scale1, r1);
+    b2->addImpulse( J * scale2, r2);
+
+    if (contact.rollingFriction == 0.0f)
         return;
 
-    t /= tl;
+    // Rolling friction opposes relative rotation about the tangent axes.
+    // Spinning about the normal is left alone.
+    glm::vec3 n = contact.contact.normal;
+    glm::vec3 w = b2->getAngularVelocity() - b1->getAngularVelocity();
+    w -= n * glm::dot(w, n);
 
-    const float fric_clamp = 0.4f * Jn;
+    float speed = glm::length(w);
+    glm::vec3 Jr(0.0f);
 
-    float vt = glm::dot(rvel, t);
+    if (speed > 0.0f) {
+        glm::vec3 axis = w / speed;
+        float k = glm::dot(axis, (iI1 + iI2) * axis);
 
-    // Relative velocity off of normal should be zero
-    {
-        float J = -vt;
-        float div = im1 + im2;
-        div += glm::dot(
-            (iI1 * glm::cross(glm::cross(r1, t), r1) +
-             iI2 * glm::cross(glm::cross(r2, t), r2)),
-            t);
-        J /= div;
+        if (k > 0.0f)
+            Jr = -axis * (speed / k);
+    }
+
+    glm::vec3 accumulated = contact.rollingImpulse + Jr;
+    float maxRolling = contact.rollingFriction * normalImpulse;
+    float rolling = glm::length(accumulated);
+
+    if (rolling > maxRolling)
+        accumulated *= maxRolling / rolling;
+
+    Jr = accumulated - contact.rollingImpulse;
+    contact.rollingImpulse = accumulated;
+
+    b1->addAngularImpulse(-Jr * scale1);
+    b2->addAngularImpulse( Jr * scale2);
+}
 
-        if (J < -fric_clamp)
-            J = -fric_clamp;
-        else if (J > fric_clamp)
-            J = fric_clamp;
+void System::updateBroadphase(int numSteps, bool refit) {
+    // Furthest a body could fall over the steps, on top of its velocity
+    float horizon = (float)(numSteps * step);
+    float fall = 0.5f * glm::length(gravity) * horizon * horizon;
 
-        //contact.b1->addImpulse(-J * t, r1);
-        //contact.b2->addImpulse( J * t, r2);
+    // Using standard pointers here to avoid shared pointer overhead. This
+    // is totally internal so isn't a problem for now.
+    shapes.resize(bodies.size());
+    transforms.resize(bodies.size());
+    boxes.resize(bodies.size());
+    groups.resize(bodies.size());
+    masks.resize(bodies.size());
+
+    for (int i = 0; i < bodies.size(); i++) {
+        Body *body = bodies[i].get();
+
+        shapes[i] = body->getShape().get();
+        transforms[i] = &body->getTransform();
+        body->clearTeleported();
+        groups[i] = body->getCollisionGroup();
+        masks[i] = body->getCollisionMask();
+
+        if (shapes[i] == nullptr) {
+            boxes[i] = AABB::empty();
+            continue;
+        }
+
+        Collision::getBoundingBox(*shapes[i], *transforms[i], boxes[i]);
+
+        // Fast movers are swept over the step, so that speculative contacts
+        // are found for anything they may reach
+        if (body->getFastMover()) {
+            glm::vec3 move = body->getLinearVelocity() * (float)step;
+
+            AABB swept = boxes[i];
+            swept.min += move;
+            swept.max += move;
+            boxes[i].merge(swept);
+        }
+
+        // When pairs are reused over several steps, boxes must cover
+        // anywhere the body may reach in that time
+        if (numSteps > 0 && !body->getFixed())
+            boxes[i].inflate(glm::length(body->getLinearVelocity()) * horizon + fall);
     }
+
+    if (boxes.empty())
+        broadphase.build(nullptr, 0);
+    else if (!refit || !broadphase.refit(&boxes[0], boxes.size(), &groups[0], &masks[0]))
+        broadphase.build(&boxes[0], boxes.size(), &groups[0], &masks[0]);
+
+    queriesDirty = false;
 }
 
-void System::integrate(double t, double dt) {
-    accumTime += dt * timeWarp;
+bool System::filterPair(void *ctx, int i1, int i2) {
+    System *system = static_cast<System *>(ctx);
 
-    while (accumTime >= step) {
-        contacts.clear();
-        /*gravity += glm::vec3(
-            (sinf(time) + sinf(time * 0.6f) + sinf(time * 1.7) + sinf(time * 3.4f)) * 1.5f, 0, 0);*/
+    return system->pairFilter(system->pairFilterData, system->bodies[i1].get(),
+        system->bodies[i2].get());
+}
 
-        for (auto body : bodies)
-            body->addLinearForce(gravity * body->getMass());
+void System::setPairFilter(PairFilter filter, void *userData) {
+    pairFilter = filter;
+    pairFilterData = userData;
 
-        for (auto body : bodies)
-            body->integrateVelocities(step);
+    if (filter)
+        broadphase.setPairFilter(&System::filterPair, this);
+    else
+        broadphase.setPairFilter(nullptr, nullptr);
+}
 
-        // TODO: check if vector re-allocates every time
+void System::findPairs(int numSteps) {
+    updateBroadphase(numSteps);
 
-        Body *b1, *b2;
-        Shape *s1, *s2;
+    candidatePairs.clear();
+    broadphase.findPairs(candidatePairs);
 
-        // Using standard pointers here to avoid shared pointer overhead. This
-        // is totally internal so isn't a problem for now.
-        for (int i = 0; i < bodies.size(); i++) {
-            b1 = bodies[i].get();
+    // Jointed links overlap where they meet
+    if (!articulations.empty()) {
+        auto jointed = [this](const Collision::Pair & pair) {
+            return linkParents[pair.i1] == pair.i2 || linkParents[pair.i2] == pair.i1;
+        };
 
-            if ((s1 = b1->getShape().get()) == nullptr)
-                continue;
+        candidatePairs.erase(std::remove_if(candidatePairs.begin(), candidatePairs.end(),
+            jointed), candidatePairs.end());
+    }
+}
+
+/**
+ * @brief Get two directions perpendicular to a normal and to each other
+ */
+static void getTangents(const glm::vec3 & n, glm::vec3 & t1, glm::vec3 & t2) {
+    // Cross with whichever axis is furthest from parallel to the normal
+    glm::vec3 axis = fabsf(n.x) < 0.57735f ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0);
+
+    t1 = glm::normalize(glm::cross(n, axis));
+    t2 = glm::cross(n, t1);
+}
+
+void System::findContacts(bool updatePairs) {
+    if (bodies.empty())
+        return;
 
-            for (int j = i + 1; j < bodies.size(); j++) {
-                b2 = bodies[j].get();
+    if (updatePairs)
+        findPairs();
 
-                if ((s2 = b2->getShape().get()) == nullptr)
-                    continue;
+    bool substepping = backend == XPBDBackend || solverMode == TGS;
 
-                ContactEx contact;
-                contact.b1 = b1;
-                contact.b2 = b2;
+    // Sort candidate pairs by shape type, so that each type of pair is checked
+    // in one batch without per-pair dispatch. Pairs whose relative transform
+    // has barely changed reuse their cached contacts instead.
+    pairs.clear();
+    pairContacts.clear();
+    speculativeContacts.clear();
 
-                if (Collision::checkCollision(*s1, *s2, b1->getTransform(),
-                    b2->getTransform(), contact.contact))
-                    contacts.push_back(contact);
+    if (contactCaching)
+        contactCache.beginStep();
+
+    for (auto & pair : candidatePairs) {
+        int i = pair.i1;
+        int j = pair.i2;
+
+        const Shape *s1 = shapes[i];
+        const Shape *s2 = shapes[j];
+
+        // Fast movers look ahead by their relative motion over the step, and
+        // skip the batches and cache which only find touching pairs. With TGS
+        // and XPBD, contacts are only found once per large step, so every pair
+        // looks ahead, including the velocity gravity adds over the step.
+        if (substepping || bodies[i]->getFastMover() || bodies[j]->getFastMover()) {
+            glm::vec3 rvel = bodies[j]->getLinearVelocity() - bodies[i]->getLinearVelocity();
+            float margin = glm::length(rvel) * (float)step;
+
+            if (substepping)
+                margin += glm::length(gravity) * (float)(step * step);
+
+            Collision::Manifold manifold;
+
+            if (Collision::checkCollision(*s1, *s2, *transforms[i], *transforms[j],
+                manifold, margin))
+            {
+                Collision::PairContact result;
+                result.i1 = i;
+                result.i2 = j;
+
+                for (int k = 0; k < manifold.count; k++) {
+                    result.contact = manifold.contacts[k];
+                    speculativeContacts.push_back(result);
+                }
             }
+
+            continue;
         }
 
-        for (int i = 0; i < 5; i++) {
-            for (auto & contact : contacts)
-                resolveContact(contact);
+        if (contactCaching && contactCache.lookup(i, j, *transforms[i], *transforms[j],
+            pairContacts))
+            continue;
 
-            //for (auto constraint : constraints)
-            //    constraint->apply(time, step);
+        pairs.add(i, s1->getShapeType(), j, s2->getShapeType());
+    }
+
+    size_t firstComputed = pairContacts.size();
+
+    Collision::checkCollisions(pairs, &shapes[0], &transforms[0], bodies.size(), sphereBatch,
+        pairContacts);
+
+    if (contactCaching) {
+        for (int t1 = 0; t1 < Shape::Count; t1++) {
+            for (int t2 = t1; t2 < Shape::Count; t2++) {
+                for (auto & pair : pairs.getBucket((Shape::ShapeType)t1, (Shape::ShapeType)t2))
+                    contactCache.store(pair.i1, pair.i2, *transforms[pair.i1],
+                        *transforms[pair.i2]);
+            }
         }
 
-        for (auto body : bodies)
-            body->integrateTransform(step);
+        for (size_t i = firstComputed; i < pairContacts.size(); i++)
+            contactCache.addContact(pairContacts[i], *transforms[pairContacts[i].i1]);
 
-        time += step;
-        accumTime -= step;
+        contactCache.endStep();
+    }
+
+    pairContacts.insert(pairContacts.end(), speculativeContacts.begin(),
+        speculativeContacts.end());
+
+    solverContacts.resize(pairContacts.size());
+    contactBodies.clear();
+    contactPairs.clear();
+    islandParent.resize(bodies.size());
+
+    for (size_t i = 0; i < bodies.size(); i++)
+        islandParent[i] = (int)i;
+
+    // Rods and springs join bodies into islands like contacts do
+    for (int i = 0; i < rods.size(); i++)
+        if (!bodies[rods.body1[i]]->getFixed() && !bodies[rods.body2[i]]->getFixed())
+            islandParent[findIsland(rods.body1[i])] = findIsland(rods.body2[i]);
+
+    for (int i = 0; i < springs.size(); i++)
+        if (!bodies[springs.body1[i]]->getFixed() && !bodies[springs.body2[i]]->getFixed())
+            islandParent[findIsland(springs.body1[i])] = findIsland(springs.body2[i]);
+
+    // Every moving link of an articulation is in one island, even when a fixed
+    // root separates its branches, so that it is synced once per iteration
+    for (size_t i = 0; i < articulations.size(); i++) {
+        int base = articulationBodies[i];
+        int numLinks = articulations[i]->getNumLinks();
+
+        for (int k = 0; k < numLinks && numLinks > 1; k++)
+            if (k != 1 && !bodies[base + k]->getFixed())
+                islandParent[findIsland(base + k)] = findIsland(base + 1);
+    }
+
+    for (size_t i = 0; i < pairContacts.size(); i++) {
+        const Collision::PairContact & pairContact = pairContacts[i];
+
+        ContactEx contact;
+        contact.contact = pairContact.contact;
+        contact.b1 = bodies[pairContact.i1].get();
+        contact.b2 = bodies[pairContact.i2].get();
+        contact.impulse = 0.0f;
+        contact.pseudoImpulse = 0.0f;
+        contact.target = 0.0f;
+        contact.tangentImpulse1 = 0.0f;
+        contact.tangentImpulse2 = 0.0f;
+        contact.rollingImpulse = glm::vec3();
+
+        // Sensors only report events
+        if (contact.b1->getSensor() || contact.b2->getSensor()) {
+            solverContacts[i] = -1;
+            continue;
+        }
+
+        getTangents(contact.contact.normal, contact.tangent1, contact.tangent2);
+        contact.friction = sqrtf(contact.b1->getFriction() * contact.b2->getFriction());
+        contact.rollingFriction = std::max(contact.b1->getRollingFriction(),
+            contact.b2->getRollingFriction());
+
+        solverContacts[i] = (int)contacts.size();
+        contacts.push_back(contact);
+
+        // Fixed bodies do not join islands, so that everything resting on the
+        // ground is not one island
+        int i1 = pairContact.i1;
+        int i2 = pairContact.i2;
+        bool fixed1 = contact.b1->getFixed();
+        bool fixed2 = contact.b2->getFixed();
+
+        if (!fixed1 && !fixed2)
+            islandParent[findIsland(i1)] = findIsland(i2);
+
+        contactBodies.push_back(!fixed1 ? i1 : (!fixed2 ? i2 : -1));
+
+        Collision::Pair bodyPair = { i1, i2 };
+        contactPairs.push_back(bodyPair);
     }
 }
 
-std::vector<System::ContactEx> & System::getContacts() {
-    return contacts;
+bool System::isSplit(const ContactEx & contact) {
+    // Shallow contacts are pushed apart by the velocity bias even with split
+    // impulses. Pseudo velocities are not held back by friction, and pushing
+    // every resting contact apart with them lets piles spread sideways.
+    float splitDepth = 0.01f; // Depth beyond which split impulses are used
+
+    return splitImpulse && contact.contact.depth > splitDepth;
 }
 
-std::vector<std::shared_ptr<Body>> & System::getBodies() {
-    return bodies;
+void System::resolvePenetration(ContactEx & contact, float & impulseDelta) {
+    // Pushes penetrating bodies apart through their pseudo velocities. The
+    // depth is measured after the pseudo motion applied so far, and a fraction
+    // of what remains is removed in each pass, as in a position solver. The
+    // accumulated pseudo impulse is clamped rather than each increment, so
+    // later passes can take back impulse which overshot.
+
+    float beta = 0.2f;  // Fraction of the remaining penetration removed per pass
+    float slop = 0.005f; // Penetration which is allowed, to keep contacts alive
+
+    if (!isSplit(contact))
+        return;
+
+    glm::vec3 p = contact.contact.position;
+    glm::vec3 r1 = p - contact.b1->getPosition();
+    glm::vec3 r2 = p - contact.b2->getPosition();
+
+    glm::vec3 n = contact.contact.normal;
+    float vn = glm::dot(contact.b2->getPseudoVelocityAtPoint(r2) -
+        contact.b1->getPseudoVelocityAtPoint(r1), n);
+
+    float depth = contact.contact.depth - vn * (float)step - slop;
+
+    if (depth <= 0.0f && contact.pseudoImpulse == 0.0f)
+        return;
+
+    float im1 = contact.b1->getInverseMass();
+    float im2 = contact.b2->getInverseMass();
+    glm::mat3 iI1 = contact.b1->getInvInertiaTensor();
+    glm::mat3 iI2 = contact.b2->getInvInertiaTensor();
+
+    float div = im1 + im2;
+    div += glm::dot(
+        (iI1 * glm::cross(glm::cross(r1, n), r1) +
+         iI2 * glm::cross(glm::cross(r2, n), r2)),
+        n);
+
+    float Jp = beta / (float)step * depth / div;
+    float accumulated = std::max(contact.pseudoImpulse + Jp, 0.0f);
+    Jp = accumulated - contact.pseudoImpulse;
+    contact.pseudoImpulse = accumulated;
+
+    contact.b1->addPseudoImpulse(-Jp * n, r1);
+    contact.b2->addPseudoImpulse( Jp * n, r2);
+
+    impulseDelta = fabsf(Jp);
+}
+
+float System::getTargetVelocity(const ContactEx & contact) {
+    // Target for the block solver. The bias is the same as in resolveContact(),
+    // but restitution is measured once from the approach velocity before the
+    // solver runs, and unlike resolveContact(), slow contacts do not bounce.
+    // Manifolds are solved for all their points at once, so a bounce at one
+    // corner would tip a resting box, as in TGS.
+    float elasticity = 0.7f;
+    float threshold = 1.0f;
+    float bias = 0.01f;
+
+    float depth = contact.contact.depth;
+
+    if (depth < 0.0f)
+        return depth / (float)step;
+
+    glm::vec3 p = contact.contact.position;
+    glm::vec3 rvel = contact.b2->getVelocityAtPoint(p - contact.b2->getPosition()) -
+        contact.b1->getVelocityAtPoint(p - contact.b1->getPosition());
+
+    float vn = glm::dot(rvel, contact.contact.normal);
+    float target = vn < -threshold ? -elasticity * vn : 0.0f;
+
+    if (!isSplit(contact))
+        target += bias / (float)step * depth;
+
+    return target;
+}
+
+/**
+ * @brief Solve a square linear system of up to MAX_MANIFOLD_CONTACTS rows by
+ * Gaussian elimination with partial pivoting. Returns false if the system is
+ * singular or badly conditioned, which is always the case for four points on a
+ * plane.
+ */
+static bool solveLinear(float A[][MAX_MANIFOLD_CONTACTS], const float *b, int count, float *x) {
+    float M[MAX_MANIFOLD_CONTACTS][MAX_MANIFOLD_CONTACTS + 1];
+    float scale = 0.0f;
+
+    for (int i = 0; i < count; i++) {
+        for (int j = 0; j < count; j++)
+            M[i][j] = A[i][j];
+
+        M[i][count] = -b[i];
+        scale = std::max(scale, A[i][i]);
+    }
+
+    for (int k = 0; k < count; k++) {
+        int pivot = k;
+
+        for (int i = k + 1; i < count; i++)
+            if (fabsf(M[i][k]) > fabsf(M[pivot][k]))
+                pivot = i;
+
+        if (fabsf(M[pivot][k]) <= 1e-4f * scale)
+            return false;
+
+        for (int j = k; j <= count; j++)
+            std::swap(M[k][j], M[pivot][j]);
+
+        for (int i = k + 1; i < count; i++) {
+            float f = M[i][k] / M[k][k];
+
+            for (int j = k; j <= count; j++)
+                M[i][j] -= f * M[k][j];
+        }
+    }
+
+    for (int i = count - 1; i >= 0; i--) {
+        float sum = M[i][count];
+
+        for (int j = i + 1; j < count; j++)
+            sum -= M[i][j] * x[j];
+
+        x[i] = sum / M[i][i];
+    }
+
+    return true;
+}
+
+/**
+ * @brief Solve one point of a manifold with the others held fixed. See
+ * System::resolveManifold().
+ */
+static void solvePoint(float A[][MAX_MANIFOLD_CONTACTS], const float *b, int count, int i,
+    float *x)
+{
+    float w = b[i];
+
+    for (int j = 0; j < count; j++)
+        if (j != i)
+            w += A[i][j] * x[j];
+
+    x[i] = std::max(-w / A[i][i], 0.0f);
+}
+
+/**
+ * @brief Solve two points of a manifold together with the others held fixed,
+ * by trying each combination of active points in turn. Falls back to solving
+ * the points one at a time when they are nearly coincident.
+ */
+static void solvePointPair(float A[][MAX_MANIFOLD_CONTACTS], const float *b, int count, int i,
+    int j, float *x)
+{
+    // Largest condition number of the 2x2 block solved directly
+    const float maxCondition = 1000.0f;
+
+    float a11 = A[i][i];
+    float a12 = A[i][j];
+    float a22 = A[j][j];
+    float det = a11 * a22 - a12 * a12;
+
+    if (a11 * a11 >= maxCondition * det) {
+        solvePoint(A, b, count, i, x);
+        solvePoint(A, b, count, j, x);
+        return;
+    }
+
+    float b1 = b[i];
+    float b2 = b[j];
+
+    for (int k = 0; k < count; k++) {
+        if (k != i && k != j) {
+            b1 += A[i][k] * x[k];
+            b2 += A[j][k] * x[k];
+        }
+    }
+
+    // Both points pushing, with zero velocity error at both
+    float x1 = (a12 * b2 - a22 * b1) / det;
+    float x2 = (a12 * b1 - a11 * b2) / det;
+
+    if (x1 >= 0.0f && x2 >= 0.0f) {
+        x[i] = x1;
+        x[j] = x2;
+        return;
+    }
+
+    // Only the first point pushing, and the second separating
+    x1 = -b1 / a11;
+
+    if (x1 >= 0.0f && a12 * x1 + b2 >= 0.0f) {
+        x[i] = x1;
+        x[j] = 0.0f;
+        return;
+    }
+
+    // Only the second point pushing
+    x2 = -b2 / a22;
+
+    if (x2 >= 0.0f && a12 * x2 + b1 >= 0.0f) {
+        x[i] = 0.0f;
+        x[j] = x2;
+        return;
+    }
+
+    // Neither point pushing
+    if (b1 >= 0.0f && b2 >= 0.0f) {
+        x[i] = 0.0f;
+        x[j] = 0.0f;
+    }
+}
+
+void System::resolveManifold(const int *indices, int count, float & impulseDelta,
+    float & residual, float scale1, float scale2)
+{
+    // Solves for accumulated normal impulses x >= 0 such that each point's
+    // velocity error w = A x + b is also >= 0, and zero wherever x > 0. A maps
+    // normal impulses to the change in normal velocity at every point, and b
+    // is the velocity error with the accumulated impulses taken back out.
+
+    ContactEx & first = contacts[indices[0]];
+    Body *b1 = first.b1;
+    Body *b2 = first.b2;
+    glm::vec3 n = first.contact.normal;
+
+    // Inverse masses are scaled as in resolveContact()
+    float im = b1->getInverseMass() * scale1 + b2->getInverseMass() * scale2;
+    glm::mat3 iI1 = b1->getInvInertiaTensor() * scale1;
+    glm::mat3 iI2 = b2->getInvInertiaTensor() * scale2;
+
+    glm::vec3 r1[MAX_MANIFOLD_CONTACTS];
+    glm::vec3 r2[MAX_MANIFOLD_CONTACTS];
+    glm::vec3 rn1[MAX_MANIFOLD_CONTACTS];
+    glm::vec3 rn2[MAX_MANIFOLD_CONTACTS];
+    float A[MAX_MANIFOLD_CONTACTS][MAX_MANIFOLD_CONTACTS];
+    float b[MAX_MANIFOLD_CONTACTS];
+    float a[MAX_MANIFOLD_CONTACTS];
+    float x[MAX_MANIFOLD_CONTACTS];
+
+    // As in resolveContact(), contacts with a body which does not move only
+    // remove approach velocity
+    bool held = scale1 == 0.0f || scale2 == 0.0f;
+
+    for (int i = 0; i < count; i++) {
+        const ContactEx & contact = contacts[indices[i]];
+        glm::vec3 p = contact.contact.position;
+
+        r1[i] = p - b1->getPosition();
+        r2[i] = p - b2->getPosition();
+        rn1[i] = glm::cross(r1[i], n);
+        rn2[i] = glm::cross(r2[i], n);
+
+        float vn = glm::dot(b2->getVelocityAtPoint(r2[i]) - b1->getVelocityAtPoint(r1[i]), n);
+
+        float target = held ? std::min(contact.target, std::max(vn, 0.0f)) : contact.target;
+
+        a[i] = contact.impulse;
+        x[i] = contact.impulse;
+        b[i] = vn - target;
+        residual = std::max(residual, -b[i]);
+    }
+
+    for (int i = 0; i < count; i++)
+        for (int j = 0; j < count; j++)
+            A[i][j] = im + glm::dot(rn1[i], iI1 * rn1[j]) + glm::dot(rn2[i], iI2 * rn2[j]);
+
+    for (int i = 0; i < count; i++)
+        for (int j = 0; j < count; j++)
+            b[i] -= A[i][j] * a[j];
+
+    if (count == 1)
+        solvePoint(A, b, count, 0, x);
+    else if (count == 2)
+        solvePointPair(A, b, count, 0, 1, x);
+    else {
+        bool solved = solveLinear(A, b, count, x);
+
+        for (int i = 0; solved && i < count; i++)
+            solved = x[i] >= 0.0f;
+
+        // Approximate the rest as a pair of points. The first point is
+        // paired with the point furthest from it, which for a face is the
+        // opposite corner.
+        if (!solved) {
+            for (int i = 0; i < count; i++)
+                x[i] = a[i];
+
+            int opposite = 1;
+            float maxDist = 0.0f;
+
+            for (int i = 1; i < count; i++) {
+                glm::vec3 d = r1[i] - r1[0];
+                float dist = glm::dot(d, d);
+
+                if (dist > maxDist) {
+                    opposite = i;
+                    maxDist = dist;
+                }
+            }
+
+            int rest[2] = { 0, 0 };
+            int numRest = 0;
+
+            for (int i = 1; i < count; i++)
+                if (i != opposite)
+                    rest[numRest++] = i;
+
+            solvePointPair(A, b, count, 0, opposite, x);
+
+            if (numRest == 2)
+                solvePointPair(A, b, count, rest[0], rest[1], x);
+            else
+                solvePoint(A, b, count, rest[0], x);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        float J = x[i] - a[i];
+
+        b1->addImpulse(-J * scale1 * n, r1[i]);
+        b2->addImpulse( J * scale2 * n, r2[i]);
+
+        contacts[indices[i]].impulse = x[i];
+        impulseDelta = std::max(impulseDelta, fabsf(J));
+    }
+}
+
+int System::findIsland(int body) {
+    while (islandParent[body] != body) {
+        islandParent[body] = islandParent[islandParent[body]];
+        body = islandParent[body];
+    }
+
+    return body;
+}
+
+int System::getIslandKey(int body1, int body2) {
+    // Key 0 collects constraints between fixed bodies
+    if (!bodies[body1]->getFixed())
+        return findIsland(body1) + 1;
+    else if (!bodies[body2]->getFixed())
+        return findIsland(body2) + 1;
+    else
+        return 0;
+}
+
+// Counting sort of item indices by key, which keeps the items of each key in
+// their original order. Afterwards, the items with key k are
+// items[offsets[k]] up to items[offsets[k + 1]].
+static void sortByKey(const std::vector<int> & keys, int numKeys,
+    std::vector<int> & offsets, std::vector<int> & items)
+{
+    offsets.assign(numKeys + 1, 0);
+
+    for (size_t i = 0; i < keys.size(); i++)
+        offsets[keys[i] + 1]++;
+
+    for (int k = 1; k <= numKeys; k++)
+        offsets[k] += offsets[k - 1];
+
+    items.resize(keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++)
+        items[offsets[keys[i]]++] = (int)i;
+
+    // Offsets were advanced to the end of each bucket, which is the start of
+    // the next one
+    for (int k = numKeys; k > 0; k--)
+        offsets[k] = offsets[k - 1];
+
+    offsets[0] = 0;
+}
+
+void System::buildIslands() {
+    // Bucket contacts, rods and springs by island root. Key 0 holds contacts
+    // and constraints with no non-fixed body.
+    int numKeys = (int)bodies.size() + 1;
+
+    islandKeys.resize(contacts.size());
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        int body = contactBodies[i];
+        islandKeys[i] = body >= 0 ? findIsland(body) + 1 : 0;
+    }
+
+    sortByKey(islandKeys, numKeys, islandOffsets, islandContacts);
+
+    islandKeys.resize(rods.size());
+
+    for (int i = 0; i < rods.size(); i++)
+        islandKeys[i] = getIslandKey(rods.body1[i], rods.body2[i]);
+
+    sortByKey(islandKeys, numKeys, islandRodOffsets, islandRods);
+
+    islandKeys.resize(springs.size());
+
+    for (int i = 0; i < springs.size(); i++)
+        islandKeys[i] = getIslandKey(springs.body1[i], springs.body2[i]);
+
+    sortByKey(islandKeys, numKeys, islandSpringOffsets, islandSprings);
+
+    // The direct solver's components each lie within one island
+    int numComponents = 0;
+
+    if (directSolving) {
+        directSolver->update(bodies, rods, springs);
+        numComponents = directSolver->getNumComponents();
+    }
+
+    islandKeys.resize(numComponents);
+
+    for (int i = 0; i < numComponents; i++) {
+        int body1, body2;
+        directSolver->getComponentBodies(rods, springs, i, body1, body2);
+        islandKeys[i] = getIslandKey(body1, body2);
+    }
+
+    sortByKey(islandKeys, numKeys, islandComponentOffsets, islandComponents);
+
+    islandKeys.resize(articulations.size());
+
+    for (size_t i = 0; i < articulations.size(); i++) {
+        int base = articulationBodies[i];
+        int link = articulations[i]->getNumLinks() > 1 ? base + 1 : base;
+        islandKeys[i] = getIslandKey(base, link);
+    }
+
+    sortByKey(islandKeys, numKeys, islandArticulationOffsets, islandArticulations);
+
+    // Compact the offsets into a list of islands with anything to solve. An
+    // island is never written past the key it is read from.
+    int count = 0;
+
+    for (int k = 0; k < numKeys; k++) {
+        if (islandOffsets[k + 1] == islandOffsets[k] &&
+            islandRodOffsets[k + 1] == islandRodOffsets[k] &&
+            islandSpringOffsets[k + 1] == islandSpringOffsets[k])
+            continue;
+
+        islandOffsets[count] = islandOffsets[k];
+        islandRodOffsets[count] = islandRodOffsets[k];
+        islandSpringOffsets[count] = islandSpringOffsets[k];
+        islandComponentOffsets[count] = islandComponentOffsets[k];
+        islandArticulationOffsets[count] = islandArticulationOffsets[k];
+        count++;
+    }
+
+    islandOffsets[count] = islandOffsets[numKeys];
+    islandRodOffsets[count] = islandRodOffsets[numKeys];
+    islandSpringOffsets[count] = islandSpringOffsets[numKeys];
+    islandComponentOffsets[count] = islandComponentOffsets[numKeys];
+    islandArticulationOffsets[count] = islandArticulationOffsets[numKeys];
+
+    islandOffsets.resize(count + 1);
+    islandRodOffsets.resize(count + 1);
+    islandSpringOffsets.resize(count + 1);
+    islandComponentOffsets.resize(count + 1);
+    islandArticulationOffsets.resize(count + 1);
+}
+
+void System::applyArticulationImpulses(int start, int end) {
+    for (int i = start; i < end; i++)
+        articulations[islandArticulations[i]]->applyImpulses();
+}
+
+void System::spreadLayers(int start) {
+    // Breadth first from the bodies queued from start onwards. Layers do not
+    // pass through fixed bodies.
+    for (int head = start; head < (int)layerQueue.size(); head++) {
+        int body = layerQueue[head];
+
+        for (int i = layerOffsets[body]; i < layerOffsets[body + 1]; i++) {
+            const Collision::Pair & pair = contactPairs[layerContacts[i]];
+            int other = pair.i1 == body ? pair.i2 : pair.i1;
+
+            if (bodyLayers[other] >= 0 || bodies[other]->getFixed())
+                continue;
+
+            bodyLayers[other] = bodyLayers[body] + 1;
+            layerQueue.push_back(other);
+        }
+    }
+}
+
+void System::buildLayers() {
+    int numBodies = (int)bodies.size();
+
+    // List each body's contacts, with a counting sort as in buildIslands()
+    layerOffsets.assign(numBodies + 1, 0);
+
+    for (auto & pair : contactPairs) {
+        layerOffsets[pair.i1 + 1]++;
+        layerOffsets[pair.i2 + 1]++;
+    }
+
+    for (int i = 0; i < numBodies; i++)
+        layerOffsets[i + 1] += layerOffsets[i];
+
+    layerContacts.resize(contactPairs.size() * 2);
+    layerQueue.assign(layerOffsets.begin(), layerOffsets.end() - 1);
+
+    for (size_t i = 0; i < contactPairs.size(); i++) {
+        layerContacts[layerQueue[contactPairs[i].i1]++] = (int)i;
+        layerContacts[layerQueue[contactPairs[i].i2]++] = (int)i;
+    }
+
+    // Layers spread out from the fixed bodies
+    bodyLayers.assign(numBodies, -1);
+    layerQueue.clear();
+
+    for (int i = 0; i < numBodies; i++) {
+        if (bodies[i]->getFixed() && layerOffsets[i + 1] > layerOffsets[i]) {
+            bodyLayers[i] = 0;
+            layerQueue.push_back(i);
+        }
+    }
+
+    spreadLayers(0);
+
+    // Islands which do not touch a fixed body are layered from their lowest
+    // body, which stands in for the ground. An island's bodies are connected,
+    // so either all of them have a layer or none do.
+    int numIslands = (int)islandOffsets.size() - 1;
+
+    for (int island = 0; island < numIslands; island++) {
+        int start = islandOffsets[island];
+        int end = islandOffsets[island + 1];
+
+        // Layers only order contacts
+        if (start == end)
+            continue;
+
+        int root = contactBodies[islandContacts[start]];
+
+        if (root < 0 || bodyLayers[root] >= 0)
+            continue;
+
+        int lowest = root;
+
+        for (int i = start; i < end; i++) {
+            const Collision::Pair & pair = contactPairs[islandContacts[i]];
+
+            int candidates[2] = { pair.i1, pair.i2 };
+
+            for (int k = 0; k < 2; k++) {
+                glm::vec3 offset = bodies[candidates[k]]->getPosition() -
+                    bodies[lowest]->getPosition();
+
+                if (glm::dot(offset, gravity) > 0.0f)
+                    lowest = candidates[k];
+            }
+        }
+
+        int first = (int)layerQueue.size();
+        bodyLayers[lowest] = 1;
+        layerQueue.push_back(lowest);
+        spreadLayers(first);
+    }
+
+    // Solve each island from the bottom up. The sort is stable, so the points
+    // of a manifold stay together.
+    for (int island = 0; island < numIslands; island++) {
+        std::stable_sort(islandContacts.begin() + islandOffsets[island],
+            islandContacts.begin() + islandOffsets[island + 1],
+            [this](int a, int b) {
+                const Collision::Pair & pa = contactPairs[a];
+                const Collision::Pair & pb = contactPairs[b];
+
+                return std::min(bodyLayers[pa.i1], bodyLayers[pa.i2]) <
+                    std::min(bodyLayers[pb.i1], bodyLayers[pb.i2]);
+            });
+    }
+}
+
+void System::prepareConstraints(float h) {
+    float beta = 0.2f; // Fraction of a rod's length error corrected per step
+
+    for (int i = 0; i < rods.size(); i++) {
+        Body *b1 = bodies[rods.body1[i]].get();
+        Body *b2 = bodies[rods.body2[i]].get();
+
+        glm::vec3 d = b2->getPosition() - b1->getPosition();
+        float dist = glm::length(d);
+        float k = b1->getInverseMass() + b2->getInverseMass();
+
+        rods.normal[i] = dist > 0.0f ? d / dist : glm::vec3(0.0f);
+        rods.mass[i] = dist > 0.0f && k > 0.0f ? 1.0f / k : 0.0f;
+        rods.bias[i] = beta * (dist - rods.length[i]) / h;
+        rods.impulse[i] = 0.0f;
+    }
+
+    // Springs are soft rods. With stiffness k and damping c, an impulse which
+    // would push the velocity error to 0 is softened so that the constraint
+    // behaves like the spring integrated implicitly over the step.
+    for (int i = 0; i < springs.size(); i++) {
+        Body *b1 = bodies[springs.body1[i]].get();
+        Body *b2 = bodies[springs.body2[i]].get();
+
+        glm::vec3 d = b2->getPosition() - b1->getPosition();
+        float dist = glm::length(d);
+        float k = b1->getInverseMass() + b2->getInverseMass();
+
+        float stiffness = springs.stiffness[i];
+        float c = springs.damping[i] + h * stiffness;
+        float softness = c > 0.0f ? 1.0f / (h * c) : 0.0f;
+
+        springs.normal[i] = dist > 0.0f ? d / dist : glm::vec3(0.0f);
+        springs.mass[i] = dist > 0.0f && k > 0.0f && c > 0.0f ? 1.0f / (k + softness) : 0.0f;
+        springs.bias[i] = c > 0.0f ? stiffness * (dist - springs.length[i]) / c : 0.0f;
+        springs.softness[i] = softness;
+        springs.impulse[i] = 0.0f;
+    }
+}
+
+void System::solveRods(int start, int end, float & impulseDelta, float & residual) {
+    for (int k = start; k < end; k++) {
+        int i = islandRods[k];
+        Body *b1 = bodies[rods.body1[i]].get();
+        Body *b2 = bodies[rods.body2[i]].get();
+        glm::vec3 n = rods.normal[i];
+
+        float error = glm::dot(b2->getLinearVelocity() - b1->getLinearVelocity(), n) +
+            rods.bias[i];
+        float J = -error * rods.mass[i];
+
+        rods.impulse[i] += J;
+
+        b1->addLinearImpulse(-J * n);
+        b2->addLinearImpulse( J * n);
+
+        impulseDelta = std::max(impulseDelta, fabsf(J));
+        residual = std::max(residual, rods.mass[i] > 0.0f ? fabsf(error) : 0.0f);
+    }
+}
+
+void System::solveSprings(int start, int end, float & impulseDelta, float & residual) {
+    for (int k = start; k < end; k++) {
+        int i = islandSprings[k];
+        Body *b1 = bodies[springs.body1[i]].get();
+        Body *b2 = bodies[springs.body2[i]].get();
+        glm::vec3 n = springs.normal[i];
+
+        float error = glm::dot(b2->getLinearVelocity() - b1->getLinearVelocity(), n) +
+            springs.bias[i] + springs.softness[i] * springs.impulse[i];
+        float J = -error * springs.mass[i];
+
+        springs.impulse[i] += J;
+
+        b1->addLinearImpulse(-J * n);
+        b2->addLinearImpulse( J * n);
+
+        impulseDelta = std::max(impulseDelta, fabsf(J));
+        residual = std::max(residual, springs.mass[i] > 0.0f ? fabsf(error) : 0.0f);
+    }
+}
+
+bool System::isDirectIsland(int island) {
+    // Islands with a few contacts among many constraints, such as ropes and
+    // chains lying on the ground. Small groups converge well enough by
+    // iterating.
+    int minConstraints = 8;
+    int constraintsPerContact = 4;
+
+    int numConstraints = islandRodOffsets[island + 1] - islandRodOffsets[island] +
+        islandSpringOffsets[island + 1] - islandSpringOffsets[island];
+    int numContacts = islandOffsets[island + 1] - islandOffsets[island];
+
+    return directSolving && numConstraints >= minConstraints &&
+        numContacts * constraintsPerContact <= numConstraints;
+}
+
+void System::solveIsland(int island, bool direct, bool shock, float & impulseDelta,
+    float & residual)
+{
+    // Rods and springs go first, so that contacts have the last word
+    if (direct) {
+        for (int i = islandComponentOffsets[island]; i < islandComponentOffsets[island + 1]; i++)
+            directSolver->solve(islandComponents[i], bodies, rods, springs, impulseDelta,
+                residual);
+    }
+    else {
+        solveRods(islandRodOffsets[island], islandRodOffsets[island + 1], impulseDelta,
+            residual);
+        solveSprings(islandSpringOffsets[island], islandSpringOffsets[island + 1],
+            impulseDelta, residual);
+    }
+
+    int end = islandOffsets[island + 1];
+
+    for (int i = islandOffsets[island]; i < end; ) {
+        int index = islandContacts[i];
+        float contactImpulseDelta = 0.0f;
+        float contactResidual = 0.0f;
+
+        // Points of a manifold are adjacent, because contacts are generated a
+        // pair at a time and islands keep their order
+        int count = 1;
+
+        if (blockSolver) {
+            const ContactEx & contact = contacts[index];
+
+            while (count < MAX_MANIFOLD_CONTACTS && i + count < end &&
+                contacts[islandContacts[i + count]].b1 == contact.b1 &&
+                contacts[islandContacts[i + count]].b2 == contact.b2)
+                count++;
+        }
+
+        // During shock propagation, the lower body of a contact does not move
+        float scale1 = 1.0f;
+        float scale2 = 1.0f;
+
+        if (shock) {
+            int layer1 = bodyLayers[contactPairs[index].i1];
+            int layer2 = bodyLayers[contactPairs[index].i2];
+
+            scale1 = layer1 < layer2 ? 0.0f : 1.0f;
+            scale2 = layer2 < layer1 ? 0.0f : 1.0f;
+        }
+
+        if (count > 1)
+            resolveManifold(&islandContacts[i], count, contactImpulseDelta, contactResidual,
+                scale1, scale2);
+        else
+            resolveContact(contacts[index], contactImpulseDelta, contactResidual, scale1,
+                scale2);
+
+        impulseDelta = std::max(impulseDelta, contactImpulseDelta);
+        residual = std::max(residual, contactResidual);
+
+        for (int k = i; k < i + count; k++) {
+            ContactEx & contact = contacts[islandContacts[k]];
+            glm::vec3 p = contact.contact.position;
+
+            resolveFriction(contact, p - contact.b1->getPosition(), p - contact.b2->getPosition(),
+                contact.impulse, scale1, scale2);
+        }
+
+        i += count;
+    }
+}
+
+void System::solveIslandPenetration(int island, float & impulseDelta) {
+    for (int i = islandOffsets[island]; i < islandOffsets[island + 1]; i++) {
+        float contactImpulseDelta = 0.0f;
+        resolvePenetration(contacts[islandContacts[i]], contactImpulseDelta);
+        impulseDelta = std::max(impulseDelta, contactImpulseDelta);
+    }
+}
+
+void System::solveContacts() {
+    buildIslands();
+
+    if (shockPropagation)
+        buildLayers();
+
+    prepareConstraints((float)step);
+
+    int numIslands = (int)islandOffsets.size() - 1;
+
+    stepStats.contacts = (int)contacts.size();
+    stepStats.constraints = rods.size() + springs.size();
+    stepStats.islands = numIslands;
+    stepStats.iterations = 0;
+    stepStats.maxIterations = 0;
+    stepStats.impulseDelta = 0.0f;
+    stepStats.residual = 0.0f;
+
+    if (blockSolver)
+        for (auto & contact : contacts)
+            contact.target = getTargetVelocity(contact);
+
+    for (int island = 0; island < numIslands; island++) {
+        int iteration = 0;
+        float maxImpulseDelta = 0.0f;
+        float maxResidual = 0.0f;
+
+        bool direct = isDirectIsland(island);
+
+        if (direct) {
+            for (int i = islandComponentOffsets[island]; i < islandComponentOffsets[island + 1];
+                i++)
+                directSolver->factor(islandComponents[i], bodies, rods, springs);
+        }
+
+        while (iteration < maxIterations) {
+            maxImpulseDelta = 0.0f;
+            maxResidual = 0.0f;
+
+            solveIsland(island, direct, false, maxImpulseDelta, maxResidual);
+
+            // Links pass what they were given on to the rest of their
+            // articulation before the next iteration
+            applyArticulationImpulses(islandArticulationOffsets[island],
+                islandArticulationOffsets[island + 1]);
+
+            iteration++;
+
+            if (iteration >= minIterations && maxImpulseDelta <= impulseTolerance &&
+                maxResidual <= residualTolerance)
+                break;
+        }
+
+        // The extra iteration is counted, but its impulses are not part of the
+        // convergence statistics
+        if (shockPropagation) {
+            float shockImpulseDelta = 0.0f;
+            float shockResidual = 0.0f;
+
+            solveIsland(island, direct, true, shockImpulseDelta, shockResidual);
+            applyArticulationImpulses(islandArticulationOffsets[island],
+                islandArticulationOffsets[island + 1]);
+            iteration++;
+        }
+
+        // Penetration is removed once velocities are settled, so that the
+        // push apart does not fight the contact impulses
+        if (splitImpulse) {
+            for (int pass = 0; pass < maxIterations; pass++) {
+                float pseudoImpulseDelta = 0.0f;
+
+                solveIslandPenetration(island, pseudoImpulseDelta);
+
+                if (pass + 1 >= minIterations && pseudoImpulseDelta <= impulseTolerance)
+                    break;
+            }
+        }
+
+        stepStats.iterations += iteration;
+        stepStats.maxIterations = std::max(stepStats.maxIterations, iteration);
+        stepStats.impulseDelta = std::max(stepStats.impulseDelta, maxImpulseDelta);
+        stepStats.residual = std::max(stepStats.residual, maxResidual);
+    }
+}
+
+void System::trackContacts() {
+    contactTracker.beginStep();
+
+    // Speculative contacts with a gap are not touching yet
+    for (size_t i = 0; i < pairContacts.size(); i++) {
+        if (pairContacts[i].contact.depth < 0.0f)
+            continue;
+
+        int index = solverContacts[i];
+        contactTracker.addContact(pairContacts[i], index >= 0 ? contacts[index].impulse : 0.0f);
+    }
+
+    pairEvents.clear();
+    contactTracker.endStep(pairEvents);
+
+    for (auto & pairEvent : pairEvents) {
+        ContactEvent event;
+        event.type = pairEvent.type;
+        event.b1 = bodies[pairEvent.i1].get();
+        event.b2 = bodies[pairEvent.i2].get();
+        event.point = pairEvent.position;
+        event.normal = pairEvent.normal;
+        event.impulse = pairEvent.impulse;
+        contactEvents.push_back(event);
+
+        if (contactEventQueue && !contactEventQueue->push(event))
+            droppedContactEvents++;
+    }
+}
+
+void System::integrate(double t, double dt) {
+    accumTime += dt * timeWarp;
+
+    contactEvents.clear();
+
+    // With an amortized broadphase, pairs are found once for every step in
+    // this call. One extra step is allowed for in case of rounding.
+    int numSteps = (int)(accumTime / step);
+    bool amortize = amortizedBroadphase && numSteps > 1;
+
+    if (amortize && !bodies.empty())
+        findPairs(numSteps + 1);
+
+    while (accumTime >= step) {
+        contacts.clear();
+        /*gravity += glm::vec3(
+            (sinf(time) + sinf(time * 0.6f) + sinf(time * 1.7) + sinf(time * 3.4f)) * 1.5f, 0, 0);*/
+
+        if (backend == XPBDBackend)
+            stepXPBD(!amortize);
+        else if (solverMode == TGS)
+            stepTGS(!amortize);
+        else
+            stepImpulse(!amortize);
+
+        // Bodies have moved since the broadphase was built, so deformables
+        // and queries refit it before use
+        queriesDirty = true;
+
+        for (auto network : springNetworks)
+            network->step(gravity, (float)step, *threadPool);
+
+        if (!cloths.empty() || !softBodies.empty() || !fluids.empty() || !granulars.empty() ||
+            !continua.empty())
+            stepDeformables();
+
+        time += step;
+        accumTime -= step;
+    }
+}
+
+void System::stepImpulse(bool updatePairs) {
+    // Articulations apply gravity and their links' forces themselves
+    for (auto body : bodies) {
+        if (body->getArticulated())
+            continue;
+
+        body->addLinearForce(gravity * body->getMass());
+        body->integrateVelocities(step);
+    }
+
+    for (auto articulation : articulations) {
+        articulation->computeDynamics(gravity, (float)step);
+        articulation->clearForces();
+    }
+
+    findContacts(updatePairs);
+
+    solveContacts();
+
+    if (contactTracking)
+        trackContacts();
+
+    for (auto body : bodies)
+        if (!body->getArticulated())
+            body->integrateTransform(step);
+
+    for (auto articulation : articulations)
+        articulation->integrate((float)step);
+}
+
+void System::solveSubstepContacts(float h, bool relax, float & impulseDelta,
+    float & residual)
+{
+    // Penetration is pushed out with a bias velocity, which the relax pass
+    // after each substep's positions are integrated solves without
+    float beta = 0.2f;    // Fraction of penetration removed per substep
+    float slop = 0.005f;  // Penetration which is allowed, to keep contacts alive
+    float maxPush = 3.0f; // Fastest speed penetration is resolved at
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        ContactEx & contact = contacts[i];
+        const SubstepContact & sc = substepContacts[i];
+
+        Transform & t1 = contact.b1->getTransform();
+        Transform & t2 = contact.b2->getTransform();
+        glm::vec3 n = contact.contact.normal;
+        glm::vec3 r1 = t1.orientation * sc.anchor1;
+        glm::vec3 r2 = t2.orientation * sc.anchor2;
+
+        // The anchors started at the same point, so their relative motion
+        // along the normal is the change in separation
+        float s = sc.separation + glm::dot((t2.position + r2) - (t1.position + r1), n);
+
+        // Close a gap over this substep, or push out of penetration
+        float target = 0.0f;
+
+        if (s > 0.0f)
+            target = -s / h;
+        else if (!relax && s < -slop)
+            target = std::min(-beta * (s + slop) / h, maxPush);
+
+        // Impulses act where the contact was found. The anchors turn with
+        // rolling bodies, and would lift off a curved surface.
+        float vn = glm::dot(contact.b2->getVelocityAtPoint(sc.arm2) -
+            contact.b1->getVelocityAtPoint(sc.arm1), n);
+
+        float J = (target - vn) * sc.mass;
+        float accumulated = std::max(contact.impulse + J, 0.0f);
+        J = accumulated - contact.impulse;
+        contact.impulse = accumulated;
+
+        contact.b1->addImpulse(-J * n, sc.arm1);
+        contact.b2->addImpulse( J * n, sc.arm2);
+
+        impulseDelta = std::max(impulseDelta, fabsf(J));
+        residual = std::max(residual, std::max(target - vn, 0.0f));
+
+        resolveFriction(contact, r1, r2, contact.impulse);
+    }
+}
+
+void System::stepTGS(bool updatePairs) {
+    float elasticity = 0.7f;  // Coefficient of restitution
+    float threshold = 1.0f;   // Approach speed below which contacts do not bounce
+    float match = 0.05f;      // Farthest a contact may move and keep its impulses
+    float carry = 0.5f;       // Share of the friction impulses kept from the last step
+
+    float h = (float)step / substeps;
+
+    // Accumulated forces are applied over the whole step up front. Gravity is
+    // applied per substep below. Articulations apply their links' forces in
+    // each substep.
+    for (auto body : bodies)
+        if (!body->getArticulated())
+            body->integrateVelocities(step);
+
+    // Boxes must cover anywhere bodies may reach during the step
+    if (updatePairs && !bodies.empty())
+        findPairs(1);
+
+    findContacts(false);
+
+    // Rods and springs are solved all together, in island order
+    buildIslands();
+
+    substepContacts.resize(contacts.size());
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        const ContactEx & contact = contacts[i];
+        SubstepContact & sc = substepContacts[i];
+
+        Transform & t1 = contact.b1->getTransform();
+        Transform & t2 = contact.b2->getTransform();
+        glm::vec3 p = contact.contact.position;
+        glm::vec3 n = contact.contact.normal;
+        glm::vec3 r1 = p - t1.position;
+        glm::vec3 r2 = p - t2.position;
+
+        sc.anchor1 = glm::conjugate(t1.orientation) * r1;
+        sc.anchor2 = glm::conjugate(t2.orientation) * r2;
+        sc.arm1 = r1;
+        sc.arm2 = r2;
+        sc.separation = -contact.contact.depth;
+
+        float div = contact.b1->getInverseMass() + contact.b2->getInverseMass();
+        div += glm::dot(
+            (contact.b1->getInvInertiaTensor() * glm::cross(glm::cross(r1, n), r1) +
+             contact.b2->getInvInertiaTensor() * glm::cross(glm::cross(r2, n), r2)),
+            n);
+
+        sc.mass = div > 0.0f ? 1.0f / div : 0.0f;
+        sc.approach = glm::dot(contact.b2->getVelocityAtPoint(r2) -
+            contact.b1->getVelocityAtPoint(r1), n);
+        sc.total = 0.0f;
+    }
+
+    // Contacts start from the impulses of the nearest contact of the same pair
+    // in the last step, so that the weight of a stack reaches the ground
+    // without many iterations. Only part of the friction is kept, as friction
+    // carried in full locks in sideways forces which make stacks sway.
+    for (size_t i = 0; i < contacts.size(); i++) {
+        ContactEx & contact = contacts[i];
+        const SubstepContact & sc = substepContacts[i];
+        const glm::quat & q1 = contact.b1->getTransform().orientation;
+
+        uint64_t key = ((uint64_t)contactPairs[i].i1 << 32) | (uint32_t)contactPairs[i].i2;
+        float nearest = match * match;
+
+        auto warm = std::lower_bound(warmContacts.begin(), warmContacts.end(), key,
+            [](const WarmContact & warm, uint64_t key) { return warm.key < key; });
+
+        for (; warm != warmContacts.end() && warm->key == key; warm++) {
+            glm::vec3 d = warm->anchor - sc.anchor1;
+            float dist2 = glm::dot(d, d);
+
+            if (dist2 >= nearest)
+                continue;
+
+            glm::vec3 tangent = carry * (q1 * warm->tangentImpulse);
+
+            contact.impulse = warm->impulse;
+            contact.tangentImpulse1 = glm::dot(tangent, contact.tangent1);
+            contact.tangentImpulse2 = glm::dot(tangent, contact.tangent2);
+            contact.rollingImpulse = carry * (q1 * warm->rollingImpulse);
+            nearest = dist2;
+        }
+    }
+
+    float maxImpulseDelta = 0.0f;
+    float maxResidual = 0.0f;
+
+    for (int substep = 0; substep < substeps; substep++) {
+        for (auto body : bodies)
+            if (!body->getArticulated())
+                body->addLinearVelocity(gravity * h);
+
+        for (auto articulation : articulations)
+            articulation->computeDynamics(gravity, h);
+
+        maxImpulseDelta = 0.0f;
+        maxResidual = 0.0f;
+
+        // Constraints are refreshed from the positions at each substep. The
+        // direct solver, if enabled, takes every component, because there is
+        // only one pass per substep.
+        prepareConstraints(h);
+
+        if (directSolving) {
+            for (int i = 0; i < directSolver->getNumComponents(); i++) {
+                directSolver->factor(i, bodies, rods, springs);
+                directSolver->solve(i, bodies, rods, springs, maxImpulseDelta, maxResidual);
+            }
+        }
+        else {
+            solveRods(0, (int)islandRods.size(), maxImpulseDelta, maxResidual);
+            solveSprings(0, (int)islandSprings.size(), maxImpulseDelta, maxResidual);
+        }
+
+        // Impulses are accumulated per substep, so each substep first applies
+        // those of the last, and then corrects them. Friction acts at the
+        // anchors, which turn with the bodies.
+        for (size_t i = 0; i < contacts.size(); i++) {
+            const ContactEx & contact = contacts[i];
+            const SubstepContact & sc = substepContacts[i];
+
+            glm::vec3 r1 = contact.b1->getTransform().orientation * sc.anchor1;
+            glm::vec3 r2 = contact.b2->getTransform().orientation * sc.anchor2;
+            glm::vec3 Jn = contact.impulse * contact.contact.normal;
+            glm::vec3 Jt = contact.tangentImpulse1 * contact.tangent1 +
+                contact.tangentImpulse2 * contact.tangent2;
+
+            contact.b1->addImpulse(-Jn, sc.arm1);
+            contact.b2->addImpulse( Jn, sc.arm2);
+            contact.b1->addImpulse(-Jt, r1);
+            contact.b2->addImpulse( Jt, r2);
+            contact.b1->addAngularImpulse(-contact.rollingImpulse);
+            contact.b2->addAngularImpulse( contact.rollingImpulse);
+        }
+
+        solveSubstepContacts(h, false, maxImpulseDelta, maxResidual);
+
+        for (auto articulation : articulations)
+            articulation->applyImpulses();
+
+        for (auto body : bodies)
+            if (!body->getArticulated())
+                body->integrateTransform(h);
+
+        for (auto articulation : articulations)
+            articulation->integrate(h);
+
+        // Remove the velocity which pushed bodies out of each other, so that
+        // it does not carry on into the next substep as bouncing
+        float relaxImpulseDelta = 0.0f;
+        float relaxResidual = 0.0f;
+
+        solveSubstepContacts(h, true, relaxImpulseDelta, relaxResidual);
+
+        for (auto articulation : articulations)
+            articulation->applyImpulses();
+
+        for (size_t i = 0; i < contacts.size(); i++)
+            substepContacts[i].total += contacts[i].impulse;
+    }
+
+    // Keep the last substep's impulses for the next step, and report the
+    // impulse over the whole step
+    nextWarmContacts.resize(contacts.size());
+
+    for (size_t i = 0; i < contacts.size(); i++) {
+        ContactEx & contact = contacts[i];
+        const SubstepContact & sc = substepContacts[i];
+        WarmContact & warm = nextWarmContacts[i];
+        glm::quat q1 = glm::conjugate(contact.b1->getTransform().orientation);
+
+        warm.key = ((uint64_t)contactPairs[i].i1 << 32) | (uint32_t)contactPairs[i].i2;
+        warm.anchor = sc.anchor1;
+        warm.impulse = contact.impulse;
+        warm.tangentImpulse = q1 * (contact.tangentImpulse1 * contact.tangent1 +
+            contact.tangentImpulse2 * contact.tangent2);
+        warm.rollingImpulse = q1 * contact.rollingImpulse;
+
+        contact.impulse = sc.total;
+    }
+
+    std::sort(nextWarmContacts.begin(), nextWarmContacts.end(),
+        [](const WarmContact & a, const WarmContact & b) { return a.key < b.key; });
+    warmContacts.swap(nextWarmContacts);
+
+    // Restitution is applied once at the end of the step, based on the speed
+    // at which the contact was approaching when it was found
+    for (size_t i = 0; i < contacts.size(); i++) {
+        ContactEx & contact = contacts[i];
+        const SubstepContact & sc = substepContacts[i];
+
+        if (sc.approach > -threshold || contact.impulse == 0.0f)
+            continue;
+
+        glm::vec3 n = contact.contact.normal;
+
+        float vn = glm::dot(contact.b2->getVelocityAtPoint(sc.arm2) -
+            contact.b1->getVelocityAtPoint(sc.arm1), n);
+
+        float J = (-elasticity * sc.approach - vn) * sc.mass;
+        float accumulated = std::max(contact.impulse + J, 0.0f);
+        J = accumulated - contact.impulse;
+        contact.impulse = accumulated;
+
+        contact.b1->addImpulse(-J * n, sc.arm1);
+        contact.b2->addImpulse( J * n, sc.arm2);
+    }
+
+    for (auto articulation : articulations) {
+        articulation->applyImpulses();
+        articulation->clearForces();
+    }
+
+    stepStats.contacts = (int)contacts.size();
+    stepStats.constraints = rods.size() + springs.size();
+    stepStats.islands = (int)islandOffsets.size() - 1;
+    stepStats.iterations = substeps;
+    stepStats.maxIterations = substeps;
+    stepStats.impulseDelta = maxImpulseDelta;
+    stepStats.residual = maxResidual;
+
+    if (contactTracking)
+        trackContacts();
+}
+
+std::vector<System::ContactEx> & System::getContacts() {
+    return contacts;
+}
+
+void System::setContactTracking(bool contactTracking) {
+    this->contactTracking = contactTracking;
+
+    if (!contactTracking)
+        contactTracker.clear();
+}
+
+bool System::getContactTracking() {
+    return contactTracking;
+}
+
+const std::vector<System::ContactEvent> & System::getContactEvents() {
+    return contactEvents;
+}
+
+void System::setContactEventQueue(ContactEventQueue *queue) {
+    contactEventQueue = queue;
+}
+
+long long System::getDroppedContactEvents() {
+    return droppedContactEvents;
+}
+
+void System::setSolverIterations(int minIterations, int maxIterations) {
+    this->minIterations = minIterations;
+    this->maxIterations = maxIterations;
+}
+
+void System::setSolverTolerance(float impulseTolerance, float residualTolerance) {
+    this->impulseTolerance = impulseTolerance;
+    this->residualTolerance = residualTolerance;
+}
+
+void System::setSplitImpulse(bool splitImpulse) {
+    this->splitImpulse = splitImpulse;
+}
+
+bool System::getSplitImpulse() {
+    return splitImpulse;
+}
+
+void System::setBlockSolver(bool blockSolver) {
+    this->blockSolver = blockSolver;
+}
+
+bool System::getBlockSolver() {
+    return blockSolver;
+}
+
+void System::setDirectSolver(bool directSolver) {
+    this->directSolving = directSolver;
+}
+
+bool System::getDirectSolver() {
+    return directSolving;
+}
+
+void System::setShockPropagation(bool shockPropagation) {
+    this->shockPropagation = shockPropagation;
+}
+
+bool System::getShockPropagation() {
+    return shockPropagation;
+}
+
+const std::vector<int> & System::getBodyLayers() {
+    return bodyLayers;
+}
+
+void System::stepXPBD(bool updatePairs) {
+    // Accumulated forces are applied over the whole step up front. Gravity is
+    // applied per substep by the solver.
+    for (auto body : bodies)
+        body->integrateVelocities(step);
+
+    if (updatePairs && !bodies.empty())
+        findPairs(1);
+
+    findContacts(false);
+
+    xpbdSolver->step(bodies, contacts, rods, springs, gravity, (float)step, substeps);
+
+    stepStats.contacts = (int)contacts.size();
+    stepStats.constraints = rods.size() + springs.size();
+    stepStats.islands = (int)islandOffsets.size() - 1;
+    stepStats.iterations = substeps;
+    stepStats.maxIterations = substeps;
+    stepStats.impulseDelta = 0.0f;
+    stepStats.residual = 0.0f;
+
+    if (contactTracking)
+        trackContacts();
+}
+
+System::Backend System::getBackend() {
+    return backend;
+}
+
+void System::setSolverMode(SolverMode solverMode) {
+    this->solverMode = solverMode;
+}
+
+System::SolverMode System::getSolverMode() {
+    return solverMode;
+}
+
+void System::setSubsteps(int substeps) {
+    this->substeps = substeps;
+}
+
+int System::getSubsteps() {
+    return substeps;
+}
+
+const System::StepStats & System::getStepStats() {
+    return stepStats;
+}
+
+void System::setAmortizedBroadphase(bool amortizedBroadphase) {
+    this->amortizedBroadphase = amortizedBroadphase;
+}
+
+bool System::getAmortizedBroadphase() {
+    return amortizedBroadphase;
+}
+
+void System::setContactCaching(bool contactCaching) {
+    this->contactCaching = contactCaching;
+
+    if (!contactCaching)
+        contactCache.clear();
+}
+
+bool System::getContactCaching() {
+    return contactCaching;
+}
+
+Collision::ContactCache & System::getContactCache() {
+    return contactCache;
+}
+
+std::vector<std::shared_ptr<Body>> & System::getBodies() {
+    return bodies;
+}
+
+void System::setThreadCount(int numThreads) {
+    threadPool.reset(new ThreadPool(numThreads));
+}
+
+ThreadPool & System::getThreadPool() {
+    return *threadPool;
+}
+
+void System::convertRayHit(const Collision::RayHit & hit, RayHit & result) {
+    result.body = hit.index >= 0 ? bodies[hit.index].get() : nullptr;
+    result.point = hit.point;
+    result.normal = hit.normal;
+    result.distance = hit.distance;
+}
+
+void System::findDeformableColliders(const AABB & box) {
+    deformableColliders.clear();
+
+    auto visitor = [&](int index) {
+        Body *body = bodies[index].get();
+
+        if (!body->getSensor())
+            deformableColliders.push_back(body);
+    };
+
+    broadphase.query(box, visitor);
+}
+
+void System::stepDeformables() {
+    // Colliders are found from where bodies are after this step's transform
+    // integration, not from boxes built before it
+    prepareQueries();
+
+    Body *const *colliders;
+
+    for (auto cloth : cloths) {
+        findDeformableColliders(cloth->getBounds(gravity, (float)step));
+        colliders = deformableColliders.empty() ? nullptr : &deformableColliders[0];
+
+        cloth->step(gravity, (float)step, colliders, (int)deformableColliders.size(),
+            *threadPool);
+    }
+
+    for (auto softBody : softBodies) {
+        findDeformableColliders(softBody->getBounds(gravity, (float)step));
+        colliders = deformableColliders.empty() ? nullptr : &deformableColliders[0];
+
+        softBody->step(gravity, (float)step, colliders, (int)deformableColliders.size(),
+            *threadPool);
+    }
+
+    // Fluids take the steps which have come due since the last system step
+    for (auto fluid : fluids) {
+        for (int i = fluid->advance((float)step); i > 0; i--) {
+            findDeformableColliders(fluid->getBounds(gravity));
+            colliders = deformableColliders.empty() ? nullptr : &deformableColliders[0];
+
+            fluid->step(gravity, colliders, (int)deformableColliders.size(), *threadPool);
+        }
+    }
+
+    // Grains likewise, usually many steps per system step
+    for (auto granular : granulars) {
+        for (int i = granular->advance((float)step); i > 0; i--) {
+            findDeformableColliders(granular->getBounds(gravity));
+            colliders = deformableColliders.empty() ? nullptr : &deformableColliders[0];
+
+            granular->step(gravity, colliders, (int)deformableColliders.size(), *threadPool);
+        }
+    }
+
+    for (auto continuum : continua) {
+        for (int i = continuum->advance((float)step); i > 0; i--) {
+            findDeformableColliders(continuum->getBounds(gravity));
+            colliders = deformableColliders.empty() ? nullptr : &deformableColliders[0];
+
+            continuum->step(gravity, colliders, (int)deformableColliders.size(), *threadPool);
+        }
+    }
+}
+
+void System::prepareQueries() {
+    // Bodies added since the last step are not in the broadphase yet
+    if (broadphase.getCount() != bodies.size()) {
+        updateBroadphase();
+        return;
+    }
+
+    // Boxes were built before the last step moved the bodies, or bodies were
+    // moved by hand since
+    bool dirty = queriesDirty;
+
+    for (size_t i = 0; i < bodies.size() && !dirty; i++)
+        dirty = bodies[i]->getTeleported();
+
+    if (dirty)
+        updateBroadphase(0, true);
+}
+
+void System::raycast(const Collision::Ray *rays, size_t count, RayHit *hits) {
+    prepareQueries();
+
+    rayHits.resize(count);
+
+    if (count == 0)
+        return;
+
+    Collision::raycastClosest(broadphase, shapes.empty() ? nullptr : &shapes[0],
+        transforms.empty() ? nullptr : &transforms[0], rays, count, &rayHits[0],
+        *threadPool);
+
+    for (size_t i = 0; i < count; i++)
+        convertRayHit(rayHits[i], hits[i]);
+}
+
+void System::raycastAll(const Collision::Ray *rays, size_t count, std::vector<RayHit> & hits,
+    std::vector<size_t> & offsets)
+{
+    prepareQueries();
+
+    Collision::raycastAll(broadphase, shapes.empty() ? nullptr : &shapes[0],
+        transforms.empty() ? nullptr : &transforms[0], rays, count, rayHits, offsets,
+        *threadPool);
+
+    hits.resize(rayHits.size());
+
+    for (size_t i = 0; i < rayHits.size(); i++)
+        convertRayHit(rayHits[i], hits[i]);
+}
+
+void System::overlapSpheres(const glm::vec3 *centers, const float *radii, size_t count,
+    int maxResults, Body **results, int *counts)
+{
+    prepareQueries();
+
+    if (count == 0 || maxResults <= 0)
+        return;
+
+    overlapResults.resize(count * maxResults);
+
+    Collision::overlapSpheres(broadphase, shapes.empty() ? nullptr : &shapes[0],
+        transforms.empty() ? nullptr : &transforms[0], centers, radii, count, maxResults,
+        &overlapResults[0], counts, *threadPool);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t start = i * maxResults;
+        int stored = std::min(counts[i], maxResults);
+
+        for (int j = 0; j < stored; j++)
+            results[start + j] = bodies[overlapResults[start + j]].get();
+    }
+}
+
+void System::overlapBoxes(const AABB *boxes, size_t count, int maxResults, Body **results,
+    int *counts)
+{
+    prepareQueries();
+
+    if (count == 0 || maxResults <= 0)
+        return;
+
+    overlapResults.resize(count * maxResults);
+
+    Collision::overlapBoxes(broadphase, shapes.empty() ? nullptr : &shapes[0],
+        transforms.empty() ? nullptr : &transforms[0], boxes, count, maxResults,
+        &overlapResults[0], counts, *threadPool);
+
+    for (size_t i = 0; i < count; i++) {
+        size_t start = i * maxResults;
+        int stored = std::min(counts[i], maxResults);
+
+        for (int j = 0; j < stored; j++)
+            results[start + j] = bodies[overlapResults[start + j]].get();
+    }
+}
+
+void System::nearest(const glm::vec3 *points, size_t count, int k, float maxDistance,
+    PointHit *results, int *counts)
+{
+    prepareQueries();
+
+    if (count == 0 || k <= 0)
+        return;
+
+    pointHits.resize(count * k);
+
+    Collision::nearest(broadphase, shapes.empty() ? nullptr : &shapes[0],
+        transforms.empty() ? nullptr : &transforms[0], points, count, k, maxDistance,
+        &pointHits[0], counts, *threadPool);
+
+    for (size_t i = 0; i < count; i++) {
+        for (int j = 0; j < counts[i]; j++) {
+            const Collision::PointHit & hit = pointHits[i * k + j];
+            PointHit & result = results[i * k + j];
+
+            result.body = bodies[hit.index].get();
+            result.point = hit.point;
+            result.distance = hit.distance;
+        }
+    }
 }
 
 }
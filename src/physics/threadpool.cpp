@@ -0,0 +1,122 @@
+/**
+ * @file threadpool.cpp
+ *
+ * @author Sean James <seanjames777@gmail.com>
+ */
+
+#include <physics/threadpool.h>
+
+namespace Physics {
+
+ThreadPool::ThreadPool(int numThreads)
+    : func(nullptr),
+      ctx(nullptr),
+      count(0),
+      grain(1),
+      next(0),
+      active(0),
+      generation(0),
+      quit(false)
+{
+    if (numThreads <= 0)
+        numThreads = (int)std::thread::hardware_concurrency();
+
+    if (numThreads <= 0)
+        numThreads = 1;
+
+    // The calling thread is thread 0
+    for (int i = 1; i < numThreads; i++)
+        workers.push_back(std::thread(&ThreadPool::workerMain, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        quit = true;
+    }
+
+    wake.notify_all();
+
+    for (auto & worker : workers)
+        worker.join();
+}
+
+int ThreadPool::getThreadCount() const {
+    return (int)workers.size() + 1;
+}
+
+void ThreadPool::runChunks(int thread) {
+    while (true) {
+        int begin = next.fetch_add(grain);
+
+        if (begin >= count)
+            break;
+
+        int end = begin + grain < count ? begin + grain : count;
+        func(ctx, thread, begin, end);
+    }
+}
+
+void ThreadPool::workerMain(int thread) {
+    unsigned seen = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            while (!quit && generation == seen)
+                wake.wait(lock);
+
+            if (quit)
+                return;
+
+            seen = generation;
+        }
+
+        runChunks(thread);
+
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+
+            if (--active == 0)
+                done.notify_one();
+        }
+    }
+}
+
+void ThreadPool::parallelFor(int count, int grain, RangeFunc func, void *ctx) {
+    if (count <= 0)
+        return;
+
+    if (grain < 1)
+        grain = 1;
+
+    // Not worth waking anybody up
+    if (workers.empty() || count <= grain) {
+        func(ctx, 0, 0, count);
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+
+        this->func = func;
+        this->ctx = ctx;
+        this->count = count;
+        this->grain = grain;
+        this->next = 0;
+        this->active = (int)workers.size();
+        generation++;
+    }
+
+    wake.notify_all();
+
+    runChunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (active > 0)
+        done.wait(lock);
+}
+
+}
@@ -13,9 +13,11 @@
 #include <util/shader.h>
 #include <util/camera.h>
 #include <util/mesh.h>
+#include <util/geometrybuilder.h>
 #include <iostream>
 #include <physics/collision/shape.h>
 #include <physics/dynamics/body.h>
+#include <physics/dynamics/softbody.h>
 #include <physics/system.h>
 #include <util/demo.h>
 
@@ -140,6 +142,14 @@ void Demo::addMesh(std::shared_ptr<Mesh> mesh, std::shared_ptr<Body> body) {
     meshes.push_back(pair);
 }
 
+void Demo::addSoftBody(std::shared_ptr<SoftBody> softBody) {
+    MeshSoftBodyPair pair;
+    pair.mesh = GeometryBuilder::createSoftBody(*softBody);
+    pair.softBody = softBody;
+
+    softBodyMeshes.push_back(pair);
+}
+
 Demo::Demo(char *executable, std::string title, int width, int height, int shadowSize, bool vsync)
     : width(width),
       height(height),
@@ -365,6 +375,17 @@ void Demo::draw() {
         pair.mesh->flushUniforms();
     }
 
+    // Soft body surfaces are already in world space
+    for (auto & pair : softBodyMeshes) {
+        GeometryBuilder::updateSoftBody(*pair.mesh, *pair.softBody);
+
+        MeshUniforms *uniforms = pair.mesh->getUniforms();
+        uniforms->world = glm::mat4(1.0f);
+        uniforms->worldInverseTranspose = glm::mat4(1.0f);
+
+        pair.mesh->flushUniforms();
+    }
+
     sceneUniforms.viewProjection = camera->getViewProjection();
     uniformBuffer->setData(sizeof(SceneUniforms), &sceneUniforms);
     uniformBuffer->bind(0);
@@ -382,6 +403,9 @@ void Demo::draw() {
     for (auto & pair : meshes)
         pair.mesh->draw(1);
 
+    for (auto & pair : softBodyMeshes)
+        pair.mesh->draw(1);
+
     shadow_shader->unbind();
     shadowTarget->unbind();
 
@@ -402,6 +426,9 @@ void Demo::draw() {
     for (auto & pair : meshes)
         pair.mesh->draw(1);
 
+    for (auto & pair : softBodyMeshes)
+        pair.mesh->draw(1);
+
     if (wireframe)
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
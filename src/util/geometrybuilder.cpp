@@ -1,4 +1,5 @@
 #include <util/geometrybuilder.h>
+#include <physics/dynamics/softbody.h>
 #include <vector>
 
 std::shared_ptr<Mesh> GeometryBuilder::createPlane(
@@ -312,3 +313,40 @@ std::shared_ptr<Mesh> GeometryBuilder::createSphere(
 
     return mesh;
 }
+
+std::shared_ptr<Mesh> GeometryBuilder::createSoftBody(
+    Physics::SoftBody & softBody)
+{
+    std::shared_ptr<Mesh> mesh = std::make_shared<Mesh>(BufferUsageStream);
+
+    const std::vector<int> & triangles = softBody.getSurfaceTriangles();
+    std::vector<unsigned int> indices(triangles.begin(), triangles.end());
+
+    mesh->setIndices(&indices[0], indices.size());
+
+    updateSoftBody(*mesh, softBody);
+
+    return mesh;
+}
+
+void GeometryBuilder::updateSoftBody(
+    Mesh & mesh,
+    Physics::SoftBody & softBody)
+{
+    const std::vector<glm::vec3> & positions = softBody.getPositions();
+    const std::vector<int> & nodes = softBody.getSurfaceNodes();
+
+    std::vector<glm::vec3> normals;
+    softBody.computeSurfaceNormals(normals);
+
+    std::vector<MeshVertex> vertices(nodes.size());
+
+    for (size_t i = 0; i < nodes.size(); i++) {
+        vertices[i].position = positions[nodes[i]];
+        vertices[i].normal = normals[i];
+        vertices[i].color = glm::vec4(1, 1, 1, 1);
+        vertices[i].uv = glm::vec2(0, 0);
+    }
+
+    mesh.setVertices(&vertices[0], vertices.size());
+}